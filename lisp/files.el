@@ -2833,6 +2833,155 @@ node `(elisp)Character Codes' for details."
         (inhibit-file-name-operation 'insert-file-contents))
     (insert-file-contents filename visit beg end replace)))
 
+(defvar insert-file-contents-async-slice-size (* 1024 1024)
+  "Number of bytes that `insert-file-contents-async' decodes at a time.
+Emacs handles input and runs timers between these slices.")
+
+(defvar coding-detection--pending)
+
+(defun insert-file-contents-async--coding (filename data coding)
+  "Return the coding system to decode DATA, the contents of FILENAME.
+CODING is the value that `coding-system-for-read' had when the file
+was requested.  The coding system is chosen as `insert-file-contents'
+would, but is detected from the first slice of DATA only."
+  (setq coding
+        (or coding
+            (and set-auto-coding-function
+                 ;; The text is not inserted by `insert-file-contents',
+                 ;; so what the function detects is not remembered.
+                 (with-temp-buffer
+                   (set-buffer-multibyte nil)
+                   (insert (if (<= (length data) 4096)
+                               data
+                             (concat (substring data 0 1024)
+                                     (substring data -3072))))
+                   (goto-char (point-min))
+                   (let ((coding-detection--pending nil))
+                     (funcall set-auto-coding-function
+                              filename (buffer-size)))))
+            (let ((val (find-operation-coding-system
+                        'insert-file-contents filename)))
+              (if (consp val) (car val) val))
+            'undecided))
+  (if (eq (coding-system-type coding) 'undecided)
+      (let ((detected (detect-coding-string
+                       (substring data 0 (min (length data)
+                                              insert-file-contents-async-slice-size))
+                       t)))
+        (if (vectorp (coding-system-eol-type coding))
+            detected
+          (coding-system-change-eol-conversion
+           detected (coding-system-eol-type coding))))
+    coding))
+
+(defun insert-file-contents-async--insert (handle data from coding marker
+                                                  callback)
+  "Insert the slice of DATA from byte FROM at MARKER, decoding it with CODING.
+Then arrange for the next slice to be inserted, or call CALLBACK if
+it was the last one.  HANDLE is as returned by
+`insert-file-contents-async'."
+  (setcdr handle nil)
+  (let ((buffer (marker-buffer marker))
+        (end (length data))
+        to)
+    (if (not (buffer-live-p buffer))
+        (funcall callback '(error "Buffer has been killed"))
+      ;; Cut the data after a newline, unless a newline byte may be
+      ;; part of a character, or the meaning of the bytes may depend
+      ;; on what came before.
+      (setq to (if (and (< (+ from insert-file-contents-async-slice-size) end)
+                        (coding-system-get coding :ascii-compatible-p)
+                        (not (eq (coding-system-type coding) 'iso-2022)))
+                   (let ((newline (string-search
+                                   "\n" data
+                                   (+ from insert-file-contents-async-slice-size))))
+                     (if newline (1+ newline) end))
+                 end))
+      (let ((text (substring data from to)))
+        (when (buffer-local-value 'enable-multibyte-characters buffer)
+          (setq text (decode-coding-string text coding t))
+          ;; The first slice determines the end-of-line format.
+          (setq coding last-coding-system-used))
+        (with-current-buffer buffer
+          (save-excursion
+            (goto-char marker)
+            (insert text)
+            (set-marker marker (point)))))
+      (if (< to end)
+          (setcdr handle
+                  (run-at-time 0 nil #'insert-file-contents-async--insert
+                               handle data to coding marker callback))
+        (set-marker marker nil)
+        (setcar handle nil)
+        (funcall callback nil)))))
+
+(defun insert-file-contents-async (filename callback &optional beg end)
+  "Insert the contents of file FILENAME after point, without waiting.
+Return at once, then read the file in the background, and decode and
+insert it in slices of `insert-file-contents-async-slice-size' bytes,
+between which Emacs keeps responding to input.  When done, call
+CALLBACK with one argument: nil if the file was inserted, or the error
+data, as in `condition-case', if it could not be read.
+
+The text is inserted in the current buffer, where point was when this
+function was called.  The coding system is chosen as by
+`insert-file-contents', with `coding-system-for-read' taken from the
+time of the call.  BEG and END, if non-nil, are the byte offsets of the
+part of the file to insert.  Unlike `insert-file-contents', this
+function does not visit the file, does not decode formats and does not
+run `after-insert-file-functions'.
+
+Return an object to pass to `insert-file-contents-async-cancel' in
+order to stop reading and inserting the file."
+  (let* ((filename (expand-file-name filename))
+         (marker (point-marker))
+         (coding coding-system-for-read)
+         ;; The request while the file is read, and the timer of the
+         ;; next slice while it is inserted.
+         (handle (cons nil nil)))
+    (if (find-file-name-handler filename 'insert-file-contents)
+        ;; Remote and compressed files are read by their handler,
+        ;; synchronously.
+        (setcdr handle
+                (run-at-time
+                 0 nil
+                 (lambda ()
+                   (setcdr handle nil)
+                   (funcall
+                    callback
+                    (condition-case err
+                        (with-current-buffer (marker-buffer marker)
+                          (save-excursion
+                            (goto-char marker)
+                            (let ((coding-system-for-read coding))
+                              (insert-file-contents filename nil beg end)))
+                          nil)
+                      (error err))))))
+      (setcar handle
+              (file-read-async
+               filename
+               (lambda (data err)
+                 (setcar handle nil)
+                 (if err
+                     (funcall callback err)
+                   (insert-file-contents-async--insert
+                    handle data 0
+                    (insert-file-contents-async--coding filename data coding)
+                    marker callback)))
+               beg end)))
+    handle))
+
+(defun insert-file-contents-async-cancel (handle)
+  "Stop inserting a file by `insert-file-contents-async'.
+HANDLE is the value returned by that function.  The text inserted so
+far stays in the buffer, and the callback is not called."
+  (when (car handle)
+    (file-read-async-cancel (car handle))
+    (setcar handle nil))
+  (when (cdr handle)
+    (cancel-timer (cdr handle))
+    (setcdr handle nil)))
+
 (defun insert-file-1 (filename insert-func)
   (if (file-directory-p filename)
       (signal 'file-error (list "Opening input file" "Is a directory"
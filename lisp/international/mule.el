@@ -2029,16 +2029,158 @@ use \"coding: 'raw-text\" instead." :warning)
 	(if coding-system
 	    (cons coding-system 'auto-coding-functions)))))
 
+;;; Remembering the coding systems detected for large files.
+
+(defcustom coding-detection-cache-threshold (* 10 1024 1024)
+  "Minimum size of the files whose detected coding system is remembered.
+When the coding system of a file at least that many bytes long is
+detected from its contents, Emacs remembers it, so that visiting or
+reverting the file again needn't detect it again, as long as the file
+has the same inode number, device, modification time and size.  If
+nil, no coding system is remembered.
+
+See also `coding-detection-cache-file'."
+  :type '(choice (const :tag "Never" nil) integer)
+  :group 'mule
+  :version "32.1")
+
+(defcustom coding-detection-cache-file
+  (locate-user-emacs-file "coding-detection-cache")
+  "File in which the coding systems detected for large files are saved.
+If nil, they are remembered only until Emacs exits.  They are not
+saved in batch mode.  See `coding-detection-cache-threshold'."
+  :initialize #'custom-initialize-delay
+  :type '(choice (const :tag "Don't save" nil) file)
+  :group 'mule
+  :version "32.1")
+
+(defvar coding-detection--cache nil
+  "Hash table of the coding systems detected for large files, or nil.
+Keys are absolute file names, and values are conses (KEY . CODING),
+where KEY is what `coding-detection--key' returned for the file when
+CODING was detected.  nil means the cache has not been loaded yet.")
+
+(defvar coding-detection--cache-modified nil
+  "Non-nil if `coding-detection--cache' was modified since it was saved.")
+
+(defvar coding-detection--pending nil
+  "The file whose coding system is being detected, and its cache key.
+`insert-file-contents' binds this, so that it only applies to the
+file being inserted.")
+
+(defun coding-detection--key (filename)
+  "Return the key of the coding system of FILENAME in the cache.
+Return nil if the coding system of FILENAME is not to be remembered."
+  (and coding-detection-cache-threshold
+       ;; Leave remote files alone.  As this is called while
+       ;; bootstrapping, before files.el is loaded, only use primitives
+       ;; on file names and attributes.
+       (not (find-file-name-handler filename 'file-attributes))
+       (let ((attrs (file-attributes filename 'integer))
+	     (coding (find-operation-coding-system
+		      'insert-file-contents filename)))
+	 (if (consp coding)
+	     (setq coding (car coding)))
+	 (and attrs
+	      (>= (nth 7 attrs) coding-detection-cache-threshold)
+	      ;; Only remember what was detected.
+	      (or (null coding)
+		  (eq (coding-system-type coding) 'undecided)
+		  (vectorp (coding-system-eol-type coding)))
+	      ;; Inode and device numbers, modification time and size.
+	      (list (nth 10 attrs) (nth 11 attrs) (nth 5 attrs) (nth 7 attrs)
+		    ;; The result of the detection also depends on these.
+		    coding
+		    (coding-system-priority-list t)
+		    inhibit-null-byte-detection
+		    inhibit-iso-escape-detection)))))
+
+(defun coding-detection--cache ()
+  "Return the cache of the coding systems detected for large files.
+Load it from `coding-detection-cache-file' if needed."
+  (unless coding-detection--cache
+    (setq coding-detection--cache (make-hash-table :test #'equal))
+    (when (and coding-detection-cache-file
+	       (file-readable-p coding-detection-cache-file))
+      (with-temp-buffer
+	(let ((coding-system-for-read 'utf-8-emacs-unix))
+	  (insert-file-contents coding-detection-cache-file))
+	(dolist (entry (ignore-errors (read (current-buffer))))
+	  (puthash (car entry) (cdr entry) coding-detection--cache))))
+    (add-hook 'kill-emacs-hook #'coding-detection-save-cache))
+  coding-detection--cache)
+
+(defun coding-detection-save-cache ()
+  "Save the coding systems detected for large files.
+They are saved in `coding-detection-cache-file', if it is non-nil,
+unless Emacs runs in batch mode.  Forget the files that no longer
+exist.  As this is called when Emacs exits, failing to save only
+displays a message."
+  (when (and coding-detection--cache-modified coding-detection-cache-file
+	     (not noninteractive))
+    (with-demoted-errors "Error saving the coding detection cache: %S"
+      (let ((entries nil))
+	(maphash (lambda (file entry)
+		   (if (file-exists-p file)
+		       (push (cons file entry) entries)))
+		 coding-detection--cache)
+	(with-file-modes #o600
+	  (let ((coding-system-for-write 'utf-8-emacs-unix)
+		(print-length nil)
+		(print-level nil))
+	    (with-temp-file coding-detection-cache-file
+	      (prin1 entries (current-buffer))
+	      (insert "\n"))))
+	(setq coding-detection--cache-modified nil)))))
+
+(defun coding-detection--lookup (filename)
+  "Return the coding system remembered for FILENAME, or nil.
+If none is remembered, prepare `after-insert-file-set-coding' to
+remember the coding system detected for FILENAME."
+  (setq coding-detection--pending nil)
+  (let ((key (coding-detection--key filename)))
+    (when key
+      (let* ((file (expand-file-name filename))
+	     (entry (gethash file (coding-detection--cache))))
+	(if (and (equal (car entry) key)
+		 (coding-system-p (cdr entry)))
+	    (cdr entry)
+	  (setq coding-detection--pending (list file key))
+	  nil)))))
+
+(defun coding-detection--remember (visit)
+  "Remember the coding system detected for the file just visited.
+VISIT is the argument of the same name of `after-insert-file-set-coding'.
+Do nothing if `coding-system-for-read' is non-nil, as the coding
+system used was not detected then."
+  (let ((pending coding-detection--pending))
+    (setq coding-detection--pending nil)
+    (when (and visit
+	       pending
+	       (null coding-system-for-read)
+	       last-coding-system-used
+	       enable-multibyte-characters
+	       buffer-file-name
+	       (equal (car pending) (expand-file-name buffer-file-name)))
+      (puthash (car pending) (cons (cadr pending) last-coding-system-used)
+	       (coding-detection--cache))
+      (setq coding-detection--cache-modified t))))
+
 (defun set-auto-coding (filename size)
   "Return coding system for a file FILENAME of which SIZE bytes follow point.
 See `find-auto-coding' for how the coding system is found.
 Return nil if an invalid coding system is found.
+If none is found, return the coding system detected the last time
+FILENAME was visited, if it is large and has not changed since then;
+see `coding-detection-cache-threshold'.
 
 The variable `set-auto-coding-function' (which see) is set to this
 function by default."
   (let ((found (find-auto-coding filename size)))
-    (if (and found (coding-system-p (car found)))
-	(car found))))
+    (if found
+	(if (coding-system-p (car found))
+	    (car found))
+      (coding-detection--lookup filename))))
 
 (setq set-auto-coding-function #'set-auto-coding)
 
@@ -2049,6 +2191,8 @@ in the situation before this function.  Return the number of characters
 inserted, as figured in the situation after.  The two numbers can be
 different if the buffer has become unibyte.
 The optional second arg VISIT non-nil means that we are visiting a file."
+  (if coding-detection--pending
+      (coding-detection--remember visit))
   (if (and visit
 	   coding-system-for-read
 	   (not (eq coding-system-for-read 'auto-save-coding)))
@@ -5756,6 +5756,21 @@ the function `undo--wrap-and-run-primitive-undo'."
   (declare (debug (form form def-body)) (indent 2))
   `(combine-change-calls-1 ,beg ,end (lambda () ,@body)))
 
+(defmacro with-coalesced-change-calls (&rest body)
+  "Evaluate BODY, running the change hooks once for all its changes.
+The changes BODY makes to the current buffer run
+`before-change-functions' only when they are outside the region the
+functions were last run for, and `after-change-functions' once, when
+BODY is finished, for a region that contains all the changes.
+
+Unlike `combine-change-calls', BODY can change any part of the buffer.
+BODY must not rely on what the change hooks keep up to date, except
+for the cache of `syntax-ppss'.  See `coalesce-change-calls' for more
+details.
+The return value is the value of the last form in BODY."
+  (declare (indent 0) (debug t))
+  `(coalesce-change-calls (lambda () ,@body)))
+
 (defun undo--wrap-and-run-primitive-undo (beg end list)
   "Call `primitive-undo' on the undo elements in LIST.
 
@@ -3788,9 +3788,9 @@ DEFUN ("make-marker", Fmake_marker, Smake_marker, 0, 0, 0,
   p->buffer = 0;
   p->bytepos = 0;
   p->charpos = 0;
-  p->next = NULL;
   p->insertion_type = 0;
   p->need_adjustment = 0;
+  p->after_gap = 0;
   return make_lisp_ptr (p, Lisp_Vectorlike);
 }
 
@@ -3808,13 +3808,11 @@ build_marker (struct buffer *buf, ptrdiff_t charpos, ptrdiff_t bytepos)
 
   struct Lisp_Marker *m = ALLOCATE_PLAIN_PSEUDOVECTOR (struct Lisp_Marker,
 						       PVEC_MARKER);
-  m->buffer = buf;
-  m->charpos = charpos;
-  m->bytepos = bytepos;
+  m->buffer = NULL;
   m->insertion_type = 0;
   m->need_adjustment = 0;
-  m->next = BUF_MARKERS (buf);
-  BUF_MARKERS (buf) = m;
+  m->after_gap = 0;
+  attach_marker (m, buf, charpos, bytepos);
   return make_lisp_ptr (m, Lisp_Vectorlike);
 }
 
@@ -7102,20 +7100,28 @@ sweep_symbols (void)
 }
 
 /* Remove BUFFER's markers that are due to be swept.  This is needed since
-   we treat BUF_MARKERS and markers's `next' field as weak pointers.  */
+   we treat BUF_MARKERS as weak pointers.  */
 static void
 unchain_dead_markers (struct buffer *buffer)
 {
-  struct Lisp_Marker *this, **prev = &BUF_MARKERS (buffer);
+  struct buffer_text *t = buffer->text;
+  struct Lisp_Marker **markers = t->markers;
+  ptrdiff_t i, j, end = t->markers_gpt + t->markers_gap_size;
 
-  while ((this = *prev))
-    if (vectorlike_marked_p (&this->header))
-      prev = &this->next;
+  /* Squeeze the live markers towards both ends of the array, to keep
+     them on the same side of its gap.  */
+  for (i = j = 0; i < t->markers_gpt; i++)
+    if (vectorlike_marked_p (&markers[i]->header))
+      markers[j++] = markers[i];
     else
-      {
-        this->buffer = NULL;
-        *prev = this->next;
-      }
+      markers[i]->buffer = NULL;
+  t->markers_gpt = j;
+  for (i = j = t->markers_size; end < i; )
+    if (vectorlike_marked_p (&markers[--i]->header))
+      markers[--j] = markers[i];
+    else
+      markers[i]->buffer = NULL;
+  t->markers_gap_size = j - t->markers_gpt;
 }
 
 NO_INLINE /* For better stack traces */
@@ -36,6 +36,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "character.h"
 #include "buffer.h"
 #include "region-cache.h"
+#include "line-index.h"
 #include "indent.h"
 #include "blockinput.h"
 #include "keymap.h"
@@ -642,6 +643,7 @@ even if it is dead.  The return value is never nil.  */)
   b->newline_cache = 0;
   b->width_run_cache = 0;
   b->bidi_paragraph_cache = 0;
+  b->line_index = 0;
   bset_width_table (b, Qnil);
   b->prevent_redisplay_optimizations_p = 1;
 
@@ -671,6 +673,14 @@ even if it is dead.  The return value is never nil.  */)
 
   bset_mark (b, Fmake_marker ());
   BUF_MARKERS (b) = NULL;
+  BUF_MARKERS_GPT (b) = 0;
+  b->text->markers_gap_size = b->text->markers_size = 0;
+  b->text->markers_z = BEG;
+  b->text->markers_z_byte = BEG_BYTE;
+  b->text->pos_index = NULL;
+  b->text->undo_log = NULL;
+  b->text->mapped_size = 0;
+  b->text->sharing = NULL;
 
   /* Put this in the alist of all live buffers.  */
   XSETBUFFER (buffer, b);
@@ -741,7 +751,7 @@ clone_per_buffer_values (struct buffer *from, struct buffer *to)
 	{
 	  struct Lisp_Marker *m = XMARKER (obj);
 
-	  obj = build_marker (to, m->charpos, m->bytepos);
+	  obj = build_marker (to, marker_charpos (m), marker_bytepos (m));
 	  XMARKER (obj)->insertion_type = m->insertion_type;
 	}
 
@@ -876,6 +886,7 @@ Interactively, CLONE and INHIBIT-BUFFER-HOOKS are nil.  */)
   b->newline_cache = 0;
   b->width_run_cache = 0;
   b->bidi_paragraph_cache = 0;
+  b->line_index = 0;
   bset_width_table (b, Qnil);
 
 #ifdef HAVE_TREE_SITTER
@@ -964,6 +975,90 @@ Interactively, CLONE and INHIBIT-BUFFER-HOOKS are nil.  */)
   return buf;
 }
 
+DEFUN ("make-buffer-snapshot", Fmake_buffer_snapshot, Smake_buffer_snapshot,
+       1, 2, 0,
+       doc: /* Return a new buffer holding a snapshot of the text of BUFFER.
+BUFFER should be a live buffer, or the name of an existing buffer.
+The new buffer is named NAME, or if NAME is nil, a name starting with a
+space is generated for it, so it is not shown to the user.
+
+The snapshot is read-only, and has the text and the text properties
+that BUFFER has now, ignoring any narrowing, and the same syntax, case
+and category tables.  It can be searched and its text extracted like
+any buffer, for instance by a Lisp thread or a timer that indexes the
+text while the user edits BUFFER.
+
+Making a snapshot is cheap, because the snapshot and BUFFER share the
+memory holding the text until one of them is modified or needs to move
+its gap; the one changed then gets a copy of the text.  The snapshot
+does not run the hooks `kill-buffer-hook',
+`kill-buffer-query-functions' and `buffer-list-update-hook', and should
+be killed when no longer needed.  */)
+  (Lisp_Object buffer, Lisp_Object name)
+{
+  Lisp_Object buf, tem;
+  struct buffer *base, *b;
+
+  tem = buffer;
+  buffer = Fget_buffer (buffer);
+  if (NILP (buffer))
+    error ("No such buffer: `%s'", SDATA (tem));
+  base = XBUFFER (buffer);
+  if (!BUFFER_LIVE_P (base))
+    error ("Buffer has been killed");
+
+  if (NILP (name))
+    name = Fgenerate_new_buffer_name (CALLN (Fformat,
+					     build_string (" *snapshot of %s*"),
+					     BVAR (base, name)),
+				      Qnil);
+  else
+    {
+      CHECK_STRING (name);
+      if (!NILP (Fget_buffer (name)))
+	error ("Buffer name `%s' is in use", SDATA (name));
+    }
+
+  buf = Fget_buffer_create (name, Qt);
+  b = XBUFFER (buf);
+
+  /* Share the text of BASE.  */
+  block_input ();
+  free_buffer_text (b);
+  share_buffer_text (base, b->text);
+#if defined USE_MMAP_FOR_BUFFERS || defined REL_ALLOC
+  /* The text is registered with its address in the buffer that
+     allocated it, which is therefore the only one that can use it.  */
+  unshare_buffer_text (b);
+#endif
+  unblock_input ();
+
+  b->zv = BUF_Z (b);
+  b->zv_byte = BUF_Z_BYTE (b);
+  bset_enable_multibyte_characters
+    (b, BVAR (base, enable_multibyte_characters));
+  bset_undo_list (b, Qt);
+
+  INTERVAL tree = copy_intervals (buffer_intervals (base), BUF_BEG (base),
+				  BUF_Z (base) - BUF_BEG (base));
+  if (tree)
+    {
+      set_interval_object (tree, buf);
+      set_buffer_intervals (b, tree);
+    }
+
+  specpdl_ref count = SPECPDL_INDEX ();
+  record_unwind_current_buffer ();
+  set_buffer_internal (b);
+  Fset_syntax_table (BVAR (base, syntax_table));
+  Fset_category_table (BVAR (base, category_table));
+  Fset_case_table (BVAR (base, downcase_table));
+  bset_read_only (b, Qt);
+  unbind_to (count, Qnil);
+
+  return buf;
+}
+
 static void
 remove_buffer_overlay (struct buffer *b, struct Lisp_Overlay *ov)
 {
@@ -1404,7 +1499,9 @@ buffer_local_value (Lisp_Object variable, Lisp_Object buffer)
       {
 	lispfwd fwd = SYMBOL_FWD (sym);
 	if (BUFFER_OBJFWDP (fwd))
-	  result = per_buffer_value (buf, XBUFFER_OFFSET (fwd));
+	  result = (XBUFFER_OFFSET (fwd) == PER_BUFFER_VAR_OFFSET (undo_list)
+		    ? buffer_undo_list (buf)
+		    : per_buffer_value (buf, XBUFFER_OFFSET (fwd)));
 	else
 	  result = Fdefault_value (variable);
 	break;
@@ -1495,6 +1592,7 @@ No argument or nil as argument means use current buffer as BUFFER.  */)
       }
   }
 
+  buffer_undo_list (buf);
   tem = buffer_local_variables_1 (buf, PER_BUFFER_VAR_OFFSET (undo_list),
 				  Qbuffer_undo_list);
   if (!NILP (tem))
@@ -1846,7 +1944,10 @@ No argument or nil as argument means do this for the current buffer.  */)
     }
 
   if (EQ (BVAR (XBUFFER (real_buffer), undo_list), Qt))
-    bset_undo_list (XBUFFER (real_buffer), Qnil);
+    {
+      bset_undo_list (XBUFFER (real_buffer), Qnil);
+      free_undo_log (XBUFFER (real_buffer));
+    }
 
   return Qnil;
 }
@@ -1871,8 +1972,10 @@ compact_buffer (struct buffer *buffer)
       if (!EQ (BVAR(buffer, undo_list), Qt))
 	truncate_undo_list (buffer);
 
-      /* Shrink buffer gaps.  */
-      if (!buffer->text->inhibit_shrinking)
+      /* Shrink buffer gaps, but not in text mapped from a file, as
+	 that would copy it.  */
+      if (!buffer->text->inhibit_shrinking && !buffer->text->mapped_size
+	  && !buffer->text->sharing)
 	{
 	  /* If a buffer's gap size is more than 10% of the buffer
 	     size, or larger than GAP_BYTES_DFL bytes, then shrink it
@@ -1910,7 +2013,6 @@ cleaning up all windows currently displaying the buffer to be killed. */)
   Lisp_Object buffer;
   struct buffer *b;
   Lisp_Object tem;
-  struct Lisp_Marker *m;
 
   if (NILP (buffer_or_name))
     buffer = Fcurrent_buffer ();
@@ -2102,17 +2204,7 @@ cleaning up all windows currently displaying the buffer to be killed. */)
       /* Unchain all markers that belong to this indirect buffer.
 	 Don't unchain the markers that belong to the base buffer
 	 or its other indirect buffers.  */
-      struct Lisp_Marker **mp = &BUF_MARKERS (b);
-      while ((m = *mp))
-	{
-	  if (m->buffer == b)
-	    {
-	      m->buffer = NULL;
-	      *mp = m->next;
-	    }
-	  else
-	    mp = &m->next;
-	}
+      unchain_buffer_markers (b);
       /* Intervals should be owned by the base buffer (Bug#16502).  */
       i = buffer_intervals (b);
       if (i)
@@ -2126,14 +2218,7 @@ cleaning up all windows currently displaying the buffer to be killed. */)
     {
       /* Unchain all markers of this buffer and its indirect buffers.
 	 and leave them pointing nowhere.  */
-      for (m = BUF_MARKERS (b); m; )
-	{
-	  struct Lisp_Marker *next = m->next;
-	  m->buffer = 0;
-	  m->next = NULL;
-	  m = next;
-	}
-      BUF_MARKERS (b) = NULL;
+      unchain_buffer_markers (b);
       set_buffer_intervals (b, NULL);
 
       /* Perhaps we should explicitly free the interval tree here...  */
@@ -2183,6 +2268,11 @@ cleaning up all windows currently displaying the buffer to be killed. */)
       free_region_cache (b->bidi_paragraph_cache);
       b->bidi_paragraph_cache = 0;
     }
+  if (b->line_index)
+    {
+      free_line_index (b->line_index);
+      b->line_index = 0;
+    }
   bset_width_table (b, Qnil);
   unblock_input ();
 
@@ -2590,6 +2680,11 @@ results, see Info node `(elisp)Swapping Text'.  */)
 	error ("One of the buffers to swap has indirect buffers");
   }
 
+  /* The buffers sharing the text point to the text structures, whose
+     contents are swapped.  */
+  maybe_unshare_buffer_text (current_buffer);
+  maybe_unshare_buffer_text (other_buffer);
+
 #define swapfield(field, type) \
   do {							\
     type tmp##field = other_buffer->field;		\
@@ -2626,6 +2721,7 @@ results, see Info node `(elisp)Swapping Text'.  */)
   swapfield (newline_cache, struct region_cache *);
   swapfield (width_run_cache, struct region_cache *);
   swapfield (bidi_paragraph_cache, struct region_cache *);
+  swapfield (line_index, struct line_index *);
   current_buffer->prevent_redisplay_optimizations_p = 1;
   other_buffer->prevent_redisplay_optimizations_p = 1;
   swapfield (long_line_optimizations_p, bool_bf);
@@ -2664,21 +2760,21 @@ results, see Info node `(elisp)Swapping Text'.  */)
   other_buffer->text->end_unchanged = other_buffer->text->gpt;
   swap_buffer_overlays (current_buffer, other_buffer);
   {
-    struct Lisp_Marker *m;
-    for (m = BUF_MARKERS (current_buffer); m; m = m->next)
-      if (m->buffer == other_buffer)
-	m->buffer = current_buffer;
-      else
-	/* Since there's no indirect buffer in sight, markers on
-	   BUF_MARKERS(buf) should either be for `buf' or dead.  */
-	eassert (!m->buffer);
-    for (m = BUF_MARKERS (other_buffer); m; m = m->next)
-      if (m->buffer == current_buffer)
-	m->buffer = other_buffer;
-      else
+    ptrdiff_t i;
+    for (i = select_markers (current_buffer, BEG, PTRDIFF_MAX);
+	 i < BUF_MARKERS_GPT (current_buffer); i++)
+      {
 	/* Since there's no indirect buffer in sight, markers on
-	   BUF_MARKERS(buf) should either be for `buf' or dead.  */
-	eassert (!m->buffer);
+	   BUF_MARKERS(buf) should be for `buf'.  */
+	eassert (BUF_MARKERS (current_buffer)[i]->buffer == other_buffer);
+	BUF_MARKERS (current_buffer)[i]->buffer = current_buffer;
+      }
+    for (i = select_markers (other_buffer, BEG, PTRDIFF_MAX);
+	 i < BUF_MARKERS_GPT (other_buffer); i++)
+      {
+	eassert (BUF_MARKERS (other_buffer)[i]->buffer == current_buffer);
+	BUF_MARKERS (other_buffer)[i]->buffer = other_buffer;
+      }
   }
   { /* Some of the C code expects that both window markers of a
        live window points to that window's buffer.  So since we
@@ -2741,12 +2837,13 @@ If the multibyte flag was really changed, undo information of the
 current buffer is cleared.  */)
   (Lisp_Object flag)
 {
-  struct Lisp_Marker *tail, *markers;
+  struct Lisp_Marker **markers;
+  ptrdiff_t i, nmarkers;
   Lisp_Object btail, other;
   ptrdiff_t begv, zv;
   bool narrowed = (BEG != BEGV || Z != ZV);
   bool modified_p = !NILP (Fbuffer_modified_p (Qnil));
-  Lisp_Object old_undo = BVAR (current_buffer, undo_list);
+  Lisp_Object old_undo = buffer_undo_list (current_buffer);
 
   if (current_buffer->base_buffer)
     error ("Cannot do `set-buffer-multibyte' on an indirect buffer");
@@ -2761,6 +2858,7 @@ current buffer is cleared.  */)
 
   /* If the cached position is for this buffer, clear it out.  */
   clear_charpos_cache (current_buffer);
+  free_pos_index (current_buffer);
 
   if (NILP (flag))
     begv = BEGV_BYTE, zv = ZV_BYTE;
@@ -2770,6 +2868,11 @@ current buffer is cleared.  */)
   if (narrowed)
     error ("Changing multibyteness in a narrowed buffer");
 
+  maybe_unshare_buffer_text (current_buffer);
+  /* Text mapped from a file is only valid as unibyte text, as the file
+     can be changed by other programs.  */
+  if (current_buffer->text->mapped_size)
+    enlarge_buffer_text (current_buffer, 0);
   invalidate_buffer_caches (current_buffer, BEGV, ZV);
 
   if (NILP (flag))
@@ -2791,8 +2894,10 @@ current buffer is cleared.  */)
       TEMP_SET_PT_BOTH (PT_BYTE, PT_BYTE);
 
 
-      for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	tail->charpos = tail->bytepos;
+      for (i = select_markers (current_buffer, BEG, PTRDIFF_MAX);
+	   i < BUF_MARKERS_GPT (current_buffer); i++)
+	BUF_MARKERS (current_buffer)[i]->charpos
+	  = BUF_MARKERS (current_buffer)[i]->bytepos;
 
       /* Convert multibyte form of 8-bit characters to unibyte.  */
       pos = BEG;
@@ -2942,25 +3047,35 @@ current buffer is cleared.  */)
 	TEMP_SET_PT_BOTH (position, byte);
       }
 
-      tail = markers = BUF_MARKERS (current_buffer);
+      struct buffer_text *t = current_buffer->text;
+      ptrdiff_t markers_size = t->markers_size;
+
+      nmarkers = select_markers (current_buffer, BEG, PTRDIFF_MAX);
+      eassert (nmarkers == 0);
+      nmarkers = t->markers_gpt;
+      markers = t->markers;
 
       /* This prevents BYTE_TO_CHAR (that is, buf_bytepos_to_charpos) from
-	 getting confused by the markers that have not yet been updated.
-	 It is also a signal that it should never create a marker.  */
-      BUF_MARKERS (current_buffer) = NULL;
+	 getting confused by the markers that have not yet been updated.  */
+      t->markers = NULL;
+      t->markers_gpt = t->markers_gap_size = t->markers_size = 0;
 
-      for (; tail; tail = tail->next)
+      for (i = 0; i < nmarkers; i++)
 	{
-	  tail->bytepos = advance_to_char_boundary (tail->bytepos);
-	  tail->charpos = BYTE_TO_CHAR (tail->bytepos);
+	  markers[i]->bytepos = advance_to_char_boundary (markers[i]->bytepos);
+	  markers[i]->charpos = BYTE_TO_CHAR (markers[i]->bytepos);
 	}
 
-      /* Make sure no markers were put on the chain
-	 while the chain value was incorrect.  */
+      /* Make sure no markers were put in the array
+	 while the array value was incorrect.  */
       if (BUF_MARKERS (current_buffer))
 	emacs_abort ();
 
-      BUF_MARKERS (current_buffer) = markers;
+      t->markers = markers;
+      t->markers_gpt = nmarkers;
+      t->markers_size = markers_size;
+      t->markers_gap_size = markers_size - nmarkers;
+      reorder_markers (current_buffer, 0);
 
       /* Do this last, so it can calculate the new correspondences
 	 between chars and bytes.  */
@@ -3683,6 +3798,110 @@ for the rear of the overlay advance when text is inserted there
   return ov;
 }
 
+/* A comparison function for qsort, ordering itree nodes by BEGIN.  */
+
+static int
+compare_node_begins (const void *v1, const void *v2)
+{
+  struct itree_node *const *n1 = v1;
+  struct itree_node *const *n2 = v2;
+  return ((*n1)->begin > (*n2)->begin) - ((*n1)->begin < (*n2)->begin);
+}
+
+DEFUN ("make-overlays", Fmake_overlays, Smake_overlays, 1, 5, 0,
+       doc: /* Create overlays for the ranges in RANGES in BUFFER.
+RANGES is a vector whose elements have the form (BEG . END), where BEG
+and END may be integers or markers.  Return a vector of the new
+overlays, in the same order as RANGES.
+If omitted, BUFFER defaults to the current buffer.
+FRONT-ADVANCE and REAR-ADVANCE apply to all the new overlays, as for
+`make-overlay'.
+If PROPERTIES is non-nil, it is a property list giving the initial
+properties of each overlay; each overlay gets its own copy.
+
+This is much faster than calling `make-overlay' for each range when
+creating many overlays, especially if RANGES is sorted by BEG.  */)
+  (Lisp_Object ranges, Lisp_Object buffer, Lisp_Object front_advance,
+   Lisp_Object rear_advance, Lisp_Object properties)
+{
+  struct buffer *b;
+
+  CHECK_VECTOR (ranges);
+  CHECK_LIST (properties);
+  if (NILP (buffer))
+    XSETBUFFER (buffer, current_buffer);
+  else
+    CHECK_BUFFER (buffer);
+
+  b = XBUFFER (buffer);
+  if (! BUFFER_LIVE_P (b))
+    error ("Attempt to create overlay in a dead buffer");
+
+  /* Check all the ranges before creating any overlay.  */
+  ptrdiff_t n = ASIZE (ranges);
+  ptrdiff_t *positions;
+  struct itree_node **nodes;
+  USE_SAFE_ALLOCA;
+  SAFE_NALLOCA (positions, 2, n);
+  SAFE_NALLOCA (nodes, 1, n);
+  for (ptrdiff_t i = 0; i < n; i++)
+    {
+      Lisp_Object range = AREF (ranges, i);
+      CHECK_CONS (range);
+      Lisp_Object beg = XCAR (range), end = XCDR (range);
+
+      if (MARKERP (beg) && !BASE_EQ (Fmarker_buffer (beg), buffer))
+	signal_error ("Marker points into wrong buffer", beg);
+      if (MARKERP (end) && !BASE_EQ (Fmarker_buffer (end), buffer))
+	signal_error ("Marker points into wrong buffer", end);
+
+      CHECK_FIXNUM_COERCE_MARKER (beg);
+      CHECK_FIXNUM_COERCE_MARKER (end);
+
+      if (XFIXNUM (beg) > XFIXNUM (end))
+	{
+	  Lisp_Object temp;
+	  temp = beg; beg = end; end = temp;
+	}
+
+      positions[2 * i] = clip_to_bounds (BUF_BEG (b), XFIXNUM (beg), BUF_Z (b));
+      positions[2 * i + 1] = clip_to_bounds (positions[2 * i], XFIXNUM (end),
+					     BUF_Z (b));
+    }
+
+  Lisp_Object result = make_nil_vector (n);
+  ptrdiff_t start = PTRDIFF_MAX, limit = PTRDIFF_MIN;
+  bool sorted = true;
+  for (ptrdiff_t i = 0; i < n; i++)
+    {
+      Lisp_Object ov = build_overlay (! NILP (front_advance),
+				      ! NILP (rear_advance),
+				      Fcopy_sequence (properties));
+      ASET (result, i, ov);
+      nodes[i] = XOVERLAY (ov)->interval;
+      nodes[i]->begin = positions[2 * i];
+      nodes[i]->end = positions[2 * i + 1];
+      XOVERLAY (ov)->buffer = b;
+      if (i > 0 && nodes[i]->begin < nodes[i - 1]->begin)
+	sorted = false;
+      start = min (start, nodes[i]->begin);
+      limit = max (limit, nodes[i]->end);
+    }
+
+  if (!sorted)
+    qsort (nodes, n, sizeof *nodes, compare_node_begins);
+  if (! b->overlays)
+    b->overlays = itree_create ();
+  itree_insert_sorted (b->overlays, nodes, n);
+
+  /* Overlays without properties don't affect the display.  */
+  if (n > 0 && !NILP (properties))
+    modify_overlay (b, start, limit);
+
+  SAFE_FREE ();
+  return result;
+}
+
 /* Mark a section of BUF as needing redisplay because of overlays changes.  */
 
 static void
@@ -3842,6 +4061,78 @@ buffer.  */)
   return Qnil;
 }
 
+/* Return true if NODE's overlay has been detached from its buffer.  */
+
+static bool
+overlay_node_dropped_p (struct itree_node *node)
+{
+  return ! XOVERLAY (node->data)->buffer;
+}
+
+DEFUN ("delete-overlays-in", Fdelete_overlays_in, Sdelete_overlays_in,
+       2, 4, 0,
+       doc: /* Delete the overlays that overlap the region BEG ... END.
+The overlays deleted are those that `overlays-in' returns.  If NAME is
+non-nil, delete only the overlays whose property NAME is `eq' to VAL.
+Unlike `remove-overlays', this does not split overlays that extend
+beyond BEG or END, but deletes them as a whole.
+
+This is much faster than calling `delete-overlay' for each overlay when
+deleting many overlays.  Return the number of overlays deleted.  */)
+  (Lisp_Object beg, Lisp_Object end, Lisp_Object name, Lisp_Object val)
+{
+  struct buffer *b = current_buffer;
+  ptrdiff_t len, noverlays, ndeleted = 0;
+  Lisp_Object *overlay_vec;
+  specpdl_ref count = SPECPDL_INDEX ();
+
+  CHECK_FIXNUM_COERCE_MARKER (beg);
+  CHECK_FIXNUM_COERCE_MARKER (end);
+
+  if (!buffer_has_overlays ())
+    return make_fixnum (0);
+
+  specbind (Qinhibit_quit, Qt);
+
+  len = 10;
+  overlay_vec = xmalloc (len * sizeof *overlay_vec);
+  noverlays = overlays_in (XFIXNUM (beg), XFIXNUM (end), 1, &overlay_vec, &len,
+			   true, false, NULL);
+  for (ptrdiff_t i = 0; i < noverlays; i++)
+    if (NILP (name) || EQ (Foverlay_get (overlay_vec[i], name), val))
+      overlay_vec[ndeleted++] = overlay_vec[i];
+
+  /* Detach the overlays first, then remove them from the tree in one
+     go, if that is faster.  */
+  bool bulk = itree_bulk_p (b->overlays, ndeleted);
+  for (ptrdiff_t i = 0; i < ndeleted; i++)
+    {
+      Lisp_Object overlay = overlay_vec[i];
+      struct Lisp_Overlay *ov = XOVERLAY (overlay);
+
+      /* See Fdelete_overlay.  */
+      if (!windows_or_buffers_changed
+	  && (!NILP (Foverlay_get (overlay, Qbefore_string))
+	      || !NILP (Foverlay_get (overlay, Qafter_string))))
+	b->prevent_redisplay_optimizations_p = 1;
+
+      if (!bulk)
+	drop_overlay (ov);
+      else
+	{
+	  if (!NILP (ov->plist))
+	    modify_overlay (b, overlay_start (ov), overlay_end (ov));
+	  ov->buffer = NULL;
+	}
+    }
+  if (bulk && ndeleted > 0)
+    itree_remove_if (b->overlays, overlay_node_dropped_p);
+
+  xfree (overlay_vec);
+  unbind_to (count, Qnil);
+  return make_fixnum (ndeleted);
+}
+
 /* Overlay dissection functions.  */
 
 DEFUN ("overlay-start", Foverlay_start, Soverlay_start, 1, 1, 0,
@@ -4609,6 +4900,232 @@ mmap_realloc (void **var, size_t nbytes)
 #endif /* USE_MMAP_FOR_BUFFERS */
 
 
+
+/***********************************************************************
+			 Mapping files as buffer text
+ ***********************************************************************/
+
+#if (defined HAVE_MMAP && !defined WINDOWSNT)
+
+#include <sys/mman.h>
+
+#if defined MAP_FIXED && (defined MAP_ANONYMOUS || defined MAP_ANON)
+# define MAP_BUFFER_TEXT
+
+/* Old versions of macOS only define MAP_ANON, not MAP_ANONYMOUS.  */
+# ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+#endif
+#endif
+
+/* Set when the SIGBUS handler found that a file mapped as buffer text
+   was truncated, and cleared when this is reported.  */
+bool volatile buffer_text_truncated;
+
+#ifdef MAP_BUFFER_TEXT
+
+/* The mappings made by map_buffer_text, which buffer_text_sigbus looks
+   up from the SIGBUS handler.  A slot is free if its base is NULL.  */
+static struct text_mapping
+{
+  /* The start of the mapping, and its size.  */
+  unsigned char *volatile base;
+  ptrdiff_t size;
+
+  /* Whether the end of the mapping was replaced by zeros because the
+     file was truncated.  */
+  bool volatile truncated;
+} text_mappings[64];
+
+/* The page size, which the SIGBUS handler cannot ask for.  */
+static uintptr_t text_mapping_page;
+
+/* Make the NBYTES bytes at the start of the file open on FD the text
+   of buffer B, which must be empty and unibyte, by mapping the file
+   into memory.  The text is put at the end of the gap, where
+   decode_coding_gap expects it.  Return false if the file cannot be
+   mapped.
+
+   The mapping is private, so the system copies the pages of the text
+   that are changed, but the others follow the changes of the file.
+   This is harmless in a unibyte buffer, where any byte is valid, but
+   the text is copied to ordinary memory when the buffer is first
+   modified or made multibyte, or when the text needs to be reallocated
+   (see enlarge_buffer_text).  If the file is truncated, the pages past
+   its end are replaced by zeros when they are accessed, see
+   buffer_text_sigbus.  */
+
+bool
+map_buffer_text (struct buffer *b, int fd, ptrdiff_t nbytes)
+{
+  ptrdiff_t page = getpagesize ();
+  ptrdiff_t head = ROUNDUP (GAP_BYTES_DFL, page);
+  ptrdiff_t size;
+  unsigned char *base;
+  struct text_mapping *m;
+
+  eassert (BUF_BEG (b) == BUF_Z (b) && !b->text->mapped_size
+	   && NILP (BVAR (b, enable_multibyte_characters)));
+
+  for (m = text_mappings; m->base; m++)
+    if (m == text_mappings + countof (text_mappings) - 1)
+      return false;
+
+  /* Leave room for a gap of GAP_BYTES_DFL bytes before the file's
+     pages, and for the anchor after the text.  */
+  if (ckd_add (&size, nbytes, head + page))
+    return false;
+  size = ROUNDUP (size, page);
+
+  base = mmap (NULL, size, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return false;
+  if (mmap (base + head, nbytes, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_FIXED, fd, 0)
+      == MAP_FAILED)
+    {
+      munmap (base, size);
+      return false;
+    }
+
+  block_input ();
+  text_mapping_page = page;
+  m->size = size;
+  m->truncated = false;
+  m->base = base;
+  free_buffer_text (b);
+  BUF_BEG_ADDR (b) = base + head - GAP_BYTES_DFL;
+  BUF_GAP_SIZE (b) = GAP_BYTES_DFL + nbytes;
+  b->text->mapped_size = size;
+
+  /* Put an anchor, in case the file grew since it was mapped.  */
+  *BUF_Z_ADDR (b) = 0;
+  unblock_input ();
+  return true;
+}
+
+/* Unmap the text of B, which is mapped from a file.  */
+
+static void
+unmap_buffer_text (struct buffer_text *t)
+{
+  /* The mapping starts at the page containing the beginning of the
+     text, see map_buffer_text.  */
+  uintptr_t page = getpagesize ();
+  unsigned char *base = (unsigned char *) ((uintptr_t) t->beg & -page);
+  struct text_mapping *m;
+
+  for (m = text_mappings; m->base != base; m++)
+    eassert (m < text_mappings + countof (text_mappings) - 1);
+  m->base = NULL;
+
+  munmap (base, t->mapped_size);
+  t->mapped_size = 0;
+}
+
+/* Called from the SIGBUS handler when accessing ADDR fails.  If ADDR is
+   in the text of a buffer mapped from a file, which means the file was
+   truncated, replace the pages of the mapping from ADDR on by private
+   zero-filled ones, so that the access can be retried, note that this
+   must be reported, and return true.  Otherwise, return false.  */
+
+bool
+buffer_text_sigbus (void *addr)
+{
+  unsigned char *p = addr;
+
+  for (struct text_mapping *m = text_mappings;
+       m < text_mappings + countof (text_mappings); m++)
+    {
+      unsigned char *base = m->base;
+
+      if (base && base <= p && p < base + m->size)
+	{
+	  unsigned char *from
+	    = (unsigned char *) ((uintptr_t) p & -text_mapping_page);
+
+	  if (mmap (from, base + m->size - from, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)
+	      == MAP_FAILED)
+	    return false;
+	  m->truncated = true;
+	  buffer_text_truncated = true;
+	  pending_signals = true;
+	  return true;
+	}
+    }
+
+  return false;
+}
+
+/* Signal a file-error about the buffers whose mapped text was found
+   truncated by buffer_text_sigbus.  The text itself remains valid.  */
+
+void
+report_truncated_buffer_text (void)
+{
+  Lisp_Object tail, buffer, files = Qnil;
+
+  buffer_text_truncated = false;
+  FOR_EACH_LIVE_BUFFER (tail, buffer)
+    {
+      struct buffer *b = XBUFFER (buffer);
+      unsigned char *base
+	= (unsigned char *) ((uintptr_t) BUF_BEG_ADDR (b)
+			     & -text_mapping_page);
+
+      if (!b->text->mapped_size || b->base_buffer)
+	continue;
+      for (struct text_mapping *m = text_mappings;
+	   m < text_mappings + countof (text_mappings); m++)
+	if (m->base == base && m->truncated)
+	  files = Fcons (NILP (BVAR (b, filename))
+			 ? BVAR (b, name) : BVAR (b, filename),
+			 files);
+    }
+
+  /* Forget the truncations, including those of the mappings that only
+     snapshots still use.  */
+  for (struct text_mapping *m = text_mappings;
+       m < text_mappings + countof (text_mappings); m++)
+    m->truncated = false;
+
+  if (!NILP (files))
+    xsignal2 (Qfile_error, build_string ("Mapped file was truncated"),
+	      Fnreverse (files));
+}
+
+#else  /* !MAP_BUFFER_TEXT */
+
+bool
+map_buffer_text (struct buffer *b, int fd, ptrdiff_t nbytes)
+{
+  return false;
+}
+
+static void
+unmap_buffer_text (struct buffer_text *t)
+{
+  emacs_abort ();
+}
+
+bool
+buffer_text_sigbus (void *addr)
+{
+  return false;
+}
+
+void
+report_truncated_buffer_text (void)
+{
+  buffer_text_truncated = false;
+}
+
+#endif	/* !MAP_BUFFER_TEXT */
+
+
 
 /***********************************************************************
 			    Buffer-text Allocation
@@ -4640,6 +5157,38 @@ alloc_buffer_text (struct buffer *b, ptrdiff_t nbytes)
   unblock_input ();
 }
 
+/* Remove the text T from the list of those sharing its text.  */
+
+static void
+unlink_buffer_text (struct buffer_text *t)
+{
+  struct buffer_text *prev = t->sharing;
+
+  while (prev->sharing != t)
+    prev = prev->sharing;
+  prev->sharing = t->sharing == prev ? NULL : t->sharing;
+  t->sharing = NULL;
+}
+
+/* Give buffer B a copy of the text it shares with other buffers.  */
+
+void
+unshare_buffer_text (struct buffer *b)
+{
+  unsigned char *old_beg = b->text->beg;
+  ptrdiff_t nbytes
+    = BUF_Z_BYTE (b) - BUF_BEG_BYTE (b) + BUF_GAP_SIZE (b) + 1;
+
+  block_input ();
+  /* Copy the gap as well, as it can already hold bytes about to be
+     inserted.  */
+  alloc_buffer_text (b, nbytes);
+  memcpy (b->text->beg, old_beg, nbytes);
+  unlink_buffer_text (b->text);
+  b->text->mapped_size = 0;
+  unblock_input ();
+}
+
 /* Enlarge buffer B's text buffer by DELTA bytes.  DELTA < 0 means
    shrink it.  */
 
@@ -4652,8 +5201,12 @@ enlarge_buffer_text (struct buffer *b, ptrdiff_t delta)
   ptrdiff_t old_nbytes =
     BUF_Z_BYTE (b) - BUF_BEG_BYTE (b) + BUF_GAP_SIZE (b) + 1;
   ptrdiff_t new_nbytes = old_nbytes + delta;
+  bool mapped = b->text->mapped_size != 0;
+  bool shared = b->text->sharing != NULL;
 
-  if (pdumper_object_p (old_beg))
+  /* Text that is in the dump file, mapped from a file or shared with
+     other buffers must be copied to newly allocated memory.  */
+  if (pdumper_object_p (old_beg) || mapped || shared)
     b->text->beg = NULL;
   else
     old_beg = NULL;
@@ -4678,30 +5231,83 @@ enlarge_buffer_text (struct buffer *b, ptrdiff_t delta)
   if (old_beg)
     memcpy (p, old_beg, min (old_nbytes, new_nbytes));
 
+  if (shared)
+    {
+      unlink_buffer_text (b->text);
+      b->text->mapped_size = 0;
+    }
+  else if (mapped)
+    {
+      BUF_BEG_ADDR (b) = old_beg;
+      unmap_buffer_text (b->text);
+    }
+
   BUF_BEG_ADDR (b) = p;
   unblock_input ();
 }
 
 
-/* Free buffer B's text buffer.  */
+/* Make T share the text of buffer B, which B can then change only
+   after giving itself a copy of it.  T is added to the list of those
+   sharing the text, and must be released with release_buffer_text
+   when no longer needed.  */
 
-static void
-free_buffer_text (struct buffer *b)
+void
+share_buffer_text (struct buffer *b, struct buffer_text *t)
+{
+  block_input ();
+  t->beg = b->text->beg;
+  t->gpt = b->text->gpt;
+  t->gpt_byte = b->text->gpt_byte;
+  t->z = b->text->z;
+  t->z_byte = b->text->z_byte;
+  t->gap_size = b->text->gap_size;
+  t->mapped_size = b->text->mapped_size;
+  t->sharing = b->text->sharing ? b->text->sharing : b->text;
+  b->text->sharing = t;
+  unblock_input ();
+}
+
+/* Free the memory holding the text T, unless it is shared with other
+   texts.  */
+
+void
+release_buffer_text (struct buffer_text *t)
 {
   block_input ();
 
-  if (!pdumper_object_p (b->text->beg))
+  if (t->sharing)
+    {
+      /* Leave the text to the buffers still sharing it.  */
+      unlink_buffer_text (t);
+      t->mapped_size = 0;
+    }
+  else if (t->mapped_size)
+    unmap_buffer_text (t);
+  else if (!pdumper_object_p (t->beg))
     {
 #if defined USE_MMAP_FOR_BUFFERS
-      mmap_free ((void **) &b->text->beg);
+      mmap_free ((void **) &t->beg);
 #elif defined REL_ALLOC
-      r_alloc_free ((void **) &b->text->beg);
+      r_alloc_free ((void **) &t->beg);
 #else
-      xfree (b->text->beg);
+      xfree (t->beg);
 #endif
     }
 
-  BUF_BEG_ADDR (b) = NULL;
+  t->beg = NULL;
+  unblock_input ();
+}
+
+/* Free buffer B's text buffer.  */
+
+static void
+free_buffer_text (struct buffer *b)
+{
+  block_input ();
+  release_buffer_text (b->text);
+  free_pos_index (b);
+  free_undo_log (b);
   unblock_input ();
 }
 
@@ -5808,6 +6414,13 @@ at all, these scans may be slow.  If `cache-long-scans' is non-nil,
 results of these scans are cached.  This doesn't help too much if
 paragraphs are of the reasonable (few thousands of characters) size.
 
+Counting the lines of a big buffer, as done by `line-number-at-pos',
+`goto-line' and the line number in the mode line, also takes time
+proportional to the number of lines counted.  If `cache-long-scans' is
+non-nil, the number of newlines in each part of the buffer is recorded
+so that lines can be counted in time roughly proportional to the
+logarithm of the buffer size.
+
 The caches require no explicit maintenance; their accuracy is
 maintained internally by the Emacs primitives.  Enabling or disabling
 the cache should not affect the behavior of any of the motion
@@ -6088,6 +6701,7 @@ There is no reason to change that value except for debugging purposes.  */);
   defsubr (&Sfind_buffer);
   defsubr (&Sget_buffer_create);
   defsubr (&Smake_indirect_buffer);
+  defsubr (&Smake_buffer_snapshot);
   defsubr (&Sgenerate_new_buffer_name);
   defsubr (&Sbuffer_name);
   defsubr (&Sbuffer_last_name);
@@ -6117,8 +6731,10 @@ There is no reason to change that value except for debugging purposes.  */);
 
   defsubr (&Soverlayp);
   defsubr (&Smake_overlay);
+  defsubr (&Smake_overlays);
   defsubr (&Sdelete_overlay);
   defsubr (&Sdelete_all_overlays);
+  defsubr (&Sdelete_overlays_in);
   defsubr (&Smove_overlay);
   defsubr (&Soverlay_start);
   defsubr (&Soverlay_end);
@@ -138,8 +138,9 @@ enum { BEG = 1, BEG_BYTE = BEG };
 /* Compaction count.  */
 #define BUF_COMPACT(buf) ((buf)->text->compact)
 
-/* Marker chain of buffer.  */
+/* Marker array of buffer, and the start of its gap.  */
 #define BUF_MARKERS(buf) ((buf)->text->markers)
+#define BUF_MARKERS_GPT(buf) ((buf)->text->markers_gpt)
 
 #define BUF_UNCHANGED_MODIFIED(buf) \
   ((buf)->text->unchanged_modified)
@@ -165,6 +166,7 @@ extern void temp_set_point_both (struct buffer *,
 				 ptrdiff_t, ptrdiff_t);
 extern void set_point_from_marker (Lisp_Object);
 extern void enlarge_buffer_text (struct buffer *, ptrdiff_t);
+extern bool map_buffer_text (struct buffer *, int, ptrdiff_t);
 
 INLINE void
 SET_PT (ptrdiff_t position)
@@ -285,14 +287,46 @@ struct buffer_text
     /* Properties of this buffer's text.  */
     INTERVAL intervals;
 
-    /* The markers that refer to this buffer.
-       This is actually a single marker ---
-       successive elements in its marker `chain'
-       are the other markers referring to this buffer.
-       This is a singly linked unordered list, which means that it's
-       very cheap to add a marker to the list and it's also very cheap
-       to move a marker within a buffer.  */
-    struct Lisp_Marker *markers;
+    /* The markers that refer to this buffer, sorted by position.
+       Like the text itself, this array has a gap, of MARKERS_GAP_SIZE
+       slots starting at index MARKERS_GPT, out of MARKERS_SIZE.
+
+       The markers before the gap hold their positions as usual; those
+       after it have their `after_gap' flag set and hold them relative
+       to MARKERS_Z and MARKERS_Z_BYTE.  Adjusting the markers for an
+       insertion or a deletion moves the gap to where it happens, and
+       then only changes MARKERS_Z and MARKERS_Z_BYTE and the positions
+       of the markers inside the deleted text or at the insertion point.
+       The array does not preserve markers from garbage collection;
+       instead, markers are removed from it when freed by GC.  */
+    struct Lisp_Marker **markers;
+    ptrdiff_t markers_gpt, markers_gap_size, markers_size;
+
+    /* What the positions of the markers after the gap are relative
+       to.  These move along with Z and Z_BYTE as the markers are
+       adjusted for insertions and deletions.  */
+    ptrdiff_t markers_z, markers_z_byte;
+
+    /* Correspondences between character and byte positions recorded
+       by the conversions between them, or NULL.  See marker.c.  */
+    struct pos_index *pos_index;
+
+    /* The records of changes made to the text for undo, that precede
+       the elements of the undo list, or NULL.  See undo.c.  */
+    struct undo_log *undo_log;
+
+    /* If nonzero, the text is mapped from a file by map_buffer_text,
+       and this is the size of the mapping, which starts at the page
+       containing BEG.  */
+    ptrdiff_t mapped_size;
+
+    /* If non-NULL, the text is shared with the snapshots made by
+       make-buffer-snapshot, or with the buffer they were made of, or
+       with a text made by share_buffer_text.  All the buffer_text
+       structures sharing the same text are linked in a circular list
+       through this field.  The text is copied by unshare_buffer_text
+       before it is changed or moved.  */
+    struct buffer_text *sharing;
 
     /* Usually false.  Temporarily true in decode_coding_gap to
        prevent Fgarbage_collect from shrinking the gap and losing
@@ -697,6 +731,11 @@ struct buffer
   struct region_cache *width_run_cache;
   struct region_cache *bidi_paragraph_cache;
 
+  /* If cache-long-scans is non-nil and lines were counted over a long
+     stretch of text, the line index of this buffer, see line-index.h.
+     Like the caches above, it is NULL in indirect buffers.  */
+  struct line_index *line_index;
+
   /* Non-zero means disable redisplay optimizations when rebuilding the glyph
      matrices (but not when redrawing).  */
   bool_bf prevent_redisplay_optimizations_p : 1;
@@ -909,6 +948,25 @@ BUFFER_FLOOR_OF (ptrdiff_t bytepos)
   return BEGV <= GPT && GPT_BYTE <= bytepos ? GPT_BYTE : BEGV_BYTE;
 }
 
+/* Return the character position of marker M, or its last position
+   if it points nowhere.  */
+
+INLINE ptrdiff_t
+marker_charpos (struct Lisp_Marker const *m)
+{
+  return (m->after_gap ? m->charpos + m->buffer->text->markers_z
+	  : m->charpos);
+}
+
+/* Likewise for the byte position.  */
+
+INLINE ptrdiff_t
+marker_bytepos (struct Lisp_Marker const *m)
+{
+  return (m->after_gap ? m->bytepos + m->buffer->text->markers_z_byte
+	  : m->bytepos);
+}
+
 /* The BUF_BEGV[_BYTE], BUF_ZV[_BYTE], and BUF_PT[_BYTE] functions cannot
    be used for assignment; use SET_BUF_* functions below for that.  */
 
@@ -1268,6 +1326,20 @@ extern void mmap_set_vars (bool);
 extern void restore_buffer (Lisp_Object);
 extern void set_buffer_if_live (Lisp_Object);
 extern Lisp_Object build_overlay (bool, bool, Lisp_Object);
+extern void unshare_buffer_text (struct buffer *);
+extern void share_buffer_text (struct buffer *, struct buffer_text *);
+extern void release_buffer_text (struct buffer_text *);
+
+/* Give B a copy of its text if it shares it with other buffers.
+   This must be done before changing the text of B, or moving the gap,
+   except for storing bytes in the gap.  */
+
+INLINE void
+maybe_unshare_buffer_text (struct buffer *b)
+{
+  if (b->text->sharing)
+    unshare_buffer_text (b);
+}
 
 /* Return B as a struct buffer pointer, defaulting to the current buffer.  */
 
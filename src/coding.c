@@ -292,6 +292,8 @@ encode_coding_XXX (struct coding_system *coding)
 #include <wchar.h>
 #endif /* HAVE_WCHAR_H */
 
+#include <nproc.h>
+
 #include "lisp.h"
 #include "character.h"
 #include "buffer.h"
@@ -1123,6 +1125,29 @@ alloc_destination (struct coding_system *coding, ptrdiff_t nbytes,
 #define UTF_8_BOM_2 0xBB
 #define UTF_8_BOM_3 0xBF
 
+/* Return the number of ASCII bytes at the start of the text from P to
+   END.  Look at a machine word at a time, since runs of ASCII are the
+   common case even in non-ASCII text.  */
+
+static ptrdiff_t
+ascii_run_length (const unsigned char *p, const unsigned char *end)
+{
+  const unsigned char *start = p;
+  size_t high_bits = SIZE_MAX / UCHAR_MAX * 0x80;
+
+  while (end - p >= sizeof (size_t))
+    {
+      size_t word;
+      memcpy (&word, p, sizeof word);
+      if (word & high_bits)
+	break;
+      p += sizeof word;
+    }
+  while (p < end && UTF_8_1_OCTET_P (*p))
+    p++;
+  return p - start;
+}
+
 /* Unlike the other detect_coding_XXX, this function counts the number
    of characters and checks the EOL format.  */
 
@@ -1157,6 +1182,14 @@ detect_coding_utf_8 (struct coding_system *coding,
       int c, c1, c2, c3, c4;
 
       src_base = src;
+      /* Each byte of a run of ASCII is a character, even in CR LF.  */
+      ptrdiff_t run = ascii_run_length (src, src_end);
+      if (run > 1)
+	{
+	  src += run - 1;
+	  nchars += run - 1;
+	  src_base = src;
+	}
       ONE_MORE_BYTE (c);
       if (c < 0 || UTF_8_1_OCTET_P (c))
 	{
@@ -1250,6 +1283,7 @@ decode_coding_utf_8 (struct coding_system *coding)
   bool eol_dos
     = !inhibit_eol_conversion && EQ (CODING_ID_EOL_TYPE (coding->id), Qdos);
   int byte_after_cr = -1;
+  const unsigned char *src_after_cr UNINIT;
 
   if (bom != utf_without_bom)
     {
@@ -1296,39 +1330,81 @@ decode_coding_utf_8 (struct coding_system *coding)
 	  break;
 	}
 
-      /* In the simple case, rapidly handle ordinary characters */
-      if (multibytep && ! eol_dos
+      /* In the simple case, rapidly handle ordinary characters: runs
+	 of ASCII, and valid multibyte sequences in unibyte sources.
+	 Anything else, including the end of the source, is left to the
+	 general code below.  */
+      if (byte_after_cr < 0
 	  && charbuf < charbuf_end - 6 && src < src_end - 6)
 	{
 	  while (charbuf < charbuf_end - 6 && src < src_end - 6)
 	    {
 	      c1 = *src;
-	      if (c1 & 0x80)
-		break;
-	      src++;
-	      consumed_chars++;
-	      *charbuf++ = c1;
-
-	      c1 = *src;
-	      if (c1 & 0x80)
-		break;
-	      src++;
-	      consumed_chars++;
-	      *charbuf++ = c1;
-
-	      c1 = *src;
-	      if (c1 & 0x80)
+	      if (UTF_8_1_OCTET_P (c1))
+		{
+		  ptrdiff_t room = min (src_end - 6 - src,
+					charbuf_end - 6 - charbuf);
+		  if (eol_dos)
+		    {
+		      /* Leave CRs to the general code.  */
+		      const unsigned char *cr = memchr (src, '\r', room);
+		      if (cr)
+			room = cr - src;
+		      if (room == 0)
+			break;
+		    }
+		  ptrdiff_t run = ascii_run_length (src, src + room);
+		  for (ptrdiff_t i = 0; i < run; i++)
+		    charbuf[i] = src[i];
+		  charbuf += run;
+		  src += run;
+		  consumed_chars += run;
+		  continue;
+		}
+	      if (multibytep)
 		break;
-	      src++;
-	      consumed_chars++;
-	      *charbuf++ = c1;
 
-	      c1 = *src;
-	      if (c1 & 0x80)
+	      int len;
+	      c2 = src[1];
+	      if (! UTF_8_EXTRA_OCTET_P (c2))
 		break;
-	      src++;
-	      consumed_chars++;
-	      *charbuf++ = c1;
+	      if (UTF_8_2_OCTET_LEADING_P (c1))
+		{
+		  c = ((c1 & 0x1F) << 6) | (c2 & 0x3F);
+		  if (c < 128)
+		    break;
+		  len = 2;
+		}
+	      else
+		{
+		  c3 = src[2];
+		  if (! UTF_8_EXTRA_OCTET_P (c3))
+		    break;
+		  if (UTF_8_3_OCTET_LEADING_P (c1))
+		    {
+		      c = (((c1 & 0xF) << 12)
+			   | ((c2 & 0x3F) << 6) | (c3 & 0x3F));
+		      if (c < 0x800 || (c >= 0xd800 && c < 0xe000))
+			break;
+		      len = 3;
+		    }
+		  else
+		    {
+		      c4 = src[3];
+		      if (! UTF_8_4_OCTET_LEADING_P (c1)
+			  || ! UTF_8_EXTRA_OCTET_P (c4))
+			break;
+		      c = (((c1 & 0x7) << 18) | ((c2 & 0x3F) << 12)
+			   | ((c3 & 0x3F) << 6) | (c4 & 0x3F));
+		      if (c < 0x10000)
+			break;
+		      len = 4;
+		    }
+		}
+	      /* Each byte of a unibyte source counts as a character.  */
+	      src += len;
+	      consumed_chars += len;
+	      *charbuf++ = c;
 	    }
 	  /* If we handled at least one character, restart the main loop.  */
 	  if (src != src_base)
@@ -1336,7 +1412,12 @@ decode_coding_utf_8 (struct coding_system *coding)
 	}
 
       if (byte_after_cr >= 0)
-	c1 = byte_after_cr, byte_after_cr = -1;
+	{
+	  /* The character starts at the byte read after CR.  */
+	  c1 = byte_after_cr, byte_after_cr = -1;
+	  src_base = src_after_cr;
+	  consumed_chars_base--;
+	}
       else
 	ONE_MORE_BYTE (c1);
       if (c1 < 0)
@@ -1346,7 +1427,10 @@ decode_coding_utf_8 (struct coding_system *coding)
       else if (UTF_8_1_OCTET_P (c1))
 	{
 	  if (eol_dos && c1 == '\r')
-	    ONE_MORE_BYTE (byte_after_cr);
+	    {
+	      src_after_cr = src;
+	      ONE_MORE_BYTE (byte_after_cr);
+	    }
 	  c = c1;
 	}
       else
@@ -6176,15 +6260,21 @@ check_ascii (struct coding_system *coding)
   src = coding->source;
   end = src + coding->src_bytes;
 
+  ptrdiff_t run = ascii_run_length (src, end);
   if (inhibit_eol_conversion
       || SYMBOLP (eol_type))
     {
       /* We don't have to check EOL format.  */
-      while (src < end && !( *src & 0x80))
-	{
-	  if (*src++ == '\n')
-	    eol_seen |= EOL_SEEN_LF;
-	}
+      if (memchr (src, '\n', run))
+	eol_seen |= EOL_SEEN_LF;
+      src += run;
+    }
+  else if (! memchr (src, '\r', run))
+    {
+      /* Without CRs, the EOL format can only be LF.  */
+      if (memchr (src, '\n', run))
+	eol_seen |= EOL_SEEN_LF;
+      src += run;
     }
   else
     {
@@ -6252,12 +6342,28 @@ check_utf_8 (struct coding_system *coding)
   /* We look ahead one byte for CR LF.  */
   end = coding->source + coding->src_bytes - 1;
   eol_seen = coding->eol_seen;
+  /* The bytes before this are known to be ASCII.  */
+  const unsigned char *ascii_end = src;
   while (src < end)
     {
       int c = *src;
 
       if (UTF_8_1_OCTET_P (*src))
 	{
+	  /* Skip ASCII up to the next CR at once.  */
+	  if (ascii_end <= src)
+	    ascii_end = src + ascii_run_length (src, end);
+	  const unsigned char *stop = memchr (src, '\r', ascii_end - src);
+	  if (!stop)
+	    stop = ascii_end;
+	  if (stop != src)
+	    {
+	      if (memchr (src, '\n', stop - src))
+		eol_seen |= EOL_SEEN_LF;
+	      nchars += stop - src;
+	      src = stop;
+	      continue;
+	    }
 	  src++;
 	  if (c < 0x20)
 	    {
@@ -6493,6 +6599,68 @@ adjust_coding_eol_type (struct coding_system *coding, int eol_seen)
   return eol_type;
 }
 
+/* The number of blocks of a sample taken by coding_detection_sample.  */
+enum { CODING_DETECTION_SAMPLE_BLOCKS = 16 };
+
+/* If `coding-detection-sample-size' is a natural number, and the
+   SRC_BYTES bytes at SRC are more than twice as many, return a sample
+   of those bytes allocated by xmalloc, and store its size in
+   *SAMPLE_BYTES.  Otherwise, return NULL.
+
+   The sample consists of blocks from the head and the tail of the
+   text, and from evenly spaced places in between.  As far as
+   possible, the blocks consist of whole lines, so that multibyte
+   sequences and ISO 2022 designations are not cut.  */
+
+static unsigned char *
+coding_detection_sample (const unsigned char *src, ptrdiff_t src_bytes,
+			 ptrdiff_t *sample_bytes)
+{
+  enum { nblocks = CODING_DETECTION_SAMPLE_BLOCKS };
+  ptrdiff_t block;
+  unsigned char *sample, *p;
+
+  if (! FIXNATP (Vcoding_detection_sample_size)
+      || src_bytes / 2 <= XFIXNAT (Vcoding_detection_sample_size))
+    return NULL;
+  block = XFIXNAT (Vcoding_detection_sample_size) / nblocks;
+  if (block == 0)
+    return NULL;
+
+  p = sample = xmalloc (block * nblocks);
+  for (int i = 0; i < nblocks; i++)
+    {
+      const unsigned char *beg, *end, *nl;
+
+      beg = src + (src_bytes - block) / (nblocks - 1) * i;
+      end = i < nblocks - 1 ? beg + block : src + src_bytes;
+      if (i == nblocks - 1)
+	beg = end - block;
+      if (i > 0)
+	{
+	  nl = memchr (beg, '\n', end - beg);
+	  if (nl)
+	    beg = nl + 1;
+	  else
+	    for (int n = 0; n < 4 && beg < end && (*beg & 0x80); n++)
+	      beg++;
+	}
+      if (i < nblocks - 1)
+	{
+	  nl = memrchr (beg, '\n', end - beg);
+	  if (nl)
+	    end = nl + 1;
+	  else
+	    for (int n = 0; n < 4 && beg < end && (end[-1] & 0x80); n++)
+	      end--;
+	}
+      memcpy (p, beg, end - beg);
+      p += end - beg;
+    }
+  *sample_bytes = p - sample;
+  return sample;
+}
+
 /* Detect how a text specified in CODING is encoded.  If a coding
    system is detected, update fields of CODING by the detected coding
    system.  */
@@ -6524,6 +6692,18 @@ detect_coding (struct coding_system *coding)
       bool inhibit_ied = inhibit_flag (coding->spec.undecided.inhibit_ied,
 				       inhibit_iso_escape_detection);
       bool prefer_utf_8 = coding->spec.undecided.prefer_utf_8;
+      const unsigned char *source = coding->source;
+      ptrdiff_t src_bytes = coding->src_bytes, sample_bytes;
+      unsigned char *sample
+	= (coding->src_multibyte ? NULL
+	   : coding_detection_sample (source, src_bytes, &sample_bytes));
+
+      if (sample)
+	{
+	  coding->source = sample;
+	  coding->src_chars = coding->src_bytes = sample_bytes;
+	  src_end = sample + sample_bytes;
+	}
 
       coding->head_ascii = 0;
       for (src = coding->source; src < src_end; src++)
@@ -6696,6 +6876,18 @@ detect_coding (struct coding_system *coding)
 		  break;
 		}
 	}
+
+      if (sample)
+	{
+	  /* What was found out about the sample, other than its
+	     encoding, doesn't apply to the whole text.  */
+	  xfree (sample);
+	  coding->source = source;
+	  coding->src_chars = coding->src_bytes = src_bytes;
+	  coding->head_ascii = -1;
+	  coding->detected_utf8_bytes = coding->detected_utf8_chars = -1;
+	  coding->eol_seen = EOL_SEEN_NONE;
+	}
     }
   else if (XFIXNUM (CODING_ATTR_CATEGORY (CODING_ID_ATTRS (coding->id)))
 	   == coding_category_utf_8_auto)
@@ -6755,6 +6947,46 @@ detect_coding (struct coding_system *coding)
 }
 
 
+/* Return the EOL format to use for a decoded text in which the EOL
+   formats EOL_SEEN were seen.  */
+
+static int
+decoded_eol_seen (int eol_seen)
+{
+  /* Handle DOS-style EOLs in a file with stray ^M characters.  */
+  if ((eol_seen & EOL_SEEN_CRLF) != 0
+      && (eol_seen & EOL_SEEN_CR) != 0
+      && (eol_seen & EOL_SEEN_LF) == 0)
+    return EOL_SEEN_CRLF;
+  else if (eol_seen != EOL_SEEN_NONE
+	   && eol_seen != EOL_SEEN_LF
+	   && eol_seen != EOL_SEEN_CRLF
+	   && eol_seen != EOL_SEEN_CR)
+    return EOL_SEEN_LF;
+  return eol_seen;
+}
+
+/* Return true if deleting characters at the end of the text from FROM
+   to TO in the current buffer, after moving the text down, is the same
+   as deleting those characters where they are.  This is so unless a
+   marker, point, or a change of text properties lies inside the text.  */
+
+static bool
+decode_eol_squeeze_p (ptrdiff_t from, ptrdiff_t to)
+{
+  if (to - from < 2)
+    return true;
+  if (from < PT && PT < to)
+    return false;
+  if (select_markers (current_buffer, from + 1, to - 1)
+      < BUF_MARKERS_GPT (current_buffer))
+    return false;
+  return (!buffer_intervals (current_buffer)
+	  || EQ (Fnext_property_change (make_fixnum (from), Qnil,
+					make_fixnum (to)),
+		 make_fixnum (to)));
+}
+
 static void
 decode_eol (struct coding_system *coding)
 {
@@ -6775,40 +7007,37 @@ decode_eol (struct coding_system *coding)
     {
       int eol_seen = EOL_SEEN_NONE;
 
-      for (p = pbeg; p < pend; p++)
+      /* Jump from CR to CR with memchr; in between, only whether
+	 there is a LF matters.  */
+      for (p = pbeg; p < pend; )
 	{
-	  if (*p == '\n')
+	  unsigned char *cr = memchr (p, '\r', pend - p);
+	  unsigned char *stop = cr ? cr : pend;
+
+	  if (! (eol_seen & EOL_SEEN_LF) && memchr (p, '\n', stop - p))
 	    eol_seen |= EOL_SEEN_LF;
-	  else if (*p == '\r')
+	  if (! cr)
+	    break;
+	  if (cr + 1 < pend && cr[1] == '\n')
 	    {
-	      if (p + 1 < pend && *(p + 1) == '\n')
-		{
-		  eol_seen |= EOL_SEEN_CRLF;
-		  p++;
-		}
-	      else
-		eol_seen |= EOL_SEEN_CR;
+	      eol_seen |= EOL_SEEN_CRLF;
+	      p = cr + 2;
+	    }
+	  else
+	    {
+	      eol_seen |= EOL_SEEN_CR;
+	      p = cr + 1;
 	    }
 	}
-      /* Handle DOS-style EOLs in a file with stray ^M characters.  */
-      if ((eol_seen & EOL_SEEN_CRLF) != 0
-	  && (eol_seen & EOL_SEEN_CR) != 0
-	  && (eol_seen & EOL_SEEN_LF) == 0)
-	eol_seen = EOL_SEEN_CRLF;
-      else if (eol_seen != EOL_SEEN_NONE
-	  && eol_seen != EOL_SEEN_LF
-	  && eol_seen != EOL_SEEN_CRLF
-	  && eol_seen != EOL_SEEN_CR)
-	eol_seen = EOL_SEEN_LF;
+      eol_seen = decoded_eol_seen (eol_seen);
       if (eol_seen != EOL_SEEN_NONE)
 	eol_type = adjust_coding_eol_type (coding, eol_seen);
     }
 
   if (EQ (eol_type, Qmac))
     {
-      for (p = pbeg; p < pend; p++)
-	if (*p == '\r')
-	  *p = '\n';
+      for (p = pbeg; (p = memchr (p, '\r', pend - p)); p++)
+	*p = '\n';
     }
   else if (EQ (eol_type, Qdos))
     {
@@ -6822,6 +7051,37 @@ decode_eol (struct coding_system *coding)
 	 current codebase.  */
       eassert (!NILP (coding->dst_object));
 
+      if (decode_eol_squeeze_p (pos, pos + coding->produced_char))
+	{
+	  /* Move the text between CRLFs down over the CRs, and then
+	     delete as many characters at the end of the text.  As CR
+	     never occurs inside a multibyte sequence, we need not
+	     look at characters.  */
+	  unsigned char *run = pbeg, *dst = pbeg, *cr;
+
+	  for (p = pbeg; (cr = memchr (p, '\r', pend - p)); )
+	    {
+	      p = cr + 1;
+	      if (p < pend && *p == '\n')
+		{
+		  if (dst != run)
+		    memmove (dst, run, cr - run);
+		  dst += cr - run;
+		  run = p;
+		  n++;
+		}
+	    }
+	  if (n > 0)
+	    {
+	      ptrdiff_t end = pos + coding->produced_char;
+	      ptrdiff_t end_byte = pos_byte + coding->produced;
+
+	      memmove (dst, run, pend - run);
+	      del_range_2 (end - n, end_byte - n, end, end_byte, 0);
+	    }
+	  pos_end = pos_byte;
+	}
+
       while (pos_byte < pos_end)
 	{
 	  int incr;
@@ -7367,7 +7627,7 @@ decode_coding (struct coding_system *coding)
       if (MODIFF <= SAVE_MODIFF)
 	record_first_change ();
 
-      undo_list = BVAR (current_buffer, undo_list);
+      undo_list = buffer_undo_list (current_buffer);
       bset_undo_list (current_buffer, Qt);
       /* Avoid running nested *-change-functions via 'produce_annotation'.
          Our callers run *-change-functions over the whole region anyway.  */
@@ -7732,6 +7992,107 @@ consume_chars (struct coding_system *coding, Lisp_Object translation_table,
 }
 
 
+/* Return true if encoding text with CODING produces the bytes of the
+   internal representation of that text, apart from end-of-lines, as
+   long as the text contains no eight-bit characters.  This holds for
+   the UTF-8 and raw-text coding systems without pre-write conversion
+   and translation table.  */
+
+static bool
+encode_coding_eol_only_p (struct coding_system *coding)
+{
+  Lisp_Object attrs = CODING_ID_ATTRS (coding->id);
+
+  if (coding->encoder == encode_coding_utf_8)
+    {
+      if (CODING_UTF_8_BOM (coding) != utf_without_bom
+	  || ! NILP (get_translation_table (attrs, 1, NULL)))
+	return false;
+    }
+  else if (coding->encoder != encode_coding_raw_text)
+    return false;
+
+  return (NILP (CODING_ATTR_PRE_WRITE (attrs))
+	  && ! (coding->mode & CODING_MODE_SELECTIVE_DISPLAY)
+	  && ! (coding->common_flags & (CODING_ANNOTATE_COMPOSITION_MASK
+					| CODING_ANNOTATE_CHARSET_MASK)));
+}
+
+/* Return true if encoding text with CODING produces exactly the bytes
+   of the internal representation of that text, as long as the text
+   contains no eight-bit characters.  Callers can then write the text
+   out as it is, without calling encode_coding_object.  */
+
+bool
+encode_coding_identity_p (struct coding_system *coding)
+{
+  Lisp_Object eol_type
+    = inhibit_eol_conversion ? Qunix : CODING_ID_EOL_TYPE (coding->id);
+
+  return ((EQ (eol_type, Qunix) || VECTORP (eol_type))
+	  && encode_coding_eol_only_p (coding));
+}
+
+/* If CODING only has to convert the end-of-lines of its source text
+   (see encode_coding_eol_only_p), encode the whole text into
+   CODING->destination at once, looking for newlines with memchr
+   instead of going through CODING->charbuf character by character.
+   Return true if this was done.  */
+
+static bool
+encode_eol_directly (struct coding_system *coding)
+{
+  const unsigned char *src, *p, *end;
+  ptrdiff_t nbytes = coding->src_bytes;
+  Lisp_Object eol_type;
+  unsigned char *dst;
+  ptrdiff_t nlines = 0;
+
+  if (! NILP (coding->dst_object) || coding->dst_multibyte
+      || ! encode_coding_eol_only_p (coding))
+    return false;
+  coding_set_source (coding);
+  src = coding->source;
+  end = src + nbytes;
+  if (memchr (src, 0xC0, nbytes) || memchr (src, 0xC1, nbytes))
+    return false;
+
+  eol_type = inhibit_eol_conversion ? Qunix : CODING_ID_EOL_TYPE (coding->id);
+  if (EQ (eol_type, Qdos))
+    for (p = src; (p = memchr (p, '\n', end - p)); p++)
+      nlines++;
+  if (coding->dst_bytes < nbytes + nlines)
+    coding_alloc_by_realloc (coding, nbytes + nlines - coding->dst_bytes);
+
+  dst = coding->destination;
+  if (EQ (eol_type, Qdos))
+    {
+      const unsigned char *nl;
+
+      for (p = src; (nl = memchr (p, '\n', end - p)); p = nl + 1)
+	{
+	  memcpy (dst, p, nl - p);
+	  dst += nl - p;
+	  *dst++ = '\r';
+	  *dst++ = '\n';
+	}
+      memcpy (dst, p, end - p);
+    }
+  else
+    {
+      memcpy (dst, src, nbytes);
+      if (EQ (eol_type, Qmac))
+	for (unsigned char *q = dst, *qend = dst + nbytes;
+	     (q = memchr (q, '\n', qend - q)); q++)
+	  *q = '\r';
+    }
+
+  coding->consumed = nbytes;
+  coding->consumed_char = coding->src_chars;
+  coding->produced = coding->produced_char = nbytes + nlines;
+  return true;
+}
+
 /* Encode the text at CODING->src_object into CODING->dst_object.
    CODING->src_object is a buffer or a string.
    CODING->dst_object is a buffer or nil.
@@ -7780,6 +8141,12 @@ encode_coding (struct coding_system *coding)
   coding->produced = coding->produced_char = 0;
   record_conversion_result (coding, CODING_RESULT_SUCCESS);
 
+  if (encode_eol_directly (coding))
+    {
+      SAFE_FREE ();
+      return;
+    }
+
   ALLOC_CONVERSION_WORK_AREA (coding, coding->src_chars);
 
   if (coding->encoder == encode_coding_ccl)
@@ -7898,7 +8265,423 @@ coding_restore_undo_list (Lisp_Object arg)
   bset_undo_list (buf, undo_list);
 }
 
-/* Decode the *last* BYTES of the gap and insert them at point.  */
+/* Decoding large texts in parallel.
+
+   When a large text in a stateless coding system, UTF-8 or raw-text,
+   is read into a multibyte buffer, decode_coding_gap splits it into
+   chunks and decodes them in several threads.  A chunk never starts
+   in the middle of a multibyte sequence or between CR and LF, so that
+   each chunk decodes to what it would in the whole text.  This is
+   done in two passes: the first one counts the characters and bytes
+   each chunk produces and the EOLs it contains, and the second one,
+   once the EOL format and the place of each chunk in the gap are
+   known, stores the decoded chunks there.  The threads only look at
+   the bytes of their chunks, never at Lisp objects; the current
+   thread does its share of the work and waits for the others.  */
+
+/* The minimum number of bytes decoded by each thread.  */
+enum { PARALLEL_DECODE_CHUNK = 1 << 20 };
+
+/* The maximum number of threads decoding a text.  */
+enum { PARALLEL_DECODE_THREADS = 16 };
+
+struct decode_chunk
+{
+  /* The chunk is SOURCE[FROM..TO) and is stored at DESTINATION + DST.  */
+  ptrdiff_t from, to, dst;
+
+  /* The numbers of characters and bytes it produces, before EOL
+     conversion, and the number of CR LF sequences it contains.  */
+  ptrdiff_t chars, bytes, crlf;
+
+  /* The EOL formats seen in the chunk.  */
+  int eol_seen;
+
+  /* True if the chunk contains a sequence for a raw-byte character,
+     whose multibyte form is shorter.  Such text is left to
+     decode_coding.  */
+  bool raw_byte_char;
+};
+
+struct parallel_decode
+{
+  sys_mutex_t mutex;
+  sys_cond_t done;
+
+  /* The number of other threads still running, and the index of the
+     next chunk to process.  Both are protected by MUTEX.  */
+  int running, next;
+
+  int nchunks;
+  struct decode_chunk chunks[PARALLEL_DECODE_THREADS * 4];
+  const unsigned char *source;
+  unsigned char *destination;
+
+  /* True if the text is in UTF-8, false if it is raw-text.  */
+  bool utf_8;
+
+  /* True if the EOLs must be looked at in the first pass.  */
+  bool count_eol;
+
+  /* True in the second pass.  */
+  bool store;
+
+  /* In the second pass, the EOL conversion to perform: EOL_SEEN_CRLF
+     for DOS, EOL_SEEN_CR for Mac, and EOL_SEEN_NONE for none.  */
+  int eol;
+};
+
+/* Return the length of the valid UTF-8 sequence for a non-ASCII
+   character at P, which is before END, or 0 if there is none.  This
+   accepts the same sequences as decode_coding_utf_8, which are the
+   multibyte forms of the same characters, except for the sequences of
+   raw-byte characters, for which it returns -1.  */
+
+static int
+utf_8_sequence_length (const unsigned char *p, const unsigned char *end)
+{
+  int c1 = p[0], len, c, i;
+
+  if (UTF_8_2_OCTET_LEADING_P (c1))
+    len = 2, c = c1 & 0x1F;
+  else if (UTF_8_3_OCTET_LEADING_P (c1))
+    len = 3, c = c1 & 0xF;
+  else if (UTF_8_4_OCTET_LEADING_P (c1))
+    len = 4, c = c1 & 0x7;
+  else if (UTF_8_5_OCTET_LEADING_P (c1))
+    len = 5, c = c1 & 0x3;
+  else
+    return 0;
+  if (end - p < len)
+    return 0;
+  for (i = 1; i < len; i++)
+    {
+      if (! UTF_8_EXTRA_OCTET_P (p[i]))
+	return 0;
+      c = (c << 6) | (p[i] & 0x3F);
+    }
+  switch (len)
+    {
+    case 2: return c < 0x80 ? 0 : len;
+    case 3: return c < 0x800 || (c >= 0xD800 && c < 0xE000) ? 0 : len;
+    case 4: return c < 0x10000 ? 0 : len;
+    default: return (c < 0x200000 || c > MAX_CHAR ? 0
+		     : c > MAX_5_BYTE_CHAR ? -1 : len);
+    }
+}
+
+/* First pass: count what CHUNK produces.  */
+
+static void
+measure_decode_chunk (struct parallel_decode *pd, struct decode_chunk *chunk)
+{
+  const unsigned char *p = pd->source + chunk->from;
+  const unsigned char *end = pd->source + chunk->to;
+  ptrdiff_t chars = 0, bytes = 0;
+
+  while (p < end)
+    {
+      if (UTF_8_1_OCTET_P (*p))
+	{
+	  ptrdiff_t run = ascii_run_length (p, end);
+	  p += run;
+	  chars += run;
+	  bytes += run;
+	  continue;
+	}
+      int len = pd->utf_8 ? utf_8_sequence_length (p, end) : 0;
+      if (len < 0)
+	{
+	  chunk->raw_byte_char = true;
+	  return;
+	}
+      p += len ? len : 1;
+      chars++;
+      bytes += len ? len : 2;
+    }
+  chunk->raw_byte_char = false;
+  chunk->chars = chars;
+  chunk->bytes = bytes;
+
+  chunk->crlf = 0;
+  chunk->eol_seen = EOL_SEEN_NONE;
+  if (pd->count_eol)
+    {
+      ptrdiff_t lf = 0, cr = 0;
+
+      for (p = pd->source + chunk->from;
+	   (p = memchr (p, '\n', end - p)); p++)
+	lf++;
+      for (p = pd->source + chunk->from;
+	   (p = memchr (p, '\r', end - p)); p++)
+	{
+	  cr++;
+	  if (p + 1 < end && p[1] == '\n')
+	    chunk->crlf++;
+	}
+      if (lf > chunk->crlf)
+	chunk->eol_seen |= EOL_SEEN_LF;
+      if (chunk->crlf > 0)
+	chunk->eol_seen |= EOL_SEEN_CRLF;
+      if (cr > chunk->crlf)
+	chunk->eol_seen |= EOL_SEEN_CR;
+    }
+}
+
+/* Second pass: store the decoded CHUNK.  */
+
+static void
+store_decode_chunk (struct parallel_decode *pd, struct decode_chunk *chunk)
+{
+  const unsigned char *p = pd->source + chunk->from;
+  const unsigned char *end = pd->source + chunk->to;
+  unsigned char *dst = pd->destination + chunk->dst;
+
+  if (chunk->bytes == chunk->to - chunk->from
+      && (pd->eol == EOL_SEEN_NONE
+	  || ! (chunk->eol_seen & (EOL_SEEN_CRLF | EOL_SEEN_CR))))
+    {
+      memcpy (dst, p, end - p);
+      return;
+    }
+
+  while (p < end)
+    {
+      if (UTF_8_1_OCTET_P (*p))
+	{
+	  const unsigned char *run_end = p + ascii_run_length (p, end);
+
+	  if (pd->eol == EOL_SEEN_NONE)
+	    {
+	      memcpy (dst, p, run_end - p);
+	      dst += run_end - p;
+	      p = run_end;
+	    }
+	  else
+	    while (p < run_end)
+	      {
+		const unsigned char *cr = memchr (p, '\r', run_end - p);
+		if (! cr)
+		  cr = run_end;
+		memcpy (dst, p, cr - p);
+		dst += cr - p;
+		p = cr;
+		if (p < run_end)
+		  {
+		    p++;
+		    if (pd->eol == EOL_SEEN_CR)
+		      *dst++ = '\n';
+		    else if (! (p < end && *p == '\n'))
+		      *dst++ = '\r';
+		  }
+	      }
+	  continue;
+	}
+      int len = pd->utf_8 ? utf_8_sequence_length (p, end) : 0;
+      if (0 < len)
+	{
+	  memcpy (dst, p, len);
+	  dst += len;
+	  p += len;
+	}
+      else
+	dst += BYTE8_STRING (*p++, dst);
+    }
+}
+
+/* Process the chunks of PD until none is left.  */
+
+static void
+parallel_decode_chunks (struct parallel_decode *pd)
+{
+  while (true)
+    {
+      sys_mutex_lock (&pd->mutex);
+      int i = pd->next < pd->nchunks ? pd->next++ : -1;
+      sys_mutex_unlock (&pd->mutex);
+      if (i < 0)
+	return;
+      if (pd->store)
+	store_decode_chunk (pd, &pd->chunks[i]);
+      else
+	measure_decode_chunk (pd, &pd->chunks[i]);
+    }
+}
+
+static void *
+parallel_decode_thread (void *arg)
+{
+  struct parallel_decode *pd = arg;
+
+  parallel_decode_chunks (pd);
+  sys_mutex_lock (&pd->mutex);
+  if (--pd->running == 0)
+    sys_cond_signal (&pd->done);
+  sys_mutex_unlock (&pd->mutex);
+  return NULL;
+}
+
+/* Process all the chunks of PD in NTHREADS threads, including the
+   current one.  If threads cannot be created, the current thread does
+   all the work.  */
+
+static void
+run_parallel_decode (struct parallel_decode *pd, int nthreads)
+{
+  pd->next = 0;
+  for (int i = 1; i < nthreads; i++)
+    {
+      sys_thread_t thread;
+
+      sys_mutex_lock (&pd->mutex);
+      pd->running++;
+      sys_mutex_unlock (&pd->mutex);
+      if (! sys_thread_create (&thread, parallel_decode_thread, pd))
+	{
+	  sys_mutex_lock (&pd->mutex);
+	  pd->running--;
+	  sys_mutex_unlock (&pd->mutex);
+	  break;
+	}
+    }
+  parallel_decode_chunks (pd);
+  sys_mutex_lock (&pd->mutex);
+  while (pd->running > 0)
+    sys_cond_wait (&pd->done, &pd->mutex);
+  sys_mutex_unlock (&pd->mutex);
+}
+
+/* Decode the last BYTES of the gap in parallel and insert them at
+   point, if CODING allows it.  Return true if this was done.  */
+
+static bool
+decode_coding_gap_parallel (struct coding_system *coding, ptrdiff_t bytes)
+{
+  Lisp_Object attrs = CODING_ID_ATTRS (coding->id);
+  Lisp_Object eol_type;
+  struct parallel_decode pd;
+  ptrdiff_t chars, produced, from;
+  int nthreads, i;
+
+  if (bytes < 2 * PARALLEL_DECODE_CHUNK
+      || ! (coding->mode & CODING_MODE_LAST_BLOCK)
+      || disable_ascii_optimization
+      || coding->src_multibyte
+      || ! coding->dst_multibyte
+      || ! NILP (CODING_ATTR_POST_READ (attrs))
+      || ! NILP (get_translation_table (attrs, 0, NULL)))
+    return false;
+  if (EQ (CODING_ATTR_TYPE (attrs), Qutf_8))
+    {
+      if (CODING_UTF_8_BOM (coding) != utf_without_bom)
+	return false;
+      pd.utf_8 = true;
+    }
+  else if (EQ (CODING_ATTR_TYPE (attrs), Qraw_text))
+    pd.utf_8 = false;
+  else
+    return false;
+
+  nthreads = num_processors (NPROC_CURRENT);
+  nthreads = min (nthreads, PARALLEL_DECODE_THREADS);
+  nthreads = min (nthreads, bytes / PARALLEL_DECODE_CHUNK);
+  nthreads = max (nthreads, 1);
+
+  /* Split the text in a few chunks per thread, so that the threads
+     finish at about the same time.  */
+  pd.nchunks = min (nthreads * 4, bytes / PARALLEL_DECODE_CHUNK);
+  pd.source = GAP_END_ADDR - bytes;
+  for (i = 0, from = 0; i < pd.nchunks; i++)
+    {
+      ptrdiff_t to = bytes / pd.nchunks * (i + 1);
+      int n;
+
+      if (i == pd.nchunks - 1)
+	to = bytes;
+      else
+	{
+	  /* Don't split a multibyte sequence.  A chunk may start with a
+	     byte following 4 continuation bytes, since no valid
+	     sequence has more.  */
+	  for (n = 0;
+	       n < 4 && to < bytes && UTF_8_EXTRA_OCTET_P (pd.source[to]);
+	       n++)
+	    to++;
+	  if (to < bytes && pd.source[to - 1] == '\r'
+	      && pd.source[to] == '\n')
+	    to++;
+	}
+      pd.chunks[i].from = from;
+      pd.chunks[i].to = from = to;
+    }
+
+  eol_type = CODING_ID_EOL_TYPE (coding->id);
+  if (inhibit_eol_conversion)
+    eol_type = Qunix;
+  pd.count_eol = ! EQ (eol_type, Qunix);
+  pd.store = false;
+  pd.running = 0;
+  sys_mutex_init (&pd.mutex);
+  sys_cond_init (&pd.done);
+  run_parallel_decode (&pd, nthreads);
+
+  for (i = 0; i < pd.nchunks; i++)
+    if (pd.chunks[i].raw_byte_char)
+      {
+	sys_cond_destroy (&pd.done);
+	sys_mutex_destroy (&pd.mutex);
+	return false;
+      }
+
+  if (VECTORP (eol_type))
+    {
+      int eol_seen = EOL_SEEN_NONE;
+
+      for (i = 0; i < pd.nchunks; i++)
+	eol_seen |= pd.chunks[i].eol_seen;
+      eol_seen = decoded_eol_seen (eol_seen);
+      if (eol_seen != EOL_SEEN_NONE)
+	eol_type = adjust_coding_eol_type (coding, eol_seen);
+    }
+  pd.eol = (EQ (eol_type, Qdos) ? EOL_SEEN_CRLF
+	    : EQ (eol_type, Qmac) ? EOL_SEEN_CR
+	    : EOL_SEEN_NONE);
+
+  for (i = 0, chars = produced = 0; i < pd.nchunks; i++)
+    {
+      struct decode_chunk *chunk = &pd.chunks[i];
+
+      if (pd.eol == EOL_SEEN_CRLF)
+	{
+	  chunk->chars -= chunk->crlf;
+	  chunk->bytes -= chunk->crlf;
+	}
+      chunk->dst = produced;
+      chars += chunk->chars;
+      produced += chunk->bytes;
+    }
+
+  /* The decoded text is stored at the head of the gap, so the gap
+     must hold it as well as the source at its tail.  */
+  if (GAP_SIZE < bytes + produced)
+    coding_alloc_by_making_gap (coding, 0, bytes + produced - GAP_SIZE);
+  pd.source = GAP_END_ADDR - bytes;
+  pd.destination = GPT_ADDR;
+  pd.store = true;
+  run_parallel_decode (&pd, nthreads);
+  sys_cond_destroy (&pd.done);
+  sys_mutex_destroy (&pd.mutex);
+
+  coding->produced = produced;
+  coding->produced_char = chars;
+  insert_from_gap (chars, produced, 0, coding->insert_before_markers);
+  return true;
+}
+
+/* Decode the *last* BYTES of the gap and insert them at point.
+   Unless CODING_MODE_LAST_BLOCK is set in CODING->mode, the bytes are
+   part of a longer text, and those that end it in the middle of a
+   character are left in CODING->carryover, as decode_coding does.  */
 void
 decode_coding_gap (struct coding_system *coding, ptrdiff_t bytes)
 {
@@ -7924,12 +8707,20 @@ decode_coding_gap (struct coding_system *coding, ptrdiff_t bytes)
   coding->eol_seen = EOL_SEEN_NONE;
   if (CODING_REQUIRE_DETECTION (coding))
     detect_coding (coding);
+  coding->carryover_bytes = 0;
   attrs = CODING_ID_ATTRS (coding->id);
+  bool last_block = coding->mode & CODING_MODE_LAST_BLOCK;
   if (! disable_ascii_optimization
       && ! coding->src_multibyte
       && ! NILP (CODING_ATTR_ASCII_COMPAT (attrs))
       && NILP (CODING_ATTR_POST_READ (attrs))
-      && NILP (get_translation_table (attrs, 0, NULL)))
+      && NILP (get_translation_table (attrs, 0, NULL))
+      /* A CR ending a block may be followed by an LF in the next one,
+	 and only the first block of a text can start with a BOM.  */
+      && (last_block
+	  || (GAP_END_ADDR[-1] != '\r'
+	      && (! EQ (CODING_ATTR_TYPE (attrs), Qutf_8)
+		  || CODING_UTF_8_BOM (coding) == utf_without_bom))))
     {
       ptrdiff_t chars = coding->head_ascii;
       if (chars < 0)
@@ -7938,13 +8729,15 @@ decode_coding_gap (struct coding_system *coding, ptrdiff_t bytes)
 	{
 	  /* There exists a non-ASCII byte.  */
 	  if (EQ (CODING_ATTR_TYPE (attrs), Qutf_8)
-	      && coding->detected_utf8_bytes == coding->src_bytes)
+	      && (coding->detected_utf8_bytes == coding->src_bytes
+		  || coding->detected_utf8_bytes < 0))
 	    {
 	      if (coding->detected_utf8_chars >= 0)
 		chars = coding->detected_utf8_chars;
 	      else
 		chars = check_utf_8 (coding);
-	      if (CODING_UTF_8_BOM (coding) != utf_without_bom
+	      if (chars >= 0
+		  && CODING_UTF_8_BOM (coding) != utf_without_bom
 		  && coding->head_ascii == 0
 		  && coding->source[0] == UTF_8_BOM_1
 		  && coding->source[1] == UTF_8_BOM_2
@@ -8002,9 +8795,10 @@ decode_coding_gap (struct coding_system *coding, ptrdiff_t bytes)
 	  return;
 	}
     }
+  if (decode_coding_gap_parallel (coding, bytes))
+    return;
   code_conversion_save (0, 0);
 
-  coding->mode |= CODING_MODE_LAST_BLOCK;
   current_buffer->text->inhibit_shrinking = 1;
   decode_coding (coding);
   current_buffer->text->inhibit_shrinking = 0;
@@ -8013,7 +8807,7 @@ decode_coding_gap (struct coding_system *coding, ptrdiff_t bytes)
     {
       ptrdiff_t prev_Z = Z, prev_Z_BYTE = Z_BYTE;
       Lisp_Object val;
-      Lisp_Object undo_list = BVAR (current_buffer, undo_list);
+      Lisp_Object undo_list = buffer_undo_list (current_buffer);
 
       record_unwind_protect (coding_restore_undo_list,
 			     Fcons (undo_list, Fcurrent_buffer ()));
@@ -8101,10 +8895,10 @@ decode_coding_object (struct coding_system *coding,
 	move_gap_both (from, from_byte);
       if (BASE_EQ (src_object, dst_object))
 	{
-	  struct Lisp_Marker *tail;
-
-	  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
+	  for (ptrdiff_t i = select_markers (current_buffer, from, to);
+	       i < BUF_MARKERS_GPT (current_buffer); i++)
 	    {
+	      struct Lisp_Marker *tail = BUF_MARKERS (current_buffer)[i];
 	      tail->need_adjustment
 		= tail->charpos == (tail->insertion_type ? from : to);
 	      need_marker_adjustment |= tail->need_adjustment;
@@ -8179,7 +8973,7 @@ decode_coding_object (struct coding_system *coding,
     {
       ptrdiff_t prev_Z = Z, prev_Z_BYTE = Z_BYTE;
       Lisp_Object val;
-      Lisp_Object undo_list = BVAR (current_buffer, undo_list);
+      Lisp_Object undo_list = buffer_undo_list (current_buffer);
       specpdl_ref count1 = SPECPDL_INDEX ();
 
       record_unwind_protect (coding_restore_undo_list,
@@ -8233,25 +9027,30 @@ decode_coding_object (struct coding_system *coding,
 
       if (need_marker_adjustment)
 	{
-	  struct Lisp_Marker *tail;
+	  ptrdiff_t end
+	    = (NILP (BVAR (current_buffer, enable_multibyte_characters))
+	       ? from_byte + coding->produced : from + coding->produced_char);
+	  ptrdiff_t start = select_markers (current_buffer, from, end);
 
-	  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	    if (tail->need_adjustment)
-	      {
-		tail->need_adjustment = 0;
-		if (tail->insertion_type)
-		  {
-		    tail->bytepos = from_byte;
-		    tail->charpos = from;
-		  }
-		else
-		  {
-		    tail->bytepos = from_byte + coding->produced;
-		    tail->charpos
-		      = (NILP (BVAR (current_buffer, enable_multibyte_characters))
-			 ? tail->bytepos : from + coding->produced_char);
-		  }
-	      }
+	  for (ptrdiff_t i = start; i < BUF_MARKERS_GPT (current_buffer); i++)
+	    {
+	      struct Lisp_Marker *tail = BUF_MARKERS (current_buffer)[i];
+	      if (tail->need_adjustment)
+		{
+		  tail->need_adjustment = 0;
+		  if (tail->insertion_type)
+		    {
+		      tail->bytepos = from_byte;
+		      tail->charpos = from;
+		    }
+		  else
+		    {
+		      tail->bytepos = from_byte + coding->produced;
+		      tail->charpos = end;
+		    }
+		}
+	    }
+	  reorder_markers (current_buffer, start);
 	}
     }
 
@@ -8321,12 +9120,14 @@ encode_coding_object (struct coding_system *coding,
   bool same_buffer = false;
   if (BASE_EQ (src_object, dst_object) && BUFFERP (src_object))
     {
-      struct Lisp_Marker *tail;
+      struct buffer *b = XBUFFER (src_object);
 
       same_buffer = true;
 
-      for (tail = BUF_MARKERS (XBUFFER (src_object)); tail; tail = tail->next)
+      for (ptrdiff_t i = select_markers (b, from, to);
+	   i < BUF_MARKERS_GPT (b); i++)
 	{
+	  struct Lisp_Marker *tail = BUF_MARKERS (b)[i];
 	  tail->need_adjustment
 	    = tail->charpos == (tail->insertion_type ? from : to);
 	  need_marker_adjustment |= tail->need_adjustment;
@@ -8488,25 +9289,30 @@ encode_coding_object (struct coding_system *coding,
 
       if (need_marker_adjustment)
 	{
-	  struct Lisp_Marker *tail;
+	  ptrdiff_t end
+	    = (NILP (BVAR (current_buffer, enable_multibyte_characters))
+	       ? from_byte + coding->produced : from + coding->produced_char);
+	  ptrdiff_t start = select_markers (current_buffer, from, end);
 
-	  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	    if (tail->need_adjustment)
-	      {
-		tail->need_adjustment = 0;
-		if (tail->insertion_type)
-		  {
-		    tail->bytepos = from_byte;
-		    tail->charpos = from;
-		  }
-		else
-		  {
-		    tail->bytepos = from_byte + coding->produced;
-		    tail->charpos
-		      = (NILP (BVAR (current_buffer, enable_multibyte_characters))
-			 ? tail->bytepos : from + coding->produced_char);
-		  }
-	      }
+	  for (ptrdiff_t i = start; i < BUF_MARKERS_GPT (current_buffer); i++)
+	    {
+	      struct Lisp_Marker *tail = BUF_MARKERS (current_buffer)[i];
+	      if (tail->need_adjustment)
+		{
+		  tail->need_adjustment = 0;
+		  if (tail->insertion_type)
+		    {
+		      tail->bytepos = from_byte;
+		      tail->charpos = from;
+		    }
+		  else
+		    {
+		      tail->bytepos = from_byte + coding->produced;
+		      tail->charpos = end;
+		    }
+		}
+	    }
+	  reorder_markers (current_buffer, start);
 	}
     }
 
@@ -8696,7 +9502,20 @@ detect_coding_system (const unsigned char *src,
   struct coding_detection_info detect_info = {0};
   enum coding_category base_category;
   bool null_byte_found = 0, eight_bit_found = 0;
+  const unsigned char *eol_src = src;
+  ptrdiff_t eol_src_bytes = src_bytes, sample_bytes;
+  unsigned char *sample
+    = (multibytep ? NULL
+       : coding_detection_sample (src, src_bytes, &sample_bytes));
 
+  /* Detect the text-format from a sample of a large text, but the
+     eol-format from the whole text.  */
+  if (sample)
+    {
+      src = sample;
+      src_chars = src_bytes = sample_bytes;
+      src_end = src + src_bytes;
+    }
   if (NILP (coding_system))
     coding_system = Qundecided;
   setup_coding_system (coding_system, &coding);
@@ -8937,16 +9756,16 @@ detect_coding_system (const unsigned char *src,
 	    if (null_byte_found)
 	      normal_eol = EOL_SEEN_LF;
 	    else
-	      normal_eol = detect_eol (coding.source, src_bytes,
+	      normal_eol = detect_eol (eol_src, eol_src_bytes,
 				       coding_category_raw_text);
 	  }
 	if (detect_info.found & (CATEGORY_MASK_UTF_16_BE
 				 | CATEGORY_MASK_UTF_16_BE_NOSIG))
-	  utf_16_be_eol = detect_eol (coding.source, src_bytes,
+	  utf_16_be_eol = detect_eol (eol_src, eol_src_bytes,
 				      coding_category_utf_16_be);
 	if (detect_info.found & (CATEGORY_MASK_UTF_16_LE
 				 | CATEGORY_MASK_UTF_16_LE_NOSIG))
-	  utf_16_le_eol = detect_eol (coding.source, src_bytes,
+	  utf_16_le_eol = detect_eol (eol_src, eol_src_bytes,
 				      coding_category_utf_16_le);
       }
     else
@@ -8993,6 +9812,7 @@ detect_coding_system (const unsigned char *src,
       }
   }
 
+  xfree (sample);
   return (highest ? (CONSP (val) ? XCAR (val) : Qnil) : val);
 }
 
@@ -12213,6 +13033,19 @@ from GNU Find and GNU Grep.  Emacs will then ignore the null bytes and
 decode text as usual.  */);
   inhibit_null_byte_detection = 0;
 
+  DEFVAR_LISP ("coding-detection-sample-size", Vcoding_detection_sample_size,
+	       doc: /* Number of bytes examined to detect the encoding of a large text.
+If this is a natural number, and a text whose coding system must be
+detected is more than twice as long, only about that many bytes of it
+are examined: some from its beginning, some from its end, and some
+from evenly spaced places in between.  This makes visiting large files
+faster, but the detection may miss bytes that would have given another
+result.  If nil, the whole text is examined.
+
+This affects the detection of the encoding of the text, not of its
+end-of-line format.  */);
+  Vcoding_detection_sample_size = Qnil;
+
   DEFVAR_BOOL ("disable-ascii-optimization", disable_ascii_optimization,
 	       doc: /* If non-nil, Emacs does not optimize code decoder for ASCII files.
 Internal use only.  Remove after the experimental optimizer becomes stable.  */);
@@ -1348,8 +1348,12 @@ do_symval_forwarding (lispfwd valcontents)
       return *XOBJVAR (valcontents);
 
     case Lisp_Fwd_Buffer_Obj:
-      return per_buffer_value (current_buffer,
-			       XBUFFER_OFFSET (valcontents));
+      {
+	int offset = XBUFFER_OFFSET (valcontents);
+	if (offset == PER_BUFFER_VAR_OFFSET (undo_list))
+	  return buffer_undo_list (current_buffer);
+	return per_buffer_value (current_buffer, offset);
+      }
 
     case Lisp_Fwd_Kboard_Obj:
       return *(Lisp_Object *) (XKBOARD_OFFSET (valcontents)
@@ -1522,6 +1526,8 @@ store_symval_forwarding (lispfwd valcontents, Lisp_Object newval,
 	  check_fwd_predicate (valcontents->u.buf.predicate, newval);
 	if (buf == NULL)
 	  buf = current_buffer;
+	if (offset == PER_BUFFER_VAR_OFFSET (undo_list))
+	  free_undo_log (buf);
 	set_per_buffer_value (buf, offset, newval);
       }
       break;
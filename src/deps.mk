@@ -38,7 +38,7 @@ atimer.o: atimer.c atimer.h syssignal.h systime.h lisp.h blockinput.h \
  globals.h ../lib/unistd.h msdos.h $(config_h)
 bidi.o: bidi.c buffer.h character.h dispextern.h msdos.h lisp.h \
    globals.h $(config_h)
-buffer.o: buffer.c buffer.h region-cache.h commands.h window.h \
+buffer.o: buffer.c buffer.h region-cache.h line-index.h commands.h window.h \
    $(INTERVALS_H) blockinput.h atimer.h systime.h character.h ../lib/unistd.h \
    indent.h keyboard.h coding.h keymap.h frame.h lisp.h globals.h $(config_h)
 callint.o: callint.c window.h commands.h buffer.h keymap.h globals.h msdos.h \
@@ -128,7 +128,8 @@ indent.o: indent.c frame.h window.h indent.h buffer.h lisp.h $(config_h) \
    keyboard.h systime.h coding.h $(INTERVALS_H) globals.h
 inotify.o: inotify.c lisp.h coding.h process.h keyboard.h frame.h termhooks.h
 insdel.o: insdel.c window.h buffer.h $(INTERVALS_H) blockinput.h character.h \
-   atimer.h systime.h region-cache.h lisp.h globals.h $(config_h)
+   atimer.h systime.h region-cache.h line-index.h lisp.h globals.h \
+   $(config_h)
 keyboard.o: keyboard.c termchar.h termhooks.h termopts.h buffer.h character.h \
    commands.h frame.h window.h macros.h disptab.h keyboard.h syssignal.h \
    systime.h syntax.h $(INTERVALS_H) blockinput.h atimer.h composite.h \
@@ -173,10 +174,13 @@ regex-emacs.o: regex-emacs.c syntax.h buffer.h lisp.h globals.h \
    category.h character.h
 region-cache.o: region-cache.c buffer.h region-cache.h \
    lisp.h globals.h $(config_h)
+line-index.o: line-index.c buffer.h line-index.h lisp.h globals.h \
+   $(config_h)
 scroll.o: scroll.c termchar.h dispextern.h frame.h msdos.h keyboard.h \
    termhooks.h lisp.h globals.h $(config_h) systime.h coding.h composite.h \
    window.h
 search.o: search.c regex-emacs.h commands.h buffer.h region-cache.h syntax.h \
+   line-index.h \
    blockinput.h atimer.h systime.h category.h character.h charset.h \
    $(INTERVALS_H) lisp.h globals.h $(config_h)
 sound.o: sound.c dispextern.h syssignal.h lisp.h globals.h $(config_h) \
@@ -212,6 +216,7 @@ window.o: window.c indent.h commands.h frame.h window.h buffer.h termchar.h \
 xdisp.o: xdisp.c macros.h commands.h process.h indent.h buffer.h \
    coding.h termchar.h frame.h window.h disptab.h termhooks.h character.h \
    charset.h lisp.h $(config_h) keyboard.h $(INTERVALS_H) region-cache.h \
+   line-index.h \
    xterm.h w32term.h nsterm.h nsgui.h msdos.h composite.h fontset.h ccl.h \
    blockinput.h atimer.h systime.h keymap.h font.h globals.h termopts.h \
    ../lib/unistd.h gnutls.h gtkutil.h
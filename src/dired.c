@@ -28,17 +28,24 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include <grp.h>
 
 #include <errno.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 #include <dirent.h>
 #include <filemode.h>
+#include <nproc.h>
 #include <stat-time.h>
 
 #include "lisp.h"
 #include "systime.h"
 #include "buffer.h"
 #include "coding.h"
+#include "systhread.h"
+
+#ifdef GNU_LINUX
+#include <sys/inotify.h>
+#endif
 
 #ifdef MSDOS
 #include "msdos.h"	/* for fstatat */
@@ -66,6 +73,8 @@ extern int is_slow_fs (const char *);
 static ptrdiff_t scmp (const char *, const char *, ptrdiff_t);
 static Lisp_Object file_attributes (int, char const *, Lisp_Object,
 				    Lisp_Object, Lisp_Object);
+static Lisp_Object stat_file_attributes (struct stat *, Lisp_Object,
+					 Lisp_Object);
 
 /* Return the number of bytes in DP's name.  */
 static ptrdiff_t
@@ -445,6 +454,493 @@ which see.  */)
 }
 
 
+/* Walking directory trees.
+
+   Fdirectory_files_walk reads the directories of a tree in a few
+   other threads, while the main thread decodes and filters the names
+   they find, calls Lisp with them, and queues the subdirectories to
+   read next.  The other threads only make system calls and use memory
+   from malloc, and never look at Lisp objects.  */
+
+/* The maximum number of other threads reading directories.  */
+enum { WALK_THREADS = 8 };
+
+/* The maximum number of file names passed at a time to the function
+   called by Fdirectory_files_walk.  */
+enum { WALK_BATCH = 1024 };
+
+struct walk_dir
+{
+  struct walk_dir *next;
+
+  /* The encoded absolute file name of the directory, and its depth
+     below the top directory, whose depth is 0.  */
+  char *name;
+  int depth;
+
+  /* Once the directory has been read, its entries other than "." and
+     "..", each as a byte that is 1 for directories and 0 for other
+     files, followed by the null-terminated name of the entry.  */
+  char *entries;
+  ptrdiff_t nbytes;
+
+  /* The device and inode numbers of the directory, and the errno
+     value if it could not be read entirely.  */
+  dev_t dev;
+  ino_t ino;
+  int err;
+};
+
+struct walk
+{
+  sys_mutex_t mutex;
+
+  /* Signaled when directories are queued or when the other threads
+     must exit, and when a directory has been read or a thread
+     exits.  */
+  sys_cond_t queued, read;
+
+  /* The directories to read, and those that have been read but not
+     processed yet.  */
+  struct walk_dir *queue, *done;
+
+  /* The directory being processed by the main thread.  */
+  struct walk_dir *current;
+
+  /* The numbers of other threads, and of the directories they are
+     reading.  */
+  int threads, busy;
+
+  /* True when the other threads must exit.  */
+  bool exiting;
+
+  bool follow_symlinks;
+};
+
+/* Return a new directory to read, whose name is DIR followed by the
+   NAMELEN bytes of NAME, if NAME is non-null, and whose depth is
+   DEPTH.  */
+
+static struct walk_dir *
+walk_dir_new (const char *dir, const char *name, ptrdiff_t namelen,
+	      int depth)
+{
+  struct walk_dir *wd = xzalloc (sizeof *wd);
+  ptrdiff_t dirlen = strlen (dir);
+  bool needsep = name && !(dirlen && IS_DIRECTORY_SEP (dir[dirlen - 1]));
+
+  wd->name = xmalloc (dirlen + needsep + namelen + 1);
+  memcpy (wd->name, dir, dirlen);
+  if (needsep)
+    wd->name[dirlen] = DIRECTORY_SEP;
+  if (name)
+    memcpy (wd->name + dirlen + needsep, name, namelen);
+  wd->name[dirlen + needsep + namelen] = '\0';
+  wd->depth = depth;
+  return wd;
+}
+
+/* Free the list of directories starting at WD.  */
+
+static void
+walk_dirs_free (struct walk_dir *wd)
+{
+  while (wd)
+    {
+      struct walk_dir *next = wd->next;
+      free (wd->entries);
+      xfree (wd->name);
+      xfree (wd);
+      wd = next;
+    }
+}
+
+/* Read the entries of directory WD.  If FOLLOW_SYMLINKS, symbolic
+   links to directories count as directories.  This can be called by
+   any thread.  */
+
+static void
+walk_read_dir (struct walk_dir *wd, bool follow_symlinks)
+{
+  emacs_dir *d;
+  struct stat st;
+  ptrdiff_t size = 0;
+  int fd;
+
+#if defined DOS_NT || (defined HAVE_ANDROID && !defined ANDROID_STUBIFY)
+  /* See open_directory.  Only the main thread walks trees there.  */
+# ifdef HAVE_ANDROID
+  do
+    d = android_opendir (wd->name);
+  while (!d && errno == EINTR);
+  fd = d ? android_dirfd (d) : -1;
+# else
+  d = opendir (wd->name);
+  fd = 0;
+# endif
+  if (!d || stat (wd->name, &st) != 0)
+    {
+      wd->err = errno;
+      if (d)
+	emacs_closedir (d);
+      return;
+    }
+#else
+  d = NULL;
+  fd = emacs_open_noquit (wd->name, O_RDONLY | O_DIRECTORY, 0);
+  if (fd < 0 || fstat (fd, &st) != 0 || !(d = fdopendir (fd)))
+    {
+      wd->err = errno;
+      if (0 <= fd)
+	emacs_close (fd);
+      return;
+    }
+#endif
+  wd->dev = st.st_dev;
+  wd->ino = st.st_ino;
+
+  while (true)
+    {
+      errno = 0;
+      struct dirent *dp = emacs_readdir (d);
+      if (!dp)
+	{
+	  if (errno == EINTR || errno == EAGAIN)
+	    continue;
+	  wd->err = errno;
+	  break;
+	}
+
+      ptrdiff_t len = dirent_namelen (dp);
+      if (dp->d_name[0] == '.'
+	  && (len == 1 || (len == 2 && dp->d_name[1] == '.')))
+	continue;
+
+      int type = dirent_type (dp);
+      if (type == DT_UNKNOWN || (type == DT_LNK && follow_symlinks))
+	{
+	  struct stat sub;
+	  if (fstatat (fd, dp->d_name, &sub,
+		       follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW)
+	      == 0)
+	    type = S_ISDIR (sub.st_mode) ? DT_DIR : DT_UNKNOWN;
+	}
+
+      if (size - wd->nbytes < len + 2)
+	{
+	  ptrdiff_t new_size = max (max (4096, 2 * size), wd->nbytes + len + 2);
+	  char *entries = realloc (wd->entries, new_size);
+	  if (!entries)
+	    {
+	      wd->err = ENOMEM;
+	      break;
+	    }
+	  wd->entries = entries;
+	  size = new_size;
+	}
+      wd->entries[wd->nbytes++] = type == DT_DIR;
+      memcpy (wd->entries + wd->nbytes, dp->d_name, len + 1);
+      wd->nbytes += len + 1;
+    }
+  emacs_closedir (d);
+}
+
+static void *
+walk_thread (void *arg)
+{
+  struct walk *w = arg;
+
+  sys_thread_set_name ("directory-walk");
+  sys_mutex_lock (&w->mutex);
+  while (true)
+    {
+      while (!w->exiting && !w->queue)
+	sys_cond_wait (&w->queued, &w->mutex);
+      if (w->exiting)
+	break;
+
+      struct walk_dir *wd = w->queue;
+      w->queue = wd->next;
+      w->busy++;
+      sys_mutex_unlock (&w->mutex);
+      walk_read_dir (wd, w->follow_symlinks);
+      sys_mutex_lock (&w->mutex);
+      w->busy--;
+      wd->next = w->done;
+      w->done = wd;
+      sys_cond_signal (&w->read);
+    }
+  w->threads--;
+  sys_cond_signal (&w->read);
+  sys_mutex_unlock (&w->mutex);
+  return NULL;
+}
+
+/* Start the other threads of W.  */
+
+static void
+walk_start_threads (struct walk *w)
+{
+#if !(defined DOS_NT || (defined HAVE_ANDROID && !defined ANDROID_STUBIFY))
+  int nthreads = min (2 * num_processors (NPROC_CURRENT), WALK_THREADS);
+
+  for (int i = 0; i < nthreads; i++)
+    {
+      sys_thread_t thread;
+
+      sys_mutex_lock (&w->mutex);
+      w->threads++;
+      sys_mutex_unlock (&w->mutex);
+      if (! sys_thread_create (&thread, walk_thread, w))
+	{
+	  sys_mutex_lock (&w->mutex);
+	  w->threads--;
+	  sys_mutex_unlock (&w->mutex);
+	  break;
+	}
+    }
+#endif
+}
+
+/* Queue the directory WD of W to be read.  */
+
+static void
+walk_queue (struct walk *w, struct walk_dir *wd)
+{
+  sys_mutex_lock (&w->mutex);
+  wd->next = w->queue;
+  w->queue = wd;
+  sys_cond_signal (&w->queued);
+  sys_mutex_unlock (&w->mutex);
+}
+
+/* Return the next directory of W to process in the main thread,
+   reading it if no other thread has, or NULL if the whole tree has
+   been processed.  */
+
+static struct walk_dir *
+walk_next (struct walk *w)
+{
+  struct walk_dir *wd = NULL;
+  bool unread = false;
+
+  sys_mutex_lock (&w->mutex);
+  while (!w->done && !w->queue && w->busy > 0)
+    sys_cond_wait (&w->read, &w->mutex);
+  if (w->done)
+    {
+      wd = w->done;
+      w->done = wd->next;
+    }
+  else if (w->queue)
+    {
+      wd = w->queue;
+      w->queue = wd->next;
+      unread = true;
+    }
+  sys_mutex_unlock (&w->mutex);
+
+  if (wd)
+    {
+      wd->next = NULL;
+      if (unread)
+	walk_read_dir (wd, w->follow_symlinks);
+    }
+  return wd;
+}
+
+/* Stop the other threads of W, and free W.  */
+
+static void
+walk_cleanup (void *arg)
+{
+  struct walk *w = arg;
+
+  sys_mutex_lock (&w->mutex);
+  w->exiting = true;
+  sys_cond_broadcast (&w->queued);
+  while (w->threads > 0)
+    sys_cond_wait (&w->read, &w->mutex);
+  sys_mutex_unlock (&w->mutex);
+
+  walk_dirs_free (w->queue);
+  walk_dirs_free (w->done);
+  walk_dirs_free (w->current);
+  sys_cond_destroy (&w->queued);
+  sys_cond_destroy (&w->read);
+  xfree (w);
+}
+
+/* Return true if the file NAME, whose absolute name is FILE, is
+   excluded by EXCLUDE, as for Fdirectory_files_walk.  */
+
+static bool
+walk_excluded_p (Lisp_Object exclude, Lisp_Object name, Lisp_Object file,
+		 Lisp_Object case_table)
+{
+  if (NILP (exclude))
+    return false;
+  if (STRINGP (exclude))
+    return fast_string_match_internal (exclude, name, case_table) >= 0;
+  return !NILP (calln (exclude, file));
+}
+
+/* Return true if directory WD has not been visited before, according
+   to VISITED, a hash table of the (DEVICE . INODE) of the directories
+   visited so far, and record it as visited.  If VISITED is nil, all
+   directories are new.  */
+
+static bool
+walk_first_visit_p (Lisp_Object visited, struct walk_dir *wd)
+{
+  if (NILP (visited))
+    return true;
+
+  Lisp_Object key = Fcons (INT_TO_INTEGER (wd->dev),
+			   INT_TO_INTEGER (wd->ino));
+  if (!NILP (Fgethash (key, visited, Qnil)))
+    return false;
+  Fputhash (key, Qt, visited);
+  return true;
+}
+
+DEFUN ("directory-files-walk", Fdirectory_files_walk,
+       Sdirectory_files_walk, 1, 6, 0,
+       doc: /* Call FUNCTION with the names of all files under DIRECTORY.
+Call FUNCTION several times, each time with a list of absolute file
+names, until all the files in DIRECTORY and in its subdirectories, at
+any depth, have been passed to it, and return nil.  If FUNCTION is nil,
+return a list of all these file names instead.  The names of
+directories end in a slash.  The names come in no particular order,
+since the directories are read by several threads when possible.
+
+If MATCH is non-nil, mention only files whose non-directory part
+matches the regexp MATCH.  If EXCLUDE is a regexp, files whose
+non-directory part matches it are not mentioned.  If it is a function,
+it is called with the name of each file, as it would be mentioned,
+and the file is not mentioned if it returns non-nil.  Unlike MATCH,
+EXCLUDE also prevents descending into the directories it excludes.
+
+If MAX-DEPTH is a natural number, descend at most that many levels of
+subdirectories: 0 means to mention the files of DIRECTORY only.
+
+If FOLLOW-SYMLINKS is non-nil, descend into symbolic links to
+directories, but visit each directory only once, so that cycles of
+links are not followed.  Otherwise, mention symbolic links as files.
+
+Subdirectories that cannot be read are silently skipped.  */)
+  (Lisp_Object directory, Lisp_Object function, Lisp_Object match,
+   Lisp_Object exclude, Lisp_Object max_depth, Lisp_Object follow_symlinks)
+{
+  directory = Fexpand_file_name (directory, Qnil);
+
+  /* If the file name has special constructs in it,
+     call the corresponding file name handler.  */
+  Lisp_Object handler
+    = Ffind_file_name_handler (directory, Qdirectory_files_walk);
+  if (!NILP (handler))
+    return CALLN (Ffuncall, handler, Qdirectory_files_walk, directory,
+		  function, match, exclude, max_depth, follow_symlinks);
+
+  if (!NILP (match))
+    CHECK_STRING (match);
+  EMACS_INT depth_limit = -1;
+  if (!NILP (max_depth))
+    {
+      CHECK_FIXNAT (max_depth);
+      depth_limit = min (XFIXNAT (max_depth), INT_MAX - 1);
+    }
+
+  /* Windows users want case-insensitive wildcards.  */
+  Lisp_Object case_table = Qnil;
+#ifdef WINDOWSNT
+  case_table = BVAR (&buffer_defaults, case_canon_table);
+#endif
+
+  Lisp_Object encoded = ENCODE_FILE (Fdirectory_file_name (directory));
+  struct walk *w = xzalloc (sizeof *w);
+  sys_mutex_init (&w->mutex);
+  sys_cond_init (&w->queued);
+  sys_cond_init (&w->read);
+  w->follow_symlinks = !NILP (follow_symlinks);
+  specpdl_ref count = SPECPDL_INDEX ();
+  record_unwind_protect_ptr (walk_cleanup, w);
+
+  /* Read DIRECTORY in this thread, to report errors.  */
+  struct walk_dir *wd = walk_dir_new (SSDATA (encoded), NULL, 0, 0);
+  w->current = wd;
+  walk_read_dir (wd, w->follow_symlinks);
+  if (wd->err)
+    report_file_errno ("Opening directory", directory, wd->err);
+
+  /* Cycles can only be made by symbolic links.  */
+  Lisp_Object visited
+    = w->follow_symlinks ? CALLN (Fmake_hash_table, QCtest, Qequal) : Qnil;
+  Lisp_Object files = Qnil, slash = build_string ("/");
+  ptrdiff_t nfiles = 0;
+  bool started = false;
+
+  while (wd)
+    {
+      w->current = wd;
+      if (walk_first_visit_p (visited, wd))
+	{
+	  Lisp_Object dir
+	    = Ffile_name_as_directory (DECODE_FILE (build_unibyte_string
+						     (wd->name)));
+	  for (char *p = wd->entries, *end = p + wd->nbytes; p < end; )
+	    {
+	      bool is_dir = *p++;
+	      char *entry = p;
+	      ptrdiff_t len = strlen (entry);
+	      p += len + 1;
+
+	      /* This can GC.  */
+	      Lisp_Object name = DECODE_FILE (make_unibyte_string (entry, len));
+	      Lisp_Object file = (is_dir
+				  ? concat3 (dir, name, slash)
+				  : concat2 (dir, name));
+
+	      maybe_quit ();
+
+	      if (walk_excluded_p (exclude, name, file, case_table))
+		continue;
+	      if (NILP (match)
+		  || fast_string_match_internal (match, name, case_table) >= 0)
+		{
+		  files = Fcons (file, files);
+		  if (!NILP (function) && ++nfiles == WALK_BATCH)
+		    {
+		      Lisp_Object batch = Fnreverse (files);
+		      files = Qnil;
+		      nfiles = 0;
+		      calln (function, batch);
+		    }
+		}
+	      if (is_dir && (depth_limit < 0 || wd->depth < depth_limit))
+		walk_queue (w, walk_dir_new (wd->name, entry, len,
+					     wd->depth + 1));
+	    }
+	}
+      if (!started && w->queue)
+	{
+	  walk_start_threads (w);
+	  started = true;
+	}
+      w->current = NULL;
+      walk_dirs_free (wd);
+      wd = walk_next (w);
+    }
+
+  unbind_to (count, Qnil);
+  files = Fnreverse (files);
+  if (NILP (function))
+    return files;
+  if (!NILP (files))
+    calln (function, files);
+  return Qnil;
+}
+
 static Lisp_Object file_name_completion (Lisp_Object, Lisp_Object, bool,
 					 Lisp_Object);
 
@@ -950,6 +1446,288 @@ stat_gname (struct stat *st)
 #endif
 }
 
+#ifndef WINDOWSNT
+/* Looking up the name of a user or group can take a while, as it may
+   read files or ask a server, so the names are remembered for
+   ID_NAMES_LIFETIME seconds.  */
+enum { ID_NAMES_LIFETIME = 60 };
+
+/* Hash tables mapping the IDs of users and groups to their decoded
+   names, or to nil if they have none, and the time when they were
+   created.  */
+static Lisp_Object user_names, group_names;
+static time_t id_names_time;
+#endif
+
+/* Return the name of the owner of the file whose status is ST, or of
+   its group if GROUP, or its numeric ID if it has no name.  */
+
+static Lisp_Object
+stat_owner (struct stat *st, bool group)
+{
+#ifdef WINDOWSNT
+  char *name = group ? stat_gname (st) : stat_uname (st);
+  if (name)
+    return DECODE_SYSTEM (build_unibyte_string (name));
+#else
+  time_t now = time (NULL);
+  if (NILP (user_names) || now < id_names_time
+      || id_names_time + ID_NAMES_LIFETIME <= now)
+    {
+      user_names = CALLN (Fmake_hash_table, QCtest, Qeql);
+      group_names = CALLN (Fmake_hash_table, QCtest, Qeql);
+      id_names_time = now;
+    }
+
+  Lisp_Object id = (group
+		    ? INT_TO_INTEGER (st->st_gid)
+		    : INT_TO_INTEGER (st->st_uid));
+  Lisp_Object names = group ? group_names : user_names;
+  Lisp_Object name = Fgethash (id, names, Qt);
+  if (EQ (name, Qt))
+    {
+      char *s = group ? stat_gname (st) : stat_uname (st);
+      name = s ? DECODE_SYSTEM (build_unibyte_string (s)) : Qnil;
+      Fputhash (id, name, names);
+    }
+  if (!NILP (name))
+    return name;
+#endif
+  return group ? INT_TO_INTEGER (st->st_gid) : INT_TO_INTEGER (st->st_uid);
+}
+
+/* The cache of file attributes.
+
+   When `cache-file-attributes' is non-nil, Ffile_attributes remembers
+   the attributes of local files, and watches with inotify the
+   directories containing them, up to the root, and the directories
+   themselves.  The pending events are read before each lookup, and
+   forget the attributes of the files they concern.
+
+   This misses the changes that the watched directories are not told
+   about: changes made on other machines to files on network file
+   systems, and changes made to a file through a hard link in another
+   directory, including the change of its number of links when a link
+   is made or removed there.  The cache may then return outdated
+   attributes.
+
+   inotify is used directly rather than through inotify.c, which is
+   only built where it is the backend of filenotify.el.  */
+
+#ifdef GNU_LINUX
+
+/* The maximum number of files whose attributes are remembered.  */
+enum { ATTRIBUTES_CACHE_SIZE = 1 << 16 };
+
+/* The events that may change the attributes of a watched directory or
+   of its files.  */
+enum { ATTRIBUTES_CACHE_EVENTS = (IN_ACCESS | IN_ATTRIB | IN_CREATE
+				  | IN_DELETE | IN_DELETE_SELF | IN_MODIFY
+				  | IN_MOVE_SELF | IN_MOVED_FROM
+				  | IN_MOVED_TO) };
+
+/* The inotify file descriptor, or -1.  */
+static int attributes_fd = -1;
+
+/* Hash tables mapping file names to their attributes with numeric IDs
+   and with names of users and groups, directory names to their watch
+   descriptors, and watch descriptors to the list of directory names
+   they watch.  */
+static Lisp_Object attributes_cache[2], attributes_watches;
+static Lisp_Object attributes_watched;
+
+/* Forget all attributes, and stop watching directories.  */
+
+static void
+attributes_cache_flush (void)
+{
+  if (0 <= attributes_fd)
+    {
+      emacs_close (attributes_fd);
+      attributes_fd = -1;
+    }
+  if (!NILP (attributes_watches))
+    {
+      Fclrhash (attributes_cache[0]);
+      Fclrhash (attributes_cache[1]);
+      Fclrhash (attributes_watches);
+      Fclrhash (attributes_watched);
+    }
+}
+
+/* Make the cache ready for use, and return true if it can be used.  */
+
+static bool
+attributes_cache_init (void)
+{
+  if (attributes_fd < 0)
+    {
+      attributes_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+      if (attributes_fd < 0)
+	return false;
+      if (NILP (attributes_watches))
+	{
+	  attributes_cache[0] = CALLN (Fmake_hash_table, QCtest, Qequal);
+	  attributes_cache[1] = CALLN (Fmake_hash_table, QCtest, Qequal);
+	  attributes_watches = CALLN (Fmake_hash_table, QCtest, Qequal);
+	  attributes_watched = CALLN (Fmake_hash_table, QCtest, Qeql);
+	}
+    }
+  return true;
+}
+
+/* Forget the attributes of FILE.  */
+
+static void
+attributes_cache_forget (Lisp_Object file)
+{
+  Fremhash (file, attributes_cache[0]);
+  Fremhash (file, attributes_cache[1]);
+}
+
+/* Read the pending inotify events, and forget what they make
+   obsolete.  */
+
+static void
+attributes_cache_read_events (void)
+{
+  alignas (struct inotify_event) char buf[4096];
+  ptrdiff_t nbytes;
+
+  while (0 <= attributes_fd
+	 && 0 < (nbytes = emacs_read (attributes_fd, buf, sizeof buf)))
+    for (char *p = buf; p < buf + nbytes; )
+      {
+	struct inotify_event *event = (struct inotify_event *) p;
+	p += sizeof *event + event->len;
+
+	/* If a watched directory goes away, or events were lost, the
+	   names of files below it may now refer to other files.  */
+	if (event->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF
+			   | IN_MOVE_SELF | IN_UNMOUNT))
+	  {
+	    attributes_cache_flush ();
+	    return;
+	  }
+
+	Lisp_Object dirs = Fgethash (make_fixnum (event->wd),
+				     attributes_watched, Qnil);
+	for (; CONSP (dirs); dirs = XCDR (dirs))
+	  {
+	    /* Any change in a directory changes its own attributes.  */
+	    Lisp_Object dir = XCAR (dirs);
+	    attributes_cache_forget (dir);
+	    attributes_cache_forget (Fdirectory_file_name (dir));
+	    if (event->len > 0)
+	      {
+		Lisp_Object file
+		  = concat2 (dir, DECODE_FILE (build_unibyte_string
+					       (event->name)));
+		Lisp_Object subdir = Ffile_name_as_directory (file);
+
+		/* If a watched directory name now refers to another
+		   directory, as when a symbolic link to it is changed,
+		   the names below it may refer to other files, and its
+		   watch is on the old directory.  */
+		if ((event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM
+				    | IN_MOVED_TO))
+		    && !NILP (Fgethash (subdir, attributes_watches, Qnil)))
+		  {
+		    attributes_cache_flush ();
+		    return;
+		  }
+		attributes_cache_forget (file);
+		attributes_cache_forget (subdir);
+	      }
+	  }
+      }
+}
+
+/* Watch directory DIR, a directory name, and return 0 if this was
+   done or if it was already watched, or an errno value.  */
+
+static int
+attributes_cache_watch (Lisp_Object dir)
+{
+  if (!NILP (Fgethash (dir, attributes_watches, Qnil)))
+    return 0;
+
+  Lisp_Object encoded = ENCODE_FILE (dir);
+  int wd = inotify_add_watch (attributes_fd, SSDATA (encoded),
+			      ATTRIBUTES_CACHE_EVENTS | IN_ONLYDIR);
+  if (wd < 0)
+    return errno;
+
+  Lisp_Object key = make_fixnum (wd);
+  Fputhash (dir, key, attributes_watches);
+  Fputhash (key, Fcons (dir, Fgethash (key, attributes_watched, Qnil)),
+	    attributes_watched);
+  return 0;
+}
+
+/* Watch the directories containing FILE, and FILE itself if it is a
+   directory.  Return true if this was done.  */
+
+static bool
+attributes_cache_watch_file (Lisp_Object file)
+{
+  /* Watch the outermost directories first, so that the ancestors of
+     a watched directory are always watched.  */
+  Lisp_Object dir = Ffile_name_directory (file), dirs = Qnil;
+  while (STRINGP (dir) && NILP (Fgethash (dir, attributes_watches, Qnil)))
+    {
+      dirs = Fcons (dir, dirs);
+      Lisp_Object parent = Ffile_name_directory (Fdirectory_file_name (dir));
+      if (!NILP (Fstring_equal (parent, dir)))
+	break;
+      dir = parent;
+    }
+  for (; CONSP (dirs); dirs = XCDR (dirs))
+    if (attributes_cache_watch (XCAR (dirs)) != 0)
+      return false;
+
+  /* FILE need not exist, nor be a directory.  */
+  int err = attributes_cache_watch (Ffile_name_as_directory (file));
+  return err == 0 || err == ENOENT || err == ENOTDIR;
+}
+
+/* Return the attributes of the local file FILENAME, an absolute file
+   name, as Ffile_attributes would with ID_FORMAT, using the cache.  */
+
+static Lisp_Object
+cached_file_attributes (Lisp_Object filename, Lisp_Object id_format)
+{
+  int strings = !(NILP (id_format) || EQ (id_format, Qinteger));
+
+  attributes_cache_read_events ();
+  if (attributes_cache_init ())
+    {
+      Lisp_Object attributes = Fgethash (filename, attributes_cache[strings],
+					 Qt);
+      if (!EQ (attributes, Qt))
+	return Fcopy_sequence (attributes);
+      if (ATTRIBUTES_CACHE_SIZE
+	  <= XFIXNUM (Fhash_table_count (attributes_cache[strings])))
+	{
+	  attributes_cache_flush ();
+	  attributes_cache_init ();
+	}
+    }
+
+  /* Watch the file before looking at it, so that no change can be
+     missed.  */
+  bool watched = 0 <= attributes_fd && attributes_cache_watch_file (filename);
+  Lisp_Object encoded = ENCODE_FILE (filename);
+  Lisp_Object attributes = file_attributes (AT_FDCWD, SSDATA (encoded), Qnil,
+					    filename, id_format);
+  if (watched && 0 <= attributes_fd)
+    Fputhash (filename, Fcopy_sequence (attributes),
+	      attributes_cache[strings]);
+  return attributes;
+}
+
+#endif	/* GNU_LINUX */
+
 DEFUN ("file-attributes", Ffile_attributes, Sfile_attributes, 1, 2, 0,
        doc: /* Return a list of attributes of file FILENAME.
 Value is nil if specified file does not exist.
@@ -1018,6 +1796,11 @@ so last access time will always be midnight of that day.  */)
 	return calln (handler, Qfile_attributes, filename, id_format);
     }
 
+#ifdef GNU_LINUX
+  if (cache_file_attributes)
+    return cached_file_attributes (filename, id_format);
+#endif
+
   encoded = ENCODE_FILE (filename);
   return file_attributes (AT_FDCWD, SSDATA (encoded), Qnil, filename,
 			  id_format);
@@ -1030,13 +1813,6 @@ file_attributes (int fd, char const *name,
 {
   specpdl_ref count = SPECPDL_INDEX ();
   struct stat s;
-
-  /* An array to hold the mode string generated by filemodestring,
-     including its terminating space and null byte.  */
-  char modes[sizeof "-rwxr-xr-x "];
-
-  char *uname = NULL, *gname = NULL;
-
   int err = EINVAL;
 
 #if defined O_PATH && !defined HAVE_CYGWIN_O_PATH_BUG	\
@@ -1098,40 +1874,258 @@ file_attributes (int fd, char const *name,
     file_type = S_ISDIR (s.st_mode) ? Qt : Qnil;
 
   unbind_to (count, Qnil);
+  return stat_file_attributes (&s, file_type, id_format);
+}
 
-  if (!(NILP (id_format) || EQ (id_format, Qinteger)))
-    {
-      uname = stat_uname (&s);
-      gname = stat_gname (&s);
-    }
+/* Return the attributes of a file whose status is S and whose type is
+   FILE_TYPE, as Ffile_attributes would with ID_FORMAT.  */
 
-  filemodestring (&s, modes);
+static Lisp_Object
+stat_file_attributes (struct stat *s, Lisp_Object file_type,
+		      Lisp_Object id_format)
+{
+  /* An array to hold the mode string generated by filemodestring,
+     including its terminating space and null byte.  */
+  char modes[sizeof "-rwxr-xr-x "];
+  bool names = !(NILP (id_format) || EQ (id_format, Qinteger));
+
+  filemodestring (s, modes);
 
   return CALLN (Flist,
 		file_type,
-		make_fixnum (s.st_nlink),
-		(uname
-		 ? DECODE_SYSTEM (build_unibyte_string (uname))
-		 : INT_TO_INTEGER (s.st_uid)),
-		(gname
-		 ? DECODE_SYSTEM (build_unibyte_string (gname))
-		 : INT_TO_INTEGER (s.st_gid)),
-		make_lisp_time (get_stat_atime (&s)),
-		make_lisp_time (get_stat_mtime (&s)),
-		make_lisp_time (get_stat_ctime (&s)),
+		make_fixnum (s->st_nlink),
+		(names ? stat_owner (s, false) : INT_TO_INTEGER (s->st_uid)),
+		(names ? stat_owner (s, true) : INT_TO_INTEGER (s->st_gid)),
+		make_lisp_time (get_stat_atime (s)),
+		make_lisp_time (get_stat_mtime (s)),
+		make_lisp_time (get_stat_ctime (s)),
 
 		/* If the file size is a 4-byte type, assume that
 		   files of sizes in the 2-4 GiB range wrap around to
 		   negative values, as this is a common bug on older
 		   32-bit platforms.  */
-		INT_TO_INTEGER (sizeof (s.st_size) == 4
-			    ? s.st_size & 0xffffffffu
-			    : s.st_size),
+		INT_TO_INTEGER (sizeof (s->st_size) == 4
+			    ? s->st_size & 0xffffffffu
+			    : s->st_size),
 
 		make_string (modes, 10),
 		Qt,
-		INT_TO_INTEGER (s.st_ino),
-		INT_TO_INTEGER (s.st_dev));
+		INT_TO_INTEGER (s->st_ino),
+		INT_TO_INTEGER (s->st_dev));
+}
+
+/* Looking at many files at once.
+
+   Ffile_attributes_list calls lstat on local files in several
+   threads when there are enough of them for this to pay off.  This
+   helps most on network file systems, where each call waits for the
+   server.  */
+
+/* The number of files looked at by a thread at a time.  */
+enum { ATTRIBUTES_CHUNK = 64 };
+
+/* The maximum number of threads looking at files.  */
+enum { ATTRIBUTES_THREADS = 8 };
+
+struct attributes_file
+{
+  /* The encoded name of the file, or NULL if it is not to be looked
+     at by lstat.  */
+  char *name;
+
+  /* The status of the file, or the errno value if lstat failed.  */
+  struct stat st;
+  int err;
+};
+
+struct attributes_batch
+{
+  sys_mutex_t mutex;
+  sys_cond_t done;
+
+  /* The number of other threads still running, and the index of the
+     next file to look at.  Both are protected by MUTEX.  */
+  int running;
+  ptrdiff_t next;
+
+  ptrdiff_t nfiles;
+  struct attributes_file *files;
+};
+
+/* Look at the files of BATCH until there are none left.  This can be
+   called by any thread.  */
+
+static void
+attributes_batch_stat (struct attributes_batch *batch)
+{
+  while (true)
+    {
+      sys_mutex_lock (&batch->mutex);
+      ptrdiff_t from = batch->next;
+      ptrdiff_t to = min (from, batch->nfiles - ATTRIBUTES_CHUNK)
+		     + ATTRIBUTES_CHUNK;
+      batch->next = to;
+      sys_mutex_unlock (&batch->mutex);
+      if (batch->nfiles <= from)
+	return;
+
+      for (struct attributes_file *f = batch->files + from;
+	   f < batch->files + to; f++)
+	if (f->name)
+	  {
+	    int r;
+	    while ((r = fstatat (AT_FDCWD, f->name, &f->st,
+				 AT_SYMLINK_NOFOLLOW))
+		   != 0
+		   && errno == EINTR)
+	      continue;
+	    f->err = r == 0 ? 0 : errno;
+	  }
+    }
+}
+
+static void *
+attributes_batch_thread (void *arg)
+{
+  struct attributes_batch *batch = arg;
+
+  sys_thread_set_name ("file-attributes");
+  attributes_batch_stat (batch);
+  sys_mutex_lock (&batch->mutex);
+  if (--batch->running == 0)
+    sys_cond_signal (&batch->done);
+  sys_mutex_unlock (&batch->mutex);
+  return NULL;
+}
+
+/* Look at the files of BATCH in up to NTHREADS threads, including the
+   current one.  */
+
+static void
+run_attributes_batch (struct attributes_batch *batch, int nthreads)
+{
+  sys_mutex_init (&batch->mutex);
+  sys_cond_init (&batch->done);
+  batch->running = 0;
+  batch->next = 0;
+  for (int i = 1; i < nthreads; i++)
+    {
+      sys_thread_t thread;
+
+      sys_mutex_lock (&batch->mutex);
+      batch->running++;
+      sys_mutex_unlock (&batch->mutex);
+      if (! sys_thread_create (&thread, attributes_batch_thread, batch))
+	{
+	  sys_mutex_lock (&batch->mutex);
+	  batch->running--;
+	  sys_mutex_unlock (&batch->mutex);
+	  break;
+	}
+    }
+  attributes_batch_stat (batch);
+  sys_mutex_lock (&batch->mutex);
+  while (batch->running > 0)
+    sys_cond_wait (&batch->done, &batch->mutex);
+  sys_mutex_unlock (&batch->mutex);
+  sys_cond_destroy (&batch->done);
+}
+
+static void
+attributes_batch_free (void *arg)
+{
+  struct attributes_batch *batch = arg;
+
+  for (ptrdiff_t i = 0; i < batch->nfiles; i++)
+    xfree (batch->files[i].name);
+  xfree (batch->files);
+}
+
+DEFUN ("file-attributes-list", Ffile_attributes_list,
+       Sfile_attributes_list, 1, 2, 0,
+       doc: /* Return a list of the attributes of each file in FILES.
+FILES is a list of file names.  Each element of the value is what
+`file-attributes' returns, with ID-FORMAT, for the corresponding
+element of FILES.  This is faster than calling `file-attributes' on
+each file, since local files are looked at by several threads when
+there are many of them.  */)
+  (Lisp_Object files, Lisp_Object id_format)
+{
+  ptrdiff_t nfiles = list_length (files);
+  Lisp_Object result = make_nil_vector (nfiles);
+
+  /* The expanded names of the files to look at in other threads.  */
+  Lisp_Object names = make_nil_vector (nfiles);
+
+  struct attributes_batch batch;
+  batch.nfiles = nfiles;
+  batch.files = xzalloc (nfiles * sizeof *batch.files);
+  specpdl_ref count = SPECPDL_INDEX ();
+  record_unwind_protect_ptr (attributes_batch_free, &batch);
+
+  ptrdiff_t i = 0, nlocal = 0;
+  for (Lisp_Object tail = files; CONSP (tail); tail = XCDR (tail), i++)
+    {
+      Lisp_Object filename
+	= internal_condition_case_2 (Fexpand_file_name, XCAR (tail), Qnil,
+				     Qt, Fidentity);
+      if (!STRINGP (filename))
+	continue;
+
+      maybe_quit ();
+
+      /* Look at the files that need special treatment one by one.  */
+#if defined DOS_NT || (defined HAVE_ANDROID && !defined ANDROID_STUBIFY)
+      bool direct = true;
+#else
+      bool direct
+	= !NILP (Ffind_file_name_handler (filename, Qfile_attributes));
+#endif
+#ifdef GNU_LINUX
+      direct |= cache_file_attributes;
+#endif
+      if (direct)
+	ASET (result, i, Ffile_attributes (filename, id_format));
+      else
+	{
+	  ASET (names, i, filename);
+	  batch.files[i].name = xstrdup (SSDATA (ENCODE_FILE (filename)));
+	  nlocal++;
+	}
+    }
+
+  if (nlocal > 0)
+    {
+      int nthreads = min (num_processors (NPROC_CURRENT), ATTRIBUTES_THREADS);
+      nthreads = min (nthreads, nlocal / ATTRIBUTES_CHUNK);
+      run_attributes_batch (&batch, max (nthreads, 1));
+    }
+
+  for (i = 0; i < nfiles; i++)
+    {
+      struct attributes_file *f = &batch.files[i];
+      Lisp_Object filename = AREF (names, i), file_type;
+
+      if (!f->name)
+	continue;
+      if (f->err)
+	{
+	  ASET (result, i, file_attribute_errno (filename, f->err));
+	  continue;
+	}
+      if (S_ISLNK (f->st.st_mode))
+	{
+	  file_type = check_emacs_readlinkat (AT_FDCWD, filename, f->name);
+	  if (NILP (file_type))
+	    continue;
+	}
+      else
+	file_type = S_ISDIR (f->st.st_mode) ? Qt : Qnil;
+      ASET (result, i, stat_file_attributes (&f->st, file_type, id_format));
+    }
+
+  unbind_to (count, Qnil);
+  return CALLN (Fappend, result, Qnil);
 }
 
 DEFUN ("file-attributes-lessp", Ffile_attributes_lessp,
@@ -1187,6 +2181,7 @@ syms_of_dired (void)
 {
   DEFSYM (Qdirectory_files, "directory-files");
   DEFSYM (Qdirectory_files_and_attributes, "directory-files-and-attributes");
+  DEFSYM (Qdirectory_files_walk, "directory-files-walk");
   DEFSYM (Qfile_name_completion, "file-name-completion");
   DEFSYM (Qfile_name_all_completions, "file-name-all-completions");
   DEFSYM (Qfile_attributes, "file-attributes");
@@ -1196,9 +2191,11 @@ syms_of_dired (void)
 
   defsubr (&Sdirectory_files);
   defsubr (&Sdirectory_files_and_attributes);
+  defsubr (&Sdirectory_files_walk);
   defsubr (&Sfile_name_completion);
   defsubr (&Sfile_name_all_completions);
   defsubr (&Sfile_attributes);
+  defsubr (&Sfile_attributes_list);
   defsubr (&Sfile_attributes_lessp);
   defsubr (&Ssystem_users);
   defsubr (&Ssystem_groups);
@@ -1210,4 +2207,26 @@ these strings or when displaying a list of completions.
 It ignores directory names if they match any string in this list which
 ends in a slash.  */);
   Vcompletion_ignored_extensions = Qnil;
+
+  DEFVAR_BOOL ("cache-file-attributes", cache_file_attributes,
+	       doc: /* Non-nil means `file-attributes' remembers what it returns.
+The attributes of local files are then remembered until they may have
+changed, which the operating system reports; this is faster when the
+same files are looked at many times, as by Dired or VC.  Some changes
+are not reported, so they may be missed: those made on other machines
+to files on network file systems, and those made to files through hard
+links in other directories, including adding and removing such links.
+This has an effect only on GNU/Linux.  */);
+  cache_file_attributes = false;
+
+#ifndef WINDOWSNT
+  staticpro (&user_names);
+  staticpro (&group_names);
+#endif
+#ifdef GNU_LINUX
+  staticpro (&attributes_cache[0]);
+  staticpro (&attributes_cache[1]);
+  staticpro (&attributes_watches);
+  staticpro (&attributes_watched);
+#endif
 }
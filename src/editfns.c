@@ -2359,7 +2359,7 @@ Both characters must have the same length of multi-byte form.  */)
   if (!changed && !NILP (noundo))
     {
       record_unwind_protect (subst_char_in_region_unwind,
-			     BVAR (current_buffer, undo_list));
+			     buffer_undo_list (current_buffer));
       bset_undo_list (current_buffer, Qt);
       /* Don't do file-locking.  */
       record_unwind_protect (subst_char_in_region_unwind_1,
@@ -3088,21 +3088,26 @@ save_restriction_restore_1 (Lisp_Object data)
       eassert (buf == end->buffer);
 
       if (buf /* Verify marker still points to a buffer.  */
-	  && (beg->charpos != BUF_BEGV (buf) || end->charpos != BUF_ZV (buf)))
+	  && (marker_charpos (beg) != BUF_BEGV (buf)
+	      || marker_charpos (end) != BUF_ZV (buf)))
 	/* The restriction has changed from the saved one, so restore
 	   the saved restriction.  */
 	{
 	  ptrdiff_t pt = BUF_PT (buf);
+	  ptrdiff_t begpos = marker_charpos (beg);
+	  ptrdiff_t begbyte = marker_bytepos (beg);
+	  ptrdiff_t endpos = marker_charpos (end);
+	  ptrdiff_t endbyte = marker_bytepos (end);
 
-	  SET_BUF_BEGV_BOTH (buf, beg->charpos, beg->bytepos);
-	  SET_BUF_ZV_BOTH (buf, end->charpos, end->bytepos);
+	  SET_BUF_BEGV_BOTH (buf, begpos, begbyte);
+	  SET_BUF_ZV_BOTH (buf, endpos, endbyte);
 
-	  if (pt < beg->charpos || pt > end->charpos)
+	  if (pt < begpos || pt > endpos)
 	    /* The point is outside the new visible range, move it inside. */
 	    SET_BUF_PT_BOTH (buf,
-			     clip_to_bounds (beg->charpos, pt, end->charpos),
-			     clip_to_bounds (beg->bytepos, BUF_PT_BYTE (buf),
-					     end->bytepos));
+			     clip_to_bounds (begpos, pt, endpos),
+			     clip_to_bounds (begbyte, BUF_PT_BYTE (buf),
+					     endbyte));
 
 	  buf->clip_changed = 1; /* Remember that the narrowing changed. */
 	}
@@ -4474,7 +4479,7 @@ transpose_markers (ptrdiff_t start1, ptrdiff_t end1,
 		   ptrdiff_t start2_byte, ptrdiff_t end2_byte)
 {
   register ptrdiff_t amt1, amt1_byte, amt2, amt2_byte, diff, diff_byte, mpos;
-  register struct Lisp_Marker *marker;
+  ptrdiff_t i, start;
 
   /* Update point as if it were a marker.  */
   if (PT < start1)
@@ -4509,8 +4514,11 @@ transpose_markers (ptrdiff_t start1, ptrdiff_t end1,
   amt1_byte = (end2_byte - start2_byte) + (start2_byte - end1_byte);
   amt2_byte = (end1_byte - start1_byte) + (start2_byte - end1_byte);
 
-  for (marker = BUF_MARKERS (current_buffer); marker; marker = marker->next)
+  start = select_markers (current_buffer, start1, end2);
+  for (i = start; i < BUF_MARKERS_GPT (current_buffer); i++)
     {
+      struct Lisp_Marker *marker = BUF_MARKERS (current_buffer)[i];
+
       mpos = marker->bytepos;
       if (mpos >= start1_byte && mpos < end2_byte)
 	{
@@ -4534,6 +4542,7 @@ transpose_markers (ptrdiff_t start1, ptrdiff_t end1,
 	}
       marker->charpos = mpos;
     }
+  reorder_markers (current_buffer, start);
 }
 
 DEFUN ("transpose-regions", Ftranspose_regions, Stranspose_regions, 4, 5,
@@ -3153,7 +3153,7 @@ shut_down_emacs (int sig, Lisp_Object stuff)
 
   inhibit_sentinels = 1;
   kill_buffer_processes (Qnil);
-  Fdo_auto_save (Qt, Qnil);
+  Fdo_auto_save (Qt, Qnil, Qnil);
 
   unlock_all_files ();
 
@@ -1891,6 +1891,8 @@ probably_quit (void)
     process_quit_flag ();
   else if (pending_signals)
     process_pending_signals ();
+  if (buffer_text_truncated && NILP (Vinhibit_quit))
+    report_truncated_buffer_text ();
   unbind_to (gc_count, Qnil);
 }
 
@@ -19,6 +19,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 #include <config.h>
 #include <limits.h>
+#include <stdlib.h>
 #include <fcntl.h>
 #include "sysstdio.h"
 #include <sys/types.h>
@@ -54,6 +55,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "window.h"
 #include "blockinput.h"
 #include "region-cache.h"
+#include "line-index.h"
 #include "frame.h"
 
 #ifdef HAVE_ANDROID
@@ -65,6 +67,10 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 # include <linux/fs.h>
 #endif
 
+#ifdef GNU_LINUX
+# include <sys/sendfile.h>
+#endif
+
 #ifdef WINDOWSNT
 #define NOMINMAX 1
 #include <windows.h>
@@ -112,6 +118,8 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #endif
 
 #include "commands.h"
+#include "process.h"
+#include "systhread.h"
 
 #if !defined HAVE_ANDROID || defined ANDROID_STUBIFY
 
@@ -175,6 +183,7 @@ static dev_t timestamp_file_system;
 static Lisp_Object Vwrite_region_annotation_buffers;
 
 static Lisp_Object emacs_readlinkat (int, char const *);
+static void auto_save_cancel (char const *);
 static bool a_write (int, Lisp_Object, ptrdiff_t, ptrdiff_t,
 		     Lisp_Object *, struct coding_system *);
 static bool e_write (int, Lisp_Object, ptrdiff_t, ptrdiff_t,
@@ -2247,6 +2256,52 @@ clone_file (int dest, int source)
 #endif
   return false;
 }
+
+/* Ways of copying files within the kernel, from the preferred one.  */
+enum kernel_copy
+  {
+    KERNEL_COPY_FILE_RANGE,
+    KERNEL_COPY_SENDFILE,
+    KERNEL_COPY_NONE
+  };
+
+/* Copy at most NBYTES bytes from the regular file SOURCE to DEST,
+   from and to their current offsets, without copying them to user
+   space, trying *METHOD first and updating it to the method that
+   works.  Return the number of bytes copied, or 0 if no more bytes
+   can be copied this way, in which case the caller should copy the
+   rest, if any, with read and write.  Do not quit.  */
+static ssize_t
+kernel_copy (int dest, int source, ssize_t nbytes, enum kernel_copy *method)
+{
+  ssize_t copied = 0;
+
+  switch (*method)
+    {
+    case KERNEL_COPY_FILE_RANGE:
+#ifndef MSDOS
+      copied = copy_file_range (source, NULL, dest, NULL, nbytes, 0);
+      if (0 < copied)
+	return copied;
+#endif
+      /* copy_file_range fails between file systems with old Linux
+	 kernels, where sendfile still works.  */
+      *method = KERNEL_COPY_SENDFILE;
+      FALLTHROUGH;
+
+    case KERNEL_COPY_SENDFILE:
+#ifdef GNU_LINUX
+      copied = sendfile (dest, source, NULL, nbytes);
+      if (0 < copied)
+	return copied;
+#endif
+      *method = KERNEL_COPY_NONE;
+      FALLTHROUGH;
+
+    default:
+      return 0;
+    }
+}
 #endif
 
 DEFUN ("copy-file", Fcopy_file, Scopy_file, 2, 6,
@@ -2410,25 +2465,24 @@ permissions.  */)
     {
       MAYBE_UNUSED off_t newsize = 0;
 
-#ifndef MSDOS
       if (emacs_fd_to_int (ifd) != -1)
 	{
+	  enum kernel_copy method = KERNEL_COPY_FILE_RANGE;
 	  for (ssize_t copied; ; newsize += copied)
 	    {
 	      /* Copy at most COPY_MAX bytes at a time; this is min
 		 (SSIZE_MAX, SIZE_MAX) truncated to a value that is
 		 surely aligned well.  */
 	      ssize_t copy_max = min (SSIZE_MAX, SIZE_MAX) >> 30 << 30;
-	      copied = copy_file_range (emacs_fd_to_int (ifd), NULL,
-					ofd, NULL, copy_max, 0);
+	      copied = kernel_copy (ofd, emacs_fd_to_int (ifd), copy_max,
+				    &method);
 	      if (copied <= 0)
 		break;
 	      maybe_quit ();
 	    }
 	}
-#endif /* MSDOS */
 
-      /* Follow up with read+write regardless of any copy_file_range failure.
+      /* Follow up with read+write regardless of any kernel_copy failure.
 	 Many copy_file_range implementations fail for no good reason,
 	 or "succeed" even when they did nothing (e.g., in /proc files).
 	 Also, if read+write fails it will report an error more
@@ -2558,6 +2612,448 @@ permissions.  */)
 
   return Qnil;
 }
+
+/* Make a pipe through which other threads wake up the main thread,
+   and store its descriptors in FDS, or -1 if that fails.  FUNC is
+   then called by wait_reading_process_output in the main thread
+   whenever wakeup_main_thread writes to FDS[1].  */
+
+static void
+make_wakeup_pipe (int fds[2], fd_callback func)
+{
+  fds[0] = fds[1] = -1;
+#ifndef WINDOWSNT
+  int p[2];
+  if (emacs_pipe (p) == 0)
+    {
+      if (p[0] < FD_SETSIZE
+	  && fcntl (p[0], F_SETFL, O_NONBLOCK) == 0
+	  && fcntl (p[1], F_SETFL, O_NONBLOCK) == 0)
+	{
+	  fds[0] = p[0];
+	  fds[1] = p[1];
+	  add_non_keyboard_read_fd (p[0], func, NULL);
+	}
+      else
+	{
+	  emacs_close (p[0]);
+	  emacs_close (p[1]);
+	}
+    }
+#endif
+}
+
+/* Wake up the main thread through the pipe whose writing end is FD,
+   unless FD is negative.  This can be called in any thread.  */
+
+static void
+wakeup_main_thread (int fd)
+{
+  if (0 <= fd)
+    {
+      char dummy = 0;
+      /* If the pipe is full, the main thread has yet to read it.  */
+      int ignored = write (fd, &dummy, 1);
+      (void) ignored;
+    }
+}
+
+/* Read the bytes written to the wakeup pipe whose reading end is
+   FD.  */
+
+static void
+drain_wakeup_pipe (int fd)
+{
+  char buf[64];
+  while (emacs_read (fd, buf, sizeof buf) > 0)
+    continue;
+}
+
+/* Copying files in the background.
+
+   copy-file-async opens the files in the main thread, as copy-file
+   does, and starts another thread that copies the data, within the
+   kernel when possible.  That thread wakes up the main thread
+   whenever it has copied FILE_COPY_CHUNK more bytes, and when it is
+   done.  The main thread then arranges for the progress functions and
+   the callbacks of the copies to be called from the command loop,
+   through pending_funcalls, and closes the files of the copies that
+   are done.  */
+
+/* Number of bytes copied between reports of progress.  */
+enum { FILE_COPY_CHUNK = 64 << 20 };
+
+/* Size of the buffer used when the data cannot be copied within the
+   kernel.  */
+enum { FILE_COPY_BUFSIZE = 1 << 20 };
+
+struct file_copy
+{
+  struct file_copy *next;
+
+  /* The descriptors of the input and output files, the status of the
+     input file, the encoded name of the output file, and whether to
+     give it the time stamps of the input file.  */
+  int ifd, ofd;
+  struct stat st;
+  char *newname;
+  bool keep_time;
+
+  /* The number of bytes copied, and whether the main thread cancelled
+     the copy.  */
+  off_t copied;
+  bool cancelled;
+
+  /* The number of bytes copied when progress was last reported.  */
+  off_t reported;
+
+  /* The errno value of the failure, what failed, and whether it failed
+     writing rather than reading.  */
+  int err;
+  char const *failure;
+  bool write_failed;
+};
+
+static struct
+{
+  /* Whether the members below are initialized.  */
+  bool initialized;
+
+  /* Protects the members below, and the COPIED and CANCELLED members
+     of the copies.  */
+  sys_mutex_t mutex;
+
+  /* The copies that are done.  */
+  struct file_copy *done;
+
+  /* The pipe used to wake up the main thread, or -1.  */
+  int wakeup[2];
+} file_copy_bg;
+
+/* The copies whose callbacks have not been called yet, as a list of
+   (ID CALLBACK PROGRESS FILE NEWNAME COPY), COPY being the C structure
+   as a mint pointer.  */
+static Lisp_Object file_copies;
+
+/* The last ID given to a copy.  */
+static EMACS_INT file_copy_last_id;
+
+/* Record in C that it failed with the errno value ERR.  */
+
+static void
+file_copy_fail (struct file_copy *c, int err, bool write_failed)
+{
+  c->err = err;
+  c->failure = write_failed ? "Write error" : "Read error";
+  c->write_failed = write_failed;
+}
+
+static void *
+file_copy_thread (void *arg)
+{
+  struct file_copy *c = arg;
+  enum kernel_copy method = KERNEL_COPY_FILE_RANGE;
+  char *buf = NULL;
+  off_t copied = 0, notified = 0;
+
+  sys_thread_set_name ("file-copy");
+
+  if (clone_file (c->ofd, c->ifd))
+    copied = c->st.st_size;
+  else
+    while (true)
+      {
+	ssize_t n = kernel_copy (c->ofd, c->ifd, FILE_COPY_CHUNK, &method);
+	if (n == 0)
+	  {
+	    /* As in copy-file, finish with read and write when the
+	       kernel cannot copy the data.  */
+	    if (!buf)
+	      buf = malloc (FILE_COPY_BUFSIZE);
+	    if (!buf)
+	      {
+		file_copy_fail (c, ENOMEM, false);
+		break;
+	      }
+	    n = emacs_read (c->ifd, buf, FILE_COPY_BUFSIZE);
+	    if (n < 0)
+	      {
+		file_copy_fail (c, errno, false);
+		break;
+	      }
+	    if (n == 0)
+	      break;
+	    if (emacs_write (c->ofd, buf, n) != n)
+	      {
+		file_copy_fail (c, errno, true);
+		break;
+	      }
+	  }
+	copied += n;
+
+	sys_mutex_lock (&file_copy_bg.mutex);
+	c->copied = copied;
+	bool cancelled = c->cancelled;
+	sys_mutex_unlock (&file_copy_bg.mutex);
+	if (cancelled)
+	  break;
+	if (FILE_COPY_CHUNK <= copied - notified)
+	  {
+	    notified = copied;
+	    wakeup_main_thread (file_copy_bg.wakeup[1]);
+	  }
+      }
+  free (buf);
+
+  sys_mutex_lock (&file_copy_bg.mutex);
+  c->copied = copied;
+  c->next = file_copy_bg.done;
+  file_copy_bg.done = c;
+  wakeup_main_thread (file_copy_bg.wakeup[1]);
+  sys_mutex_unlock (&file_copy_bg.mutex);
+  return NULL;
+}
+
+/* Close the files of copy C, which is done, and return the arguments
+   of its callback, or nil if it was cancelled.  FILE and NEWNAME are
+   the names of its files.  */
+
+static Lisp_Object
+file_copy_finish (struct file_copy *c, Lisp_Object file, Lisp_Object newname)
+{
+  Lisp_Object data = Qnil;
+
+  if (!c->err && !c->cancelled && c->keep_time)
+    {
+      struct timespec ts[2];
+      ts[0] = get_stat_atime (&c->st);
+      ts[1] = get_stat_mtime (&c->st);
+      if (futimens (c->ofd, ts) != 0)
+	data = list3 (Qfile_date_error,
+		      build_string ("Cannot set file date"), newname);
+    }
+  if (emacs_close (c->ofd) != 0 && !c->err)
+    file_copy_fail (c, errno, true);
+  emacs_close (c->ifd);
+
+  if (c->cancelled)
+    {
+      /* Don't leave a partial copy behind.  */
+      emacs_unlink (c->newname);
+      return Qnil;
+    }
+  if (c->err)
+    data = get_file_errno_data (c->failure,
+				c->write_failed ? newname : file, c->err);
+  return list1 (data);
+}
+
+/* Arrange for the progress functions of the copies that progressed,
+   and the callbacks of those that are done, to be called.  */
+
+static void
+file_copy_process (void)
+{
+  Lisp_Object calls = Qnil, tail;
+
+  sys_mutex_lock (&file_copy_bg.mutex);
+  struct file_copy *c = file_copy_bg.done;
+  file_copy_bg.done = NULL;
+  for (tail = file_copies; CONSP (tail); tail = XCDR (tail))
+    {
+      Lisp_Object entry = XCAR (tail);
+      Lisp_Object progress = Fnth (make_fixnum (2), entry);
+      struct file_copy *p = xmint_pointer (Fnth (make_fixnum (5), entry));
+      if (!NILP (progress) && p->copied != p->reported)
+	{
+	  p->reported = p->copied;
+	  calls = Fcons (list3 (progress, INT_TO_INTEGER (p->copied),
+				INT_TO_INTEGER (p->st.st_size)),
+			 calls);
+	}
+    }
+  sys_mutex_unlock (&file_copy_bg.mutex);
+
+  while (c)
+    {
+      struct file_copy *next = c->next;
+      Lisp_Object entry = Qnil;
+
+      /* Cancelled copies are no longer in file_copies.  */
+      for (tail = file_copies; CONSP (tail); tail = XCDR (tail))
+	if (xmint_pointer (Fnth (make_fixnum (5), XCAR (tail))) == c)
+	  {
+	    entry = XCAR (tail);
+	    break;
+	  }
+      if (NILP (entry))
+	file_copy_finish (c, Qnil, Qnil);
+      else
+	{
+	  Lisp_Object args
+	    = file_copy_finish (c, Fnth (make_fixnum (3), entry),
+				Fnth (make_fixnum (4), entry));
+	  file_copies = Fdelq (entry, file_copies);
+	  calls = Fcons (Fcons (Fnth (make_fixnum (1), entry), args), calls);
+	}
+      xfree (c->newname);
+      xfree (c);
+      c = next;
+    }
+
+  /* Call the functions after those already pending, in order.  */
+  if (!NILP (calls))
+    pending_funcalls = CALLN (Fnconc, pending_funcalls, Fnreverse (calls));
+}
+
+static void
+file_copy_wakeup (int fd, void *data)
+{
+  drain_wakeup_pipe (fd);
+  file_copy_process ();
+}
+
+DEFUN ("copy-file-async", Fcopy_file_async, Scopy_file_async, 3, 6, 0,
+       doc: /* Copy FILE to NEWNAME in the background.
+Return at once, and call CALLBACK later, when the copy is done, with
+one argument: nil if the copy succeeded, or the error data, as in
+`condition-case', if it failed.  The data is copied by another thread,
+within the kernel when the system supports it, so that copying large
+files neither keeps Emacs from responding nor goes through its memory.
+
+FILE, NEWNAME, OK-IF-ALREADY-EXISTS and KEEP-TIME are as in
+`copy-file'.  Errors found before the copy starts, such as NEWNAME
+already existing, are signaled at once.  If NEWNAME is created, its
+file permission bits are those of FILE, masked by the default file
+permissions.
+
+If PROGRESS is non-nil, it is a function called from time to time
+during the copy with two arguments: the number of bytes copied so far,
+and the size of FILE.
+
+Return an object identifying the copy, which can be passed to
+`copy-file-async-cancel'.  */)
+  (Lisp_Object file, Lisp_Object newname, Lisp_Object callback,
+   Lisp_Object ok_if_already_exists, Lisp_Object keep_time,
+   Lisp_Object progress)
+{
+  Lisp_Object handler;
+
+  file = Fexpand_file_name (file, Qnil);
+  newname = expand_cp_target (file, newname);
+
+  handler = Ffind_file_name_handler (file, Qcopy_file_async);
+  if (NILP (handler))
+    handler = Ffind_file_name_handler (newname, Qcopy_file_async);
+  if (!NILP (handler))
+    return calln (handler, Qcopy_file_async, file, newname, callback,
+		  ok_if_already_exists, keep_time, progress);
+
+  Lisp_Object id = make_int (++file_copy_last_id);
+
+#ifdef DOS_NT
+  /* Copy the file at once, but still call CALLBACK later.  */
+  Fcopy_file (file, newname, ok_if_already_exists, keep_time, Qnil, Qnil);
+  pending_funcalls = CALLN (Fnconc, pending_funcalls,
+			    list1 (list2 (callback, Qnil)));
+#else
+  specpdl_ref count = SPECPDL_INDEX ();
+  Lisp_Object encoded_file = ENCODE_FILE (file);
+  Lisp_Object encoded_newname = ENCODE_FILE (newname);
+  bool already_exists = false;
+  struct stat st;
+  int ifd, ofd;
+
+  ifd = emacs_open (SSDATA (encoded_file), O_RDONLY | O_NONBLOCK, 0);
+  if (ifd < 0)
+    report_file_error ("Opening input file", file);
+  record_unwind_protect_int (close_file_unwind, ifd);
+
+  if (sys_fstat (ifd, &st) != 0)
+    report_file_error ("Input file status", file);
+
+  /* We can copy only regular files.  */
+  if (!S_ISREG (st.st_mode))
+    report_file_errno ("Non-regular file", file,
+		       S_ISDIR (st.st_mode) ? EISDIR : EINVAL);
+
+  ofd = emacs_open (SSDATA (encoded_newname), O_WRONLY | O_CREAT | O_EXCL,
+		    st.st_mode & 0777);
+  if (ofd < 0 && errno == EEXIST)
+    {
+      if (NILP (ok_if_already_exists) || FIXNUMP (ok_if_already_exists))
+	barf_or_query_if_file_exists (newname, true, "copy to it",
+				      FIXNUMP (ok_if_already_exists), false);
+      already_exists = true;
+      ofd = emacs_open (SSDATA (encoded_newname), O_WRONLY | O_TRUNC, 0);
+    }
+  if (ofd < 0)
+    report_file_error ("Opening output file", newname);
+  record_unwind_protect_int (close_file_unwind, ofd);
+
+  if (already_exists)
+    {
+      struct stat out_st;
+      if (sys_fstat (ofd, &out_st) != 0)
+	report_file_error ("Output file status", newname);
+      if (st.st_dev == out_st.st_dev && st.st_ino == out_st.st_ino)
+	report_file_errno ("Input and output files are the same",
+			   list2 (file, newname), 0);
+    }
+
+  if (!file_copy_bg.initialized)
+    {
+      sys_mutex_init (&file_copy_bg.mutex);
+      make_wakeup_pipe (file_copy_bg.wakeup, file_copy_wakeup);
+      file_copy_bg.initialized = true;
+    }
+
+  struct file_copy *c = xzalloc (sizeof *c);
+  c->ifd = ifd;
+  c->ofd = ofd;
+  c->st = st;
+  c->newname = xstrdup (SSDATA (encoded_newname));
+  c->keep_time = !NILP (keep_time);
+  file_copies = Fcons (list (id, callback, progress, file, newname,
+			     make_mint_ptr (c)),
+		       file_copies);
+
+  /* The files now belong to C.  */
+  specpdl_ptr = specpdl_ref_to_ptr (count);
+
+  sys_thread_t thread;
+  if (file_copy_bg.wakeup[0] < 0
+      || !sys_thread_create (&thread, file_copy_thread, c))
+    {
+      file_copy_thread (c);
+      file_copy_process ();
+    }
+#endif
+  return id;
+}
+
+DEFUN ("copy-file-async-cancel", Fcopy_file_async_cancel,
+       Scopy_file_async_cancel, 1, 1, 0,
+       doc: /* Cancel a copy started by `copy-file-async'.
+COPY is the value returned by `copy-file-async'.  Its callback and
+progress function will not be called anymore, and the partial copy is
+deleted.  Return non-nil if the copy was cancelled, nil if its
+callback was already called or is about to be.  */)
+  (Lisp_Object copy)
+{
+  Lisp_Object entry = Fassq (copy, file_copies);
+
+  if (NILP (entry))
+    return Qnil;
+  file_copies = Fdelq (entry, file_copies);
+
+  struct file_copy *c = xmint_pointer (Fnth (make_fixnum (5), entry));
+  sys_mutex_lock (&file_copy_bg.mutex);
+  c->cancelled = true;
+  sys_mutex_unlock (&file_copy_bg.mutex);
+  return Qt;
+}
+
 
 DEFUN ("make-directory-internal", Fmake_directory_internal,
        Smake_directory_internal, 1, 1, 0,
@@ -2611,6 +3107,7 @@ If file has multiple names, it continues to exist with the other names. */)
   filename = Fexpand_file_name (filename, Qnil);
   encoded_file = ENCODE_FILE (filename);
 
+  auto_save_cancel (SSDATA (encoded_file));
   if (emacs_unlink (SSDATA (encoded_file)) != 0
       && errno != ENOENT)
     report_file_error ("Removing old name", filename);
@@ -2769,6 +3266,7 @@ This is what happens in interactive use with M-x.  */)
   encoded_file = ENCODE_FILE (file);
   encoded_newname = ENCODE_FILE (newname);
 
+  auto_save_cancel (SSDATA (encoded_file));
   bool plain_rename = (case_only_rename
 		       || (!NILP (ok_if_already_exists)
 			   && !FIXNUMP (ok_if_already_exists)));
@@ -4123,7 +4621,7 @@ by calling `format-decode', which see.  */)
   /* If the undo log only contains the insertion, there's no point
      keeping it.  It's typically when we first fill a file-buffer.  */
   bool empty_undo_list_p
-    = (!NILP (visit) && NILP (BVAR (current_buffer, undo_list))
+    = (!NILP (visit) && NILP (buffer_undo_list (current_buffer))
        && BEG == Z);
   Lisp_Object old_Vdeactivate_mark = Vdeactivate_mark;
   bool we_locked_file = false;
@@ -4139,6 +4637,12 @@ by calling `format-decode', which see.  */)
   /* The size reported by fstat, or -1 if the file was not found or its
      size is meaningless.  */
   off_t st_size = -1;
+  /* Whether to try mapping the file into memory rather than reading
+     it, see `file-mapping-threshold'.  */
+  bool map_file = false;
+  /* Whether the bytes inserted are at the end of the gap, rather than
+     at its beginning.  */
+  bool text_at_gap_tail = false;
 
   if (current_buffer->base_buffer && ! NILP (visit))
     error ("Cannot do file visiting in an indirect buffer");
@@ -4171,6 +4675,10 @@ by calling `format-decode', which see.  */)
       goto handled;
     }
 
+  /* What set-auto-coding prepares to remember about the file is only
+     for after-insert-file-set-coding, below.  */
+  specbind (Qcoding_detection__pending, Qnil);
+
   if (!NILP (visit))
     {
       if (!NILP (beg) || !NILP (end))
@@ -4309,11 +4817,26 @@ by calling `format-decode', which see.  */)
       /* Ensure we set Vlast_coding_system_used.  */
       set_coding_system = true;
     }
-  else if (BEG < Z)
+  else
+    {
+      /* Map big files only if they are inserted whole in an empty
+	 unibyte buffer, where the changes other programs can make to
+	 the file cannot make the text invalid.  */
+      map_file = (regular && st_size > 0
+		  && FIXNATP (Vfile_mapping_threshold)
+		  && st_size >= XFIXNAT (Vfile_mapping_threshold)
+		  && NILP (beg) && NILP (end) && NILP (replace)
+		  && BEG == Z && emacs_fd_to_int (fd) >= 0
+		  && NILP (BVAR (current_buffer,
+				 enable_multibyte_characters)));
+    }
+
+  if (!set_coding_system && (BEG < Z || map_file))
     {
       /* Decide the coding system to use for reading the file now
          because we can't use an optimized method for handling
-         `coding:' tag if the current buffer is not empty.  */
+         `coding:' tag if the current buffer is not empty, nor when
+         the file is mapped, since that method moves the text.  */
       if (!NILP (Vcoding_system_for_read))
 	coding_system = Vcoding_system_for_read;
       else
@@ -4898,6 +5421,17 @@ by calling `format-decode', which see.  */)
 
   move_gap_both (PT, PT_BYTE);
 
+  /* Map the file rather than reading it if it is big: the
+     end-of-line conversion, if any, then works in place.  */
+  if (map_file && beg_offset == 0 && st_size <= end_offset
+      && BEG == Z && NILP (BVAR (current_buffer, enable_multibyte_characters))
+      && map_buffer_text (current_buffer, emacs_fd_to_int (fd), st_size))
+    {
+      inserted = st_size;
+      text_at_gap_tail = true;
+      goto read_done;
+    }
+
   /* Ensure the gap is at least one byte larger than needed for the
      estimated insertion, so that in the usual case we read
      without reallocating.  */
@@ -4994,6 +5528,7 @@ by calling `format-decode', which see.  */)
       }
   }
 
+ read_done:
   /* Now we have either read all the file data into the gap,
      or stop reading on I/O error or quit.  If nothing was
      read, undo marking the buffer modified.  */
@@ -5022,7 +5557,7 @@ by calling `format-decode', which see.  */)
 
 	 Note that we can get here only if the buffer was empty
 	 before the insertion.  */
-      eassert (Z == BEG);
+      eassert (Z == BEG && !text_at_gap_tail);
 
       if (!NILP (Vcoding_system_for_read))
 	coding_system = Vcoding_system_for_read;
@@ -5037,7 +5572,7 @@ by calling `format-decode', which see.  */)
             = BVAR (current_buffer, enable_multibyte_characters);
           Lisp_Object unwind_data
             = Fcons (multibyte,
-                     Fcons (BVAR (current_buffer, undo_list),
+                     Fcons (buffer_undo_list (current_buffer),
 			    Fcurrent_buffer ()));
 	  specpdl_ref count1 = SPECPDL_INDEX ();
 
@@ -5110,7 +5645,9 @@ by calling `format-decode', which see.  */)
       /* Now we have all the new bytes at the beginning of the gap,
          but `decode_coding_gap` can't have them at the beginning of the gap,
          so we need to move them.  */
-      memmove (GAP_END_ADDR - inserted, GPT_ADDR, inserted);
+      if (!text_at_gap_tail)
+	memmove (GAP_END_ADDR - inserted, GPT_ADDR, inserted);
+      coding.mode |= CODING_MODE_LAST_BLOCK;
       decode_coding_gap (&coding, inserted);
       inserted = coding.produced_char;
       coding_system = CODING_ID_NAME (coding.id);
@@ -5119,11 +5656,18 @@ by calling `format-decode', which see.  */)
     {
       /* Make the text read part of the buffer.  */
       eassert (NILP (BVAR (current_buffer, enable_multibyte_characters)));
-      insert_from_gap_1 (inserted, inserted, false);
+      if (text_at_gap_tail)
+	/* Don't move the gap over the text, which would copy all of
+	   it if it is mapped.  */
+	insert_from_gap (inserted, inserted, true, false);
+      else
+	{
+	  insert_from_gap_1 (inserted, inserted, false);
 
-      invalidate_buffer_caches (current_buffer, PT, PT + inserted);
-      adjust_after_insert (PT, PT_BYTE, PT + inserted, PT_BYTE + inserted,
-			   inserted);
+	  invalidate_buffer_caches (current_buffer, PT, PT + inserted);
+	  adjust_after_insert (PT, PT_BYTE, PT + inserted,
+			       PT_BYTE + inserted, inserted);
+	}
     }
 
   /* Call after-change hooks for the inserted text, aside from the case
@@ -5148,7 +5692,10 @@ by calling `format-decode', which see.  */)
   if (!NILP (visit))
     {
       if (empty_undo_list_p)
-	bset_undo_list (current_buffer, Qnil);
+	{
+	  bset_undo_list (current_buffer, Qnil);
+	  free_undo_log (current_buffer);
+	}
 
       if (NILP (handler))
 	{
@@ -5195,7 +5742,7 @@ by calling `format-decode', which see.  */)
       specbind (Qinhibit_modification_hooks, Qt);
 
       /* Save old undo list and don't record undo for decoding.  */
-      old_undo = BVAR (current_buffer, undo_list);
+      old_undo = buffer_undo_list (current_buffer);
       bset_undo_list (current_buffer, Qt);
 
       if (NILP (replace))
@@ -5298,9 +5845,12 @@ by calling `format-decode', which see.  */)
 	    }
 	}
       else
-	/* If undo_list was Qt before, keep it that way.
-	   Otherwise start with an empty undo_list.  */
-	bset_undo_list (current_buffer, EQ (old_undo, Qt) ? Qt : Qnil);
+	{
+	  /* If undo_list was Qt before, keep it that way.
+	     Otherwise start with an empty undo_list.  */
+	  bset_undo_list (current_buffer, EQ (old_undo, Qt) ? Qt : Qnil);
+	  free_undo_log (current_buffer);
+	}
 
       unbind_to (count1, Qnil);
     }
@@ -5323,6 +5873,13 @@ by calling `format-decode', which see.  */)
     invalidate_region_cache (current_buffer,
                              current_buffer->newline_cache,
                              PT - BEG, Z - PT - inserted);
+  if (current_buffer->base_buffer && current_buffer->base_buffer->line_index)
+    invalidate_line_index (current_buffer->base_buffer,
+			   current_buffer->base_buffer->line_index,
+			   PT - BEG, Z - PT - inserted);
+  else if (current_buffer->line_index)
+    invalidate_line_index (current_buffer, current_buffer->line_index,
+			   PT - BEG, Z - PT - inserted);
 
   if (read_quit)
     quit ();
@@ -5334,6 +5891,361 @@ by calling `format-decode', which see.  */)
   return unbind_to (count, val);
 }
 
+/* Reading files in the background.
+
+   file-read-async hands each request to a small pool of threads,
+   which open the file and read it into memory.  When a request is
+   done, its thread puts it on a list and writes a byte to a pipe
+   watched by wait_reading_process_output.  The callback of that pipe,
+   which runs in the main thread, then arranges for the Lisp callback
+   of the request to be called from the command loop, through
+   pending_funcalls.  Without threads, requests are read at once, but
+   their callbacks are still called later.  */
+
+enum { FILE_READ_THREADS = 4 };
+
+/* Number of bytes a thread reads before checking whether its request
+   was cancelled.  */
+enum { FILE_READ_CHUNK = 1 << 20 };
+
+struct file_read_request
+{
+  struct file_read_request *next;
+
+  /* The number that identifies the request in Lisp.  */
+  EMACS_INT id;
+
+  /* The encoded name of the file, and the byte offsets to read from
+     and up to; END is negative to read up to the end of the file.  */
+  char *filename;
+  off_t beg, end;
+
+  /* Set by the main thread to tell the thread reading the file to
+     stop.  */
+  bool cancelled;
+
+  /* The bytes read, or the errno value of the failure, and what
+     failed.  */
+  char *data;
+  ptrdiff_t nbytes;
+  int err;
+  char const *failure;
+};
+
+static struct
+{
+  /* Whether the members below are initialized.  */
+  bool initialized;
+
+  /* Protects the members below, and the CANCELLED flag of the
+     requests; QUEUED is signaled when a request is queued.  */
+  sys_mutex_t mutex;
+  sys_cond_t queued;
+
+  /* Requests waiting for a thread, oldest first, and their number.  */
+  struct file_read_request *queue, **queue_tail;
+  int nqueued;
+
+  /* Requests that have been read.  */
+  struct file_read_request *done;
+
+  /* The number of threads, and how many of them are waiting for a
+     request.  */
+  int threads, idle;
+
+  /* The pipe used to wake up the main thread, or -1.  */
+  int wakeup[2];
+} file_read;
+
+/* The requests whose callbacks have not been called yet, as a list of
+   (ID CALLBACK FILENAME REQUEST), REQUEST being the C structure as a
+   mint pointer.  */
+static Lisp_Object file_read_requests;
+
+/* The last ID given to a request.  */
+static EMACS_INT file_read_last_id;
+
+/* Read the file of REQ, recording the result in REQ.  This can be
+   called in any thread, and does not quit.  */
+
+static void
+file_read_contents (struct file_read_request *req)
+{
+  struct stat st;
+  ptrdiff_t size = 0, alloc;
+  off_t limit = req->end < 0 ? TYPE_MAXIMUM (off_t) : req->end - req->beg;
+  int fd = emacs_open_noquit (req->filename, O_RDONLY, 0);
+
+  if (fd < 0)
+    {
+      req->err = errno;
+      req->failure = "Opening input file";
+      return;
+    }
+  if (fstat (fd, &st) != 0)
+    {
+      req->err = errno;
+      req->failure = "Input file status";
+      goto out;
+    }
+  if (S_ISDIR (st.st_mode))
+    {
+      req->err = EISDIR;
+      req->failure = "Read error";
+      goto out;
+    }
+  if (req->beg > 0 && lseek (fd, req->beg, SEEK_SET) < 0)
+    {
+      req->err = errno;
+      req->failure = "Setting file position";
+      goto out;
+    }
+
+  /* Allocate room for the whole file if its size is known, plus one
+     byte to see the end of file.  */
+  alloc = (S_ISREG (st.st_mode) && req->beg < st.st_size
+	   ? min (min (st.st_size - req->beg, limit), STRING_BYTES_BOUND) + 1
+	   : FILE_READ_CHUNK);
+  req->data = malloc (alloc);
+
+  while (req->data && size < limit)
+    {
+      bool cancelled;
+      sys_mutex_lock (&file_read.mutex);
+      cancelled = req->cancelled;
+      sys_mutex_unlock (&file_read.mutex);
+      if (cancelled)
+	break;
+
+      if (size == alloc)
+	{
+	  char *data = NULL;
+	  if (alloc <= STRING_BYTES_BOUND / 2)
+	    data = realloc (req->data, alloc * 2);
+	  if (!data)
+	    {
+	      req->err = alloc <= STRING_BYTES_BOUND / 2 ? ENOMEM : EFBIG;
+	      req->failure = "Read error";
+	      break;
+	    }
+	  req->data = data;
+	  alloc *= 2;
+	}
+
+      ptrdiff_t n = emacs_read (fd, req->data + size,
+				min (min (alloc - size, FILE_READ_CHUNK),
+				     limit - size));
+      if (n < 0)
+	{
+	  req->err = errno;
+	  req->failure = "Read error";
+	  break;
+	}
+      if (n == 0)
+	break;
+      size += n;
+    }
+  if (!req->data)
+    {
+      req->err = ENOMEM;
+      req->failure = "Read error";
+    }
+  req->nbytes = size;
+
+ out:
+  emacs_close (fd);
+}
+
+/* Put REQ on the list of requests that have been read, and wake up the
+   main thread.  The caller must hold file_read.mutex.  */
+
+static void
+file_read_finish (struct file_read_request *req)
+{
+  req->next = file_read.done;
+  file_read.done = req;
+  wakeup_main_thread (file_read.wakeup[1]);
+}
+
+static void *
+file_read_thread (void *arg)
+{
+  sys_thread_set_name ("file-read");
+  sys_mutex_lock (&file_read.mutex);
+  while (true)
+    {
+      while (!file_read.queue)
+	sys_cond_wait (&file_read.queued, &file_read.mutex);
+
+      struct file_read_request *req = file_read.queue;
+      file_read.queue = req->next;
+      if (!file_read.queue)
+	file_read.queue_tail = &file_read.queue;
+      file_read.nqueued--;
+      file_read.idle--;
+
+      if (!req->cancelled)
+	{
+	  sys_mutex_unlock (&file_read.mutex);
+	  file_read_contents (req);
+	  sys_mutex_lock (&file_read.mutex);
+	}
+      file_read_finish (req);
+      file_read.idle++;
+    }
+  return NULL;
+}
+
+/* Arrange for the callbacks of the requests that have been read to be
+   called.  */
+
+static void
+file_read_process_done (void)
+{
+  sys_mutex_lock (&file_read.mutex);
+  struct file_read_request *req = file_read.done;
+  file_read.done = NULL;
+  sys_mutex_unlock (&file_read.mutex);
+
+  while (req)
+    {
+      struct file_read_request *next = req->next;
+      Lisp_Object entry = Fassq (make_int (req->id), file_read_requests);
+
+      /* Cancelled requests are no longer in file_read_requests.  */
+      if (!NILP (entry))
+	{
+	  Lisp_Object callback = XCAR (XCDR (entry));
+	  Lisp_Object filename = XCAR (XCDR (XCDR (entry)));
+	  Lisp_Object args
+	    = (req->err
+	       ? list2 (Qnil, get_file_errno_data (req->failure, filename,
+						   req->err))
+	       : list2 (make_unibyte_string (req->data, req->nbytes), Qnil));
+
+	  file_read_requests = Fdelq (entry, file_read_requests);
+	  pending_funcalls = Fcons (Fcons (callback, args), pending_funcalls);
+	}
+      free (req->data);
+      xfree (req->filename);
+      xfree (req);
+      req = next;
+    }
+}
+
+static void
+file_read_wakeup (int fd, void *data)
+{
+  drain_wakeup_pipe (fd);
+  file_read_process_done ();
+}
+
+static void
+file_read_init (void)
+{
+  if (file_read.initialized)
+    return;
+  sys_mutex_init (&file_read.mutex);
+  sys_cond_init (&file_read.queued);
+  file_read.queue_tail = &file_read.queue;
+  make_wakeup_pipe (file_read.wakeup, file_read_wakeup);
+  file_read.initialized = true;
+}
+
+DEFUN ("file-read-async", Ffile_read_async, Sfile_read_async, 2, 4, 0,
+       doc: /* Read the contents of file FILENAME in the background.
+Return at once, and call CALLBACK later, when the file has been read,
+with two arguments: a unibyte string holding the bytes of the file,
+and nil; or, if the file could not be read, nil and the error data, as
+in `condition-case'.  The file is opened and read by other threads
+when possible, so that slow files do not keep Emacs from responding.
+
+If BEG and/or END are non-nil, they are the byte offsets of the part
+of the file to read, as in `insert-file-contents'.
+
+Return an object identifying the request, which can be passed to
+`file-read-async-cancel'.  */)
+  (Lisp_Object filename, Lisp_Object callback, Lisp_Object beg,
+   Lisp_Object end)
+{
+  filename = Fexpand_file_name (filename, Qnil);
+
+  Lisp_Object handler = Ffind_file_name_handler (filename, Qfile_read_async);
+  if (!NILP (handler))
+    return calln (handler, Qfile_read_async, filename, callback, beg, end);
+
+  off_t beg_offset = NILP (beg) ? 0 : file_offset (beg);
+  off_t end_offset = NILP (end) ? -1 : file_offset (end);
+  Lisp_Object encoded = ENCODE_FILE (filename);
+
+  file_read_init ();
+
+  struct file_read_request *req = xzalloc (sizeof *req);
+  req->id = ++file_read_last_id;
+  req->filename = xstrdup (SSDATA (encoded));
+  req->beg = beg_offset;
+  req->end = end_offset < 0 ? -1 : max (end_offset, beg_offset);
+  Lisp_Object id = make_int (req->id);
+  file_read_requests = Fcons (list4 (id, callback, filename,
+				     make_mint_ptr (req)),
+			      file_read_requests);
+
+  sys_mutex_lock (&file_read.mutex);
+  if (0 <= file_read.wakeup[0]
+      && file_read.idle <= file_read.nqueued
+      && file_read.threads < FILE_READ_THREADS)
+    {
+      sys_thread_t thread;
+      if (sys_thread_create (&thread, file_read_thread, NULL))
+	{
+	  file_read.threads++;
+	  file_read.idle++;
+	}
+    }
+  if (file_read.threads > 0)
+    {
+      req->next = NULL;
+      *file_read.queue_tail = req;
+      file_read.queue_tail = &req->next;
+      file_read.nqueued++;
+      sys_cond_signal (&file_read.queued);
+      sys_mutex_unlock (&file_read.mutex);
+    }
+  else
+    {
+      sys_mutex_unlock (&file_read.mutex);
+      file_read_contents (req);
+      sys_mutex_lock (&file_read.mutex);
+      file_read_finish (req);
+      sys_mutex_unlock (&file_read.mutex);
+      if (file_read.wakeup[0] < 0)
+	file_read_process_done ();
+    }
+  return id;
+}
+
+DEFUN ("file-read-async-cancel", Ffile_read_async_cancel,
+       Sfile_read_async_cancel, 1, 1, 0,
+       doc: /* Cancel the reading of a file by `file-read-async'.
+REQUEST is the value returned by `file-read-async'.  Its callback will
+not be called.  Return non-nil if the request was cancelled, nil if
+its callback was already called or is about to be.  */)
+  (Lisp_Object request)
+{
+  Lisp_Object entry = Fassq (request, file_read_requests);
+
+  if (NILP (entry))
+    return Qnil;
+  file_read_requests = Fdelq (entry, file_read_requests);
+
+  struct file_read_request *req = xmint_pointer (Fnth (make_fixnum (3),
+						       entry));
+  sys_mutex_lock (&file_read.mutex);
+  req->cancelled = true;
+  sys_mutex_unlock (&file_read.mutex);
+  return Qt;
+}
+
 static Lisp_Object build_annotations (Lisp_Object, Lisp_Object);
 
 static void
@@ -6016,6 +6928,33 @@ a_write (int desc, Lisp_Object string, ptrdiff_t pos,
 
 enum { E_WRITE_MAX = 8 * 1024 * 1024 };
 
+/* Return true if the current buffer's text from START_BYTE to END_BYTE
+   can be written as it is, because encoding it with CODING would
+   reproduce its internal representation.  That representation differs
+   from the encoded bytes only for eight-bit characters, whose internal
+   form starts with the byte 0xC0 or 0xC1.  */
+
+static bool
+e_write_as_is (struct coding_system *coding,
+	       ptrdiff_t start_byte, ptrdiff_t end_byte)
+{
+  if (!encode_coding_identity_p (coding))
+    return false;
+
+  while (start_byte < end_byte)
+    {
+      ptrdiff_t stop_byte = (start_byte < GPT_BYTE && GPT_BYTE < end_byte
+			     ? GPT_BYTE : end_byte);
+      unsigned char *p = BYTE_POS_ADDR (start_byte);
+      ptrdiff_t nbytes = stop_byte - start_byte;
+
+      if (memchr (p, 0xC0, nbytes) || memchr (p, 0xC1, nbytes))
+	return false;
+      start_byte = stop_byte;
+    }
+  return true;
+}
+
 /* Write text in the range START and END into descriptor DESC,
    encoding them with coding system CODING.  If STRING is nil, START
    and END are character positions of the current buffer, else they
@@ -6034,6 +6973,12 @@ e_write (int desc, Lisp_Object string, ptrdiff_t start, ptrdiff_t end,
   /* We used to have a code for handling selective display here.  But,
      now it is handled within encode_coding.  */
 
+  /* Write buffer text that needs no real encoding straight from the
+     buffer, without copying it through encode_coding_object.  */
+  bool as_is = (!STRINGP (string) && start < end
+		&& e_write_as_is (coding, CHAR_TO_BYTE (start),
+				  CHAR_TO_BYTE (end)));
+
   while (start < end)
     {
       if (STRINGP (string))
@@ -6065,7 +7010,7 @@ e_write (int desc, Lisp_Object string, ptrdiff_t start, ptrdiff_t end,
 	  ptrdiff_t end_byte = CHAR_TO_BYTE (end);
 
 	  coding->src_multibyte = (end - start) < (end_byte - start_byte);
-	  if (CODING_REQUIRE_ENCODING (coding))
+	  if (CODING_REQUIRE_ENCODING (coding) && !as_is)
 	    {
 	      ptrdiff_t nchars = min (end - start, E_WRITE_MAX);
 
@@ -6245,14 +7190,14 @@ auto_save_error (Lisp_Object error_val)
   return Qnil;
 }
 
-static Lisp_Object
-auto_save_1 (void)
+/* Return the mode of the auto-save file of the current buffer.  */
+
+static mode_t
+auto_save_file_modes (void)
 {
   struct stat st;
   Lisp_Object modes;
 
-  auto_save_mode_bits = 0666;
-
   /* Get visited file's mode to become the auto save file's mode.  */
   if (! NILP (BVAR (current_buffer, filename)))
     {
@@ -6260,12 +7205,19 @@ auto_save_1 (void)
 			 &st, 0)
 	  == 0)
 	/* But make sure we can overwrite it later!  */
-	auto_save_mode_bits = (st.st_mode | 0600) & 0777;
+	return (st.st_mode | 0600) & 0777;
       else if (modes = Ffile_modes (BVAR (current_buffer, filename), Qnil),
 	       FIXNUMP (modes))
 	/* Remote files don't cooperate with fstatat.  */
-	auto_save_mode_bits = (XFIXNUM (modes) | 0600) & 0777;
+	return (XFIXNUM (modes) | 0600) & 0777;
     }
+  return 0666;
+}
+
+static Lisp_Object
+auto_save_1 (void)
+{
+  auto_save_mode_bits = auto_save_file_modes ();
 
   return
     Fwrite_region (Qnil, Qnil, BVAR (current_buffer, auto_save_file_name), Qnil,
@@ -6273,10 +7225,408 @@ auto_save_1 (void)
 		   Qnil, Qnil);
 }
 
+/* Auto-saving in the background.
+
+   When Emacs is idle, it calls do-auto-save with ASYNC non-nil.  The
+   buffers whose auto-save files write-region would write in
+   utf-8-emacs-unix, without annotations or file name handlers, as is
+   usual, are then not written by write-region.  Instead, each of them
+   shares its text with a job, as make-buffer-snapshot does, and
+   another thread writes the text of all these jobs, converting raw
+   bytes, then syncs the files to disk together.  When it is done, the
+   thread writes to a pipe watched by wait_reading_process_output,
+   whose callback frees the jobs in the main thread.  The main thread
+   thus only has to find the buffers to save, however large they
+   are.  */
+
+#if !(defined USE_MMAP_FOR_BUFFERS || defined REL_ALLOC || defined DOS_NT)
+# define AUTO_SAVE_IN_BACKGROUND
+#endif
+
+/* Size of the buffer gathering the bytes written by a job.  */
+enum { AUTO_SAVE_BUFSIZE = 1 << 16 };
+
+struct auto_save_job
+{
+  struct auto_save_job *next;
+
+  /* The text to write, shared with the buffer, and whether the buffer
+     is multibyte.  */
+  struct buffer_text text;
+  bool multibyte;
+
+  /* The encoded name of the auto-save file, and the mode it is
+     created with.  */
+  char *filename;
+  mode_t mode;
+
+  /* Whether to sync the file, which write-region-inhibit-fsync
+     decides, as the thread cannot look at it.  */
+  bool do_fsync;
+
+  /* The modification count of the buffer when the job was made, and
+     its auto-save modification count before that.  */
+  modiff_count modiff, autosave_modiff;
+
+  /* Set by the main thread when the file is deleted or renamed, to
+     tell the thread not to write it.  */
+  bool cancelled;
+
+  /* The descriptor of the file being written, or -1; and the errno
+     value of the failure, and what failed.  */
+  int fd;
+  int err;
+  char const *failure;
+};
+
+static struct
+{
+  /* Whether the members below are initialized.  */
+  bool initialized;
+
+  /* Protects the members below, and the CANCELLED flag of the jobs;
+     FINISHED is broadcast when a thread is done.  */
+  sys_mutex_t mutex;
+  sys_cond_t finished;
+
+  /* The number of threads writing jobs, and the jobs written.  */
+  int threads;
+  struct auto_save_job *done;
+
+  /* The pipe used to wake up the main thread, or -1.  */
+  int wakeup[2];
+} auto_save_bg;
+
+/* The jobs that have not been freed yet, as a list of (BUFFER . JOB),
+   JOB being the C structure as a mint pointer.  */
+static Lisp_Object auto_save_jobs;
+
+/* Accumulated time spent by the main thread in do-auto-save.  */
+static struct timespec auto_save_time;
+
+/* Write the NBYTES bytes at P to FD, gathering small writes in BUF,
+   which holds *USED bytes not written yet.  Return true if
+   successful.  */
+
+static bool
+auto_save_put (int fd, unsigned char *buf, ptrdiff_t *used,
+	       unsigned char const *p, ptrdiff_t nbytes)
+{
+  if (AUTO_SAVE_BUFSIZE - *used < nbytes)
+    {
+      if (emacs_write (fd, buf, *used) != *used)
+	return false;
+      *used = 0;
+      if (AUTO_SAVE_BUFSIZE <= nbytes)
+	return emacs_write (fd, p, nbytes) == nbytes;
+    }
+  memcpy (buf + *used, p, nbytes);
+  *used += nbytes;
+  return true;
+}
+
+/* Write the NBYTES bytes of text at P to FD, encoded in utf-8-emacs,
+   which is how they are represented in memory, except that raw bytes
+   are written as themselves if MULTIBYTE.  Return true if
+   successful.  */
+
+static bool
+auto_save_write_text (int fd, unsigned char *buf, ptrdiff_t *used,
+		      unsigned char const *p, ptrdiff_t nbytes,
+		      bool multibyte)
+{
+  unsigned char const *end = p + nbytes;
+
+  if (!multibyte)
+    return auto_save_put (fd, buf, used, p, nbytes);
+
+  while (p < end)
+    {
+      unsigned char const *q = p;
+      while (q < end && !CHAR_BYTE8_HEAD_P (*q))
+	q++;
+      if (!auto_save_put (fd, buf, used, p, q - p))
+	return false;
+      if (q == end)
+	break;
+      unsigned char byte = CHAR_TO_BYTE8 (STRING_CHAR (q));
+      if (!auto_save_put (fd, buf, used, &byte, 1))
+	return false;
+      p = q + 2;
+    }
+  return true;
+}
+
+/* Write the text of JOB to its file, leaving it open in JOB->fd.
+   This is called in another thread, and does not quit.  */
+
+static void
+auto_save_write_job (struct auto_save_job *job, unsigned char *buf)
+{
+  struct buffer_text *t = &job->text;
+  ptrdiff_t used = 0;
+
+  /* Check whether the job was cancelled and open the file at once, so
+     that a file deleted or renamed after that is not created again.  */
+  sys_mutex_lock (&auto_save_bg.mutex);
+  bool cancelled = job->cancelled;
+  if (!cancelled)
+    job->fd = emacs_open_noquit (job->filename,
+				 O_WRONLY | O_CREAT | O_TRUNC, job->mode);
+  int open_errno = errno;
+  sys_mutex_unlock (&auto_save_bg.mutex);
+  if (job->fd < 0)
+    {
+      if (!cancelled)
+	{
+	  job->err = open_errno;
+	  job->failure = "Opening output file";
+	}
+      return;
+    }
+
+  if (! (auto_save_write_text (job->fd, buf, &used, t->beg,
+			       t->gpt_byte - BEG_BYTE, job->multibyte)
+	 && auto_save_write_text (job->fd, buf, &used,
+				  t->beg + t->gpt_byte - BEG_BYTE + t->gap_size,
+				  t->z_byte - t->gpt_byte, job->multibyte)
+	 && emacs_write (job->fd, buf, used) == used))
+    {
+      job->err = errno;
+      job->failure = "Write error";
+    }
+}
+
+static void *
+auto_save_thread (void *arg)
+{
+  struct auto_save_job *jobs = arg, *job;
+  unsigned char *buf = malloc (AUTO_SAVE_BUFSIZE);
+
+  sys_thread_set_name ("auto-save");
+
+  for (job = jobs; job; job = job->next)
+    if (!buf)
+      {
+	job->err = ENOMEM;
+	job->failure = "Write error";
+      }
+    else
+      auto_save_write_job (job, buf);
+  free (buf);
+
+  /* Sync the files only when they have all been written, so that the
+     disk can write them together.  */
+  for (job = jobs; job; job = job->next)
+    if (0 <= job->fd)
+      {
+	if (!job->err && job->do_fsync && fsync (job->fd) != 0
+	    && errno != EINVAL)
+	  {
+	    job->err = errno;
+	    job->failure = "Write error";
+	  }
+	if (emacs_close (job->fd) != 0 && !job->err)
+	  {
+	    job->err = errno;
+	    job->failure = "Write error";
+	  }
+      }
+
+  sys_mutex_lock (&auto_save_bg.mutex);
+  for (job = jobs; job->next; job = job->next)
+    continue;
+  job->next = auto_save_bg.done;
+  auto_save_bg.done = jobs;
+  auto_save_bg.threads--;
+  sys_cond_broadcast (&auto_save_bg.finished);
+  wakeup_main_thread (auto_save_bg.wakeup[1]);
+  sys_mutex_unlock (&auto_save_bg.mutex);
+  return NULL;
+}
+
+/* Free the jobs that have been written, reporting their errors.  */
+
+static void
+auto_save_process_done (void)
+{
+  sys_mutex_lock (&auto_save_bg.mutex);
+  struct auto_save_job *job = auto_save_bg.done;
+  auto_save_bg.done = NULL;
+  sys_mutex_unlock (&auto_save_bg.mutex);
+
+  while (job)
+    {
+      struct auto_save_job *next = job->next;
+      Lisp_Object entry, tail;
+      for (tail = auto_save_jobs; ; tail = XCDR (tail))
+	{
+	  entry = XCAR (tail);
+	  if (xmint_pointer (XCDR (entry)) == job)
+	    break;
+	}
+      struct buffer *b = XBUFFER (XCAR (entry));
+
+      auto_save_jobs = Fdelq (entry, auto_save_jobs);
+      release_buffer_text (&job->text);
+
+      if (job->cancelled && job->fd < 0)
+	{
+	  /* The file was not written; save the buffer again next
+	     time, unless it has been auto-saved since.  */
+	  if (BUFFER_LIVE_P (b) && BUF_AUTOSAVE_MODIFF (b) == job->modiff)
+	    BUF_AUTOSAVE_MODIFF (b) = job->autosave_modiff;
+	}
+      else if (job->err)
+	{
+	  AUTO_STRING (format, "Auto-saving %s: %s");
+	  Lisp_Object filename = DECODE_FILE (build_unibyte_string
+					      (job->filename));
+	  Lisp_Object msg
+	    = CALLN (Fformat, format,
+		     BUFFER_LIVE_P (b) ? BVAR (b, name) : filename,
+		     Ferror_message_string (get_file_errno_data
+					    (job->failure, filename,
+					     job->err)));
+	  pending_funcalls = Fcons (list4 (Qdisplay_warning, Qauto_save,
+					   msg, QCerror),
+				    pending_funcalls);
+	}
+      xfree (job->filename);
+      xfree (job);
+      job = next;
+    }
+}
+
+static void
+auto_save_wakeup (int fd, void *data)
+{
+  drain_wakeup_pipe (fd);
+  auto_save_process_done ();
+}
+
+static void
+auto_save_init (void)
+{
+  if (auto_save_bg.initialized)
+    return;
+  sys_mutex_init (&auto_save_bg.mutex);
+  sys_cond_init (&auto_save_bg.finished);
+  make_wakeup_pipe (auto_save_bg.wakeup, auto_save_wakeup);
+  auto_save_bg.initialized = true;
+}
+
+/* Wait until the auto-save files being written in the background are
+   written.  */
+
+static void
+auto_save_wait (void)
+{
+  if (NILP (auto_save_jobs))
+    return;
+  sys_mutex_lock (&auto_save_bg.mutex);
+  while (auto_save_bg.threads > 0)
+    sys_cond_wait (&auto_save_bg.finished, &auto_save_bg.mutex);
+  sys_mutex_unlock (&auto_save_bg.mutex);
+  auto_save_process_done ();
+}
+
+/* Tell the threads writing auto-save files not to write FILE, an
+   encoded absolute file name, because it is about to be deleted or
+   renamed.  */
+
+static void
+auto_save_cancel (char const *file)
+{
+  Lisp_Object tail;
+
+  for (tail = auto_save_jobs; CONSP (tail); tail = XCDR (tail))
+    {
+      struct auto_save_job *job = xmint_pointer (XCDR (XCAR (tail)));
+      if (strcmp (job->filename, file) == 0)
+	{
+	  sys_mutex_lock (&auto_save_bg.mutex);
+	  job->cancelled = true;
+	  sys_mutex_unlock (&auto_save_bg.mutex);
+	}
+    }
+}
+
+/* If the auto-save file of the current buffer can be written in the
+   background, make a job writing it and add it to *JOBS, and return
+   true.  Otherwise, return false.  */
+
+static bool
+auto_save_start_job (struct auto_save_job **jobs)
+{
+#ifdef AUTO_SAVE_IN_BACKGROUND
+  struct buffer *b = current_buffer;
+  Lisp_Object file = BVAR (b, auto_save_file_name);
+  Lisp_Object format = (EQ (BVAR (b, auto_save_file_format), Qt)
+			? BVAR (b, file_format)
+			: BVAR (b, auto_save_file_format));
+
+  /* See choose_write_coding_system and build_annotations for what
+     write-region would do.  */
+  if (!NILP (Vauto_save_visited_file_name)
+      || !NILP (Fstring_equal (BVAR (b, filename), file))
+      || !NILP (Vwrite_region_annotate_functions)
+      || !NILP (Vwrite_region_post_annotation_function)
+      || !NILP (format)
+      || EQ (BVAR (b, selective_display), Qt)
+      || !NILP (Ffind_file_name_handler (file, Qwrite_region)))
+    return false;
+
+  auto_save_init ();
+  if (auto_save_bg.wakeup[0] < 0)
+    return false;
+
+  struct auto_save_job *job = xzalloc (sizeof *job);
+  file = ENCODE_FILE (Fexpand_file_name (file, Qnil));
+  job->filename = xstrdup (SSDATA (file));
+  job->mode = auto_save_file_modes ();
+  job->do_fsync = !write_region_inhibit_fsync;
+  job->multibyte = !NILP (BVAR (b, enable_multibyte_characters));
+  job->modiff = BUF_MODIFF (b);
+  job->autosave_modiff = BUF_AUTOSAVE_MODIFF (b);
+  job->fd = -1;
+  share_buffer_text (b, &job->text);
+
+  Lisp_Object buffer;
+  XSETBUFFER (buffer, b);
+  auto_save_jobs = Fcons (Fcons (buffer, make_mint_ptr (job)),
+			  auto_save_jobs);
+  job->next = *jobs;
+  *jobs = job;
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* Write the auto-save files of JOBS in another thread, or at once if
+   no thread can be made.  */
+
+static void
+auto_save_run_jobs (struct auto_save_job *jobs)
+{
+  sys_thread_t thread;
+
+  sys_mutex_lock (&auto_save_bg.mutex);
+  auto_save_bg.threads++;
+  sys_mutex_unlock (&auto_save_bg.mutex);
+  if (!sys_thread_create (&thread, auto_save_thread, jobs))
+    {
+      auto_save_thread (jobs);
+      auto_save_process_done ();
+    }
+}
+
 struct auto_save_unwind
 {
   FILE *stream;
   bool auto_raise;
+  struct auto_save_job *jobs;
 };
 
 static void
@@ -6286,6 +7636,8 @@ do_auto_save_unwind (void *arg)
   FILE *stream = p->stream;
   minibuffer_auto_raise = p->auto_raise;
   auto_saving = 0;
+  if (p->jobs)
+    auto_save_run_jobs (p->jobs);
   if (stream != NULL)
     {
       block_input ();
@@ -6312,7 +7664,7 @@ do_auto_save_eh (Lisp_Object ignore)
   return Qnil;
 }
 
-DEFUN ("do-auto-save", Fdo_auto_save, Sdo_auto_save, 0, 2, "",
+DEFUN ("do-auto-save", Fdo_auto_save, Sdo_auto_save, 0, 3, "",
        doc: /* Auto-save all buffers that need it.
 This auto-saves all buffers that have auto-saving enabled and
 were changed since last auto-saved.
@@ -6327,9 +7679,17 @@ Normally, run the normal hook `auto-save-hook' before saving.
 
 A non-nil NO-MESSAGE argument means do not print any message if successful.
 
-A non-nil CURRENT-ONLY argument means save only current buffer.  */)
-  (Lisp_Object no_message, Lisp_Object current_only)
+A non-nil CURRENT-ONLY argument means save only current buffer.
+
+A non-nil ASYNC argument means write the auto-save files in the
+background when possible, so that large buffers do not keep Emacs from
+responding; Emacs does this when it auto-saves while idle, if
+`auto-save-in-background' is non-nil.  Otherwise, wait until the
+auto-save files being written in the background are written, and
+write the other ones.  */)
+  (Lisp_Object no_message, Lisp_Object current_only, Lisp_Object async)
 {
+  struct timespec start_time = current_timespec ();
   struct buffer *old = current_buffer, *b;
   Lisp_Object tail, buf, hook;
   bool auto_saved = 0;
@@ -6355,6 +7715,9 @@ A non-nil CURRENT-ONLY argument means save only current buffer.  */)
   oquit = Vquit_flag;
   Vquit_flag = Qnil;
 
+  if (NILP (async))
+    auto_save_wait ();
+
   hook = Qauto_save_hook;
   safe_run_hooks (hook);
 
@@ -6382,6 +7745,7 @@ A non-nil CURRENT-ONLY argument means save only current buffer.  */)
 
   auto_save_unwind.stream = stream;
   auto_save_unwind.auto_raise = minibuffer_auto_raise;
+  auto_save_unwind.jobs = NULL;
   record_unwind_protect_ptr (do_auto_save_unwind, &auto_save_unwind);
   minibuffer_auto_raise = 0;
   auto_saving = 1;
@@ -6435,6 +7799,8 @@ A non-nil CURRENT-ONLY argument means save only current buffer.  */)
 	    /* -1 means we've turned off autosaving for a while--see below.  */
 	    && FIXNUMP (BVAR (b, save_length))
 	    && XFIXNUM (BVAR (b, save_length)) >= 0
+	    /* Don't save again a buffer being saved in the background.  */
+	    && NILP (Fassq (buf, auto_save_jobs))
 	    && (do_handled_files
 		|| NILP (Ffind_file_name_handler (BVAR (b, auto_save_file_name),
 						  Qwrite_region))))
@@ -6475,7 +7841,8 @@ A non-nil CURRENT-ONLY argument means save only current buffer.  */)
 	      }
 	    if (!auto_saved && NILP (no_message))
 	      message1 ("Auto-saving...");
-	    internal_condition_case (auto_save_1, Qt, auto_save_error);
+	    if (NILP (async) || !auto_save_start_job (&auto_save_unwind.jobs))
+	      internal_condition_case (auto_save_1, Qt, auto_save_error);
 	    auto_saved = 1;
 	    BUF_AUTOSAVE_MODIFF (b) = BUF_MODIFF (b);
 	    XSETFASTINT (BVAR (current_buffer, save_length), Z - BEG);
@@ -6490,6 +7857,12 @@ A non-nil CURRENT-ONLY argument means save only current buffer.  */)
 	  }
       }
 
+  if (auto_save_unwind.jobs)
+    {
+      auto_save_run_jobs (auto_save_unwind.jobs);
+      auto_save_unwind.jobs = NULL;
+    }
+
   /* Prevent another auto save till enough input events come in.  */
   record_auto_save ();
 
@@ -6511,6 +7884,14 @@ A non-nil CURRENT-ONLY argument means save only current buffer.  */)
 
   Vquit_flag = oquit;
 
+  if (FLOATP (Vauto_save_elapsed))
+    {
+      auto_save_time = timespec_add (auto_save_time,
+				     timespec_sub (current_timespec (),
+						   start_time));
+      Vauto_save_elapsed = make_float (timespectod (auto_save_time));
+    }
+
   /* This restores the message-stack status.  */
   return unbind_to (count, Qnil);
 }
@@ -6731,6 +8112,7 @@ syms_of_fileio (void)
   DEFSYM (Qunhandled_file_name_directory, "unhandled-file-name-directory");
   DEFSYM (Qfile_name_as_directory, "file-name-as-directory");
   DEFSYM (Qcopy_file, "copy-file");
+  DEFSYM (Qcopy_file_async, "copy-file-async");
   DEFSYM (Qmake_directory_internal, "make-directory-internal");
   DEFSYM (Qmake_directory, "make-directory");
   DEFSYM (Qdelete_file_internal, "delete-file-internal");
@@ -6756,6 +8138,7 @@ syms_of_fileio (void)
   DEFSYM (Qset_file_acl, "set-file-acl");
   DEFSYM (Qfile_newer_than_file_p, "file-newer-than-file-p");
   DEFSYM (Qinsert_file_contents, "insert-file-contents");
+  DEFSYM (Qfile_read_async, "file-read-async");
   DEFSYM (Qwrite_region, "write-region");
   DEFSYM (Qverify_visited_file_modtime, "verify-visited-file-modtime");
   DEFSYM (Qset_visited_file_modtime, "set-visited-file-modtime");
@@ -6813,6 +8196,7 @@ behaves as if file names were encoded in `utf-8'.  */);
   /* Lisp function for setting buffer-file-coding-system and the
      multibyteness of the current buffer after inserting a file.  */
   DEFSYM (Qafter_insert_file_set_coding, "after-insert-file-set-coding");
+  DEFSYM (Qcoding_detection__pending, "coding-detection--pending");
 
   DEFSYM (Qcar_less_than_car, "car-less-than-car");
 
@@ -6932,6 +8316,9 @@ each of those additional buffers as well, in addition to the original
 buffer.  The relevant buffer is current during each function call.  */);
   Vwrite_region_post_annotation_function = Qnil;
   staticpro (&Vwrite_region_annotation_buffers);
+  staticpro (&file_read_requests);
+  staticpro (&file_copies);
+  staticpro (&auto_save_jobs);
 
   DEFVAR_LISP ("write-region-annotations-so-far",
 	       Vwrite_region_annotations_so_far,
@@ -6968,6 +8355,23 @@ in the buffer; this is the default behavior, because the auto-save
 file is usually more useful if it contains the deleted text.  */);
   Vauto_save_include_big_deletions = Qnil;
 
+  DEFVAR_BOOL ("auto-save-in-background", auto_save_in_background,
+	       doc: /* Non-nil means auto-save in the background when Emacs is idle.
+The text of the buffers is then written to their auto-save files by
+another thread, so that auto-saving large buffers does not keep Emacs
+from responding, and the files are synced to disk.  This applies only
+to auto-save files written in the usual way, without a file name
+handler, `buffer-auto-save-file-format' or annotation functions.  See
+`do-auto-save'.  */);
+  auto_save_in_background = true;
+
+  DEFVAR_LISP ("auto-save-elapsed", Vauto_save_elapsed,
+	       doc: /* Accumulated time spent auto-saving without responding to the user.
+This is the time Emacs spent in `do-auto-save', in seconds as a
+floating point value, which does not include the time spent writing
+auto-save files in the background.  */);
+  Vauto_save_elapsed = make_float (0.0);
+
   DEFVAR_BOOL ("write-region-inhibit-fsync", write_region_inhibit_fsync,
 	       doc: /* Non-nil means don't call fsync in `write-region'.
 This variable affects calls to `write-region' as well as save commands.
@@ -6988,6 +8392,22 @@ necessarily cause file-save operations to actually survive a crash.  */);
      https://austingroupbugs.net/view.php?id=672  */
   write_region_inhibit_fsync = true;
 
+  DEFVAR_LISP ("file-mapping-threshold", Vfile_mapping_threshold,
+	       doc: /* Size from which `insert-file-contents' maps files into memory.
+If a natural number, regular files at least this many bytes long that
+are inserted whole into an empty unibyte buffer, as by
+`find-file-literally', are mapped into memory rather than read, when
+the system supports it.  The pages of the file are then read only when
+needed, and the text is not copied until the buffer is modified or made
+multibyte.
+
+Until then, changes made to the file by other programs may show up in
+the buffer.  If the file is truncated, the text that was cut off reads
+as null bytes, and a `file-error' is signaled.
+
+If nil, files are always read.  */);
+  Vfile_mapping_threshold = Qnil;
+
   DEFVAR_BOOL ("delete-by-moving-to-trash", delete_by_moving_to_trash,
                doc: /* Specifies whether to use the system's trash can.
 When non-nil, certain file deletion commands use the function
@@ -7026,6 +8446,8 @@ This includes interactive calls to `delete-file' and
   defsubr (&Sexpand_file_name);
   defsubr (&Ssubstitute_in_file_name);
   defsubr (&Scopy_file);
+  defsubr (&Scopy_file_async);
+  defsubr (&Scopy_file_async_cancel);
   defsubr (&Smake_directory_internal);
   defsubr (&Sdelete_directory_internal);
   defsubr (&Sdelete_file_internal);
@@ -7054,6 +8476,8 @@ This includes interactive calls to `delete-file' and
   defsubr (&Sdefault_file_modes);
   defsubr (&Sfile_newer_than_file_p);
   defsubr (&Sinsert_file_contents);
+  defsubr (&Sfile_read_async);
+  defsubr (&Sfile_read_async_cancel);
   defsubr (&Swrite_region);
   defsubr (&Scar_less_than_car);
   defsubr (&Sverify_visited_file_modtime);
@@ -2963,7 +2963,8 @@ internal_equal_1 (Lisp_Object o1, Lisp_Object o2, enum equal_kind equal_kind,
 	  case PVEC_MARKER:
 	    return (XMARKER (o1)->buffer == XMARKER (o2)->buffer
 		    && (XMARKER (o1)->buffer == 0
-			|| XMARKER (o1)->bytepos == XMARKER (o2)->bytepos));
+			|| (marker_bytepos (XMARKER (o1))
+			    == marker_bytepos (XMARKER (o2)))));
 
 	  case PVEC_BOOL_VECTOR:
 	    {
@@ -3213,8 +3214,8 @@ value_cmp (Lisp_Object a, Lisp_Object b, int maxdepth)
 		  int cmp = value_cmp (buf_a, buf_b, maxdepth - 1);
 		  if (cmp != 0)
 		    return cmp;
-		  ptrdiff_t pa = XMARKER (a)->charpos;
-		  ptrdiff_t pb = XMARKER (b)->charpos;
+		  ptrdiff_t pa = marker_charpos (XMARKER (a));
+		  ptrdiff_t pb = marker_charpos (XMARKER (b));
 		  return pa < pb ? -1 : pa > pb;
 		}
 
@@ -5541,7 +5542,7 @@ sxhash_obj (Lisp_Object obj, int depth)
 	else if (pvec_type == PVEC_MARKER)
 	  {
 	    ptrdiff_t bytepos
-	      = XMARKER (obj)->buffer ? XMARKER (obj)->bytepos : 0;
+	      = XMARKER (obj)->buffer ? marker_bytepos (XMARKER (obj)) : 0;
 	    EMACS_UINT hash
 	      = sxhash_combine ((intptr_t) XMARKER (obj)->buffer, bytepos);
 	    return hash;
@@ -29,6 +29,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "buffer.h"
 #include "window.h"
 #include "region-cache.h"
+#include "line-index.h"
 #include "pdumper.h"
 
 #ifdef HAVE_TREE_SITTER
@@ -56,6 +57,29 @@ static Lisp_Object combine_after_change_list;
 /* Buffer which combine_after_change_list is about.  */
 static Lisp_Object combine_after_change_buffer;
 
+/* The state of the innermost call to `coalesce-change-calls'.  The
+   regions are recorded as the numbers of chars unchanged before and
+   after them in the buffer, which stay valid as the text between them
+   changes.  */
+struct coalesced_changes
+{
+  /* The buffer whose changes are coalesced, or nil.  */
+  Lisp_Object buffer;
+
+  /* The region for which the before-change functions were run, if
+     ANNOUNCED, otherwise the region passed to `coalesce-change-calls'
+     if HEAD is nonnegative.  */
+  ptrdiff_t announced_head, announced_tail;
+  bool announced;
+
+  /* If CHANGED, the region of the changes made, and the number of
+     chars they added (negative if they deleted more).  */
+  bool changed;
+  ptrdiff_t head, tail, change;
+};
+
+static struct coalesced_changes coalesced_changes;
+
 static void signal_before_change (ptrdiff_t, ptrdiff_t, ptrdiff_t *);
 
 /* Also used in marker.c to enable expensive marker checks.  */
@@ -65,18 +89,28 @@ static void signal_before_change (ptrdiff_t, ptrdiff_t, ptrdiff_t *);
 static void
 check_markers (void)
 {
-  struct Lisp_Marker *tail;
+  struct buffer_text *t = current_buffer->text;
   bool multibyte = ! NILP (BVAR (current_buffer, enable_multibyte_characters));
+  ptrdiff_t i, prev = BEG;
 
-  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
+  for (i = 0; i < t->markers_size; i++)
     {
-      if (tail->buffer->text != current_buffer->text)
+      struct Lisp_Marker *tail = t->markers[i];
+
+      if (t->markers_gpt <= i && i < t->markers_gpt + t->markers_gap_size)
+	continue;
+      if (tail->buffer->text != t)
+	emacs_abort ();
+      if (tail->after_gap != (t->markers_gpt <= i))
 	emacs_abort ();
-      if (tail->charpos > Z)
+      if (marker_charpos (tail) < prev)
 	emacs_abort ();
-      if (tail->bytepos > Z_BYTE)
+      prev = marker_charpos (tail);
+      if (marker_charpos (tail) > Z)
 	emacs_abort ();
-      if (multibyte && ! CHAR_HEAD_P (FETCH_BYTE (tail->bytepos)))
+      if (marker_bytepos (tail) > Z_BYTE)
+	emacs_abort ();
+      if (multibyte && ! CHAR_HEAD_P (FETCH_BYTE (marker_bytepos (tail))))
 	emacs_abort ();
     }
 }
@@ -113,6 +147,7 @@ gap_left (ptrdiff_t charpos, ptrdiff_t bytepos, bool newgap)
   ptrdiff_t i;
   ptrdiff_t new_s1;
 
+  maybe_unshare_buffer_text (current_buffer);
   if (!newgap)
     BUF_COMPUTE_UNCHANGED (current_buffer, charpos, GPT);
 
@@ -176,6 +211,7 @@ gap_right (ptrdiff_t charpos, ptrdiff_t bytepos)
   register ptrdiff_t i;
   ptrdiff_t new_s1; /* May point in the middle of multibyte sequences.  */
 
+  maybe_unshare_buffer_text (current_buffer);
   BUF_COMPUTE_UNCHANGED (current_buffer, charpos, GPT);
 
   i = GPT_BYTE;
@@ -231,8 +267,8 @@ adjust_suspend_auto_hscroll (ptrdiff_t from, ptrdiff_t to)
 
       if (BUFFERP (w->contents)
 	  && XBUFFER (w->contents) == current_buffer
-	  && XMARKER (w->old_pointm)->charpos >= from
-	  && XMARKER (w->old_pointm)->charpos <= to)
+	  && marker_charpos (XMARKER (w->old_pointm)) >= from
+	  && marker_charpos (XMARKER (w->old_pointm)) <= to)
 	w->suspend_auto_hscroll = 0;
     }
 }
@@ -249,29 +285,14 @@ void
 adjust_markers_for_delete (ptrdiff_t from, ptrdiff_t from_byte,
 			   ptrdiff_t to, ptrdiff_t to_byte)
 {
-  struct Lisp_Marker *m;
-  ptrdiff_t charpos;
-
   adjust_suspend_auto_hscroll (from, to);
-  for (m = BUF_MARKERS (current_buffer); m; m = m->next)
-    {
-      charpos = m->charpos;
-      eassert (charpos <= Z);
-
-      /* If the marker is after the deletion,
-	 relocate by number of chars / bytes deleted.  */
-      if (charpos > to)
-	{
-	  m->charpos -= to - from;
-	  m->bytepos -= to_byte - from_byte;
-	}
-      /* Here's the case where a marker is inside text being deleted.  */
-      else if (charpos > from)
-	{
-	  m->charpos = from;
-	  m->bytepos = from_byte;
-	}
-    }
+  /* The markers after the deletion are relocated by the number of
+     chars / bytes deleted, and those inside the deleted text go to
+     FROM.  */
+  relocate_markers_for_replace (current_buffer, from, from_byte,
+				to - from, to_byte - from_byte, 0, 0);
+  relocate_pos_index_for_replace (current_buffer, from,
+				  to - from, to_byte - from_byte, 0, 0);
   adjust_overlays_for_delete (from, to - from);
 }
 
@@ -288,30 +309,11 @@ static void
 adjust_markers_for_insert (ptrdiff_t from, ptrdiff_t from_byte,
 			   ptrdiff_t to, ptrdiff_t to_byte, bool before_markers)
 {
-  struct Lisp_Marker *m;
-  ptrdiff_t nchars = to - from;
-  ptrdiff_t nbytes = to_byte - from_byte;
-
   adjust_suspend_auto_hscroll (from, to);
-  for (m = BUF_MARKERS (current_buffer); m; m = m->next)
-    {
-      eassert (m->bytepos >= m->charpos
-	       && m->bytepos - m->charpos <= Z_BYTE - Z);
-
-      if (m->bytepos == from_byte)
-	{
-	  if (m->insertion_type || before_markers)
-	    {
-	      m->bytepos = to_byte;
-	      m->charpos = to;
-	    }
-	}
-      else if (m->bytepos > from_byte)
-	{
-	  m->bytepos += nbytes;
-	  m->charpos += nchars;
-	}
-    }
+  relocate_markers_for_insert (current_buffer, from, to - from,
+			       to_byte - from_byte, before_markers);
+  relocate_pos_index_for_insert (current_buffer, from, to - from,
+				 to_byte - from_byte);
   adjust_overlays_for_insert (from, to - from, before_markers);
 }
 
@@ -343,11 +345,6 @@ adjust_markers_for_replace (ptrdiff_t from, ptrdiff_t from_byte,
 			    ptrdiff_t old_chars, ptrdiff_t old_bytes,
 			    ptrdiff_t new_chars, ptrdiff_t new_bytes)
 {
-  register struct Lisp_Marker *m;
-  ptrdiff_t prev_to_byte = from_byte + old_bytes;
-  ptrdiff_t diff_chars = new_chars - old_chars;
-  ptrdiff_t diff_bytes = new_bytes - old_bytes;
-
   if (old_chars == 0)
     {
       /* Just an insertion: markers at FROM may need to move or not depending
@@ -362,19 +359,10 @@ adjust_markers_for_replace (ptrdiff_t from, ptrdiff_t from_byte,
 
   adjust_suspend_auto_hscroll (from, from + old_chars);
 
-  for (m = BUF_MARKERS (current_buffer); m; m = m->next)
-    {
-      if (m->bytepos >= prev_to_byte)
-	{
-	  m->charpos += diff_chars;
-	  m->bytepos += diff_bytes;
-	}
-      else if (m->bytepos > from_byte)
-	{
-	  m->charpos = from;
-	  m->bytepos = from_byte;
-	}
-    }
+  relocate_markers_for_replace (current_buffer, from, from_byte,
+				old_chars, old_bytes, new_chars, new_bytes);
+  relocate_pos_index_for_replace (current_buffer, from, old_chars, old_bytes,
+				  new_chars, new_bytes);
 
   check_markers ();
 
@@ -413,45 +401,41 @@ void
 adjust_markers_bytepos (ptrdiff_t from, ptrdiff_t from_byte,
 			ptrdiff_t to, ptrdiff_t to_byte, int to_z)
 {
-  register struct Lisp_Marker *m;
+  struct Lisp_Marker **markers;
+  ptrdiff_t i, gpt;
   ptrdiff_t beg = from, begbyte = from_byte;
 
   adjust_suspend_auto_hscroll (from, to);
 
+  /* The affected markers are those after FROM, since their character
+     positions are still right.  */
+  i = select_markers (current_buffer, from + 1, to_z ? PTRDIFF_MAX : to);
+  markers = BUF_MARKERS (current_buffer);
+  gpt = BUF_MARKERS_GPT (current_buffer);
+
   if (Z == Z_BYTE || (!to_z && to == to_byte))
     {
       /* Make sure each affected marker's bytepos is equal to
 	 its charpos.  */
-      for (m = BUF_MARKERS (current_buffer); m; m = m->next)
-	{
-	  if (m->bytepos > from_byte
-	      && (to_z || m->bytepos <= to_byte))
-	    m->bytepos = m->charpos;
-	}
+      for (; i < gpt; i++)
+	markers[i]->bytepos = markers[i]->charpos;
     }
   else
     {
-      for (m = BUF_MARKERS (current_buffer); m; m = m->next)
+      /* Recompute each affected marker's bytepos, scanning forward
+	 from the previous one since they are sorted.  */
+      for (; i < gpt; i++)
 	{
-	  /* Recompute each affected marker's bytepos.  */
-	  if (m->bytepos > from_byte
-	      && (to_z || m->bytepos <= to_byte))
-	    {
-	      if (m->charpos < beg
-		  && beg - m->charpos > m->charpos - from)
-		{
-		  beg = from;
-		  begbyte = from_byte;
-		}
-	      m->bytepos = count_bytes (beg, begbyte, m->charpos);
-	      beg = m->charpos;
-	      begbyte = m->bytepos;
-	    }
+	  struct Lisp_Marker *m = markers[i];
+	  m->bytepos = count_bytes (beg, begbyte, m->charpos);
+	  beg = m->charpos;
+	  begbyte = m->bytepos;
 	}
     }
 
   /* Make sure cached charpos/bytepos is invalid.  */
   clear_charpos_cache (current_buffer);
+  truncate_pos_index (current_buffer, from);
 }
 
 
@@ -895,6 +879,8 @@ insert_1_both (const char *string,
   if (nchars == 0)
     return;
 
+  maybe_unshare_buffer_text (current_buffer);
+
   if (NILP (BVAR (current_buffer, enable_multibyte_characters)))
     nchars = nbytes;
 
@@ -1022,6 +1008,8 @@ insert_from_string_1 (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
   ptrdiff_t outgoing_nbytes = nbytes;
   INTERVAL intervals;
 
+  maybe_unshare_buffer_text (current_buffer);
+
   /* Make OUTGOING_NBYTES describe the text
      as it will be inserted in this buffer.  */
 
@@ -1125,6 +1113,9 @@ insert_from_gap_1 (ptrdiff_t nchars, ptrdiff_t nbytes, bool text_at_gap_tail)
   eassert (NILP (BVAR (current_buffer, enable_multibyte_characters))
            ? nchars == nbytes : nchars <= nbytes);
 
+  /* This copies the bytes already stored in the gap.  */
+  maybe_unshare_buffer_text (current_buffer);
+
 #ifdef HAVE_TREE_SITTER
   ptrdiff_t ins_bytepos = GPT_BYTE;
   struct ts_linecol start_linecol
@@ -1248,6 +1239,8 @@ insert_from_buffer_1 (struct buffer *buf,
   ptrdiff_t outgoing_nbytes = incoming_nbytes;
   INTERVAL intervals;
 
+  maybe_unshare_buffer_text (current_buffer);
+
   if (nchars == 0)
     return;
 
@@ -1378,6 +1371,8 @@ adjust_after_replace (ptrdiff_t from, ptrdiff_t from_byte,
 {
   ptrdiff_t nchars_del = 0, nbytes_del = 0;
 
+  maybe_unshare_buffer_text (current_buffer);
+
 #ifdef BYTE_COMBINING_DEBUG
   if (count_combining_before (GPT_ADDR, len_byte, from, from_byte)
       || count_combining_after (GPT_ADDR, len_byte, from, from_byte))
@@ -1521,6 +1516,8 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
   if (nbytes_del <= 0 && inschars == 0)
     return;
 
+  maybe_unshare_buffer_text (current_buffer);
+
 #ifdef HAVE_TREE_SITTER
   struct ts_linecol start_linecol
     = treesit_linecol_maybe (from, from_byte,
@@ -1584,15 +1581,37 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
     outgoing_insbytes
       = count_size_as_multibyte (insbeg_ptr, insbytes);
 
+  if (! EQ (BVAR (current_buffer, undo_list), Qt))
+    deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
+
+  /* If the new text is the same size as the old one, as with most
+     replacements done by `query-replace', and the old text is all on
+     one side of the gap, overwrite it where it is.  Moving the gap
+     there instead could mean moving much of the buffer, and again for
+     the next change elsewhere.  */
+  if (inschars == nchars_del && outgoing_insbytes == nbytes_del
+      && insbuf != current_buffer
+      && (to_byte <= GPT_BYTE || GPT_BYTE <= from_byte))
+    {
+      copy_text (insbeg_ptr, BYTE_POS_ADDR (from_byte), insbytes,
+		 new_is_multibyte,
+		 ! NILP (BVAR (current_buffer, enable_multibyte_characters)));
+      BUF_COMPUTE_UNCHANGED (current_buffer, from - 1, to);
+
+      if (!NILP (deletion))
+	{
+	  record_insert (from + SCHARS (deletion), inschars);
+	  record_delete (from, deletion, false);
+	}
+      goto adjust;
+    }
+
   /* Make sure the gap is somewhere in or next to what we are deleting.  */
   if (from > GPT)
     gap_right (from, from_byte);
   if (to < GPT)
     gap_left (to, to_byte, 0);
 
-  if (! EQ (BVAR (current_buffer, undo_list), Qt))
-    deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
-
   GAP_SIZE += nbytes_del;
   ZV -= nchars_del;
   Z -= nchars_del;
@@ -1650,6 +1669,7 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
 
   eassert (GPT <= GPT_BYTE);
 
+ adjust:
   /* Adjust markers for the deletion and the insertion.  */
   adjust_markers_for_replace (from, from_byte, nchars_del, nbytes_del,
 			      inschars, outgoing_insbytes);
@@ -1692,8 +1712,8 @@ replace_range (ptrdiff_t from, ptrdiff_t to, Lisp_Object new,
 
   if (run_mod_hooks)
     {
-      signal_after_change (from, nchars_del, GPT - from);
-      update_compositions (from, GPT, CHECK_BORDER);
+      signal_after_change (from, nchars_del, inschars);
+      update_compositions (from, from + inschars, CHECK_BORDER);
     }
 }
 
@@ -1721,6 +1741,8 @@ replace_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
 {
   ptrdiff_t nbytes_del, nchars_del;
 
+  maybe_unshare_buffer_text (current_buffer);
+
   check_markers ();
 
   nchars_del = to - from;
@@ -1994,6 +2016,8 @@ del_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
   ptrdiff_t nbytes_del, nchars_del;
   Lisp_Object deletion;
 
+  maybe_unshare_buffer_text (current_buffer);
+
   check_markers ();
 
   nchars_del = to - from;
@@ -2020,14 +2044,18 @@ del_range_2 (ptrdiff_t from, ptrdiff_t from_byte,
     emacs_abort ();
 #endif
 
-  if (ret_string || ! EQ (BVAR (current_buffer, undo_list), Qt))
-    deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
-  else
-    deletion = Qnil;
-
   /* Record marker adjustments, and text deletion into undo
      history.  */
-  record_delete (from, deletion, true);
+  if (ret_string)
+    {
+      deletion = make_buffer_string_both (from, from_byte, to, to_byte, 1);
+      record_delete (from, deletion, true);
+    }
+  else
+    {
+      deletion = Qnil;
+      record_delete_text (from, from_byte, to, to_byte);
+    }
 
   /* Relocate all markers pointing into the new, larger gap to point
      at the end of the text before the gap.  */
@@ -2135,10 +2163,12 @@ prepare_to_modify_buffer_1 (ptrdiff_t start, ptrdiff_t end,
   /* If we're about to modify a buffer the contents of which come from
      a dump file, copy the contents to private storage first so we
      don't take a COW fault on the buffer text and keep it around
-     forever.  */
-  if (pdumper_object_p (BEG_ADDR))
+     forever.  Likewise for text mapped from a file, which could
+     otherwise change under our feet.  */
+  if (pdumper_object_p (BEG_ADDR) || current_buffer->text->mapped_size)
     enlarge_buffer_text (current_buffer, 0);
   eassert (!pdumper_object_p (BEG_ADDR));
+  maybe_unshare_buffer_text (current_buffer);
 
   run_undoable_change();
 
@@ -2252,6 +2282,9 @@ invalidate_buffer_caches (struct buffer *buf, ptrdiff_t start, ptrdiff_t end)
     invalidate_region_cache (buf,
                              buf->width_run_cache,
                              start - BUF_BEG (buf), BUF_Z (buf) - end);
+  if (buf->line_index)
+    invalidate_line_index (buf, buf->line_index,
+			   start - BUF_BEG (buf), BUF_Z (buf) - end);
 }
 
 /* These macros work with an argument named `preserve_ptr'
@@ -2300,6 +2333,40 @@ reset_var_on_error (void *ptr)
     *p->location = Qnil;
 }
 
+/* Return whether the changes to the current buffer are being
+   coalesced by `coalesce-change-calls'.  */
+
+static bool
+coalescing_changes_p (void)
+{
+  return (BUFFERP (coalesced_changes.buffer)
+	  && XBUFFER (coalesced_changes.buffer) == current_buffer);
+}
+
+/* Call `syntax-ppss-flush-cache' for a change between START and END
+   if it is one of the before-change functions, which
+   `coalesce-change-calls' doesn't run for every change, because the
+   functions that make the changes may use `syntax-ppss'.  */
+
+static void
+flush_syntax_ppss_cache (ptrdiff_t start, ptrdiff_t end)
+{
+  Lisp_Object hooks = Vbefore_change_functions;
+
+  if (CONSP (hooks)
+      && (!NILP (Fmemq (Qsyntax_ppss_flush_cache, hooks))
+	  || (!NILP (Fmemq (Qt, hooks))
+	      && (hooks = Fdefault_value (Qbefore_change_functions),
+		  CONSP (hooks))
+	      && !NILP (Fmemq (Qsyntax_ppss_flush_cache, hooks)))))
+    {
+      specpdl_ref count = SPECPDL_INDEX ();
+      specbind (Qinhibit_modification_hooks, Qt);
+      calln (Qsyntax_ppss_flush_cache, make_fixnum (start), make_fixnum (end));
+      unbind_to (count, Qnil);
+    }
+}
+
 /* Signal a change to the buffer immediately before it happens.
    START_INT and END_INT are the bounds of the text to be changed.
 
@@ -2316,6 +2383,40 @@ signal_before_change (ptrdiff_t start_int, ptrdiff_t end_int,
   specpdl_ref count = SPECPDL_INDEX ();
   struct rvoe_arg rvoe_arg;
 
+  if (coalescing_changes_p ())
+    {
+      struct coalesced_changes *cc = &coalesced_changes;
+
+      /* Nothing to do if the hooks were already run for a region
+	 that contains this change.  */
+      if (cc->announced
+	  && start_int - BEG >= cc->announced_head
+	  && Z - end_int >= cc->announced_tail)
+	{
+	  flush_syntax_ppss_cache (start_int, end_int);
+	  return;
+	}
+
+      /* Otherwise, run them for a region that also contains the
+	 previous one.  When it has to be extended, extend it to the
+	 end of the accessible portion, so that edits proceeding in
+	 one direction don't run the hooks each time.  */
+      if (cc->announced_head >= 0)
+	{
+	  ptrdiff_t head_pos = BEG + cc->announced_head;
+	  ptrdiff_t tail_pos = Z - cc->announced_tail;
+	  if (cc->announced && start_int < head_pos)
+	    start_int = min (start_int, BEGV);
+	  if (cc->announced && tail_pos < end_int)
+	    end_int = max (end_int, ZV);
+	  start_int = min (start_int, head_pos);
+	  end_int = max (end_int, tail_pos);
+	}
+      cc->announced = true;
+      cc->announced_head = start_int - BEG;
+      cc->announced_tail = Z - end_int;
+    }
+
   start = make_fixnum (start_int);
   end = make_fixnum (end_int);
   preserve_marker = Qnil;
@@ -2387,6 +2488,26 @@ signal_after_change (ptrdiff_t charpos, ptrdiff_t lendel, ptrdiff_t lenins)
   if (inhibit_modification_hooks)
     return;
 
+  /* Within `coalesce-change-calls', just merge the change into the
+     region to report when it returns.  */
+  if (coalescing_changes_p ())
+    {
+      struct coalesced_changes *cc = &coalesced_changes;
+      ptrdiff_t head = charpos - BEG, tail = Z - (charpos + lenins);
+
+      if (!cc->changed)
+	{
+	  cc->changed = true;
+	  cc->head = head;
+	  cc->tail = tail;
+	  cc->change = 0;
+	}
+      cc->head = min (cc->head, head);
+      cc->tail = min (cc->tail, tail);
+      cc->change += lenins - lendel;
+      return;
+    }
+
   /* If we are deferring calls to the after-change functions
      and there are no before-change functions,
      just record the args that we were going to use.  */
@@ -2557,6 +2678,74 @@ DEFUN ("combine-after-change-execute", Fcombine_after_change_execute,
   return unbind_to (count, Qnil);
 }
 
+/* Stop coalescing changes, restoring the state OUTER of the outer
+   call to `coalesce-change-calls', and run the after-change functions
+   for the changes made.  */
+
+static void
+end_coalesced_changes (void *outer)
+{
+  struct coalesced_changes cc = coalesced_changes;
+  coalesced_changes = *(struct coalesced_changes *) outer;
+
+  if (cc.changed && BUFFER_LIVE_P (XBUFFER (cc.buffer)))
+    {
+      specpdl_ref count = SPECPDL_INDEX ();
+      record_unwind_current_buffer ();
+      set_buffer_internal (XBUFFER (cc.buffer));
+      ptrdiff_t beg = BEG + cc.head;
+      ptrdiff_t end = max (beg, Z - cc.tail);
+      signal_after_change (beg, max (0, end - beg - cc.change), end - beg);
+      unbind_to (count, Qnil);
+    }
+}
+
+DEFUN ("coalesce-change-calls", Fcoalesce_change_calls,
+       Scoalesce_change_calls, 1, 3, 0,
+       doc: /* Call FUNCTION, running the change hooks once for all its changes.
+FUNCTION is called with no arguments, and its value is returned.
+
+The changes that FUNCTION makes to the current buffer don't run
+`before-change-functions' and the modification hooks of overlays every
+time.  Instead, they run them when a change is made outside the region
+they were last run for, with a region that includes that one and the
+change.  If BEG and END are non-nil, they are the bounds of the region
+to use the first time, which should contain the changes FUNCTION makes,
+so that the hooks are run only once.
+
+After FUNCTION returns or exits nonlocally, `after-change-functions'
+and the modification hooks are run once, with a region that contains
+all the changes.
+
+Unlike `combine-change-calls', this doesn't require the changes to be
+made in a given region, and doesn't change the recording of changes
+for undo.  Changes made to other buffers run the hooks as usual.  If
+`syntax-ppss-flush-cache' is one of the `before-change-functions', it
+is called for every change, as FUNCTION may use `syntax-ppss'.  Other
+state that the change hooks keep up to date, e.g. for indentation or
+for a language server, is not, so FUNCTION must not rely on it.  */)
+  (Lisp_Object function, Lisp_Object beg, Lisp_Object end)
+{
+  if (coalescing_changes_p ())
+    return calln (function);
+
+  struct coalesced_changes outer = coalesced_changes;
+  specpdl_ref count = SPECPDL_INDEX ();
+  record_unwind_protect_ptr (end_coalesced_changes, &outer);
+
+  coalesced_changes = (struct coalesced_changes) { .buffer = Qnil,
+						   .announced_head = -1 };
+  if (!NILP (beg) || !NILP (end))
+    {
+      validate_region (&beg, &end);
+      coalesced_changes.announced_head = XFIXNUM (beg) - BEG;
+      coalesced_changes.announced_tail = Z - XFIXNUM (end);
+    }
+  coalesced_changes.buffer = Fcurrent_buffer ();
+
+  return unbind_to (count, calln (function));
+}
+
 void
 syms_of_insdel (void)
 {
@@ -2564,6 +2753,8 @@ syms_of_insdel (void)
   staticpro (&combine_after_change_buffer);
   combine_after_change_list = Qnil;
   combine_after_change_buffer = Qnil;
+  staticpro (&coalesced_changes.buffer);
+  coalesced_changes.buffer = Qnil;
 
   DEFSYM (Qundo_auto__undoable_change, "undo-auto--undoable-change");
   DEFSYM (Qsyntax_ppss_flush_cache, "syntax-ppss-flush-cache");
@@ -2589,4 +2780,5 @@ See also the info node `(elisp) Change Hooks'.  */);
   DEFSYM (Qinhibit_modification_hooks, "inhibit-modification-hooks");
 
   defsubr (&Scombine_after_change_execute);
+  defsubr (&Scoalesce_change_calls);
 }
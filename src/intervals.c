@@ -63,12 +63,14 @@ static void
 set_interval_left (INTERVAL i, INTERVAL left)
 {
   i->left = left;
+  invalidate_interval_summary (i);
 }
 
 static void
 set_interval_right (INTERVAL i, INTERVAL right)
 {
   i->right = right;
+  invalidate_interval_summary (i);
 }
 
 /* Make the parent of D be whatever the parent of S is, regardless
@@ -721,6 +723,197 @@ previous_interval (register INTERVAL interval)
   return NULL;
 }
 
+/* Summaries of property runs.
+
+   Scanning for the next change of a property that rarely changes, such
+   as `invisible' or `field', one interval at a time is slow in buffers
+   with many intervals, as font-lock makes.  So each interval records,
+   for the few properties numbered by interval_summary_index, whether
+   the property has the same raw value (the value on the plist, not
+   taking `category' or defaults into account) throughout its subtree.
+   The subtree then holds the value of its root interval, and
+   next_property_run_change can skip it as a whole.
+
+   The summaries are computed lazily, when a search needs them, and are
+   invalidated by set_interval_plist, set_interval_left and
+   set_interval_right, which covers changes of the properties as well as
+   of the shape of the tree.  Code that modifies a plist in place must
+   call invalidate_interval_summary itself.
+
+   Since the value of a property can come from the `category' symbol of
+   the interval, the summary of the `category' property itself is also
+   consulted when searching for a change of another one.  */
+
+/* Return the number of PROP's bit in the summaries, or -1 if there is
+   none.  */
+
+int
+interval_summary_index (Lisp_Object prop)
+{
+  if (EQ (prop, Qcategory))
+    return 0;
+  if (EQ (prop, Qinvisible))
+    return 1;
+  if (EQ (prop, Qfield))
+    return 2;
+  if (EQ (prop, Qdisplay))
+    return 3;
+  if (EQ (prop, Qfontified))
+    return 4;
+  if (EQ (prop, Qcomposition))
+    return 5;
+  if (EQ (prop, Qmouse_face))
+    return 6;
+  if (EQ (prop, Qsyntax_table))
+    return 7;
+  return -1;
+}
+
+/* Store in VALUES the raw values of the summarized properties on I's
+   plist, or Qunbound for those not present.  Like textget, use the
+   first occurrence of a property, except for `category', whose last
+   occurrence counts.  */
+
+static void
+interval_summary_values (INTERVAL i, Lisp_Object *values)
+{
+  for (int k = 0; k < INTERVAL_SUMMARY_PROPS; k++)
+    values[k] = Qunbound;
+  for (Lisp_Object tail = i->plist;
+       CONSP (tail) && CONSP (XCDR (tail));
+       tail = XCDR (XCDR (tail)))
+    {
+      int k = interval_summary_index (XCAR (tail));
+      if (k == 0 || (k > 0 && BASE_EQ (values[k], Qunbound)))
+	values[k] = XCAR (XCDR (tail));
+    }
+}
+
+/* Make sure the summary of the subtree rooted at I is valid.  */
+
+static void
+update_interval_summary (INTERVAL i)
+{
+  if (i->summary_valid)
+    return;
+
+  Lisp_Object values[INTERVAL_SUMMARY_PROPS];
+  Lisp_Object child_values[INTERVAL_SUMMARY_PROPS];
+  INTERVAL children[2] = { i->left, i->right };
+  unsigned int uniform = (1u << INTERVAL_SUMMARY_PROPS) - 1;
+
+  interval_summary_values (i, values);
+  for (int c = 0; c < 2; c++)
+    if (children[c])
+      {
+	update_interval_summary (children[c]);
+	uniform &= children[c]->uniform;
+	interval_summary_values (children[c], child_values);
+	for (int k = 0; k < INTERVAL_SUMMARY_PROPS; k++)
+	  if (!EQ (values[k], child_values[k]))
+	    uniform &= ~(1u << k);
+      }
+
+  i->uniform = uniform;
+  i->summary_valid = true;
+}
+
+/* Return true if the raw values of the properties in MASK on I's plist
+   are those in VALUES.  */
+
+static bool
+interval_summary_match (INTERVAL i, unsigned int mask, Lisp_Object *values)
+{
+  Lisp_Object here[INTERVAL_SUMMARY_PROPS];
+
+  interval_summary_values (i, here);
+  for (int k = 0; k < INTERVAL_SUMMARY_PROPS; k++)
+    if ((mask & (1u << k)) && !EQ (here[k], values[k]))
+      return false;
+  return true;
+}
+
+/* Return true if the properties in MASK have the raw values in VALUES
+   throughout the subtree rooted at I.  */
+
+static bool
+interval_subtree_match (INTERVAL i, unsigned int mask, Lisp_Object *values)
+{
+  update_interval_summary (i);
+  return ((i->uniform & mask) == mask
+	  && interval_summary_match (i, mask, values));
+}
+
+/* Return the first interval after I where the raw value of the property
+   numbered K by interval_summary_index, or that of `category', differs
+   from its value in I, or NULL if there is none.  Set the `position'
+   field of the result based on that of I.
+
+   This takes time proportional to the height of the tree once the
+   summaries are up to date.  Since the value of the property as seen by
+   textget can be the same on both sides, for instance when one side
+   has it explicitly and the other through its category, callers should
+   check the value at the result and call this again from there if it
+   hasn't changed.  */
+
+INTERVAL
+next_property_run_change (INTERVAL i, int k)
+{
+  unsigned int mask = (1u << k) | 1u;
+  Lisp_Object values[INTERVAL_SUMMARY_PROPS];
+  INTERVAL subtree = NULL;
+  ptrdiff_t start;
+
+  eassert (0 <= k && k < INTERVAL_SUMMARY_PROPS);
+  interval_summary_values (i, values);
+
+  /* Look for the first subtree after I that doesn't match, going up
+     from I and tracking where each subtree starts.  */
+  start = i->position + LENGTH (i);
+  if (i->right && !interval_subtree_match (i->right, mask, values))
+    subtree = i->right;
+  else
+    {
+      start += RIGHT_TOTAL_LENGTH (i);
+      while (!subtree && !NULL_PARENT (i))
+	{
+	  bool left_child = AM_LEFT_CHILD (i);
+
+	  i = INTERVAL_PARENT (i);
+	  if (!left_child)
+	    continue;
+	  if (!interval_summary_match (i, mask, values))
+	    {
+	      i->position = start;
+	      return i;
+	    }
+	  start += LENGTH (i);
+	  if (i->right && !interval_subtree_match (i->right, mask, values))
+	    subtree = i->right;
+	  else
+	    start += RIGHT_TOTAL_LENGTH (i);
+	}
+      if (!subtree)
+	return NULL;
+    }
+
+  /* Descend to the first interval in SUBTREE that doesn't match.  If
+     its left subtree and its root match, its right subtree cannot.  */
+  for (i = subtree; ; i = i->right)
+    {
+      while (i->left && !interval_subtree_match (i->left, mask, values))
+	i = i->left;
+      start += LEFT_TOTAL_LENGTH (i);
+      if (!interval_summary_match (i, mask, values))
+	{
+	  i->position = start;
+	  return i;
+	}
+      start += LENGTH (i);
+      eassert (i->right);
+    }
+}
+
 /* Set the ->position field of I's parent, based on I->position. */
 #define SET_PARENT_POSITION(i)                                  \
   if (AM_LEFT_CHILD (i))                                        \
@@ -24,6 +24,10 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 INLINE_HEADER_BEGIN
 
+/* Number of properties whose runs are summarized in the interval tree;
+   see next_property_run_change.  */
+enum { INTERVAL_SUMMARY_PROPS = 8 };
+
 /* Basic data type for use of intervals.  */
 
 struct interval
@@ -53,6 +57,15 @@ struct interval
 
   bool_bf gcmarkbit : 1;
 
+  /* Summaries of a few properties over the subtree rooted here, for
+     next_property_run_change.  UNIFORM has a bit for each property in
+     interval_summary_index that is set if the property has the same
+     value in the whole subtree; it is meaningful only if SUMMARY_VALID
+     is true.  Whenever an interval's summary is invalid, so are those of
+     all its ancestors.  */
+  bool_bf summary_valid : 1;
+  unsigned int uniform : INTERVAL_SUMMARY_PROPS;
+
   /* The remaining components are `properties' of the interval.
      The first four are duplicates for things which can be on the list,
      for purposes of speed.  */
@@ -158,10 +171,24 @@ set_interval_parent (INTERVAL i, INTERVAL parent)
   i->up.interval = parent;
 }
 
+/* Record that the properties or the children of I have changed, so
+   that the summaries of I and its ancestors must be recomputed.  */
+
+INLINE void
+invalidate_interval_summary (INTERVAL i)
+{
+  while (i && i->summary_valid)
+    {
+      i->summary_valid = false;
+      i = INTERVAL_HAS_PARENT (i) ? INTERVAL_PARENT (i) : NULL;
+    }
+}
+
 INLINE void
 set_interval_plist (INTERVAL i, Lisp_Object plist)
 {
   i->plist = plist;
+  invalidate_interval_summary (i);
 }
 
 /* Get the parent interval, if any, otherwise a null pointer.  Useful
@@ -179,6 +206,7 @@ set_interval_plist (INTERVAL i, Lisp_Object plist)
   (i)->write_protect = false;		      \
   (i)->visible = false;			      \
   (i)->front_sticky = (i)->rear_sticky = false;	\
+  (i)->summary_valid = false;		      \
   set_interval_plist (i, Qnil);		      \
  } while (false)
 
@@ -262,6 +290,8 @@ extern INTERVAL split_interval_left (INTERVAL, ptrdiff_t) ATTRIBUTE_RETURNS_NONN
 extern INTERVAL find_interval (INTERVAL, ptrdiff_t);
 extern INTERVAL next_interval (INTERVAL);
 extern INTERVAL previous_interval (INTERVAL);
+extern int interval_summary_index (Lisp_Object);
+extern INTERVAL next_property_run_change (INTERVAL, int);
 extern INTERVAL merge_interval_left (INTERVAL);
 extern void offset_intervals (struct buffer *, ptrdiff_t, ptrdiff_t);
 extern void graft_intervals_into_buffer (INTERVAL, ptrdiff_t, ptrdiff_t,
@@ -738,6 +738,123 @@ itree_insert (struct itree_tree *tree, struct itree_node *node,
   itree_insert_node (tree, node);
 }
 
+/* +=======================================================================+
+ * | Bulk operations
+ * +=======================================================================+ */
+
+/* Inserting or removing many nodes one at a time costs O(log N) each,
+   with rotations.  When the number of nodes inserted or removed is
+   comparable to the size of the tree, it is cheaper to list the nodes
+   in order, merge or filter the list, and build a balanced tree from
+   it in linear time.  */
+
+/* Return true if inserting or removing COUNT nodes of TREE is faster
+   with itree_insert_sorted or itree_remove_if than one at a time.  */
+
+bool
+itree_bulk_p (struct itree_tree *tree, intmax_t count)
+{
+  intmax_t size = tree->size + count;
+  int height = 1;
+  for (intmax_t n = size; n > 1; n >>= 1)
+    height++;
+  return count * height >= size;
+}
+
+/* Store in NODES, from *N on, the nodes of the subtree rooted at NODE
+   in ascending order, applying their offsets.  */
+
+static void
+itree_collect (uintmax_t otick, struct itree_node *node,
+	       struct itree_node **nodes, intmax_t *n)
+{
+  while (node)
+    {
+      itree_inherit_offset (otick, node);
+      itree_collect (otick, node->left, nodes, n);
+      nodes[(*n)++] = node;
+      node = node->right;
+    }
+}
+
+/* Make a balanced tree of the N nodes in NODES, which are sorted by
+   BEGIN and clean, under PARENT and return its root.  The nodes at
+   depth RED_DEPTH, the deepest level if it is not the root, are red,
+   and the others black, so that all paths have the same number of
+   black nodes.  */
+
+static struct itree_node *
+itree_build (uintmax_t otick, struct itree_node **nodes, intmax_t n,
+	     struct itree_node *parent, int depth, int red_depth)
+{
+  if (n == 0)
+    return NULL;
+
+  intmax_t mid = n / 2;
+  struct itree_node *node = nodes[mid];
+  node->parent = parent;
+  node->offset = 0;
+  node->otick = otick;
+  node->red = depth == red_depth;
+  node->left = itree_build (otick, nodes, mid, node, depth + 1, red_depth);
+  node->right = itree_build (otick, nodes + mid + 1, n - mid - 1, node,
+			     depth + 1, red_depth);
+  node->limit = itree_newlimit (node);
+  return node;
+}
+
+/* Replace the nodes of TREE with the N nodes in NODES, which are
+   sorted by BEGIN and clean.  */
+
+static void
+itree_build_tree (struct itree_tree *tree, struct itree_node **nodes,
+		  intmax_t n)
+{
+  int depth = 0;
+  for (intmax_t i = n; i > 1; i >>= 1)
+    depth++;
+  tree->root = itree_build (tree->otick, nodes, n, NULL, 0,
+			    depth > 0 ? depth : -1);
+  tree->size = n;
+  eassert (check_tree (tree, true)); /* FIXME: Too expensive.  */
+}
+
+/* Insert the N nodes in NODES into TREE.  The nodes must be sorted by
+   BEGIN, and their BEGIN and END must be set.  This is like calling
+   itree_insert for each node, but takes linear time if itree_bulk_p
+   says so.  */
+
+void
+itree_insert_sorted (struct itree_tree *tree, struct itree_node **nodes,
+		     intmax_t n)
+{
+  for (intmax_t i = 0; i < n; i++)
+    {
+      eassert (i == 0 || nodes[i - 1]->begin <= nodes[i]->begin);
+      nodes[i]->otick = tree->otick;
+    }
+
+  if (!itree_bulk_p (tree, n))
+    {
+      for (intmax_t i = 0; i < n; i++)
+	itree_insert_node (tree, nodes[i]);
+      return;
+    }
+
+  /* Merge the nodes of the tree with NODES.  */
+  intmax_t size = tree->size, m = 0;
+  struct itree_node **old = xnmalloc (size, sizeof *old);
+  struct itree_node **all = xnmalloc (size + n, sizeof *all);
+  itree_collect (tree->otick, tree->root, old, &m);
+  eassert (m == size);
+  for (intmax_t i = 0, j = 0, k = 0; k < size + n; k++)
+    all[k] = (j == n || (i < size && old[i]->begin < nodes[j]->begin)
+	      ? old[i++] : nodes[j++]);
+  itree_build_tree (tree, all, size + n);
+  xfree (all);
+  xfree (old);
+}
+
 /* Safely modify a node's interval. */
 
 void
@@ -1040,6 +1157,35 @@ itree_remove (struct itree_tree *tree, struct itree_node *node)
 }
 
 
+/* Remove the nodes of TREE for which PREDICATE returns true.  The
+   nodes passed to PREDICATE are clean, so it can use their BEGIN and
+   END.  This is like calling itree_remove for each of them, but takes
+   linear time when many nodes are removed.  */
+
+void
+itree_remove_if (struct itree_tree *tree,
+		 bool (*predicate) (struct itree_node *))
+{
+  intmax_t size = tree->size, n = 0, m = 0;
+  struct itree_node **nodes = xnmalloc (size, sizeof *nodes);
+
+  itree_collect (tree->otick, tree->root, nodes, &n);
+  eassert (n == size);
+  for (intmax_t i = 0; i < n; i++)
+    if (!predicate (nodes[i]))
+      nodes[m++] = nodes[i];
+    else
+      {
+	nodes[i]->red = false;
+	nodes[i]->right = nodes[i]->left = nodes[i]->parent = NULL;
+	nodes[i]->limit = 0;
+      }
+
+  if (m < n)
+    itree_build_tree (tree, nodes, m);
+  xfree (nodes);
+}
+
 /* +=======================================================================+
  * | Insert/Delete Gaps
  * +=======================================================================+ */
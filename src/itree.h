@@ -127,6 +127,11 @@ extern void itree_insert (struct itree_tree *, struct itree_node *,
 			  ptrdiff_t, ptrdiff_t);
 extern struct itree_node *itree_remove (struct itree_tree *,
 					struct itree_node *);
+extern bool itree_bulk_p (struct itree_tree *, intmax_t);
+extern void itree_insert_sorted (struct itree_tree *, struct itree_node **,
+				 intmax_t);
+extern void itree_remove_if (struct itree_tree *,
+			     bool (*) (struct itree_node *));
 extern void itree_insert_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t, bool);
 extern void itree_delete_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t);
 
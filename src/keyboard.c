@@ -2899,7 +2899,8 @@ read_char (int commandflag, Lisp_Object map,
       && num_nonmacro_input_events - last_auto_save > max (auto_save_interval, 20)
       && !detect_input_pending_run_timers (0))
     {
-      Fdo_auto_save (auto_save_no_message ? Qt : Qnil, Qnil);
+      Fdo_auto_save (auto_save_no_message ? Qt : Qnil, Qnil,
+		     auto_save_in_background ? Qt : Qnil);
       /* Hooks can actually change some buffers in auto save.  */
       redisplay ();
     }
@@ -2974,7 +2975,8 @@ read_char (int commandflag, Lisp_Object map,
 	  if (EQ (tem0, Qt)
 	      && ! CONSP (Vunread_command_events))
 	    {
-	      Fdo_auto_save (auto_save_no_message ? Qt : Qnil, Qnil);
+	      Fdo_auto_save (auto_save_no_message ? Qt : Qnil, Qnil,
+			     auto_save_in_background ? Qt : Qnil);
 	      redisplay ();
 	    }
 	}
@@ -12663,7 +12665,7 @@ handle_interrupt (bool in_signal_handler)
 	  c = read_stdin ();
 	  if (c == 'y' || c == 'Y')
 	    {
-	      Fdo_auto_save (Qt, Qnil);
+	      Fdo_auto_save (Qt, Qnil, Qnil);
 #ifdef MSDOS
 	      write_stdout ("\r\nAuto-save done");
 #else
@@ -0,0 +1,448 @@
+/* Counting newlines in logarithmic time.
+
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
+
+
+#include <config.h>
+
+#include "lisp.h"
+#include "buffer.h"
+#include "line-index.h"
+
+
+/* Data structures.  */
+
+/* The index is a treap (a binary search tree that is also a heap on
+   randomly chosen priorities, and thus balanced with high
+   probability) of chunks, in buffer order.  Chunks store their sizes
+   rather than their positions, so that the positions of the chunks
+   after a modified region need no adjustment; the position of a chunk
+   is the sum of the sizes of the chunks before it.
+
+   Since a newline is a single byte in both unibyte and multibyte
+   text, and is never part of a multibyte sequence, chunk boundaries
+   need not fall on character boundaries.  */
+
+struct line_chunk
+{
+  struct line_chunk *left, *right;
+
+  /* This chunk's priority, which is not less than those of its
+     children.  */
+  unsigned int priority;
+
+  /* The number of bytes, and of newlines, in this chunk.  */
+  ptrdiff_t nbytes, nlines;
+
+  /* The same, summed over this chunk and its descendants.  */
+  ptrdiff_t total_bytes, total_lines;
+};
+
+struct line_index
+{
+  /* The root of the tree, or NULL if the buffer is empty or the index
+     was never built.  */
+  struct line_chunk *root;
+
+  /* The number of chars at the beginning and at the end of the buffer
+     that haven't changed since the tree was last brought up to date,
+     or PTRDIFF_MAX if nothing changed.  */
+  ptrdiff_t beg_unchanged, end_unchanged;
+
+  /* State of the generator of priorities.  */
+  unsigned int seed;
+};
+
+/* The size of the chunks the text is divided into.  Scanning a chunk
+   should cost about as much as walking down the tree.  */
+enum { LINE_CHUNK_SIZE = 8 * 1024 };
+
+#define TOTAL_BYTES(chunk) ((chunk) ? (chunk)->total_bytes : 0)
+#define TOTAL_LINES(chunk) ((chunk) ? (chunk)->total_lines : 0)
+
+
+/* Allocating, initializing and disposing of line indices.  */
+
+struct line_index *
+new_line_index (void)
+{
+  struct line_index *index = xmalloc (sizeof *index);
+
+  index->root = NULL;
+  index->beg_unchanged = 0;
+  index->end_unchanged = 0;
+  index->seed = 2463534242;
+  return index;
+}
+
+static void
+free_chunks (struct line_chunk *chunk)
+{
+  while (chunk)
+    {
+      struct line_chunk *right = chunk->right;
+      free_chunks (chunk->left);
+      xfree (chunk);
+      chunk = right;
+    }
+}
+
+void
+free_line_index (struct line_index *index)
+{
+  free_chunks (index->root);
+  xfree (index);
+}
+
+
+/* Scanning the buffer text.  */
+
+/* Return the number of newlines between byte positions FROM and TO of
+   buffer B.  */
+
+static ptrdiff_t
+count_newlines (struct buffer *b, ptrdiff_t from, ptrdiff_t to)
+{
+  ptrdiff_t nlines = 0;
+
+  while (from < to)
+    {
+      ptrdiff_t stop = (from < BUF_GPT_BYTE (b)
+			? min (to, BUF_GPT_BYTE (b)) : to);
+      unsigned char *p = BUF_BYTE_ADDRESS (b, from);
+      unsigned char *lim = p + (stop - from);
+
+      while ((p = memchr (p, '\n', lim - p)))
+	{
+	  nlines++;
+	  p++;
+	}
+      from = stop;
+    }
+  return nlines;
+}
+
+/* Return the byte position after the Nth newline at or after byte
+   position FROM of buffer B.  There must be that many newlines.  */
+
+static ptrdiff_t
+forward_newline (struct buffer *b, ptrdiff_t from, ptrdiff_t n)
+{
+  while (true)
+    {
+      ptrdiff_t stop = (from < BUF_GPT_BYTE (b)
+			? BUF_GPT_BYTE (b) : BUF_Z_BYTE (b));
+      unsigned char *base = BUF_BYTE_ADDRESS (b, from);
+      unsigned char *p = base, *lim = p + (stop - from);
+
+      while ((p = memchr (p, '\n', lim - p)))
+	{
+	  p++;
+	  if (--n == 0)
+	    return from + (p - base);
+	}
+      eassert (stop < BUF_Z_BYTE (b));
+      from = stop;
+    }
+}
+
+/* Return the byte position after the Nth newline before byte position
+   TO of buffer B.  There must be that many newlines.  */
+
+static ptrdiff_t
+backward_newline (struct buffer *b, ptrdiff_t to, ptrdiff_t n)
+{
+  while (true)
+    {
+      ptrdiff_t stop = (to > BUF_GPT_BYTE (b)
+			? BUF_GPT_BYTE (b) : BUF_BEG_BYTE (b));
+      unsigned char *base = BUF_BYTE_ADDRESS (b, stop);
+      unsigned char *p = base + (to - stop);
+
+      while ((p = memrchr (base, '\n', p - base)))
+	if (--n == 0)
+	  return stop + (p - base) + 1;
+      eassert (stop > BUF_BEG_BYTE (b));
+      to = stop;
+    }
+}
+
+
+/* Maintaining the tree.  */
+
+static struct line_chunk *
+update_chunk (struct line_chunk *chunk)
+{
+  chunk->total_bytes = (TOTAL_BYTES (chunk->left) + chunk->nbytes
+			+ TOTAL_BYTES (chunk->right));
+  chunk->total_lines = (TOTAL_LINES (chunk->left) + chunk->nlines
+			+ TOTAL_LINES (chunk->right));
+  return chunk;
+}
+
+/* Return the tree made of the chunks of A followed by those of B.  */
+
+static struct line_chunk *
+merge_chunks (struct line_chunk *a, struct line_chunk *b)
+{
+  if (!a)
+    return b;
+  if (!b)
+    return a;
+  if (a->priority >= b->priority)
+    {
+      a->right = merge_chunks (a->right, b);
+      return update_chunk (a);
+    }
+  b->left = merge_chunks (a, b->left);
+  return update_chunk (b);
+}
+
+/* Split the tree CHUNK into *LEFT, holding the chunks within its
+   first NBYTES bytes, and *RIGHT, holding the others.  If STRADDLE,
+   a chunk that straddles that boundary goes to *LEFT rather than to
+   *RIGHT.  */
+
+static void
+split_chunks (struct line_chunk *chunk, ptrdiff_t nbytes, bool straddle,
+	      struct line_chunk **left, struct line_chunk **right)
+{
+  if (!chunk)
+    {
+      *left = *right = NULL;
+      return;
+    }
+
+  ptrdiff_t before = TOTAL_BYTES (chunk->left);
+  ptrdiff_t after = before + chunk->nbytes;
+
+  if (after <= nbytes || (straddle && before < nbytes))
+    {
+      split_chunks (chunk->right, nbytes - after, straddle,
+		    &chunk->right, right);
+      *left = update_chunk (chunk);
+    }
+  else
+    {
+      split_chunks (chunk->left, nbytes, straddle, left, &chunk->left);
+      *right = update_chunk (chunk);
+    }
+}
+
+/* Return a tree of new chunks for the text of buffer B between byte
+   positions FROM and TO, using the generator of priorities of
+   INDEX.  */
+
+static struct line_chunk *
+make_chunks (struct buffer *b, struct line_index *index,
+	     ptrdiff_t from, ptrdiff_t to)
+{
+  struct line_chunk *tree = NULL;
+
+  while (from < to)
+    {
+      /* Rather than leaving a small chunk at the end, make the last
+	 one up to half as large again as the others.  */
+      ptrdiff_t end = (to - from < LINE_CHUNK_SIZE + LINE_CHUNK_SIZE / 2
+		       ? to : from + LINE_CHUNK_SIZE);
+      struct line_chunk *chunk = xmalloc (sizeof *chunk);
+      unsigned int x = index->seed;
+
+      /* Xorshift.  */
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      index->seed = x;
+
+      chunk->left = chunk->right = NULL;
+      chunk->priority = x;
+      chunk->nbytes = end - from;
+      chunk->nlines = count_newlines (b, from, end);
+      tree = merge_chunks (tree, update_chunk (chunk));
+      from = end;
+    }
+  return tree;
+}
+
+
+/* Invalidation and revalidation.  */
+
+void
+invalidate_line_index (struct buffer *buf, struct line_index *index,
+		       ptrdiff_t head, ptrdiff_t tail)
+{
+  /* Unlike invalidate_region_cache, don't bring the index up to date
+     when a change is far from those already recorded: some callers
+     have already changed the text when they get here.  Unrelated
+     modifications between two consultations of the index are rare
+     anyway, since redisplay consults it after every command.  */
+  if (head < index->beg_unchanged)
+    index->beg_unchanged = head;
+  if (tail < index->end_unchanged)
+    index->end_unchanged = tail;
+}
+
+/* Recount the chunks of INDEX that overlap the text of B modified
+   since the last time.  */
+
+static void
+revalidate_line_index (struct buffer *b, struct line_index *index)
+{
+  if (index->beg_unchanged == PTRDIFF_MAX)
+    return;
+
+  ptrdiff_t head_bytes
+    = (buf_charpos_to_bytepos (b, BUF_BEG (b) + index->beg_unchanged)
+       - BUF_BEG_BYTE (b));
+  ptrdiff_t tail_bytes
+    = (BUF_Z_BYTE (b)
+       - buf_charpos_to_bytepos (b, BUF_Z (b) - index->end_unchanged));
+  ptrdiff_t old_bytes = TOTAL_BYTES (index->root);
+  struct line_chunk *left, *middle, *right;
+
+  eassert (head_bytes + tail_bytes <= old_bytes || !index->root);
+
+  /* Keep the chunks that lie entirely within the unchanged head and
+     tail, and make new chunks for the rest.  */
+  split_chunks (index->root, head_bytes, false, &left, &middle);
+  split_chunks (middle, old_bytes - tail_bytes - TOTAL_BYTES (left), true,
+		&middle, &right);
+  free_chunks (middle);
+  middle = make_chunks (b, index, BUF_BEG_BYTE (b) + TOTAL_BYTES (left),
+			BUF_Z_BYTE (b) - TOTAL_BYTES (right));
+  index->root = merge_chunks (merge_chunks (left, middle), right);
+  index->beg_unchanged = index->end_unchanged = PTRDIFF_MAX;
+
+  eassert (TOTAL_BYTES (index->root) == BUF_Z_BYTE (b) - BUF_BEG_BYTE (b));
+}
+
+
+/* Consulting the index.  */
+
+/* Return the number of newlines before byte position POS_BYTE of B.  */
+
+static ptrdiff_t
+lines_before (struct buffer *b, struct line_index *index, ptrdiff_t pos_byte)
+{
+  struct line_chunk *chunk = index->root;
+  ptrdiff_t start = BUF_BEG_BYTE (b), nlines = 0;
+
+  while (chunk)
+    {
+      ptrdiff_t before = TOTAL_BYTES (chunk->left);
+
+      if (pos_byte - start < before)
+	chunk = chunk->left;
+      else
+	{
+	  nlines += TOTAL_LINES (chunk->left);
+	  start += before;
+	  if (pos_byte - start <= chunk->nbytes)
+	    {
+	      /* Scan from whichever end of the chunk is nearer.  */
+	      ptrdiff_t end = start + chunk->nbytes;
+	      if (pos_byte - start <= end - pos_byte)
+		return nlines + count_newlines (b, start, pos_byte);
+	      return nlines + chunk->nlines - count_newlines (b, pos_byte, end);
+	    }
+	  nlines += chunk->nlines;
+	  start += chunk->nbytes;
+	  chunk = chunk->right;
+	}
+    }
+  return nlines;
+}
+
+/* Return the byte position after the Nth newline of B, counting from
+   1.  There must be that many newlines.  */
+
+static ptrdiff_t
+newline_end (struct buffer *b, struct line_index *index, ptrdiff_t n)
+{
+  struct line_chunk *chunk = index->root;
+  ptrdiff_t start = BUF_BEG_BYTE (b);
+
+  while (true)
+    {
+      ptrdiff_t before = TOTAL_LINES (chunk->left);
+
+      if (n <= before)
+	chunk = chunk->left;
+      else
+	{
+	  n -= before;
+	  start += TOTAL_BYTES (chunk->left);
+	  if (n <= chunk->nlines)
+	    return (n <= chunk->nlines - n
+		    ? forward_newline (b, start, n)
+		    : backward_newline (b, start + chunk->nbytes,
+					chunk->nlines - n + 1));
+	  n -= chunk->nlines;
+	  start += chunk->nbytes;
+	  chunk = chunk->right;
+	}
+    }
+}
+
+ptrdiff_t
+line_index_scan (struct buffer *buf, struct line_index *index,
+		 ptrdiff_t from_byte, ptrdiff_t to_byte,
+		 ptrdiff_t count, ptrdiff_t *counted)
+{
+  revalidate_line_index (buf, index);
+
+  /* The newlines between FROM_BYTE and TO_BYTE are those numbered
+     from FROM_LINES + 1 to TO_LINES if COUNT is positive, and from
+     TO_LINES + 1 to FROM_LINES otherwise.  */
+  ptrdiff_t from_lines = lines_before (buf, index, from_byte);
+  ptrdiff_t to_lines = lines_before (buf, index, to_byte);
+
+  if (count > 0
+      ? to_lines - from_lines < count
+      : from_lines - to_lines < -count)
+    {
+      *counted = to_lines - from_lines;
+      return to_byte;
+    }
+  *counted = count;
+  return newline_end (buf, index, from_lines + count + (count < 0));
+}
+
+struct line_index *
+buffer_line_index (struct buffer *buf, ptrdiff_t span)
+{
+  struct buffer *base_buf = buf->base_buffer ? buf->base_buffer : buf;
+
+  /* Like newline_cache_on_off, leave the index of the base buffer
+     alone if its value of cache-long-scans disagrees.  */
+  if (NILP (BVAR (buf, cache_long_scans)))
+    {
+      if (base_buf->line_index && NILP (BVAR (base_buf, cache_long_scans)))
+	{
+	  free_line_index (base_buf->line_index);
+	  base_buf->line_index = NULL;
+	}
+      return NULL;
+    }
+
+  if (span < LINE_INDEX_THRESHOLD)
+    return NULL;
+  if (!base_buf->line_index)
+    base_buf->line_index = new_line_index ();
+  return base_buf->line_index;
+}
@@ -0,0 +1,84 @@
+/* Header file: Counting newlines in logarithmic time.
+
+Copyright (C) 2026 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
+
+#ifndef EMACS_LINE_INDEX_H
+#define EMACS_LINE_INDEX_H
+
+/* Counting lines by searching for newlines costs time proportional
+   to the distance covered, which makes `line-number-at-pos',
+   `goto-line' and line numbers in the mode line slow in buffers with
+   millions of lines.
+
+   The line index divides the text of a buffer into chunks of a few
+   kilobytes and remembers how many newlines each chunk contains, in a
+   balanced tree that also records the totals for each subtree.  The
+   number of the line containing a given byte position, and the start
+   of a given line, can then be found in logarithmic time plus a scan
+   of at most one chunk.
+
+   Like the region caches, the index is invalidated by the buffer
+   modification primitives (see invalidate_buffer_caches), which only
+   record the extent of the modified text; the chunks covering it are
+   recounted the next time the index is consulted.
+
+   A buffer gets a line index when cache-long-scans is non-nil and a
+   line count spans at least LINE_INDEX_THRESHOLD bytes; shorter scans
+   are faster without it.  */
+
+struct buffer;
+
+enum
+  {
+    /* Don't bother with the index for scans shorter than this many
+       bytes...  */
+    LINE_INDEX_THRESHOLD = 64 * 1024,
+
+    /* ...or for fewer newlines than this.  */
+    LINE_INDEX_MIN_COUNT = 128
+  };
+
+/* Allocate, initialize and return a new, empty line index.  */
+extern struct line_index *new_line_index (void);
+
+/* Free a line index.  */
+extern void free_line_index (struct line_index *);
+
+/* Indicate that a section of BUF has changed, to invalidate INDEX.
+   HEAD and TAIL are the number of chars unchanged at the beginning
+   and at the end of the buffer, as for invalidate_region_cache.  */
+extern void invalidate_line_index (struct buffer *buf,
+				   struct line_index *index,
+				   ptrdiff_t head, ptrdiff_t tail);
+
+/* Return the line index of BUF if it should be used for a scan of
+   SPAN bytes, creating it if necessary, or NULL if not.  */
+extern struct line_index *buffer_line_index (struct buffer *buf,
+					     ptrdiff_t span);
+
+/* Search, using INDEX, for COUNT newlines between the byte positions
+   FROM_BYTE and TO_BYTE of BUF, like find_newline.  Return the byte
+   position after the COUNTth newline, or TO_BYTE if there are not
+   enough newlines, and set *COUNTED to the number found (negated if
+   COUNT is negative).  */
+extern ptrdiff_t line_index_scan (struct buffer *buf,
+				  struct line_index *index,
+				  ptrdiff_t from_byte, ptrdiff_t to_byte,
+				  ptrdiff_t count, ptrdiff_t *counted);
+
+#endif /* EMACS_LINE_INDEX_H */
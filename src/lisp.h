@@ -2813,14 +2813,16 @@ struct Lisp_Marker
   union vectorlike_header header;
 
   /* This is the buffer that the marker points into, or 0 if it points nowhere.
-     Note: a chain of markers can contain markers pointing into different
-     buffers (the chain is per buffer_text rather than per buffer, so it's
-     shared between indirect buffers).  */
+     Note: the array of markers of a buffer can contain markers pointing
+     into different buffers (the array is per buffer_text rather than
+     per buffer, so it's shared between indirect buffers).  */
   /* This is used for (other than NULL-checking):
      - Fmarker_buffer
      - Fset_marker: check eq(oldbuf, newbuf) to avoid unchain+rechain.
-     - unchain_marker: to find the list from which to unchain.
+     - unchain_marker: to find the array from which to unchain.
      - Fkill_buffer: to only unchain the markers of current indirect buffer.
+     - marker_charpos: to find the positions that CHARPOS and BYTEPOS
+       are relative to.
      */
   struct buffer *buffer;
 
@@ -2831,17 +2833,18 @@ struct Lisp_Marker
   /* True means normal insertion at the marker's position
      leaves the marker after the inserted text.  */
   bool_bf insertion_type : 1;
+  /* True means the marker is after the gap in the array of markers of
+     its buffer, so its positions are relative to the end of the text.  */
+  bool_bf after_gap : 1;
 
   /* The remaining fields are meaningless in a marker that
-     does not point anywhere.  */
-
-  /* For markers that point somewhere,
-     this is used to chain of all the markers in a given buffer.
-     The chain does not preserve markers from garbage collection;
-     instead, markers are removed from the chain when freed by GC.  */
-  /* We could remove it and use an array in buffer_text instead.
-     That would also allow us to preserve it ordered.  */
-  struct Lisp_Marker *next;
+     does not point anywhere, except that they keep the last position
+     of a marker whose buffer was killed.
+
+     Do not read them directly: they are relative to the end of the
+     text if AFTER_GAP is set.  Use marker_charpos and marker_bytepos
+     instead.  */
+
   /* This is the char position where the marker points.  */
   ptrdiff_t charpos;
   /* This is the byte position.
@@ -4943,6 +4946,9 @@ extern void report_overlay_modification (Lisp_Object, Lisp_Object, bool,
                                          Lisp_Object, Lisp_Object, Lisp_Object);
 extern bool overlay_touches_p (ptrdiff_t);
 extern Lisp_Object other_buffer_safely (Lisp_Object);
+extern bool volatile buffer_text_truncated;
+extern bool buffer_text_sigbus (void *);
+extern void report_truncated_buffer_text (void);
 extern void init_buffer_once (void);
 extern void init_buffer (void);
 extern void syms_of_buffer (void);
@@ -4956,6 +4962,24 @@ extern ptrdiff_t buf_charpos_to_bytepos (struct buffer *, ptrdiff_t);
 extern ptrdiff_t buf_bytepos_to_charpos (struct buffer *, ptrdiff_t);
 extern void detach_marker (Lisp_Object);
 extern void unchain_marker (struct Lisp_Marker *);
+extern void attach_marker (struct Lisp_Marker *, struct buffer *,
+			   ptrdiff_t, ptrdiff_t);
+extern void relocate_markers_for_insert (struct buffer *, ptrdiff_t,
+					 ptrdiff_t, ptrdiff_t, bool);
+extern void relocate_markers_for_replace (struct buffer *, ptrdiff_t,
+					  ptrdiff_t, ptrdiff_t, ptrdiff_t,
+					  ptrdiff_t, ptrdiff_t);
+extern ptrdiff_t select_markers (struct buffer *, ptrdiff_t, ptrdiff_t);
+extern void reorder_markers (struct buffer *, ptrdiff_t);
+extern void unchain_buffer_markers (struct buffer *);
+extern void free_pos_index (struct buffer *);
+extern void relocate_pos_index_for_insert (struct buffer *, ptrdiff_t,
+					   ptrdiff_t, ptrdiff_t);
+extern void relocate_pos_index_for_replace (struct buffer *, ptrdiff_t,
+					    ptrdiff_t, ptrdiff_t,
+					    ptrdiff_t, ptrdiff_t);
+extern void truncate_pos_index (struct buffer *, ptrdiff_t);
+extern void collect_markers_for_dump (void);
 extern Lisp_Object set_marker_restricted (Lisp_Object, Lisp_Object, Lisp_Object);
 extern Lisp_Object set_marker_both (Lisp_Object, Lisp_Object, ptrdiff_t, ptrdiff_t);
 extern Lisp_Object set_marker_restricted_both (Lisp_Object, Lisp_Object,
@@ -5248,8 +5272,11 @@ extern void syms_of_macros (void);
 
 /* Defined in undo.c.  */
 extern void truncate_undo_list (struct buffer *);
+extern Lisp_Object buffer_undo_list (struct buffer *);
+extern void free_undo_log (struct buffer *);
 extern void record_insert (ptrdiff_t, ptrdiff_t);
 extern void record_delete (ptrdiff_t, Lisp_Object, bool);
+extern void record_delete_text (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t);
 extern void record_first_change (void);
 extern void record_change (ptrdiff_t, ptrdiff_t);
 extern void record_property_change (ptrdiff_t, ptrdiff_t,
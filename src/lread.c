@@ -392,8 +392,7 @@ source_marker_get (source_t *src)
 	c = BYTE8_TO_CHAR (c);
       bytepos++;
     }
-  XMARKER (m)->bytepos = bytepos;
-  XMARKER (m)->charpos++;
+  attach_marker (XMARKER (m), b, marker_charpos (XMARKER (m)) + 1, bytepos);
   return c;
 }
 
@@ -402,10 +401,9 @@ source_marker_unget (source_t *src, int c)
 {
   Lisp_Object m = src->object;
   struct buffer *b = XMARKER (m)->buffer;
-  ptrdiff_t bytepos = XMARKER (m)->bytepos;
-  XMARKER (m)->charpos--;
+  ptrdiff_t bytepos = marker_bytepos (XMARKER (m));
   bytepos -= src->multibyte ? buf_prev_char_len (b, bytepos) : 1;
-  XMARKER (m)->bytepos = bytepos;
+  attach_marker (XMARKER (m), b, marker_charpos (XMARKER (m)) - 1, bytepos);
 }
 
 static int
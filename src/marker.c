@@ -20,6 +20,8 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 
 #include <config.h>
 
+#include <stdlib.h>
+
 /* Work around GCC bug 113253.  */
 #if __GNUC__ == 13 && __GNUC_MINOR__ < 3
 # pragma GCC diagnostic ignored "-Wanalyzer-deref-before-check"
@@ -29,6 +31,13 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "character.h"
 #include "buffer.h"
 #include "window.h"
+#include "pdumper.h"
+
+/* The markers of the live buffers, while Emacs is being dumped.  The
+   marker arrays are not dumped, so they are rebuilt from this list
+   when the dump is loaded.  */
+
+static Lisp_Object dumped_markers;
 
 /* Record one cached position found recently by
    buf_charpos_to_bytepos or buf_bytepos_to_charpos.  */
@@ -86,7 +95,8 @@ clear_charpos_cache (struct buffer *b)
 
 /* There are several places in the buffer where we know
    the correspondence: BEG, BEGV, PT, GPT, ZV and Z,
-   and everywhere there is a marker.  So we find the one of these places
+   everywhere there is a marker, and at the entries of the position
+   index (see below).  So we find the one of these places
    that is closest to the specified position, and scan from there.  */
 
 /* This macro is a subroutine of buf_charpos_to_bytepos.
@@ -139,37 +149,438 @@ CHECK_MARKER (Lisp_Object x)
   CHECK_TYPE (MARKERP (x), Qmarkerp, x);
 }
 
-/* When converting bytes from/to chars, we look through the list of
-   markers to try and find a good starting point (since markers keep
-   track of both bytepos and charpos at the same time).
-   But if there are many markers, it can take too much time to find a "good"
-   marker from which to start.  Worse yet: if it takes a long time and we end
-   up finding a nearby markers, we won't add a new marker to cache this
-   result, so next time around we'll have to go through this same long list
-   to (re)find this best marker.  So the further down the list of
-   markers we go, the less demanding we are w.r.t what is a good marker.
-
-   The previous code used INITIAL=50 and INCREMENT=0 and this lead to
-   really poor performance when there are many markers.
-   I haven't tried to tweak INITIAL, but experiments on my trusty Thinkpad
-   T61 using various artificial test cases seem to suggest that INCREMENT=50
-   might be "the best compromise": it significantly improved the
-   worst case and it was rarely slower and never by much.
-
-   The asymptotic behavior is still poor, tho, so in largish buffers with many
-   overlays (e.g. 300KB and 30K overlays), it can still be a bottleneck.  */
-#define BYTECHAR_DISTANCE_INITIAL 50
-#define BYTECHAR_DISTANCE_INCREMENT 50
+/* The array of markers of a buffer.
+
+   The markers of a buffer are kept sorted by position in an array
+   with a gap, BUF_MARKERS (B), and the markers after the gap record
+   their positions relative to the end of the text (see struct
+   buffer_text).  This makes it possible to find the markers near a
+   position by bisection, and to adjust the markers for a change by
+   moving the gap there, which usually costs little because most
+   changes happen near the previous one.  */
+
+/* Return the index of the first marker at or after POS among the
+   markers from index LO to HI of MARKERS, which must all be on the same
+   side of the gap.  POS is a byte position if BYTES, a character
+   position otherwise, and must be relative to the end of the text if
+   the markers are after the gap.  */
+
+static ptrdiff_t
+bisect_markers (struct Lisp_Marker **markers, ptrdiff_t lo, ptrdiff_t hi,
+		ptrdiff_t pos, bool bytes)
+{
+  while (lo < hi)
+    {
+      ptrdiff_t mid = lo + (hi - lo) / 2;
+      if ((bytes ? markers[mid]->bytepos : markers[mid]->charpos) < pos)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return lo;
+}
+
+/* Move the gap in the marker array of T so that the markers before it
+   are those at or before CHARPOS.  */
+
+static void
+move_marker_gap (struct buffer_text *t, ptrdiff_t charpos)
+{
+  struct Lisp_Marker **markers = t->markers;
+  ptrdiff_t gpt = t->markers_gpt, gap = t->markers_gap_size;
+
+  while (gpt > 0 && markers[gpt - 1]->charpos > charpos)
+    {
+      struct Lisp_Marker *m = markers[--gpt];
+      m->charpos -= t->markers_z;
+      m->bytepos -= t->markers_z_byte;
+      m->after_gap = true;
+      markers[gpt + gap] = m;
+    }
+  while (gpt + gap < t->markers_size
+	 && markers[gpt + gap]->charpos + t->markers_z <= charpos)
+    {
+      struct Lisp_Marker *m = markers[gpt + gap];
+      m->charpos += t->markers_z;
+      m->bytepos += t->markers_z_byte;
+      m->after_gap = false;
+      markers[gpt++] = m;
+    }
+  t->markers_gpt = gpt;
+}
+
+/* Return the index of marker M in the marker array of T, or -1 if it
+   is not there.  */
+
+static ptrdiff_t
+marker_index (struct buffer_text *t, struct Lisp_Marker *m)
+{
+  ptrdiff_t lo = m->after_gap ? t->markers_gpt + t->markers_gap_size : 0;
+  ptrdiff_t hi = m->after_gap ? t->markers_size : t->markers_gpt;
+  ptrdiff_t i;
+
+  for (i = bisect_markers (t->markers, lo, hi, m->charpos, false);
+       i < hi && t->markers[i] != m; i++)
+    eassert (t->markers[i]->charpos == m->charpos);
+
+  /* Error if marker was not in its array.  */
+  eassert (i < hi);
+  return i < hi ? i : -1;
+}
+
+/* Store CHARPOS and BYTEPOS in M, which is at index I of the marker
+   array of T, in the way appropriate to that index.  */
+
+static void
+set_marker_at (struct buffer_text *t, ptrdiff_t i, struct Lisp_Marker *m,
+	       ptrdiff_t charpos, ptrdiff_t bytepos)
+{
+  m->after_gap = t->markers_gpt <= i;
+  m->charpos = charpos - (m->after_gap ? t->markers_z : 0);
+  m->bytepos = bytepos - (m->after_gap ? t->markers_z_byte : 0);
+  t->markers[i] = m;
+}
+
+/* Insert marker M in the marker array of T, at CHARPOS and BYTEPOS.
+   Shift the markers between its place and the gap, instead of moving
+   the gap, because that is cheaper.  */
+
+static void
+insert_marker (struct buffer_text *t, struct Lisp_Marker *m,
+	       ptrdiff_t charpos, ptrdiff_t bytepos)
+{
+  struct Lisp_Marker **markers;
+  ptrdiff_t gpt = t->markers_gpt, end, i;
+
+  if (t->markers_gap_size == 0)
+    {
+      ptrdiff_t old_size = t->markers_size;
+      t->markers = xpalloc (t->markers, &t->markers_size, 1, -1,
+			    sizeof *t->markers);
+      t->markers_gap_size = t->markers_size - old_size;
+      memmove (t->markers + gpt + t->markers_gap_size, t->markers + gpt,
+	       (old_size - gpt) * sizeof *t->markers);
+    }
+
+  markers = t->markers;
+  end = gpt + t->markers_gap_size;
+  if (gpt > 0 && charpos < markers[gpt - 1]->charpos)
+    {
+      i = bisect_markers (markers, 0, gpt, charpos, false);
+      memmove (markers + i + 1, markers + i, (gpt - i) * sizeof *markers);
+      t->markers_gpt++;
+    }
+  else if (end < t->markers_size
+	   && markers[end]->charpos + t->markers_z < charpos)
+    {
+      i = bisect_markers (markers, end, t->markers_size,
+			  charpos - t->markers_z, false) - 1;
+      memmove (markers + end - 1, markers + end, (i - end + 1) * sizeof *markers);
+    }
+  else
+    i = t->markers_gpt++;
+  t->markers_gap_size--;
+  set_marker_at (t, i, m, charpos, bytepos);
+}
+
+/* Remove the marker at index I from the marker array of T, recording
+   its absolute positions in it.  */
+
+static void
+remove_marker (struct buffer_text *t, ptrdiff_t i)
+{
+  struct Lisp_Marker **markers = t->markers;
+  struct Lisp_Marker *m = markers[i];
+  ptrdiff_t gpt = t->markers_gpt;
+
+  if (m->after_gap)
+    {
+      ptrdiff_t end = gpt + t->markers_gap_size;
+      m->charpos += t->markers_z;
+      m->bytepos += t->markers_z_byte;
+      m->after_gap = false;
+      memmove (markers + end + 1, markers + end, (i - end) * sizeof *markers);
+    }
+  else
+    {
+      memmove (markers + i, markers + i + 1, (gpt - i - 1) * sizeof *markers);
+      t->markers_gpt--;
+    }
+  t->markers_gap_size++;
+}
+
+/* Set *BELOW and *ABOVE to the markers of B nearest to POS, below it
+   and at or above it respectively, or to NULL if there are none.  POS
+   is a byte position if BYTES, a character position otherwise.  */
+
+static void
+nearest_markers (struct buffer *b, ptrdiff_t pos, bool bytes,
+		 struct Lisp_Marker **below, struct Lisp_Marker **above)
+{
+  struct buffer_text *t = b->text;
+  struct Lisp_Marker **markers = t->markers;
+  ptrdiff_t gpt = t->markers_gpt, end = gpt + t->markers_gap_size;
+  ptrdiff_t i;
+
+  if (gpt > 0
+      && pos <= (bytes ? markers[gpt - 1]->bytepos : markers[gpt - 1]->charpos))
+    {
+      i = bisect_markers (markers, 0, gpt, pos, bytes);
+      *below = i > 0 ? markers[i - 1] : NULL;
+      *above = markers[i];
+    }
+  else
+    {
+      i = bisect_markers (markers, end, t->markers_size,
+			  pos - (bytes ? t->markers_z_byte : t->markers_z),
+			  bytes);
+      *below = i > end ? markers[i - 1] : gpt > 0 ? markers[gpt - 1] : NULL;
+      *above = i < t->markers_size ? markers[i] : NULL;
+    }
+}
+
+/* The position index of a buffer.
+
+   In a large buffer with many non-ASCII characters, the places where
+   we know the correspondence between character and byte positions
+   can be far from the position to convert, and the scan from there
+   costs time proportional to the distance.  So the scans also record
+   the correspondence at places about POS_INDEX_INTERVAL bytes apart,
+   in an array sorted by position that is kept in the buffer text.
+
+   Like the marker array, this array has a gap, and the entries after
+   the gap hold their positions relative to the end of the text, so
+   insdel.c can adjust the index for a change by moving the gap to
+   where it happens (see relocate_pos_index_for_insert and
+   relocate_pos_index_for_replace).  When two consecutive entries are
+   as many characters as bytes apart, the text between them is ASCII,
+   and the positions between them are converted without scanning.  */
+
+struct pos_index_entry
+{
+  ptrdiff_t charpos, bytepos;
+};
+
+struct pos_index
+{
+  /* The entries, with a gap of GAP_SIZE slots starting at GPT, out of
+     SIZE.  */
+  struct pos_index_entry *entries;
+  ptrdiff_t gpt, gap_size, size;
+
+  /* What the positions of the entries after the gap are relative to.
+     These are the Z and Z_BYTE of the buffer, unless some change of
+     the text was not reported to the index.  */
+  ptrdiff_t z, z_byte;
+};
+
+/* How far apart the scans record entries.  Scanning that many bytes
+   should cost little more than finding the nearest entry.  */
+enum { POS_INDEX_INTERVAL = 4 * 1024 };
+
+void
+free_pos_index (struct buffer *b)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  if (index)
+    {
+      xfree (index->entries);
+      xfree (index);
+      b->text->pos_index = NULL;
+    }
+}
+
+/* Return the position index of B, or NULL if it has none.  */
+
+static struct pos_index *
+buffer_pos_index (struct buffer *b)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  /* If the text changed behind the back of the index, its entries
+     cannot be trusted.  */
+  if (index && (index->z != BUF_Z (b) || index->z_byte != BUF_Z_BYTE (b)))
+    {
+      free_pos_index (b);
+      index = NULL;
+    }
+  return index;
+}
+
+/* Return entry number I of INDEX, not counting the gap.  */
+
+static struct pos_index_entry
+pos_index_entry (struct pos_index *index, ptrdiff_t i)
+{
+  struct pos_index_entry e;
+
+  if (i < index->gpt)
+    e = index->entries[i];
+  else
+    {
+      e = index->entries[i + index->gap_size];
+      e.charpos += index->z;
+      e.bytepos += index->z_byte;
+    }
+  return e;
+}
+
+/* Return the number of entries of INDEX before POS, which is a byte
+   position if BYTES, a character position otherwise.  */
+
+static ptrdiff_t
+bisect_pos_index (struct pos_index *index, ptrdiff_t pos, bool bytes)
+{
+  ptrdiff_t lo = 0, hi = index->size - index->gap_size;
+
+  while (lo < hi)
+    {
+      ptrdiff_t mid = lo + (hi - lo) / 2;
+      struct pos_index_entry e = pos_index_entry (index, mid);
+      if ((bytes ? e.bytepos : e.charpos) < pos)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return lo;
+}
+
+/* Move the gap of INDEX so that the entries before it are those at or
+   before CHARPOS.  */
+
+static void
+move_pos_index_gap (struct pos_index *index, ptrdiff_t charpos)
+{
+  struct pos_index_entry *entries = index->entries;
+  ptrdiff_t gpt = index->gpt, gap = index->gap_size;
+
+  while (gpt > 0 && entries[gpt - 1].charpos > charpos)
+    {
+      gpt--;
+      entries[gpt + gap].charpos = entries[gpt].charpos - index->z;
+      entries[gpt + gap].bytepos = entries[gpt].bytepos - index->z_byte;
+    }
+  while (gpt + gap < index->size
+	 && entries[gpt + gap].charpos + index->z <= charpos)
+    {
+      entries[gpt].charpos = entries[gpt + gap].charpos + index->z;
+      entries[gpt].bytepos = entries[gpt + gap].bytepos + index->z_byte;
+      gpt++;
+    }
+  index->gpt = gpt;
+}
+
+/* Record in the position index of B that CHARPOS corresponds to
+   BYTEPOS, during a scan forward if FORWARD, backward otherwise.  The
+   scan must not have crossed any entry of the index, which is true if
+   it started from the nearest known place.  */
+
+static void
+record_pos_index_entry (struct buffer *b, ptrdiff_t charpos,
+			ptrdiff_t bytepos, bool forward)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  if (!index)
+    {
+      index = b->text->pos_index = xzalloc (sizeof *index);
+      index->z = BUF_Z (b);
+      index->z_byte = BUF_Z_BYTE (b);
+    }
+
+  if (index->gap_size == 0)
+    {
+      ptrdiff_t old_size = index->size;
+      index->entries = xpalloc (index->entries, &index->size, 1, -1,
+				sizeof *index->entries);
+      index->gap_size = index->size - old_size;
+      memmove (index->entries + index->gpt + index->gap_size,
+	       index->entries + index->gpt,
+	       (old_size - index->gpt) * sizeof *index->entries);
+    }
+
+  /* Usually the gap is already there, since the scans record several
+     entries in a row.  */
+  move_pos_index_gap (index, forward ? charpos : charpos - 1);
+  if (forward)
+    index->entries[index->gpt++] = (struct pos_index_entry) {
+      charpos, bytepos };
+  else
+    index->entries[index->gpt + index->gap_size - 1]
+      = (struct pos_index_entry) { charpos - index->z,
+				   bytepos - index->z_byte };
+  index->gap_size--;
+}
+
+/* Adjust the position index of B for the insertion of NCHARS
+   characters, NBYTES bytes, at FROM.  */
+
+void
+relocate_pos_index_for_insert (struct buffer *b, ptrdiff_t from,
+			       ptrdiff_t nchars, ptrdiff_t nbytes)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  if (index)
+    {
+      move_pos_index_gap (index, from);
+      index->z += nchars;
+      index->z_byte += nbytes;
+    }
+}
+
+/* Adjust the position index of B for the replacement of OLD_CHARS
+   characters, OLD_BYTES bytes, at FROM by NEW_CHARS characters,
+   NEW_BYTES bytes.  The entries inside the old text are dropped.  */
+
+void
+relocate_pos_index_for_replace (struct buffer *b, ptrdiff_t from,
+				ptrdiff_t old_chars, ptrdiff_t old_bytes,
+				ptrdiff_t new_chars, ptrdiff_t new_bytes)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  if (index)
+    {
+      ptrdiff_t to = from + old_chars;
+
+      move_pos_index_gap (index, from);
+      while (index->gpt + index->gap_size < index->size
+	     && (index->entries[index->gpt + index->gap_size].charpos
+		 + index->z) < to)
+	index->gap_size++;
+      index->z += new_chars - old_chars;
+      index->z_byte += new_bytes - old_bytes;
+    }
+}
+
+/* Forget what the position index of B says about positions after
+   FROM, whose byte positions changed in a way it was not told.  */
+
+void
+truncate_pos_index (struct buffer *b, ptrdiff_t from)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  if (index)
+    {
+      move_pos_index_gap (index, from);
+      index->gap_size = index->size - index->gpt;
+      index->z = BUF_Z (b);
+      index->z_byte = BUF_Z_BYTE (b);
+    }
+}
 
 /* Return the byte position corresponding to CHARPOS in B.  */
 
 ptrdiff_t
 buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
 {
-  struct Lisp_Marker *tail;
+  struct Lisp_Marker *below, *above;
+  struct pos_index *index;
   ptrdiff_t best_above, best_above_byte;
   ptrdiff_t best_below, best_below_byte;
-  ptrdiff_t distance = BYTECHAR_DISTANCE_INITIAL;
 
   eassert (BUF_BEG (b) <= charpos && charpos <= BUF_Z (b));
 
@@ -202,15 +613,27 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
   if (b == cached_buffer && BUF_MODIFF (b) == cached_modiff)
     CONSIDER (cached_charpos, cached_bytepos);
 
-  for (tail = BUF_MARKERS (b);
-       /* If we are down to a range of DISTANCE chars,
-          don't bother checking any other markers;
-          scan the intervening chars directly now.  */
-       tail && !(best_above - charpos < distance
-		 || charpos - best_below < distance);
-       tail = tail->next,
-       distance += BYTECHAR_DISTANCE_INCREMENT)
-    CONSIDER (tail->charpos, tail->bytepos);
+  nearest_markers (b, charpos, false, &below, &above);
+  if (below)
+    CONSIDER (marker_charpos (below), marker_bytepos (below));
+  if (above)
+    CONSIDER (marker_charpos (above), marker_bytepos (above));
+
+  index = buffer_pos_index (b);
+  if (index)
+    {
+      ptrdiff_t i = bisect_pos_index (index, charpos, false);
+      if (i > 0)
+	{
+	  struct pos_index_entry e = pos_index_entry (index, i - 1);
+	  CONSIDER (e.charpos, e.bytepos);
+	}
+      if (i < index->size - index->gap_size)
+	{
+	  struct pos_index_entry e = pos_index_entry (index, i);
+	  CONSIDER (e.charpos, e.bytepos);
+	}
+    }
 
   /* We get here if we did not exactly hit one of the known places.
      We have one known above and one known below.
@@ -219,19 +642,21 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
   eassert (best_below <= charpos && charpos <= best_above);
   if (charpos - best_below < best_above - charpos)
     {
-      bool record = charpos - best_below > 5000;
+      ptrdiff_t record_byte = best_below_byte + POS_INDEX_INTERVAL;
 
       while (best_below < charpos)
 	{
 	  best_below++;
 	  best_below_byte += buf_next_char_len (b, best_below_byte);
-	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.  */
-      if (record)
-	build_marker (b, best_below, best_below_byte);
+	  /* If this position is quite far from the nearest known
+	     position, record the correspondence in the index.  */
+	  if (best_below_byte >= record_byte)
+	    {
+	      record_pos_index_entry (b, best_below, best_below_byte, true);
+	      record_byte = best_below_byte + POS_INDEX_INTERVAL;
+	    }
+	}
 
       byte_char_debug_check (b, best_below, best_below_byte);
 
@@ -244,19 +669,19 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
     }
   else
     {
-      bool record = best_above - charpos > 5000;
+      ptrdiff_t record_byte = best_above_byte - POS_INDEX_INTERVAL;
 
       while (best_above > charpos)
 	{
 	  best_above--;
 	  best_above_byte -= buf_prev_char_len (b, best_above_byte);
-	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.  */
-      if (record)
-	build_marker (b, best_above, best_above_byte);
+	  if (best_above_byte <= record_byte)
+	    {
+	      record_pos_index_entry (b, best_above, best_above_byte, false);
+	      record_byte = best_above_byte - POS_INDEX_INTERVAL;
+	    }
+	}
 
       byte_char_debug_check (b, best_above, best_above_byte);
 
@@ -319,10 +744,10 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
 ptrdiff_t
 buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
 {
-  struct Lisp_Marker *tail;
+  struct Lisp_Marker *below, *above;
+  struct pos_index *index;
   ptrdiff_t best_above, best_above_byte;
   ptrdiff_t best_below, best_below_byte;
-  ptrdiff_t distance = BYTECHAR_DISTANCE_INITIAL;
 
   eassert (BUF_BEG_BYTE (b) <= bytepos && bytepos <= BUF_Z_BYTE (b));
 
@@ -350,15 +775,27 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
   if (b == cached_buffer && BUF_MODIFF (b) == cached_modiff)
     CONSIDER (cached_bytepos, cached_charpos);
 
-  for (tail = BUF_MARKERS (b);
-       /* If we are down to a range of DISTANCE bytes,
-          don't bother checking any other markers;
-          scan the intervening chars directly now.  */
-       tail && !(best_above_byte - bytepos < distance
-		 || bytepos - best_below_byte < distance);
-       tail = tail->next,
-       distance += BYTECHAR_DISTANCE_INCREMENT)
-    CONSIDER (tail->bytepos, tail->charpos);
+  nearest_markers (b, bytepos, true, &below, &above);
+  if (below)
+    CONSIDER (marker_bytepos (below), marker_charpos (below));
+  if (above)
+    CONSIDER (marker_bytepos (above), marker_charpos (above));
+
+  index = buffer_pos_index (b);
+  if (index)
+    {
+      ptrdiff_t i = bisect_pos_index (index, bytepos, true);
+      if (i > 0)
+	{
+	  struct pos_index_entry e = pos_index_entry (index, i - 1);
+	  CONSIDER (e.bytepos, e.charpos);
+	}
+      if (i < index->size - index->gap_size)
+	{
+	  struct pos_index_entry e = pos_index_entry (index, i);
+	  CONSIDER (e.bytepos, e.charpos);
+	}
+    }
 
   /* We get here if we did not exactly hit one of the known places.
      We have one known above and one known below.
@@ -366,21 +803,21 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
 
   if (bytepos - best_below_byte < best_above_byte - bytepos)
     {
-      bool record = bytepos - best_below_byte > 5000;
+      ptrdiff_t record_byte = best_below_byte + POS_INDEX_INTERVAL;
 
       while (best_below_byte < bytepos)
 	{
 	  best_below++;
 	  best_below_byte += buf_next_char_len (b, best_below_byte);
-	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.
-	 But don't do it if BUF_MARKERS is nil;
-	 that is a signal from Fset_buffer_multibyte.  */
-      if (record && BUF_MARKERS (b))
-	build_marker (b, best_below, best_below_byte);
+	  /* If this position is quite far from the nearest known
+	     position, record the correspondence in the index.  */
+	  if (best_below_byte >= record_byte)
+	    {
+	      record_pos_index_entry (b, best_below, best_below_byte, true);
+	      record_byte = best_below_byte + POS_INDEX_INTERVAL;
+	    }
+	}
 
       byte_char_debug_check (b, best_below, best_below_byte);
 
@@ -393,21 +830,19 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
     }
   else
     {
-      bool record = best_above_byte - bytepos > 5000;
+      ptrdiff_t record_byte = best_above_byte - POS_INDEX_INTERVAL;
 
       while (best_above_byte > bytepos)
 	{
 	  best_above--;
 	  best_above_byte -= buf_prev_char_len (b, best_above_byte);
-	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.
-	 But don't do it if BUF_MARKERS is nil;
-	 that is a signal from Fset_buffer_multibyte.  */
-      if (record && BUF_MARKERS (b))
-	build_marker (b, best_above, best_above_byte);
+	  if (best_above_byte <= record_byte)
+	    {
+	      record_pos_index_entry (b, best_above, best_above_byte, false);
+	      record_byte = best_above_byte - POS_INDEX_INTERVAL;
+	    }
+	}
 
       byte_char_debug_check (b, best_above, best_above_byte);
 
@@ -450,7 +885,7 @@ DEFUN ("marker-position", Fmarker_position, Smarker_position, 1, 1, 0,
 {
   CHECK_MARKER (marker);
   if (XMARKER (marker)->buffer)
-    return make_fixnum (XMARKER (marker)->charpos);
+    return make_fixnum (marker_charpos (XMARKER (marker)));
 
   return Qnil;
 }
@@ -464,15 +899,17 @@ before it was killed.  */)
 {
   CHECK_MARKER (marker);
 
-  return make_fixnum (XMARKER (marker)->charpos);
+  return make_fixnum (marker_charpos (XMARKER (marker)));
 }
 
 /* Change M so it points to B at CHARPOS and BYTEPOS.  */
 
-static void
+void
 attach_marker (struct Lisp_Marker *m, struct buffer *b,
 	       ptrdiff_t charpos, ptrdiff_t bytepos)
 {
+  struct buffer_text *t = b->text;
+
   /* In a single-byte buffer, two positions must be equal.
      Otherwise, every character is at least one byte.  */
   if (BUF_Z (b) == BUF_Z_BYTE (b))
@@ -480,16 +917,34 @@ attach_marker (struct Lisp_Marker *m, struct buffer *b,
   else
     eassert (charpos <= bytepos);
 
-  m->charpos = charpos;
-  m->bytepos = bytepos;
-
-  if (m->buffer != b)
+  if (m->buffer && m->buffer->text == t)
     {
-      unchain_marker (m);
-      m->buffer = b;
-      m->next = BUF_MARKERS (b);
-      BUF_MARKERS (b) = m;
+      ptrdiff_t i = marker_index (t, m);
+
+      if (i >= 0)
+	{
+	  /* Leave M at its place in the array if the markers around
+	     it are still in order, which is often the case.  */
+	  ptrdiff_t gpt = t->markers_gpt, end = gpt + t->markers_gap_size;
+	  ptrdiff_t prev = i == end ? gpt - 1 : i - 1;
+	  ptrdiff_t next = i + 1 == gpt ? end : i + 1;
+
+	  m->buffer = b;
+	  if ((prev < 0 || marker_charpos (t->markers[prev]) <= charpos)
+	      && (next >= t->markers_size
+		  || charpos <= marker_charpos (t->markers[next])))
+	    {
+	      set_marker_at (t, i, m, charpos, bytepos);
+	      return;
+	    }
+	  remove_marker (t, i);
+	}
     }
+  else
+    unchain_marker (m);
+
+  m->buffer = b;
+  insert_marker (t, m, charpos, bytepos);
 }
 
 /* If BUFFER is nil, return current buffer pointer.  Next, check
@@ -527,10 +982,8 @@ set_marker_internal (Lisp_Object marker, Lisp_Object position,
      an existing marker, and MARKER is already in the same buffer.  */
   else if (MARKERP (position) && b == XMARKER (position)->buffer
 	   && b == m->buffer)
-    {
-      m->bytepos = XMARKER (position)->bytepos;
-      m->charpos = XMARKER (position)->charpos;
-    }
+    attach_marker (m, b, marker_charpos (XMARKER (position)),
+		   marker_bytepos (XMARKER (position)));
 
   else
     {
@@ -554,8 +1007,8 @@ set_marker_internal (Lisp_Object marker, Lisp_Object position,
 	}
       else if (MARKERP (position))
 	{
-	  charpos = XMARKER (position)->charpos;
-	  bytepos = XMARKER (position)->bytepos;
+	  charpos = marker_charpos (XMARKER (position));
+	  bytepos = marker_bytepos (XMARKER (position));
 	}
       else
 	wrong_type_argument (Qinteger_or_marker_p, position);
@@ -677,7 +1130,7 @@ detach_marker (Lisp_Object marker)
   Fset_marker (marker, Qnil, Qnil);
 }
 
-/* Remove MARKER from the chain of whatever buffer it is in.  Set its
+/* Remove MARKER from the array of whatever buffer it is in.  Set its
    buffer NULL.  */
 
 void
@@ -687,37 +1140,163 @@ unchain_marker (register struct Lisp_Marker *marker)
 
   if (b)
     {
-      register struct Lisp_Marker *tail, **prev;
+      ptrdiff_t i;
 
       /* No dead buffers here.  */
       eassert (BUFFER_LIVE_P (b));
 
+      i = marker_index (b->text, marker);
+      if (i >= 0)
+	remove_marker (b->text, i);
       marker->buffer = NULL;
-      prev = &BUF_MARKERS (b);
-
-      for (tail = BUF_MARKERS (b); tail; prev = &tail->next, tail = *prev)
-	if (marker == tail)
-	  {
-	    if (*prev == BUF_MARKERS (b))
-	      {
-		/* Deleting first marker from the buffer's chain.  Crash
-		   if new first marker in chain does not say it belongs
-		   to the same buffer, or at least that they have the same
-		   base buffer.  */
-		if (tail->next && b->text != tail->next->buffer->text)
-		  emacs_abort ();
-	      }
-	    *prev = tail->next;
-	    /* We have removed the marker from the chain;
-	       no need to scan the rest of the chain.  */
-	    break;
-	  }
-
-      /* Error if marker was not in it's chain.  */
-      eassert (tail != NULL);
     }
 }
 
+/* Make all the markers of B point nowhere, or only those that belong
+   to B if it is an indirect buffer.  */
+
+void
+unchain_buffer_markers (struct buffer *b)
+{
+  struct buffer_text *t = b->text;
+  ptrdiff_t i, n = 0;
+
+  move_marker_gap (t, PTRDIFF_MAX);
+  for (i = 0; i < t->markers_gpt; i++)
+    {
+      struct Lisp_Marker *m = t->markers[i];
+      if (!b->base_buffer || m->buffer == b)
+	m->buffer = NULL;
+      else
+	t->markers[n++] = m;
+    }
+  t->markers_gpt = n;
+  t->markers_gap_size = t->markers_size - n;
+  if (n == 0)
+    {
+      xfree (t->markers);
+      t->markers = NULL;
+      t->markers_size = t->markers_gap_size = 0;
+    }
+}
+
+/* Adjust the markers of B for an insertion of NCHARS characters and
+   NBYTES bytes at FROM.  The markers at FROM are advanced if either
+   their insertion type is t or BEFORE_MARKERS is true.  */
+
+void
+relocate_markers_for_insert (struct buffer *b, ptrdiff_t from,
+			     ptrdiff_t nchars, ptrdiff_t nbytes,
+			     bool before_markers)
+{
+  struct buffer_text *t = b->text;
+  struct Lisp_Marker **markers = t->markers;
+  ptrdiff_t gpt, gap = t->markers_gap_size, i, j, k;
+
+  move_marker_gap (t, from);
+
+  /* The markers at FROM are now just before the gap.  Put those that
+     stay in front, and move the others after the gap.  */
+  gpt = t->markers_gpt;
+  for (i = gpt; i > 0 && markers[i - 1]->charpos == from; i--)
+    continue;
+  j = i;
+  if (!before_markers)
+    for (k = i; k < gpt; k++)
+      if (!markers[k]->insertion_type)
+	{
+	  struct Lisp_Marker *m = markers[k];
+	  markers[k] = markers[j];
+	  markers[j++] = m;
+	}
+  while (gpt > j)
+    {
+      struct Lisp_Marker *m = markers[--gpt];
+      m->charpos -= t->markers_z;
+      m->bytepos -= t->markers_z_byte;
+      m->after_gap = true;
+      markers[gpt + gap] = m;
+    }
+  t->markers_gpt = gpt;
+
+  t->markers_z += nchars;
+  t->markers_z_byte += nbytes;
+}
+
+/* Adjust the markers of B for a replacement of the OLD_CHARS
+   characters (OLD_BYTES bytes) at FROM (FROM_BYTE) by NEW_CHARS
+   characters (NEW_BYTES bytes).  The markers inside the replaced text
+   are moved to FROM; those at its end or after it are shifted.  This
+   also handles deletions, with NEW_CHARS and NEW_BYTES zero.  */
+
+void
+relocate_markers_for_replace (struct buffer *b,
+			      ptrdiff_t from, ptrdiff_t from_byte,
+			      ptrdiff_t old_chars, ptrdiff_t old_bytes,
+			      ptrdiff_t new_chars, ptrdiff_t new_bytes)
+{
+  struct buffer_text *t = b->text;
+  struct Lisp_Marker **markers = t->markers;
+  ptrdiff_t gpt, end;
+
+  move_marker_gap (t, from);
+
+  gpt = t->markers_gpt;
+  end = gpt + t->markers_gap_size;
+  while (end < t->markers_size
+	 && markers[end]->charpos + t->markers_z < from + old_chars)
+    {
+      struct Lisp_Marker *m = markers[end++];
+      m->charpos = from;
+      m->bytepos = from_byte;
+      m->after_gap = false;
+      markers[gpt++] = m;
+    }
+  t->markers_gpt = gpt;
+
+  t->markers_z += new_chars - old_chars;
+  t->markers_z_byte += new_bytes - old_bytes;
+}
+
+/* Arrange for the markers of B between FROM and TO inclusive to be
+   just before the gap in its marker array, BUF_MARKERS (B), with
+   absolute positions, and return the index of the first of them.
+
+   This is for loops over the markers in a region, from that index to
+   BUF_MARKERS_GPT (B).  They can change the positions of the markers
+   directly, as long as they call reorder_markers afterwards and no
+   position goes outside of the region.  */
+
+ptrdiff_t
+select_markers (struct buffer *b, ptrdiff_t from, ptrdiff_t to)
+{
+  struct buffer_text *t = b->text;
+
+  move_marker_gap (t, to);
+  return bisect_markers (t->markers, 0, t->markers_gpt, from, false);
+}
+
+static int
+compare_marker_positions (void const *a, void const *b)
+{
+  struct Lisp_Marker const *m1 = *(struct Lisp_Marker *const *) a;
+  struct Lisp_Marker const *m2 = *(struct Lisp_Marker *const *) b;
+  return (m1->charpos > m2->charpos) - (m1->charpos < m2->charpos);
+}
+
+/* Sort again the markers of B from index START, as returned by
+   select_markers, to the gap, after their positions were changed.  */
+
+void
+reorder_markers (struct buffer *b, ptrdiff_t start)
+{
+  struct buffer_text *t = b->text;
+
+  if (start < t->markers_gpt)
+    qsort (t->markers + start, t->markers_gpt - start, sizeof *t->markers,
+	   compare_marker_positions);
+}
+
 /* Return the char position of marker MARKER, as a C integer.  */
 
 ptrdiff_t
@@ -729,9 +1308,10 @@ marker_position (Lisp_Object marker)
   if (!buf)
     error ("Marker does not point anywhere");
 
-  eassert (BUF_BEG (buf) <= m->charpos && m->charpos <= BUF_Z (buf));
+  ptrdiff_t charpos = marker_charpos (m);
+  eassert (BUF_BEG (buf) <= charpos && charpos <= BUF_Z (buf));
 
-  return m->charpos;
+  return charpos;
 }
 
 /* Return the byte position of marker MARKER, as a C integer.  */
@@ -745,9 +1325,10 @@ marker_byte_position (Lisp_Object marker)
   if (!buf)
     error ("Marker does not point anywhere");
 
-  eassert (BUF_BEG_BYTE (buf) <= m->bytepos && m->bytepos <= BUF_Z_BYTE (buf));
+  ptrdiff_t bytepos = marker_bytepos (m);
+  eassert (BUF_BEG_BYTE (buf) <= bytepos && bytepos <= BUF_Z_BYTE (buf));
 
-  return m->bytepos;
+  return bytepos;
 }
 
 DEFUN ("copy-marker", Fcopy_marker, Scopy_marker, 0, 2, 0,
@@ -800,8 +1381,7 @@ The list includes markers at BEG and at END.  */)
   (Lisp_Object beg, Lisp_Object end)
 {
   Lisp_Object res = Qnil;
-  struct Lisp_Marker *tail;
-  ptrdiff_t ibeg, iend;
+  ptrdiff_t ibeg, iend, i, start;
   if (NILP (beg))
     ibeg = BEGV;
   else
@@ -817,9 +1397,11 @@ The list includes markers at BEG and at END.  */)
       iend = clip_to_bounds (BEGV, XFIXNUM (end), ZV);
     }
 
-  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-    if (ibeg <= tail->charpos && tail->charpos <= iend)
-      res = Fcons (make_lisp_ptr (tail, Lisp_Vectorlike), res);
+  start = select_markers (current_buffer, ibeg, iend);
+  for (i = BUF_MARKERS_GPT (current_buffer); start < i; i--)
+    res = Fcons (make_lisp_ptr (BUF_MARKERS (current_buffer)[i - 1],
+				Lisp_Vectorlike),
+		 res);
 
   return res;
 }
@@ -831,13 +1413,7 @@ The list includes markers at BEG and at END.  */)
 int
 count_markers (struct buffer *buf)
 {
-  int total = 0;
-  struct Lisp_Marker *tail;
-
-  for (tail = BUF_MARKERS (buf); tail; tail = tail->next)
-    total++;
-
-  return total;
+  return buf->text->markers_size - buf->text->markers_gap_size;
 }
 
 /* For debugging -- recompute the bytepos corresponding
@@ -860,9 +1436,47 @@ verify_bytepos (ptrdiff_t charpos)
 
 #endif /* MARKER_DEBUG */
 
+/* Prepare the markers of all live buffers to be dumped.  */
+
+void
+collect_markers_for_dump (void)
+{
+  Lisp_Object tail, buffer;
+
+  dumped_markers = Qnil;
+  FOR_EACH_LIVE_BUFFER (tail, buffer)
+    {
+      struct buffer *b = XBUFFER (buffer);
+      if (!b->base_buffer)
+	for (ptrdiff_t i = select_markers (b, BEG, PTRDIFF_MAX);
+	     i < BUF_MARKERS_GPT (b); i++)
+	  dumped_markers = Fcons (make_lisp_ptr (BUF_MARKERS (b)[i],
+						 Lisp_Vectorlike),
+				  dumped_markers);
+    }
+}
+
+static void
+restore_markers_after_pdumper_load (void)
+{
+  for (Lisp_Object tail = dumped_markers; CONSP (tail); tail = XCDR (tail))
+    {
+      struct Lisp_Marker *m = XMARKER (XCAR (tail));
+      struct buffer *b = m->buffer;
+
+      m->buffer = NULL;
+      attach_marker (m, b, m->charpos, m->bytepos);
+    }
+  dumped_markers = Qnil;
+}
+
 void
 syms_of_marker (void)
 {
+  staticpro (&dumped_markers);
+  dumped_markers = Qnil;
+  pdumper_do_now_and_after_load (restore_markers_after_pdumper_load);
+
   defsubr (&Smarker_position);
   defsubr (&Smarker_last_position);
   defsubr (&Smarker_buffer);
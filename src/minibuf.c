@@ -912,6 +912,7 @@ read_minibuf (Lisp_Object map, Lisp_Object initial, Lisp_Object prompt,
 
   /* Don't allow the user to undo past this point.  */
   bset_undo_list (current_buffer, Qnil);
+  free_undo_log (current_buffer);
 
   recursive_edit_1 ();
 
@@ -2034,7 +2034,7 @@ dump_interval_tree (struct dump_context *ctx,
                     INTERVAL tree,
                     dump_off parent_offset)
 {
-#if CHECK_STRUCTS && !defined (HASH_interval_1B38941C37)
+#if CHECK_STRUCTS && !defined (HASH_interval_964BAF467C)
 # error "interval changed. See CHECK_STRUCTS comment in config.h."
 #endif
   /* TODO: output tree breadth-first?  */
@@ -2056,6 +2056,9 @@ dump_interval_tree (struct dump_context *ctx,
     dump_field_lv (ctx, &out, tree, &tree->up.obj, WEIGHT_STRONG);
   DUMP_FIELD_COPY (&out, tree, up_obj);
   eassert (tree->gcmarkbit == 0);
+  /* Don't dump summary_valid and uniform.  Leaving every summary
+     invalid is consistent, and the summaries are recomputed lazily
+     when first needed.  */
   DUMP_FIELD_COPY (&out, tree, write_protect);
   DUMP_FIELD_COPY (&out, tree, visible);
   DUMP_FIELD_COPY (&out, tree, front_sticky);
@@ -2124,7 +2127,7 @@ dump_string (struct dump_context *ctx, const struct Lisp_String *string)
 static dump_off
 dump_marker (struct dump_context *ctx, const struct Lisp_Marker *marker)
 {
-#if CHECK_STRUCTS && !defined (HASH_Lisp_Marker_642DBAF866)
+#if CHECK_STRUCTS && !defined (HASH_Lisp_Marker_0F392BEF8D)
 # error "Lisp_Marker changed. See CHECK_STRUCTS comment in config.h."
 #endif
 
@@ -2134,10 +2137,11 @@ dump_marker (struct dump_context *ctx, const struct Lisp_Marker *marker)
   DUMP_FIELD_COPY (out, marker, insertion_type);
   if (marker->buffer)
     {
+      /* The markers of live buffers are made to record absolute
+	 positions by collect_markers_for_dump.  */
+      eassert (!marker->after_gap);
       dump_field_lv_rawptr (ctx, out, marker, &marker->buffer,
 			    Lisp_Vectorlike, WEIGHT_NORMAL);
-      dump_field_lv_rawptr (ctx, out, marker, &marker->next,
-			    Lisp_Vectorlike, WEIGHT_STRONG);
       DUMP_FIELD_COPY (out, marker, charpos);
       DUMP_FIELD_COPY (out, marker, bytepos);
     }
@@ -2745,7 +2749,7 @@ dump_obarray (struct dump_context *ctx, Lisp_Object object)
 static dump_off
 dump_buffer (struct dump_context *ctx, const struct buffer *in_buffer)
 {
-#if CHECK_STRUCTS && !defined HASH_buffer_418DFE6359
+#if CHECK_STRUCTS && !defined HASH_buffer_84382AC28A
 # error "buffer changed. See CHECK_STRUCTS comment in config.h."
 #endif
   struct buffer munged_buffer = *in_buffer;
@@ -2811,8 +2815,18 @@ dump_buffer (struct dump_context *ctx, const struct buffer *in_buffer)
       DUMP_FIELD_COPY (out, buffer, own_text.overlay_unchanged_modified);
       if (buffer->own_text.intervals)
         dump_field_fixup_later (ctx, out, buffer, &buffer->own_text.intervals);
-      dump_field_lv_rawptr (ctx, out, buffer, &buffer->own_text.markers,
-                            Lisp_Vectorlike, WEIGHT_NORMAL);
+      /* The marker array is rebuilt when the dump is loaded, see
+	 collect_markers_for_dump.  */
+      out->own_text.markers = NULL;
+      out->own_text.markers_gpt = 0;
+      out->own_text.markers_gap_size = 0;
+      out->own_text.markers_size = 0;
+      DUMP_FIELD_COPY (out, buffer, own_text.markers_z);
+      DUMP_FIELD_COPY (out, buffer, own_text.markers_z_byte);
+      out->own_text.pos_index = NULL;
+      out->own_text.undo_log = NULL;
+      out->own_text.mapped_size = 0;
+      out->own_text.sharing = NULL;
       DUMP_FIELD_COPY (out, buffer, own_text.inhibit_shrinking);
       DUMP_FIELD_COPY (out, buffer, own_text.redisplay);
     }
@@ -2854,6 +2868,7 @@ dump_buffer (struct dump_context *ctx, const struct buffer *in_buffer)
   out->newline_cache = NULL;
   out->width_run_cache = NULL;
   out->bidi_paragraph_cache = NULL;
+  out->line_index = NULL;
 
   DUMP_FIELD_COPY (out, buffer, prevent_redisplay_optimizations_p);
   DUMP_FIELD_COPY (out, buffer, clip_changed);
@@ -4102,6 +4117,8 @@ types.  */)
     }
   while (number_finalizers_run);
 
+  collect_markers_for_dump ();
+
   specpdl_ref count = SPECPDL_INDEX ();
 
   /* Bind `command-line-processed' to nil before dumping,
@@ -135,6 +135,22 @@ static struct rlimit nofile_limit;
 #endif
 #endif
 
+/* GLib, NS and Android wait for their own descriptors along with
+   those of Emacs, so the main thread can only wait with epoll when
+   none of them is used.  */
+#if (defined subprocesses && defined GNU_LINUX && !defined HAVE_GLIB \
+     && !defined HAVE_NS && !defined HAVE_ANDROID)
+# define USE_EPOLL
+# include <sys/epoll.h>
+#endif
+
+/* Process output can be read straight into the gap of the process
+   buffer when it is known how much of it is ready; see
+   read_process_output_to_gap.  */
+#if defined subprocesses && defined USABLE_FIONREAD && !defined WINDOWSNT
+# define READ_OUTPUT_TO_GAP
+#endif
+
 #if defined HAVE_GETADDRINFO_A || defined HAVE_GNUTLS
 /* This is 0.1s in nanoseconds. */
 #define ASYNC_RETRY_NSEC 100000000
@@ -476,6 +492,23 @@ clear_fd_callback_data (struct fd_callback_data* elem)
   elem->waiting_thread = NULL;
 }
 
+#ifdef USE_EPOLL
+static void epoll_forget (int);
+#endif
+
+/* Note that FD is about to be monitored.  If it was not, it may be a
+   new descriptor that reuses the number of one that was closed before
+   being deleted, which epoll must then forget.  */
+
+static void
+new_monitored_fd (int fd)
+{
+#ifdef USE_EPOLL
+  if (fd_callback_info[fd].flags == 0)
+    epoll_forget (fd);
+#endif
+}
+
 /* If FD is out of range, close it and return -1, setting errno to
    EMFILE.  Otherwise, return FD.  This module routinely does this for
    file descriptors so that fd_set-based primitives work even on
@@ -540,6 +573,7 @@ add_process_read_fd (int fd)
   eassert (fd >= 0 && fd < FD_SETSIZE);
   eassert (fd_callback_info[fd].func == NULL);
 
+  new_monitored_fd (fd);
   fd_callback_info[fd].flags &= ~KEYBOARD_FD;
   fd_callback_info[fd].flags |= FOR_READ;
   if (fd > max_desc)
@@ -564,6 +598,7 @@ add_write_fd (int fd, fd_callback func, void *data)
 {
   eassert (fd >= 0 && fd < FD_SETSIZE);
 
+  new_monitored_fd (fd);
   fd_callback_info[fd].func = func;
   fd_callback_info[fd].data = data;
   fd_callback_info[fd].flags |= FOR_WRITE;
@@ -577,6 +612,7 @@ add_non_blocking_write_fd (int fd)
   eassert (fd >= 0 && fd < FD_SETSIZE);
   eassert (fd_callback_info[fd].func == NULL);
 
+  new_monitored_fd (fd);
   fd_callback_info[fd].flags |= FOR_WRITE | NON_BLOCKING_CONNECT_FD;
   if (fd > max_desc)
     max_desc = fd;
@@ -615,6 +651,9 @@ delete_write_fd (int fd)
   if (fd_callback_info[fd].flags == 0)
     {
       clear_fd_callback_data (&fd_callback_info[fd]);
+#ifdef USE_EPOLL
+      epoll_forget (fd);
+#endif
 
       if (fd == max_desc)
 	recompute_max_desc ();
@@ -744,6 +783,278 @@ kbd_is_ours (void)
   return false;
 }
 
+#ifdef USE_EPOLL
+
+/* Waiting with epoll.
+
+   When process-use-epoll is non-nil, the main thread waits for its
+   descriptors with epoll rather than pselect.  The epoll instance
+   keeps watching the descriptors between waits, and epoll_sync only
+   changes those that were added to or removed from the masks since
+   the last wait, so that the kernel does not have to look again at
+   every descriptor each time Emacs waits.  Descriptors are forgotten
+   when they are deleted, as they are then about to be closed, and
+   another descriptor with the same number could be watched later.  */
+
+/* The epoll instance, or -1 if it has not been made yet, or -2 if
+   it could not be made.  */
+static int epoll_fd = -1;
+
+/* The descriptors watched by epoll_fd for reading and for writing,
+   and the descriptors that epoll cannot watch, such as regular files,
+   which are always ready.  */
+static fd_set epoll_read_set, epoll_write_set, epoll_always_set;
+
+/* One more than the largest descriptor in these sets, and the number
+   of descriptors in them.  */
+static int epoll_nfds, epoll_count;
+
+/* Whether some descriptors in epoll_always_set are being waited for.  */
+static bool epoll_always_ready;
+
+/* Whether epoll_fd has reported events for descriptors that were not
+   waited for.  This happens when a descriptor was closed before being
+   deleted while another process still had a copy of it, since epoll
+   then keeps watching the copy, and the instance must be made again.  */
+static bool epoll_stale;
+
+/* Stop watching FD with epoll.  */
+
+static void
+epoll_forget (int fd)
+{
+  bool watched = (FD_ISSET (fd, &epoll_read_set)
+		  || FD_ISSET (fd, &epoll_write_set));
+  if (watched)
+    epoll_ctl (epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+  if (watched || FD_ISSET (fd, &epoll_always_set))
+    epoll_count--;
+  FD_CLR (fd, &epoll_read_set);
+  FD_CLR (fd, &epoll_write_set);
+  FD_CLR (fd, &epoll_always_set);
+}
+
+/* Make epoll watch FD for reading if READ, and for writing if WRITE.
+   Return false if this fails.  */
+
+static bool
+epoll_watch (int fd, bool read, bool write)
+{
+  bool watched_read = FD_ISSET (fd, &epoll_read_set);
+  bool watched_write = FD_ISSET (fd, &epoll_write_set);
+
+  if (FD_ISSET (fd, &epoll_always_set))
+    {
+      if (read || write)
+	epoll_always_ready = true;
+      else
+	{
+	  FD_CLR (fd, &epoll_always_set);
+	  epoll_count--;
+	}
+      return true;
+    }
+  if (read == watched_read && write == watched_write)
+    return true;
+
+  struct epoll_event event;
+  event.events = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+  event.data.fd = fd;
+  int op = (!watched_read && !watched_write ? EPOLL_CTL_ADD
+	    : read || write ? EPOLL_CTL_MOD
+	    : EPOLL_CTL_DEL);
+  int err = epoll_ctl (epoll_fd, op, fd, &event);
+
+  /* FD may have been closed and reopened behind our back, in which
+     case epoll has already forgotten it, or not yet if the same file
+     was opened again.  */
+  if (err != 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+    err = epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  else if (err != 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+    err = epoll_ctl (epoll_fd, EPOLL_CTL_MOD, fd, &event);
+  if (err != 0)
+    {
+      if (errno == EPERM)
+	{
+	  FD_SET (fd, &epoll_always_set);
+	  epoll_always_ready = true;
+	}
+      else if (! (op == EPOLL_CTL_DEL && (errno == ENOENT || errno == EBADF)))
+	return false;
+    }
+
+  if (op == EPOLL_CTL_ADD)
+    epoll_count++;
+  else if (op == EPOLL_CTL_DEL)
+    epoll_count--;
+  if (read && !FD_ISSET (fd, &epoll_always_set))
+    FD_SET (fd, &epoll_read_set);
+  else
+    FD_CLR (fd, &epoll_read_set);
+  if (write && !FD_ISSET (fd, &epoll_always_set))
+    FD_SET (fd, &epoll_write_set);
+  else
+    FD_CLR (fd, &epoll_write_set);
+  return true;
+}
+
+/* Make epoll watch the descriptors below NFDS that are in RFDS for
+   reading, and those in WFDS, unless it is NULL, for writing, and
+   only those.  Return false if pselect should be used instead, either
+   because epoll cannot be used, or because the wait is for only a few
+   of the descriptors already watched, as when waiting for the output
+   of a single process; pselect is cheap then, and leaving the others
+   watched saves watching them again after the wait.  */
+
+static bool
+epoll_sync (int nfds, fd_set *rfds, fd_set *wfds)
+{
+  if (epoll_stale)
+    {
+      emacs_close (epoll_fd);
+      epoll_fd = -1;
+      FD_ZERO (&epoll_read_set);
+      FD_ZERO (&epoll_write_set);
+      FD_ZERO (&epoll_always_set);
+      epoll_nfds = epoll_count = 0;
+      epoll_stale = false;
+    }
+  if (epoll_fd == -1)
+    {
+      epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+      if (epoll_fd < 0)
+	epoll_fd = -2;
+    }
+  if (epoll_fd < 0)
+    return false;
+
+  int wanted = 0;
+  for (int fd = 0; fd < nfds; fd++)
+    if (FD_ISSET (fd, rfds) || (wfds && FD_ISSET (fd, wfds)))
+      wanted++;
+  if (wanted * 2 < epoll_count)
+    return false;
+
+  int limit = max (nfds, epoll_nfds);
+  epoll_nfds = 0;
+  epoll_always_ready = false;
+  for (int fd = 0; fd < limit; fd++)
+    {
+      bool read = fd < nfds && FD_ISSET (fd, rfds);
+      bool write = fd < nfds && wfds && FD_ISSET (fd, wfds);
+      if (!epoll_watch (fd, read, write))
+	{
+	  /* Leave the sets as they are; they are fixed by the next
+	     call.  */
+	  epoll_nfds = limit;
+	  return false;
+	}
+      if (read || write)
+	epoll_nfds = fd + 1;
+    }
+  return true;
+}
+
+/* A replacement for pselect that waits with epoll for the descriptors
+   in RFDS and WFDS, which epoll_sync has made it watch.  EFDS must be
+   NULL.  This is called without the global lock.  */
+
+static int
+epoll_pselect (int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds,
+	       const struct timespec *timeout, const sigset_t *sigmask)
+{
+  static struct epoll_event events[FD_SETSIZE];
+  fd_set read_wanted, write_wanted;
+  int ms = -1, ready = 0;
+
+  eassert (!efds);
+  read_wanted = *rfds;
+  if (wfds)
+    write_wanted = *wfds;
+  else
+    FD_ZERO (&write_wanted);
+
+  /* Round the timeout up to milliseconds, so as not to wake up
+     before it is reached.  */
+  if (epoll_always_ready)
+    ms = 0;
+  else if (timeout)
+    ms = (timeout->tv_sec < INT_MAX / 1000 - 1
+	  ? (timeout->tv_sec * 1000
+	     + (timeout->tv_nsec + 999999) / 1000000)
+	  : INT_MAX);
+
+  int n = epoll_pwait (epoll_fd, events, FD_SETSIZE, ms, sigmask);
+  if (n < 0)
+    return n;
+
+  FD_ZERO (rfds);
+  if (wfds)
+    FD_ZERO (wfds);
+  for (int i = 0; i < n; i++)
+    {
+      int fd = events[i].data.fd;
+      uint32_t e = events[i].events;
+
+      /* Report errors and hangups as pselect does, by saying the
+	 descriptor can be read or written.  */
+      if (e & (EPOLLIN | EPOLLERR | EPOLLHUP)
+	  && FD_ISSET (fd, &read_wanted))
+	{
+	  FD_SET (fd, rfds);
+	  ready++;
+	}
+      if (e & (EPOLLOUT | EPOLLERR | EPOLLHUP)
+	  && FD_ISSET (fd, &write_wanted))
+	{
+	  FD_SET (fd, wfds);
+	  ready++;
+	}
+    }
+  if (n > 0 && ready == 0 && !epoll_always_ready)
+    {
+      /* Have the caller wait again once epoll_fd has been made
+	 again.  */
+      epoll_stale = true;
+      errno = EINTR;
+      return -1;
+    }
+
+  if (epoll_always_ready)
+    for (int fd = 0; fd < nfds; fd++)
+      if (FD_ISSET (fd, &epoll_always_set))
+	{
+	  if (FD_ISSET (fd, &read_wanted))
+	    {
+	      FD_SET (fd, rfds);
+	      ready++;
+	    }
+	  if (FD_ISSET (fd, &write_wanted))
+	    {
+	      FD_SET (fd, wfds);
+	      ready++;
+	    }
+	}
+
+  return ready;
+}
+
+/* Return the function with which to wait for the descriptors below
+   NFDS in RFDS and WFDS.  */
+
+static select_func *
+process_select_func (int nfds, fd_set *rfds, fd_set *wfds)
+{
+  if (process_use_epoll && main_thread_p (current_thread)
+      && epoll_sync (nfds, rfds, wfds))
+    return epoll_pselect;
+  return pselect;
+}
+
+#else  /* !USE_EPOLL */
+# define process_select_func(nfds, rfds, wfds) pselect
+#endif	/* !USE_EPOLL */
+
 
 /* Compute the Lisp form of the process status, p->status, from
    the numeric status that was returned by `wait'.  */
@@ -5558,10 +5869,10 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
 	  if (0 <= fd)
 	    FD_CLR (fd, &Atemp);
 
+	  fd_set *Cp = num_pending_connects > 0 ? &Ctemp : NULL;
 	  timeout = make_timespec (0, 0);
-	  if ((thread_select (pselect, max_desc + 1,
-			      &Atemp,
-			      (num_pending_connects > 0 ? &Ctemp : NULL),
+	  if ((thread_select (process_select_func (max_desc + 1, &Atemp, Cp),
+			      max_desc + 1, &Atemp, Cp,
 			      NULL, &timeout, NULL)
 	       <= 0))
 	    {
@@ -5822,9 +6133,11 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
 			    &Available, (check_write ? &Writeok : 0),
 			    NULL, &timeout, NULL);
 #else  /* !HAVE_GLIB */
-	  nfds = thread_select (pselect, max_desc + 1,
-				&Available,
-				(check_write ? &Writeok : 0),
+	  nfds = thread_select (process_select_func (max_desc + 1, &Available,
+						     (check_write
+						      ? &Writeok : 0)),
+				max_desc + 1,
+				&Available, (check_write ? &Writeok : 0),
 				NULL, &timeout, NULL);
 #endif	/* !HAVE_GLIB */
 #endif /* HAVE_ANDROID && !ANDROID_STUBIFY */
@@ -6230,14 +6543,45 @@ read_process_output_error_handler (Lisp_Object error_val)
   return Qt;
 }
 
-static void read_and_dispose_of_process_output (struct Lisp_Process *, char *,
-						ssize_t,
-						struct coding_system *);
+static ssize_t read_and_dispose_of_process_output (struct Lisp_Process *,
+						   char *, ssize_t,
+						   struct coding_system *);
 
 static void read_and_insert_process_output (struct Lisp_Process *, char *,
 					    ssize_t,
 					    struct coding_system *);
 
+/* Adjust the delay before reading output from P again, after NBYTES
+   were read when up to WANTED could have been.  */
+
+static void
+adapt_read_output_delay (struct Lisp_Process *p, ssize_t nbytes,
+			 ptrdiff_t wanted)
+{
+  int delay = p->read_output_delay;
+  if (nbytes < 256)
+    {
+      if (delay < READ_OUTPUT_DELAY_MAX_MAX)
+	{
+	  if (delay == 0)
+	    process_output_delay_count++;
+	  delay += READ_OUTPUT_DELAY_INCREMENT * 2;
+	}
+    }
+  else if (delay > 0 && nbytes == wanted)
+    {
+      delay -= READ_OUTPUT_DELAY_INCREMENT;
+      if (delay == 0)
+	process_output_delay_count--;
+    }
+  p->read_output_delay = delay;
+  if (delay)
+    {
+      p->read_output_skip = 1;
+      process_output_skip = 1;
+    }
+}
+
 /* Read pending output from the process channel,
    starting with our buffered-ahead character if we have one.
    Yield number of decoded characters read,
@@ -6263,6 +6607,38 @@ read_process_output (Lisp_Object proc, int channel)
   Lisp_Object odeactivate;
   char *chars;
 
+#ifdef READ_OUTPUT_TO_GAP
+  /* If the output is to be inserted into the process buffer, and
+     some is ready, read it straight into the gap; this saves copying
+     it.  Otherwise read it into CHARS, which also takes care of the
+     end of the output.  */
+  int ready;
+  if (fast_read_process_output
+      && EQ (p->filter, Qinternal_default_process_filter)
+      && BUFFERP (p->buffer) && BUFFER_LIVE_P (XBUFFER (p->buffer))
+      && (!NILP (BVAR (XBUFFER (p->buffer), enable_multibyte_characters))
+	  || !CODING_MAY_REQUIRE_DECODING (coding))
+      && channel == p->infd
+      && proc_buffered_char[channel] < 0
+#ifdef DATAGRAM_SOCKETS
+      && !DATAGRAM_CHAN_P (channel)
+#endif
+#ifdef HAVE_GNUTLS
+      && !p->gnutls_p
+#endif
+      && ioctl (channel, FIONREAD, &ready) == 0 && 0 < ready)
+    {
+      odeactivate = Vdeactivate_mark;
+      record_unwind_current_buffer ();
+      nbytes = read_and_dispose_of_process_output (p, NULL,
+						   min (ready, readmax),
+						   coding);
+      Vdeactivate_mark = odeactivate;
+      unbind_to (count, Qnil);
+      return nbytes;
+    }
+#endif
+
   USE_SAFE_ALLOCA;
   chars = SAFE_ALLOCA (sizeof coding->carryover + readmax);
 
@@ -6298,30 +6674,7 @@ read_process_output (Lisp_Object proc, int channel)
 	nbytes = emacs_read (channel, chars + carryover + buffered,
 			     readmax - buffered);
       if (nbytes > 0 && p->adaptive_read_buffering)
-	{
-	  int delay = p->read_output_delay;
-	  if (nbytes < 256)
-	    {
-	      if (delay < READ_OUTPUT_DELAY_MAX_MAX)
-		{
-		  if (delay == 0)
-		    process_output_delay_count++;
-		  delay += READ_OUTPUT_DELAY_INCREMENT * 2;
-		}
-	    }
-	  else if (delay > 0 && nbytes == readmax - buffered)
-	    {
-	      delay -= READ_OUTPUT_DELAY_INCREMENT;
-	      if (delay == 0)
-		process_output_delay_count--;
-	    }
-	  p->read_output_delay = delay;
-	  if (delay)
-	    {
-	      p->read_output_skip = 1;
-	      process_output_skip = 1;
-	    }
-	}
+	adapt_read_output_delay (p, nbytes, readmax - buffered);
       nbytes += buffered;
       nbytes += buffered && nbytes <= 0;
     }
@@ -6532,7 +6885,106 @@ read_and_insert_process_output (struct Lisp_Process *p, char *buf,
 				    before, before_byte, opoint, opoint_byte);
 }
 
-static void
+#ifdef READ_OUTPUT_TO_GAP
+
+/* Read NBYTES of output of P, which must be ready, straight into the
+   gap of its buffer, and decode them there with PROCESS_CODING, along
+   with the bytes carried over from the previous output.  Return the
+   number of bytes decoded, or -1 (setting errno) if reading fails.
+
+   This does what read_process_output and read_and_insert_process_output
+   do, without copying the output from a separate array.  The
+   modification hooks are run before reading, so that they cannot move
+   the gap under the output; that is why NBYTES must be ready.  */
+
+static ssize_t
+read_process_output_to_gap (struct Lisp_Process *p, ssize_t nbytes,
+			    struct coding_system *process_coding)
+{
+  int carryover = p->decoding_carryover;
+  Lisp_Object old_read_only;
+  ptrdiff_t old_begv, old_zv;
+  ptrdiff_t before, before_byte;
+  ptrdiff_t opoint, opoint_byte;
+  ptrdiff_t chars, bytes;
+
+  read_process_output_before_insert (p, &old_read_only, &old_begv, &old_zv,
+				     &before, &before_byte, &opoint,
+				     &opoint_byte);
+  prepare_to_modify_buffer (PT, PT, NULL);
+
+  if (GPT != PT)
+    move_gap_both (PT, PT_BYTE);
+  if (GAP_SIZE < carryover + nbytes)
+    make_gap (carryover + nbytes - GAP_SIZE);
+
+  /* The output must end at the end of the gap, for decode_coding_gap
+     and insert_from_gap.  It is read there, and moved if fewer bytes
+     came, which only happens if someone else read some.  */
+  unsigned char *output = GAP_END_ADDR - nbytes;
+  if (carryover)
+    memcpy (output - carryover, SDATA (p->decoding_buf), carryover);
+  ssize_t nread = emacs_read (p->infd, output, nbytes);
+  if (nread <= 0)
+    {
+      int err = nread < 0 ? errno : EAGAIN;
+      signal_after_change (PT, 0, 0);
+      read_process_output_after_insert (p, &old_read_only, old_begv, old_zv,
+					before, before_byte,
+					opoint, opoint_byte);
+      errno = err;
+      return -1;
+    }
+  if (p->adaptive_read_buffering)
+    adapt_read_output_delay (p, nread, nbytes);
+  if (nread < nbytes)
+    memmove (GAP_END_ADDR - carryover - nread, output - carryover,
+	     carryover + nread);
+  p->decoding_carryover = 0;
+  p->nbytes_read += nread;
+  bytes = carryover + nread;
+
+  if (NILP (BVAR (current_buffer, enable_multibyte_characters))
+      && ! CODING_MAY_REQUIRE_DECODING (process_coding))
+    {
+      /* Insert before markers, like read_and_insert_process_output.  */
+      insert_from_gap (bytes, bytes, true, true);
+      chars = bytes;
+    }
+  else
+    {
+      specpdl_ref count = SPECPDL_INDEX ();
+
+      /* See read_and_insert_process_output.  */
+      process_coding->insert_before_markers = true;
+      process_coding->dst_multibyte
+	= !NILP (BVAR (current_buffer, enable_multibyte_characters));
+      specbind (Qinhibit_modification_hooks, Qt);
+      decode_coding_gap (process_coding, bytes);
+      unbind_to (count, Qnil);
+
+      read_process_output_set_last_coding_system (p, process_coding);
+      chars = process_coding->produced_char;
+      bytes = process_coding->produced;
+    }
+
+  TEMP_SET_PT_BOTH (PT + chars, PT_BYTE + bytes);
+  signal_after_change (PT - chars, 0, chars);
+
+  read_process_output_after_insert (p, &old_read_only, old_begv, old_zv,
+				    before, before_byte, opoint, opoint_byte);
+  return carryover + nread;
+}
+
+#endif	/* READ_OUTPUT_TO_GAP */
+
+/* Dispose of the NBYTES of output of P in CHARS, decoding them with
+   CODING, and return NBYTES.  If CHARS is null, P has the default
+   filter, and NBYTES of output are ready to be read into its buffer
+   by read_process_output_to_gap; return the number of bytes decoded
+   then, or -1 (setting errno) if reading fails.  */
+
+static ssize_t
 read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
 				    ssize_t nbytes,
 				    struct coding_system *coding)
@@ -6571,6 +7023,11 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
      save the match data in a special nonrecursive fashion.  */
   running_asynch_code = 1;
 
+#ifdef READ_OUTPUT_TO_GAP
+  if (!chars)
+    nbytes = read_process_output_to_gap (p, nbytes, coding);
+  else
+#endif
   if (fast_read_process_output
       && EQ (p->filter, Qinternal_default_process_filter))
     read_and_insert_process_output (p, chars, nbytes, coding);
@@ -6599,6 +7056,7 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
   /* Restore waiting_for_user_input_p as it was
      when we were called, in case the filter clobbered it.  */
   waiting_for_user_input_p = waiting;
+  return nbytes;
 }
 
 DEFUN ("internal-default-process-filter", Finternal_default_process_filter,
@@ -8358,6 +8816,7 @@ add_keyboard_wait_descriptor (int desc)
 {
 #ifdef subprocesses /* Actually means "not MSDOS".  */
   eassert (desc >= 0 && desc < FD_SETSIZE);
+  new_monitored_fd (desc);
   fd_callback_info[desc].flags &= ~PROCESS_FD;
   fd_callback_info[desc].flags |= (FOR_READ | KEYBOARD_FD);
   if (desc > max_desc)
@@ -8374,6 +8833,9 @@ delete_keyboard_wait_descriptor (int desc)
   eassert (desc >= 0 && desc < FD_SETSIZE);
 
   clear_fd_callback_data (&fd_callback_info[desc]);
+#ifdef USE_EPOLL
+  epoll_forget (desc);
+#endif
 
   if (desc == max_desc)
     recompute_max_desc ();
@@ -8962,6 +9424,15 @@ non-nil, Emacs will always restart the loop from the first file descriptor,
 thus favoring processes with lower descriptors.  */);
   process_prioritize_lower_fds = 0;
 
+  DEFVAR_BOOL ("process-use-epoll", process_use_epoll,
+	       doc: /* Whether to wait for subprocess output with epoll.
+If non-nil, Emacs waits for output from subprocesses and network
+connections with epoll rather than `pselect', which scales better when
+there are many of them, as the kernel then only looks at the ones that
+changed.  This has no effect except on GNU/Linux, in builds that do not
+use GLib, nor when waiting in Lisp threads other than the main one.  */);
+  process_use_epoll = true;
+
   DEFVAR_LISP ("interrupt-process-functions", Vinterrupt_process_functions,
 	       doc: /* List of functions to be called for `interrupt-process'.
 The arguments of the functions are the same as for `interrupt-process'.
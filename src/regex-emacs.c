@@ -193,6 +193,10 @@ static ptrdiff_t re_match_2_internal (struct re_pattern_buffer *bufp,
 				     ptrdiff_t pos,
 				     struct re_registers *regs,
 				     ptrdiff_t stop);
+static bool linear_match_ok (struct re_pattern_buffer *, ptrdiff_t *);
+static ptrdiff_t re_match_linear (struct re_pattern_buffer *,
+				  re_char *, ptrdiff_t, re_char *, ptrdiff_t,
+				  ptrdiff_t, struct re_registers *, ptrdiff_t);
 
 /* These are the command codes that appear in compiled regular
    expressions.  Some opcodes are followed by argument bytes.  A
@@ -892,6 +896,11 @@ enum { RE_NREGS = 30 };
    with the process stack limit.  */
 ptrdiff_t emacs_re_max_failures = 40000;
 
+/* The number of times re_match_2_internal may backtrack at a single
+   starting position before handing the match over to re_match_linear,
+   for patterns that it can handle.  */
+#define RE_MAX_BACKTRACKS (1 << 20)
+
 union fail_stack_elt
 {
   re_char *pointer;
@@ -984,9 +993,8 @@ typedef struct
 while (REMAINING_AVAIL_SLOTS <= space) {				\
   if (!GROW_FAIL_STACK (fail_stack))					\
     {									\
-      unbind_to (count, Qnil);						\
-      SAFE_FREE ();							\
-      return -2;							\
+      retval = -2;							\
+      goto endof_re_match;						\
     }									\
   DEBUG_PRINT ("\n  Doubled stack; size now: %td\n", fail_stack.size);	\
   DEBUG_PRINT ("	 slots available: %td\n", REMAINING_AVAIL_SLOTS);\
@@ -1791,6 +1799,7 @@ regex_compile (re_char *pattern, ptrdiff_t size,
   /* Initialize the pattern buffer.  */
   bufp->fastmap_accurate = false;
   bufp->used_syntax = false;
+  bufp->match_linear = false;
 
   /* Set 'used' to zero, so that if we return an error, the pattern
      printer (for debugging) will think there's no pattern.  We reset it
@@ -3424,6 +3433,8 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, ptrdiff_t size1,
   if (startpos < 0 || startpos > total_size)
     return -1;
 
+  bufp->match_linear = false;
+
   /* Fix up RANGE if it might eventually take us outside
      the virtual concatenation of STRING1 and STRING2.
      Make sure we won't move STARTPOS below 0 or above TOTAL_SIZE.  */
@@ -4052,12 +4063,46 @@ re_match_2 (struct re_pattern_buffer *bufp,
 
   RE_SETUP_SYNTAX_TABLE_FOR_OBJECT (re_match_object, pos);
 
+  bufp->match_linear = false;
   result = re_match_2_internal (bufp, (re_char *) string1, size1,
 				(re_char *) string2, size2,
 				pos, regs, stop);
   return result;
 }
 
+/* Make sure REGS has room for NUM_REGS registers, as BUFP's
+   'regs_allocated' says.  */
+
+static void
+allocate_registers (struct re_pattern_buffer *bufp,
+		    struct re_registers *regs, ptrdiff_t num_regs)
+{
+  /* Have the register data arrays been allocated?	*/
+  if (bufp->regs_allocated == REGS_UNALLOCATED)
+    { /* No.  So allocate them with malloc.  */
+      ptrdiff_t n = max (RE_NREGS, num_regs);
+      regs->start = xnmalloc (n, sizeof *regs->start);
+      regs->end = xnmalloc (n, sizeof *regs->end);
+      regs->num_regs = n;
+      bufp->regs_allocated = REGS_REALLOCATE;
+    }
+  else if (bufp->regs_allocated == REGS_REALLOCATE)
+    { /* Yes.  If we need more elements than were already
+	 allocated, reallocate them.  If we need fewer, just
+	 leave it alone.  */
+      ptrdiff_t n = regs->num_regs;
+      if (n < num_regs)
+	{
+	  n = max (n + (n >> 1), num_regs);
+	  regs->start = xnrealloc (regs->start, n, sizeof *regs->start);
+	  regs->end = xnrealloc (regs->end, n, sizeof *regs->end);
+	  regs->num_regs = n;
+	}
+    }
+  else
+    eassert (bufp->regs_allocated == REGS_FIXED);
+}
+
 static void
 unwind_re_match (void *ptr)
 {
@@ -4077,6 +4122,10 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
   eassume (0 <= size2);
   eassume (0 <= pos && pos <= stop && stop <= size1 + size2);
 
+  if (bufp->match_linear)
+    return re_match_linear (bufp, string1, size1, string2, size2,
+			    pos, regs, stop);
+
   /* General temporaries.  */
   int mcnt;
 
@@ -4155,6 +4204,9 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
   /* This keeps track of how many buffer/string positions we examined.  */
   ptrdiff_t nchars = 0;
 
+  /* How many times we have backtracked.  */
+  ptrdiff_t nbacktracks = 0;
+
   /* Final return value of the function.  */
   ptrdiff_t retval = -1;        /* Presumes failure to match for now.  */
 
@@ -4349,31 +4401,7 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
 	  /* If caller wants register contents data back, do it.  */
 	  if (regs)
 	    {
-	      /* Have the register data arrays been allocated?	*/
-	      if (bufp->regs_allocated == REGS_UNALLOCATED)
-		{ /* No.  So allocate them with malloc.  */
-		  ptrdiff_t n = max (RE_NREGS, num_regs);
-		  regs->start = xnmalloc (n, sizeof *regs->start);
-		  regs->end = xnmalloc (n, sizeof *regs->end);
-		  regs->num_regs = n;
-		  bufp->regs_allocated = REGS_REALLOCATE;
-		}
-	      else if (bufp->regs_allocated == REGS_REALLOCATE)
-		{ /* Yes.  If we need more elements than were already
-		     allocated, reallocate them.  If we need fewer, just
-		     leave it alone.  */
-		  ptrdiff_t n = regs->num_regs;
-		  if (n < num_regs)
-		    {
-		      n = max (n + (n >> 1), num_regs);
-		      regs->start
-			= xnrealloc (regs->start, n, sizeof *regs->start);
-		      regs->end = xnrealloc (regs->end, n, sizeof *regs->end);
-		      regs->num_regs = n;
-		    }
-		}
-	      else
-		eassert (bufp->regs_allocated == REGS_FIXED);
+	      allocate_registers (bufp, regs, num_regs);
 
 	      /* Convert the pointer data in 'regstart' and 'regend' to
 		 indices.  Register zero has to be set differently,
@@ -5233,6 +5261,13 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
     /* We goto here if a matching operation fails. */
     fail:
       maybe_quit ();
+      if (++nbacktracks == RE_MAX_BACKTRACKS && linear_match_ok (bufp, NULL))
+	{
+	  /* This looks like catastrophic backtracking; let
+	     re_match_linear redo the match.  */
+	  retval = -2;
+	  goto endof_re_match;
+	}
       if (!FAIL_STACK_EMPTY ())
 	{
 	  re_char *str, *pat;
@@ -5281,6 +5316,15 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
   unbind_to (count, Qnil);
   SAFE_FREE ();
 
+  /* If backtracking ran out of failure stack or time, fall back on
+     the linear-time matcher when the pattern allows it.  */
+  if (retval == -2 && linear_match_ok (bufp, NULL))
+    {
+      bufp->match_linear = true;
+      return re_match_linear (bufp, string1, size1, string2, size2,
+			      pos, regs, stop);
+    }
+
   /* The factor of 50 below is a heuristic that needs to be tuned.
      It means we consider 50 buffer positions examined by this function
      roughly equivalent to the display engine iterating over a single
@@ -5291,6 +5335,688 @@ re_match_2_internal (struct re_pattern_buffer *bufp,
   return retval;
 }
 
+/* Linear-time matching.
+
+   When backtracking overflows the failure stack, or needs more than
+   RE_MAX_BACKTRACKS failures at a single starting position,
+   re_match_2_internal hands the match over to re_match_linear.  It
+   simulates the compiled pattern as a nondeterministic automaton in
+   the manner of Pike's VM: a list of threads, each a pattern offset
+   with its own registers, advances through the text one character
+   at a time.  The list is kept in the order in which backtracking
+   would try the alternatives, so the match found is the one
+   backtracking would have found; and since a pattern offset is
+   entered at most once per text position, the time needed is
+   proportional to the size of the pattern times the length of the
+   text, and no failure stack is needed.
+
+   Back-references cannot be simulated this way, nor can the counted
+   repetitions that rewrite their counters inside the pattern, so
+   patterns using them keep the old behavior.  */
+
+/* A step of the closure computation in linear_add_thread: either
+   visit pattern offset PC, or, if PC is negative, restore register
+   REG to VAL.  */
+struct linear_frame
+{
+  ptrdiff_t pc, reg, val;
+};
+
+/* A list of threads, ordered by priority.  */
+struct linear_threads
+{
+  ptrdiff_t n;
+  ptrdiff_t *pc;
+  /* The registers of thread I start at REGS[I * NREGS].  */
+  ptrdiff_t *regs;
+};
+
+struct linear_matcher
+{
+  struct re_pattern_buffer *bufp;
+  re_char *string1, *string2;
+  ptrdiff_t size1, size2, stop;
+
+  /* INFO[I] is -1 if offset I of the pattern starts an operation, the
+     offset just past the literal text if I lies inside the literal
+     text of an 'exactn', and 0 otherwise.  */
+  ptrdiff_t *info;
+
+  /* MARK[I] equals GEN if offset I of the pattern has already been
+     visited in the closure being computed.  */
+  ptrdiff_t *mark;
+  ptrdiff_t gen;
+
+  /* Number of registers per thread: a start and an end for each
+     subexpression, and for the whole match.  */
+  ptrdiff_t nregs;
+
+  /* The registers of the closure being computed, and its stack.  */
+  ptrdiff_t *cur;
+  struct linear_frame *stack;
+};
+
+/* Return true if the compiled pattern of BUFP can be matched by
+   re_match_linear.  If INFO is non-null, fill it in as described in
+   struct linear_matcher.  */
+
+static bool
+linear_match_ok (struct re_pattern_buffer *bufp, ptrdiff_t *info)
+{
+  re_char *start = bufp->buffer;
+  re_char *p = start, *pend = start + bufp->used;
+
+  if (info)
+    memset (info, 0, (bufp->used + 1) * sizeof *info);
+
+  while (p < pend)
+    {
+      re_char *next;
+
+      switch (*p)
+	{
+	case exactn:
+	  next = p + 2 + p[1];
+	  if (info)
+	    for (re_char *q = p + 3; q < next; q++)
+	      info[q - start] = next - start;
+	  break;
+
+	case charset:
+	case charset_not:
+	  next = p + 2 + CHARSET_BITMAP_SIZE (p);
+	  if (CHARSET_RANGE_TABLE_EXISTS_P (p))
+	    {
+	      int count;
+	      re_char *rtp = CHARSET_RANGE_TABLE (p);
+	      EXTRACT_NUMBER_AND_INCR (count, rtp);
+	      next = CHARSET_RANGE_TABLE_END (rtp, count);
+	    }
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	case syntaxspec:
+	case notsyntaxspec:
+	case categoryspec:
+	case notcategoryspec:
+	  next = p + 2;
+	  break;
+
+	case jump:
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  next = p + 3;
+	  break;
+
+	case duplicate:
+	case succeed_n:
+	case jump_n:
+	case set_number_at:
+	  return false;
+
+	default:
+	  next = p + 1;
+	  break;
+	}
+
+      if (info)
+	info[p - start] = -1;
+      p = next;
+    }
+
+  return true;
+}
+
+/* Return the address of offset POS in the text matched by M.  */
+
+static re_char *
+linear_addr (struct linear_matcher *m, ptrdiff_t pos)
+{
+  return pos < m->size1 ? m->string1 + pos : m->string2 + (pos - m->size1);
+}
+
+/* Return true if the zero-width operation at P holds at text offset
+   POS.  This mirrors the corresponding cases of re_match_2_internal.  */
+
+static bool
+linear_assertion (struct linear_matcher *m, re_char *p, ptrdiff_t pos)
+{
+  re_char *string1 = m->string1, *string2 = m->string2;
+  re_char *end1 = string1 + m->size1, *end2 = string2 + m->size2;
+  ptrdiff_t total = m->size1 + m->size2;
+  bool target_multibyte = RE_TARGET_MULTIBYTE_P (m->bufp);
+  re_char *d = linear_addr (m, pos);
+  int c1, c2, s1, s2, dummy;
+  ptrdiff_t charpos;
+
+  switch (*p)
+    {
+    case begline:
+      if (pos == 0)
+	return true;
+      GET_CHAR_BEFORE_2 (c1, d, string1, end1, string2, end2);
+      return c1 == '\n';
+
+    case endline:
+      return pos == total || *d == '\n';
+
+    case begbuf:
+      return pos == 0;
+
+    case endbuf:
+      return pos == total;
+
+    case wordbound:
+    case notwordbound:
+      {
+	bool not = *p == notwordbound;
+	if (pos == 0 || pos == total)
+	  return !not;
+	charpos = RE_SYNTAX_TABLE_BYTE_TO_CHAR (pos) - 1;
+	UPDATE_SYNTAX_TABLE (charpos);
+	GET_CHAR_BEFORE_2 (c1, d, string1, end1, string2, end2);
+	s1 = SYNTAX (c1);
+	UPDATE_SYNTAX_TABLE_FORWARD (charpos + 1);
+	GET_CHAR_AFTER (c2, d, dummy);
+	s2 = SYNTAX (c2);
+	if ((s1 == Sword) != (s2 == Sword)
+	    || (s1 == Sword && WORD_BOUNDARY_P (c1, c2)))
+	  not = !not;
+	return not;
+      }
+
+    case wordbeg:
+      if (pos == total || pos == m->stop)
+	return false;
+      charpos = RE_SYNTAX_TABLE_BYTE_TO_CHAR (pos);
+      UPDATE_SYNTAX_TABLE (charpos);
+      GET_CHAR_AFTER (c2, d, dummy);
+      s2 = SYNTAX (c2);
+      if (s2 != Sword)
+	return false;
+      if (pos != 0)
+	{
+	  GET_CHAR_BEFORE_2 (c1, d, string1, end1, string2, end2);
+	  UPDATE_SYNTAX_TABLE_BACKWARD (charpos - 1);
+	  s1 = SYNTAX (c1);
+	  if (s1 == Sword && !WORD_BOUNDARY_P (c1, c2))
+	    return false;
+	}
+      return true;
+
+    case wordend:
+      if (pos == 0)
+	return false;
+      charpos = RE_SYNTAX_TABLE_BYTE_TO_CHAR (pos) - 1;
+      UPDATE_SYNTAX_TABLE (charpos);
+      GET_CHAR_BEFORE_2 (c1, d, string1, end1, string2, end2);
+      s1 = SYNTAX (c1);
+      if (s1 != Sword)
+	return false;
+      if (pos != total)
+	{
+	  GET_CHAR_AFTER (c2, d, dummy);
+	  UPDATE_SYNTAX_TABLE_FORWARD (charpos + 1);
+	  s2 = SYNTAX (c2);
+	  if (s2 == Sword && !WORD_BOUNDARY_P (c1, c2))
+	    return false;
+	}
+      return true;
+
+    case symbeg:
+      if (pos == total || pos == m->stop)
+	return false;
+      charpos = RE_SYNTAX_TABLE_BYTE_TO_CHAR (pos);
+      UPDATE_SYNTAX_TABLE (charpos);
+      c2 = RE_STRING_CHAR (d, target_multibyte);
+      s2 = SYNTAX (c2);
+      if (s2 != Sword && s2 != Ssymbol)
+	return false;
+      if (pos != 0)
+	{
+	  GET_CHAR_BEFORE_2 (c1, d, string1, end1, string2, end2);
+	  UPDATE_SYNTAX_TABLE_BACKWARD (charpos - 1);
+	  s1 = SYNTAX (c1);
+	  if (s1 == Sword || s1 == Ssymbol)
+	    return false;
+	}
+      return true;
+
+    case symend:
+      if (pos == 0)
+	return false;
+      charpos = RE_SYNTAX_TABLE_BYTE_TO_CHAR (pos) - 1;
+      UPDATE_SYNTAX_TABLE (charpos);
+      GET_CHAR_BEFORE_2 (c1, d, string1, end1, string2, end2);
+      s1 = SYNTAX (c1);
+      if (s1 != Sword && s1 != Ssymbol)
+	return false;
+      if (pos != total)
+	{
+	  c2 = RE_STRING_CHAR (d, target_multibyte);
+	  UPDATE_SYNTAX_TABLE_FORWARD (charpos + 1);
+	  s2 = SYNTAX (c2);
+	  if (s2 == Sword || s2 == Ssymbol)
+	    return false;
+	}
+      return true;
+
+    case at_dot:
+      return PTR_BYTE_POS (d) == PT_BYTE;
+
+    default:
+      abort ();
+    }
+}
+
+/* Add to LIST, in priority order, the threads that can be reached
+   from pattern offset PC with registers REGS without consuming any
+   text at text offset POS.  Threads that have already been added at
+   this position are skipped.  */
+
+static void
+linear_add_thread (struct linear_matcher *m, struct linear_threads *list,
+		   ptrdiff_t pc, ptrdiff_t const *regs, ptrdiff_t pos)
+{
+  re_char *start = m->bufp->buffer;
+  ptrdiff_t used = m->bufp->used;
+  ptrdiff_t *cur = m->cur;
+  struct linear_frame *sp = m->stack;
+
+  memcpy (cur, regs, m->nregs * sizeof *cur);
+  *sp++ = (struct linear_frame) { .pc = pc };
+
+  while (sp > m->stack)
+    {
+      struct linear_frame f = *--sp;
+      if (f.pc < 0)
+	{
+	  cur[f.reg] = f.val;
+	  continue;
+	}
+      re_char *p = start + f.pc;
+      if (m->mark[f.pc] == m->gen)
+	{
+	  /* Like CHECK_INFINITE_LOOP, leave a loop that has come back
+	     to its start without consuming anything, rather than
+	     dropping the thread, so as to keep what the empty
+	     iteration recorded in the registers.  */
+	  if (f.pc < used && m->info[f.pc] < 0)
+	    {
+	      if (*p == on_failure_jump_loop)
+		*sp++ = (struct linear_frame)
+		  { .pc = extract_address (p + 1) - start };
+	      else if (*p == on_failure_jump_nastyloop)
+		*sp++ = (struct linear_frame) { .pc = f.pc + 3 };
+	    }
+	  continue;
+	}
+      m->mark[f.pc] = m->gen;
+
+      if (f.pc == used || 0 < m->info[f.pc])
+	goto add;
+
+      switch (*p)
+	{
+	case no_op:
+	  *sp++ = (struct linear_frame) { .pc = f.pc + 1 };
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  {
+	    ptrdiff_t reg = 2 * p[1] + (*p == stop_memory);
+	    *sp++ = (struct linear_frame) { .pc = -1, .reg = reg,
+					    .val = cur[reg] };
+	    cur[reg] = pos;
+	    *sp++ = (struct linear_frame) { .pc = f.pc + 2 };
+	  }
+	  break;
+
+	case begline:
+	case endline:
+	case begbuf:
+	case endbuf:
+	case wordbound:
+	case notwordbound:
+	case wordbeg:
+	case wordend:
+	case symbeg:
+	case symend:
+	case at_dot:
+	  if (linear_assertion (m, p, pos))
+	    *sp++ = (struct linear_frame) { .pc = f.pc + 1 };
+	  break;
+
+	case jump:
+	  {
+	    ptrdiff_t target = extract_address (p + 1) - start;
+	    /* on_failure_jump_smart turns a loop into
+	       "on_failure_keep_string_jump END; BODY; jump BODY; END:",
+	       which is only correct when backtracking.  Go back to the
+	       on_failure_keep_string_jump instead, so that every
+	       iteration can leave the loop.  */
+	    if (3 <= target && m->info[target - 3] < 0
+		&& start[target - 3] == on_failure_keep_string_jump
+		&& extract_address (start + target - 2) == p + 3)
+	      target -= 3;
+	    *sp++ = (struct linear_frame) { .pc = target };
+	  }
+	  break;
+
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  /* Backtracking tries the next operation first.  */
+	  *sp++ = (struct linear_frame) { .pc = extract_address (p + 1) - start };
+	  *sp++ = (struct linear_frame) { .pc = f.pc + 3 };
+	  break;
+
+	default:
+	  /* 'succeed' or an operation that consumes a character.  */
+	add:
+	  list->pc[list->n] = f.pc;
+	  memcpy (list->regs + list->n * m->nregs, cur,
+		  m->nregs * sizeof *cur);
+	  list->n++;
+	  break;
+	}
+    }
+}
+
+/* Try to match one character at text offset POS with the operation
+   at pattern offset PC, which must consume a character.  Return the
+   pattern offset to continue at, or -1 if there is no match.  This
+   mirrors the corresponding cases of re_match_2_internal.  */
+
+static ptrdiff_t
+linear_step (struct linear_matcher *m, ptrdiff_t pc, ptrdiff_t pos)
+{
+  re_char *start = m->bufp->buffer;
+  re_char *p = start + pc;
+  re_char *d = linear_addr (m, pos);
+  Lisp_Object translate = m->bufp->translate;
+  bool multibyte = RE_MULTIBYTE_P (m->bufp);
+  bool target_multibyte = RE_TARGET_MULTIBYTE_P (m->bufp);
+
+  if (0 < m->info[pc] || *p == exactn)
+    {
+      /* Match the next character of the literal text.  */
+      int pat_charlen, pat_ch, buf_ch;
+
+      if (*p == exactn && m->info[pc] < 0)
+	p += 2;
+      if (target_multibyte)
+	{
+	  int buf_charlen;
+	  if (multibyte)
+	    pat_ch = string_char_and_length (p, &pat_charlen);
+	  else
+	    {
+	      pat_ch = RE_CHAR_TO_MULTIBYTE (*p);
+	      pat_charlen = 1;
+	    }
+	  buf_ch = string_char_and_length (d, &buf_charlen);
+	  if (TRANSLATE (buf_ch) != pat_ch)
+	    return -1;
+	}
+      else
+	{
+	  if (multibyte)
+	    {
+	      pat_ch = string_char_and_length (p, &pat_charlen);
+	      pat_ch = RE_CHAR_TO_UNIBYTE (pat_ch);
+	    }
+	  else
+	    {
+	      pat_ch = *p;
+	      pat_charlen = 1;
+	    }
+	  buf_ch = RE_CHAR_TO_MULTIBYTE (*d);
+	  if (! CHAR_BYTE8_P (buf_ch))
+	    {
+	      buf_ch = TRANSLATE (buf_ch);
+	      buf_ch = RE_CHAR_TO_UNIBYTE (buf_ch);
+	      if (buf_ch < 0)
+		buf_ch = *d;
+	    }
+	  else
+	    buf_ch = *d;
+	  if (buf_ch != pat_ch)
+	    return -1;
+	}
+      return p + pat_charlen - start;
+    }
+
+  switch (*p)
+    {
+    case anychar:
+      {
+	int buf_charlen;
+	int buf_ch = RE_STRING_CHAR_AND_LENGTH (d, buf_charlen,
+						target_multibyte);
+	if (TRANSLATE (buf_ch) == '\n')
+	  return -1;
+	return pc + 1;
+      }
+
+    case charset:
+    case charset_not:
+      {
+	bool unibyte_char = false;
+	int len;
+	int corig = RE_STRING_CHAR_AND_LENGTH (d, len, target_multibyte);
+	int c = corig;
+	if (target_multibyte)
+	  {
+	    c = TRANSLATE (c);
+	    int c1 = RE_CHAR_TO_UNIBYTE (c);
+	    if (c1 >= 0)
+	      {
+		unibyte_char = true;
+		c = c1;
+	      }
+	  }
+	else
+	  {
+	    int c1 = RE_CHAR_TO_MULTIBYTE (c);
+	    if (! CHAR_BYTE8_P (c1))
+	      {
+		c1 = TRANSLATE (c1);
+		c1 = RE_CHAR_TO_UNIBYTE (c1);
+		if (c1 >= 0)
+		  {
+		    unibyte_char = true;
+		    c = c1;
+		  }
+	      }
+	    else
+	      unibyte_char = true;
+	  }
+	if (!execute_charset (&p, c, corig, unibyte_char, translate))
+	  return -1;
+	return p - start;
+      }
+
+    case syntaxspec:
+    case notsyntaxspec:
+      {
+	bool not = *p == notsyntaxspec;
+	int c, len;
+	UPDATE_SYNTAX_TABLE (RE_SYNTAX_TABLE_BYTE_TO_CHAR (pos));
+	GET_CHAR_AFTER (c, d, len);
+	if ((SYNTAX (c) != (enum syntaxcode) p[1]) ^ not)
+	  return -1;
+	return pc + 2;
+      }
+
+    case categoryspec:
+    case notcategoryspec:
+      {
+	bool not = *p == notcategoryspec;
+	int c, len;
+	GET_CHAR_AFTER (c, d, len);
+	if ((!CHAR_HAS_CATEGORY (c, p[1])) ^ not)
+	  return -1;
+	return pc + 2;
+      }
+
+    default:
+      abort ();
+    }
+}
+
+/* Match the compiled pattern in BUFP against the text at POS, with
+   the same arguments and value as re_match_2_internal, but in time
+   linear in the length of the text.  BUFP must satisfy
+   linear_match_ok.  */
+
+static ptrdiff_t
+re_match_linear (struct re_pattern_buffer *bufp,
+		 re_char *string1, ptrdiff_t size1,
+		 re_char *string2, ptrdiff_t size2,
+		 ptrdiff_t pos, struct re_registers *regs, ptrdiff_t stop)
+{
+  struct linear_matcher m;
+  struct linear_threads lists[2];
+  ptrdiff_t npcs = bufp->used + 1;
+  ptrdiff_t num_regs = bufp->re_nsub + 1;
+  ptrdiff_t *init, *best;
+  ptrdiff_t match_end = -1;
+  ptrdiff_t nchars = 0;
+  REGEX_USE_SAFE_ALLOCA;
+
+  specpdl_ref count = SPECPDL_INDEX ();
+
+  /* See re_match_2_internal.  */
+  if (!current_buffer->text->inhibit_shrinking)
+    {
+      record_unwind_protect_ptr (unwind_re_match, current_buffer);
+      current_buffer->text->inhibit_shrinking = 1;
+    }
+
+  m.bufp = bufp;
+  m.string1 = string1;
+  m.size1 = size1;
+  m.string2 = string2;
+  m.size2 = size2;
+  m.stop = stop;
+  m.nregs = 2 * num_regs;
+  m.gen = 0;
+  SAFE_NALLOCA (m.info, 1, npcs);
+  SAFE_NALLOCA (m.mark, 1, npcs);
+  SAFE_NALLOCA (m.cur, 1, m.nregs);
+  SAFE_NALLOCA (m.stack, 3, npcs);
+  SAFE_NALLOCA (init, 1, m.nregs);
+  SAFE_NALLOCA (best, 1, m.nregs);
+  for (int i = 0; i < 2; i++)
+    {
+      SAFE_NALLOCA (lists[i].pc, 1, npcs);
+      SAFE_NALLOCA (lists[i].regs, m.nregs, npcs);
+    }
+
+  linear_match_ok (bufp, m.info);
+  for (ptrdiff_t i = 0; i < npcs; i++)
+    m.mark[i] = -1;
+  for (ptrdiff_t i = 0; i < m.nregs; i++)
+    init[i] = -1;
+
+  struct linear_threads *clist = &lists[0], *nlist = &lists[1];
+  clist->n = 0;
+  linear_add_thread (&m, clist, 0, init, pos);
+
+  for (ptrdiff_t d = pos; ; )
+    {
+      bool more = d < stop;
+      int len = (!more ? 0
+		 : RE_TARGET_MULTIBYTE_P (bufp)
+		 ? BYTES_BY_CHAR_HEAD (*linear_addr (&m, d))
+		 : 1);
+
+      m.gen++;
+      nlist->n = 0;
+      for (ptrdiff_t i = 0; i < clist->n; i++)
+	{
+	  ptrdiff_t pc = clist->pc[i];
+	  ptrdiff_t *tregs = clist->regs + i * m.nregs;
+
+	  if (pc == bufp->used
+	      || (m.info[pc] < 0 && bufp->buffer[pc] == succeed))
+	    {
+	      /* A match.  Threads later in CLIST have lower priority,
+		 so drop them unless we are looking for the longest
+		 match (the POSIX variant, which has no 'succeed').  */
+	      if (match_end < d)
+		{
+		  match_end = d;
+		  memcpy (best, tregs, m.nregs * sizeof *best);
+		}
+	      if (pc != bufp->used)
+		break;
+	      continue;
+	    }
+
+	  if (more)
+	    {
+	      ptrdiff_t next = linear_step (&m, pc, d);
+	      if (0 <= next)
+		linear_add_thread (&m, nlist, next, tregs, d + len);
+	    }
+	}
+
+      if (!more || nlist->n == 0)
+	break;
+
+      struct linear_threads *tem = clist;
+      clist = nlist;
+      nlist = tem;
+      d += len;
+      nchars++;
+      maybe_quit ();
+    }
+
+  ptrdiff_t retval = -1;
+  if (0 <= match_end)
+    {
+      if (regs)
+	{
+	  allocate_registers (bufp, regs, num_regs);
+	  if (regs->num_regs > 0)
+	    {
+	      regs->start[0] = pos;
+	      regs->end[0] = match_end;
+	    }
+	  for (ptrdiff_t reg = 1; reg < num_regs; reg++)
+	    {
+	      if (best[2 * reg + 1] < 0)
+		regs->start[reg] = regs->end[reg] = -1;
+	      else
+		{
+		  regs->start[reg] = best[2 * reg];
+		  regs->end[reg] = best[2 * reg + 1];
+		}
+	    }
+	  for (ptrdiff_t reg = num_regs; reg < regs->num_regs; reg++)
+	    regs->start[reg] = regs->end[reg] = -1;
+	}
+      retval = match_end - pos;
+    }
+
+  unbind_to (count, Qnil);
+  SAFE_FREE ();
+
+  if (max_redisplay_ticks > 0 && nchars > 0)
+    update_redisplay_ticks (nchars / 50 + 1, NULL);
+
+  return retval;
+}
+
 /* Subroutine definitions for re_match_2.  */
 
 /* Return true if TRANSLATE[S1] and TRANSLATE[S2] are not identical
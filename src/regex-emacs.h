@@ -118,6 +118,11 @@ struct re_pattern_buffer
   /* If true, multi-byte form in the target of match should be
      recognized as a multibyte character.  */
   bool_bf target_multibyte : 1;
+
+  /* If true, backtracking took too long with this pattern during the
+     current search, so the rest of the search matches it in linear
+     time.  */
+  bool_bf match_linear : 1;
 };
 
 /* Declarations for routines.  */
@@ -30,6 +30,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "syntax.h"
 #include "charset.h"
 #include "region-cache.h"
+#include "line-index.h"
 #include "blockinput.h"
 #include "intervals.h"
 #include "pdumper.h"
@@ -698,6 +699,30 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
   if (counted)
     *counted = count;
 
+  /* Looking for many newlines over a long stretch of text is faster
+     with the line index, if the buffer has or should have one.  */
+  if (eabs (count) >= LINE_INDEX_MIN_COUNT)
+    {
+      struct line_index *line_index;
+
+      if (start_byte == -1)
+	start_byte = CHAR_TO_BYTE (start);
+      line_index = buffer_line_index (current_buffer,
+				      eabs (end_byte - start_byte));
+      if (line_index)
+	{
+	  ptrdiff_t found, pos_byte;
+
+	  pos_byte = line_index_scan (current_buffer, line_index,
+				      start_byte, end_byte, count, &found);
+	  if (counted)
+	    *counted = found;
+	  if (bytepos)
+	    *bytepos = pos_byte;
+	  return found == count ? BYTE_TO_CHAR (pos_byte) : end;
+	}
+    }
+
   if (count > 0)
     while (start != end)
       {
@@ -1294,6 +1319,293 @@ search_buffer_re (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
   return (pos);
 }
 
+/* Byte-filter search.
+
+   For a pattern whose bytes match only themselves, or themselves and
+   a single ASCII case partner, we can look for candidate positions
+   a whole machine word at a time: a position is a candidate only if
+   the buffer byte there can match the first byte of the pattern and
+   the byte LEN_BYTE - 1 further on can match the last one.  Checking
+   both ends rejects nearly every position in ordinary text, so the
+   full comparison runs rarely.  This beats boyer_moore for the short
+   patterns typical of interactive search, and unlike simple_search it
+   does not decode characters.  */
+
+struct byte_filter
+{
+  /* The pattern, already translated, and its length in bytes.  */
+  unsigned char const *pat;
+  ptrdiff_t len;
+
+  /* FOLD[B] is the pattern byte that buffer byte B matches, or B
+     itself if B is not a case partner of some pattern byte.  */
+  unsigned char fold[0400];
+
+  /* The bytes that can match the first and last byte of PAT.  The two
+     elements are equal when the byte has no case partner.  */
+  unsigned char first[2], last[2];
+
+  /* True if FOLD is not the identity mapping.  */
+  bool folded;
+};
+
+/* Number of candidate positions to examine between quit checks.  */
+enum { BYTE_FILTER_CHUNK = 1 << 20 };
+
+/* Return true if F can be used to search for the LEN_BYTE bytes at
+   PAT, which have already been translated with TRT, and set up F
+   accordingly.  INVERSE_TRT is the inverse of TRT.  */
+
+static bool
+init_byte_filter (struct byte_filter *f, unsigned char const *pat,
+		  ptrdiff_t len_byte, Lisp_Object trt,
+		  Lisp_Object inverse_trt)
+{
+  unsigned char partner[2];
+
+  f->pat = pat;
+  f->len = len_byte;
+  f->folded = false;
+  for (int i = 0; i < 0400; i++)
+    f->fold[i] = i;
+  partner[0] = pat[0];
+  partner[1] = pat[len_byte - 1];
+
+  if (!NILP (trt))
+    for (ptrdiff_t i = 0; i < len_byte; i++)
+      {
+	int c = pat[i], translated, inverse, back;
+
+	/* Only ASCII characters whose case-equivalents are all ASCII
+	   can be matched byte by byte.  A non-ASCII equivalent (such
+	   as KELVIN SIGN for `k') needs the general searchers.  */
+	if (!ASCII_CHAR_P (c))
+	  return false;
+	TRANSLATE (translated, trt, c);
+	if (translated != c)
+	  return false;
+	TRANSLATE (inverse, inverse_trt, c);
+	if (inverse == c)
+	  continue;
+	if (!ASCII_CHAR_P (inverse))
+	  return false;
+	TRANSLATE (back, inverse_trt, inverse);
+	if (back != c)
+	  return false;
+
+	f->fold[inverse] = c;
+	f->folded = true;
+	if (i == 0)
+	  partner[0] = inverse;
+	if (i == len_byte - 1)
+	  partner[1] = inverse;
+      }
+
+  f->first[0] = pat[0];
+  f->first[1] = partner[0];
+  f->last[0] = pat[len_byte - 1];
+  f->last[1] = partner[1];
+  return true;
+}
+
+/* Return true if the LEN bytes at P match F's pattern.  */
+
+static bool
+byte_filter_match_p (struct byte_filter const *f, unsigned char const *p)
+{
+  if (!f->folded)
+    return memcmp (p, f->pat, f->len) == 0;
+  for (ptrdiff_t i = 0; i < f->len; i++)
+    if (f->fold[p[i]] != f->pat[i])
+      return false;
+  return true;
+}
+
+/* Load a word from a possibly unaligned address.  */
+
+static size_t
+load_word (unsigned char const *p)
+{
+  size_t x;
+  memcpy (&x, p, sizeof x);
+  return x;
+}
+
+/* Return a word whose bytes all equal B.  */
+
+static size_t
+broadcast_byte (unsigned char b)
+{
+  return SIZE_MAX / UCHAR_MAX * b;
+}
+
+/* Return a word with the high bit set in exactly those bytes of X
+   that equal the corresponding byte of Y, and all other bits clear.
+   Unlike the usual "has zero byte" trick this never reports a false
+   match, since no carry crosses a byte boundary.  */
+
+static size_t
+word_bytes_equal (size_t x, size_t y)
+{
+  size_t low7 = SIZE_MAX / UCHAR_MAX * 0x7f;
+  size_t d = x ^ y;
+  return ~(((d & low7) + low7) | d | low7);
+}
+
+/* Return the first (if FORWARD) or last pointer in [P, LAST] at which
+   F's pattern occurs, or NULL if there is none.  The bytes from P
+   through LAST + F->len - 1 must be contiguous.  */
+
+static unsigned char const *
+byte_filter_scan (struct byte_filter const *f, unsigned char const *p,
+		  unsigned char const *last, bool forward)
+{
+  ptrdiff_t tail = f->len - 1;
+  int ws = sizeof (size_t);
+  size_t first0 = broadcast_byte (f->first[0]);
+  size_t first1 = broadcast_byte (f->first[1]);
+  size_t last0 = broadcast_byte (f->last[0]);
+  size_t last1 = broadcast_byte (f->last[1]);
+
+  if (forward)
+    {
+      for (; last - p >= ws - 1; p += ws)
+	{
+	  size_t head = load_word (p), end = load_word (p + tail);
+	  if ((word_bytes_equal (head, first0) | word_bytes_equal (head, first1))
+	      & (word_bytes_equal (end, last0) | word_bytes_equal (end, last1)))
+	    for (int i = 0; i < ws; i++)
+	      if (byte_filter_match_p (f, p + i))
+		return p + i;
+	}
+      for (; p <= last; p++)
+	if (byte_filter_match_p (f, p))
+	  return p;
+    }
+  else
+    {
+      for (; last - p >= ws - 1; last -= ws)
+	{
+	  unsigned char const *q = last - (ws - 1);
+	  size_t head = load_word (q), end = load_word (q + tail);
+	  if ((word_bytes_equal (head, first0) | word_bytes_equal (head, first1))
+	      & (word_bytes_equal (end, last0) | word_bytes_equal (end, last1)))
+	    for (int i = ws - 1; i >= 0; i--)
+	      if (byte_filter_match_p (f, q + i))
+		return q + i;
+	}
+      for (; p <= last; last--)
+	if (byte_filter_match_p (f, last))
+	  return last;
+    }
+  return NULL;
+}
+
+/* Return the byte position of the first (if FORWARD) or last
+   occurrence of F's pattern in the current buffer that starts in
+   [FROM, TO], or -1 if there is none.  TO + F->len must not exceed
+   Z_BYTE.  The part of the range before the gap, the few positions
+   whose match would straddle the gap, and the part after the gap are
+   examined separately, so the gap need not be moved.  */
+
+static ptrdiff_t
+byte_filter_search_range (struct byte_filter const *f,
+			  ptrdiff_t from, ptrdiff_t to, bool forward)
+{
+  ptrdiff_t len_byte = f->len;
+  /* The candidate starts in each part, in buffer order.  */
+  ptrdiff_t seg_from[3], seg_to[3];
+
+  seg_from[0] = from;
+  seg_to[0] = min (to, GPT_BYTE - len_byte);
+  seg_from[1] = max (from, GPT_BYTE - len_byte + 1);
+  seg_to[1] = min (to, GPT_BYTE - 1);
+  seg_from[2] = max (from, GPT_BYTE);
+  seg_to[2] = to;
+
+  for (int k = 0; k < 3; k++)
+    {
+      int seg = forward ? k : 2 - k;
+      ptrdiff_t beg = seg_from[seg], end = seg_to[seg];
+
+      if (beg > end)
+	continue;
+
+      if (seg != 1)
+	{
+	  unsigned char const *base = BYTE_POS_ADDR (beg);
+	  unsigned char const *hit
+	    = byte_filter_scan (f, base, base + (end - beg), forward);
+	  if (hit)
+	    return beg + (hit - base);
+	}
+      else
+	for (ptrdiff_t i = 0; i <= end - beg; i++)
+	  {
+	    ptrdiff_t start = forward ? beg + i : end - i;
+	    ptrdiff_t j;
+	    for (j = 0; j < len_byte; j++)
+	      if (f->fold[FETCH_BYTE (start + j)] != f->pat[j])
+		break;
+	    if (j == len_byte)
+	      return start;
+	  }
+    }
+
+  return -1;
+}
+
+/* Search N times for F's pattern from byte position POS_BYTE until
+   LIM_BYTE, with the same conventions for N and the value as
+   boyer_moore.  */
+
+static EMACS_INT
+byte_filter_search (EMACS_INT n, struct byte_filter const *f,
+		    ptrdiff_t pos_byte, ptrdiff_t lim_byte)
+{
+  bool forward = n > 0;
+  ptrdiff_t len_byte = f->len;
+  ptrdiff_t match = -1;
+
+  while (n > 0)
+    {
+      /* The last position at which a match may start.  */
+      ptrdiff_t last = lim_byte - len_byte;
+      if (pos_byte > last)
+	return -n;
+      maybe_quit ();
+      ptrdiff_t to = min (last, pos_byte + (BYTE_FILTER_CHUNK - 1));
+      match = byte_filter_search_range (f, pos_byte, to, true);
+      if (match < 0)
+	pos_byte = to + 1;
+      else
+	{
+	  pos_byte = match + len_byte;
+	  n--;
+	}
+    }
+
+  while (n < 0)
+    {
+      ptrdiff_t last = pos_byte - len_byte;
+      if (last < lim_byte)
+	return n;
+      maybe_quit ();
+      ptrdiff_t from = max (lim_byte, last - (BYTE_FILTER_CHUNK - 1));
+      match = byte_filter_search_range (f, from, last, false);
+      if (match < 0)
+	pos_byte = from - 1 + len_byte;
+      else
+	{
+	  pos_byte = match;
+	  n++;
+	}
+    }
+
+  set_search_regs (match, len_byte);
+  return BYTE_TO_CHAR (forward ? match + len_byte : match);
+}
+
 static EMACS_INT
 search_buffer_non_re (Lisp_Object string, ptrdiff_t pos,
                       ptrdiff_t pos_byte, ptrdiff_t lim, ptrdiff_t lim_byte,
@@ -1485,8 +1797,13 @@ search_buffer_non_re (Lisp_Object string, ptrdiff_t pos,
   len_byte = pat - patbuf;
   pat = base_pat = patbuf;
 
+  /* Prefer the byte filter when the pattern matches byte by byte;
+     boyer_moore remains for translations it cannot express.  */
+  struct byte_filter filter;
   EMACS_INT result
-    = (boyer_moore_ok
+    = (init_byte_filter (&filter, pat, len_byte, trt, inverse_trt)
+       ? byte_filter_search (n, &filter, pos_byte, lim_byte)
+       : boyer_moore_ok
        ? boyer_moore (n, pat, len_byte, trt, inverse_trt,
                       pos_byte, lim_byte,
                       char_base)
@@ -1810,22 +1810,28 @@ handle_arith_signal (int sig)
   xsignal0 (Qarith_error);
 }
 
-#if defined HAVE_ANDROID && !defined ANDROID_STUBIFY && defined HAVE_MMAP
+#if defined HAVE_MMAP && !defined WINDOWSNT && defined SIGBUS
 
 static void
 handle_sigbus (int sig, siginfo_t *siginfo, void *arg)
 {
+  /* Buffer text mapped from a file that was truncated.  */
+  if (buffer_text_sigbus (siginfo->si_addr))
+    return;
+
+#if defined HAVE_ANDROID && !defined ANDROID_STUBIFY
   /* If this arrives during sfntfont_open, then Emacs may be
      screwed.  */
 
   if (sfntfont_detect_sigbus (siginfo->si_addr))
     return;
+#endif
 
-  handle_fatal_signal (sig);
+  deliver_fatal_thread_signal (sig);
 }
 
-/* Try to set up SIGBUS handling for the sfnt font driver.
-   Value is 1 upon failure, 0 otherwise.  */
+/* Try to set up SIGBUS handling for buffer text mapped from files, and
+   for the sfnt font driver.  Value is 1 upon failure, 0 otherwise.  */
 
 static int
 init_sigbus (void)
@@ -2108,7 +2114,7 @@ init_signals (void)
   sigaction (SIGEMT, &thread_fatal_action, 0);
 #endif
 #ifdef SIGBUS
-#if defined HAVE_ANDROID && !defined ANDROID_STUBIFY && defined HAVE_MMAP
+#if defined HAVE_MMAP && !defined WINDOWSNT
   if (init_sigbus ())
 #endif
     sigaction (SIGBUS, &thread_fatal_action, 0);
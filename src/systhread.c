@@ -48,6 +48,11 @@ sys_mutex_unlock (sys_mutex_t *m)
 {
 }
 
+void
+sys_mutex_destroy (sys_mutex_t *m)
+{
+}
+
 void
 sys_cond_init (sys_cond_t *c)
 {
@@ -151,6 +156,14 @@ sys_mutex_unlock (sys_mutex_t *sys_mutex)
   eassert (error == 0);
 }
 
+void
+sys_mutex_destroy (sys_mutex_t *sys_mutex)
+{
+  pthread_mutex_t *mutex = SYSTHREAD_ALIGN_PTR (pthread_mutex_t, sys_mutex);
+  int error = pthread_mutex_destroy (mutex);
+  eassert (error == 0);
+}
+
 void
 sys_cond_init (sys_cond_t *sys_cond)
 {
@@ -310,6 +323,12 @@ sys_mutex_unlock (sys_mutex_t *mutex)
   LeaveCriticalSection ((LPCRITICAL_SECTION)mutex);
 }
 
+void
+sys_mutex_destroy (sys_mutex_t *mutex)
+{
+  DeleteCriticalSection ((LPCRITICAL_SECTION)mutex);
+}
+
 void
 sys_cond_init (sys_cond_t *cond)
 {
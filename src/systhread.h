@@ -141,6 +141,7 @@ typedef void *(thread_creation_function) (void *);
 extern void sys_mutex_init (sys_mutex_t *);
 extern void sys_mutex_lock (sys_mutex_t *);
 extern void sys_mutex_unlock (sys_mutex_t *);
+extern void sys_mutex_destroy (sys_mutex_t *);
 
 extern void sys_cond_init (sys_cond_t *);
 extern void sys_cond_wait (sys_cond_t *, sys_mutex_t *);
@@ -435,6 +435,7 @@ add_properties (Lisp_Object plist, INTERVAL i, Lisp_Object object,
 		  Fsetcar (this_cdr, list2 (Fcar (this_cdr), val1));
 	      }
 	    }
+	    invalidate_interval_summary (i);
 	    changed = true;
 	    break;
 	  }
@@ -830,6 +831,16 @@ The property values are compared with `eq'.  */)
 	  if (XFIXNUM (position) > ZV)
 	    XSETFASTINT (position, ZV);
 	}
+      else if (!buffer_has_overlays ()
+	       && BEGV <= XFIXNUM (position) && XFIXNUM (position) < ZV)
+	{
+	  /* Without overlays, only text properties matter, and
+	     next-single-property-change can skip runs of intervals.  */
+	  position = Fnext_single_property_change (position, prop,
+						    object, limit);
+	  if (XFIXNUM (position) > ZV)
+	    XSETFASTINT (position, ZV);
+	}
       else
 	while (true)
 	  {
@@ -1045,11 +1056,27 @@ past position LIMIT; return LIMIT if nothing is found before LIMIT.  */)
     return limit;
 
   here_val = textget (i->plist, prop);
-  next = next_interval (i);
-  while (next
-	 && EQ (here_val, textget (next->plist, prop))
-	 && (NILP (limit) || next->position < XFIXNUM (limit)))
-    next = next_interval (next);
+
+  /* If PROP's runs are summarized in the interval tree, skip the
+     intervals that have the same raw value as I.  */
+  int k = (NILP (Fassq (prop, Vchar_property_alias_alist))
+	   ? interval_summary_index (prop) : -1);
+  if (k >= 0)
+    {
+      next = next_property_run_change (i, k);
+      while (next
+	     && EQ (here_val, textget (next->plist, prop))
+	     && (NILP (limit) || next->position < XFIXNUM (limit)))
+	next = next_property_run_change (next, k);
+    }
+  else
+    {
+      next = next_interval (i);
+      while (next
+	     && EQ (here_val, textget (next->plist, prop))
+	     && (NILP (limit) || next->position < XFIXNUM (limit)))
+	next = next_interval (next);
+    }
 
   if (!next
       || (next->position
@@ -1327,6 +1354,199 @@ markers).  If OBJECT is a string, START and END are 0-based indices into it.  */
   return Qnil;
 }
 
+/* Add PROPERTIES to the LEN characters of OBJECT from position S,
+   which is in interval I, like add_text_properties_1 with
+   TEXT_PROPERTY_REPLACE, but without running any hooks.  Set *MODIFIED
+   to true if a property value changed.  Return the interval containing
+   the last character, with its position set.  */
+
+static INTERVAL
+add_properties_in_range (INTERVAL i, ptrdiff_t s, ptrdiff_t len,
+			 Lisp_Object properties, Lisp_Object object,
+			 bool *modified)
+{
+  for (;;)
+    {
+      ptrdiff_t got = LENGTH (i) - (s - i->position);
+
+      if (! interval_has_all_properties (properties, i))
+	{
+	  INTERVAL unchanged;
+
+	  if (i->position != s)
+	    {
+	      unchanged = i;
+	      i = split_interval_right (unchanged, s - unchanged->position);
+	      copy_properties (unchanged, i);
+	    }
+	  if (LENGTH (i) > len)
+	    {
+	      unchanged = i;
+	      i = split_interval_left (unchanged, len);
+	      copy_properties (unchanged, i);
+	    }
+	  if (add_properties (properties, i, object,
+			      TEXT_PROPERTY_REPLACE, true))
+	    *modified = true;
+	  got = LENGTH (i);
+	}
+
+      if (got >= len)
+	return i;
+      s += got;
+      len -= got;
+      i = next_interval (i);
+    }
+}
+
+/* Return the first position in the LEN characters of OBJECT from
+   position S, which is in interval I, where some of PROPERTIES are
+   missing, or -1 if there is none.  Set *LAST to the interval
+   examined last.  */
+
+static ptrdiff_t
+first_missing_properties (INTERVAL i, ptrdiff_t s, ptrdiff_t len,
+			  Lisp_Object properties, INTERVAL *last)
+{
+  for (;;)
+    {
+      ptrdiff_t got = LENGTH (i) - (s - i->position);
+
+      *last = i;
+      if (! interval_has_all_properties (properties, i))
+	return s;
+      if (got >= len)
+	return -1;
+      s += got;
+      len -= got;
+      i = next_interval (i);
+    }
+}
+
+DEFUN ("add-text-properties-batch", Fadd_text_properties_batch,
+       Sadd_text_properties_batch, 1, 2, 0,
+       doc: /* Add properties to several ranges of text at once.
+SPECS is a vector of elements of the form (START END PROPERTIES),
+sorted by START; each means to add the property list PROPERTIES to the
+text from START to END, like `add-text-properties'.  The ranges may
+overlap, in which case later elements take precedence.
+If the optional second argument OBJECT is a buffer (or nil, which means
+the current buffer), START and END are buffer positions (integers or
+markers).  If OBJECT is a string, START and END are 0-based indices
+into it.
+
+This is faster than calling `add-text-properties' for each element,
+because the modification hooks are called only once, for the text from
+the first changed START to the last END, and the intervals are visited
+in a single pass.
+Return t if any property value actually changed, nil otherwise.  */)
+  (Lisp_Object specs, Lisp_Object object)
+{
+  if (BUFFERP (object) && XBUFFER (object) != current_buffer)
+    {
+      specpdl_ref count = SPECPDL_INDEX ();
+      record_unwind_current_buffer ();
+      set_buffer_internal (XBUFFER (object));
+      return unbind_to (count, Fadd_text_properties_batch (specs, object));
+    }
+
+  CHECK_VECTOR (specs);
+  if (NILP (object))
+    XSETBUFFER (object, current_buffer);
+
+  /* Check the elements, and collect their ranges.  */
+  ptrdiff_t n = ASIZE (specs);
+  ptrdiff_t *ranges;
+  ptrdiff_t lo = PTRDIFF_MAX, hi = PTRDIFF_MIN;
+  USE_SAFE_ALLOCA;
+  SAFE_NALLOCA (ranges, 2, n);
+  for (ptrdiff_t k = 0; k < n; k++)
+    {
+      Lisp_Object spec = AREF (specs, k);
+      Lisp_Object start = Fcar (spec), end = Fcar (Fcdr (spec));
+      validate_plist (Fcar (Fcdr (Fcdr (spec))));
+      CHECK_FIXNUM_COERCE_MARKER (start);
+      CHECK_FIXNUM_COERCE_MARKER (end);
+      ptrdiff_t s = XFIXNUM (start), e = XFIXNUM (end);
+      if (s > e)
+	{
+	  ptrdiff_t tem = s;
+	  s = e;
+	  e = tem;
+	}
+      if (k > 0 && s < ranges[2 * k - 2])
+	error ("Text property specifications are not sorted");
+      ranges[2 * k] = s;
+      ranges[2 * k + 1] = e;
+      lo = min (lo, s);
+      hi = max (hi, e);
+    }
+  if (lo >= hi)
+    {
+      SAFE_FREE ();
+      return Qnil;
+    }
+
+  /* Find the first position that needs changing, and make sure all
+     the ranges are in OBJECT.  Since the ranges are sorted by their
+     start, those that start after the first such position found so far
+     cannot contain an earlier one.  */
+  Lisp_Object start = make_fixnum (lo), end = make_fixnum (hi);
+  INTERVAL i = validate_interval_range (object, &start, &end, hard);
+  ptrdiff_t first = -1;
+  for (ptrdiff_t k = 0; i && k < n && (first < 0 || ranges[2 * k] < first);
+       k++)
+    {
+      Lisp_Object properties = validate_plist (Fcar (Fcdr (Fcdr
+							    (AREF (specs,
+								   k)))));
+      ptrdiff_t s = ranges[2 * k], len = ranges[2 * k + 1] - s;
+      if (NILP (properties) || len == 0)
+	continue;
+      i = update_interval (i, s);
+      ptrdiff_t missing = first_missing_properties (i, s, len,
+						    properties, &i);
+      if (missing >= 0 && (first < 0 || missing < first))
+	first = missing;
+    }
+  if (first < 0)
+    {
+      SAFE_FREE ();
+      return Qnil;
+    }
+
+  if (BUFFERP (object))
+    {
+      /* The modification hooks can change the text, so find the
+	 intervals again afterwards.  */
+      modify_text_properties (object, make_fixnum (first), end);
+      start = make_fixnum (lo);
+      end = make_fixnum (hi);
+      i = validate_interval_range (object, &start, &end, hard);
+    }
+
+  bool modified = false;
+  for (ptrdiff_t k = 0; i && k < n; k++)
+    {
+      Lisp_Object properties = validate_plist (Fcar (Fcdr (Fcdr
+							    (AREF (specs,
+								   k)))));
+      /* Text before FIRST already has the properties.  */
+      ptrdiff_t s = max (ranges[2 * k], first);
+      ptrdiff_t len = ranges[2 * k + 1] - s;
+      if (NILP (properties) || len <= 0)
+	continue;
+      i = update_interval (i, s);
+      i = add_properties_in_range (i, s, len, properties, object,
+				   &modified);
+    }
+
+  if (BUFFERP (object))
+    signal_after_change (first, hi - first, hi - first);
+  SAFE_FREE ();
+  return modified ? Qt : Qnil;
+}
+
 DEFUN ("set-text-properties", Fset_text_properties,
        Sset_text_properties, 3, 4, 0,
        doc: /* Completely replace properties of text from START to END.
@@ -2467,6 +2687,7 @@ inherits it if NONSTICKINESS is nil.  The `front-sticky' and
   defsubr (&Sprevious_property_change);
   defsubr (&Sprevious_single_property_change);
   defsubr (&Sadd_text_properties);
+  defsubr (&Sadd_text_properties_batch);
   defsubr (&Sput_text_property);
   defsubr (&Sset_text_properties);
   defsubr (&Sadd_face_text_property);
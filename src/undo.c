@@ -23,6 +23,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "lisp.h"
 #include "buffer.h"
 #include "keyboard.h"
+#include "intervals.h"
 
 /* The first time a command records something for undo.
    it also allocates the undo-boundary object
@@ -31,6 +32,249 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
    an undo-boundary.  */
 static Lisp_Object pending_boundary;
 
+/* The compact undo log.
+
+   Recording each change in buffer-undo-list conses a few cells, and a
+   string for each deletion, which adds up when Lisp programs make
+   many small changes to a buffer.  When undo-compact-log is non-nil,
+   insertions, deletions, boundaries and positions of point are
+   instead appended as records to a log, a growable array of bytes
+   attached to the text of the buffer, so that indirect buffers share
+   it like they share the undo list.  The text of a deletion is copied
+   right after its record.  An insertion that continues the previous
+   one extends its record, and so does a deletion that continues the
+   previous deletion, so typing or deleting a run of characters makes
+   a single record.
+
+   The records are newer than the elements of buffer-undo-list.  The
+   undo list of the buffer consists of their Lisp form followed by
+   the elements of buffer-undo-list, and they are converted into it by
+   buffer_undo_list whenever it is used, most notably when Lisp gets
+   the value of buffer-undo-list.  Setting buffer-undo-list discards
+   them, see free_undo_log.  Changes that don't fit in a record, like
+   those of text properties and deletions of text with properties or
+   with markers in it, are pushed onto buffer-undo-list after
+   converting the records.
+
+   Since the records contain no Lisp objects, the garbage collector
+   need not know about them, but truncate_undo_list takes them into
+   account, as the size they would have in the undo list.  */
+
+enum undo_record_type
+  {
+    UNDO_BOUNDARY,		/* nil */
+    UNDO_POINT,			/* POSITION */
+    UNDO_INSERT,		/* (BEG . END) */
+    UNDO_DELETE			/* (TEXT . POSITION) */
+  };
+
+struct undo_record
+{
+  /* The offset of the previous record in the log, or -1.  */
+  ptrdiff_t prev;
+
+  /* The position of point for UNDO_POINT, the positions where the
+     inserted text starts and ends for UNDO_INSERT, or the positions
+     where the deleted text was for UNDO_DELETE.  */
+  ptrdiff_t beg, end;
+
+  /* The number of bytes of the deleted text, which follows the
+     record, padded to the alignment of records.  */
+  ptrdiff_t nbytes;
+
+  ENUM_BF (undo_record_type) type : 2;
+
+  /* Whether the deleted text is multibyte.  */
+  bool_bf multibyte : 1;
+
+  /* Whether point was at the end of the deleted text, which makes
+     POSITION negative.  */
+  bool_bf point_at_end : 1;
+};
+
+struct undo_log
+{
+  /* The records, oldest first.  */
+  unsigned char *records;
+
+  /* The number of bytes used and allocated in RECORDS.  */
+  ptrdiff_t size, alloc;
+
+  /* The offset of the last record, or -1 if there are none.  */
+  ptrdiff_t last;
+};
+
+/* Don't prepend to the text of a deletion longer than this many bytes,
+   as it has to be moved.  */
+enum { UNDO_PREPEND_MAX = 256 };
+
+static ptrdiff_t
+undo_record_size (struct undo_record const *r)
+{
+  return sizeof *r + ROUNDUP (r->nbytes, alignof (struct undo_record));
+}
+
+static struct undo_record *
+undo_log_record (struct undo_log *log, ptrdiff_t offset)
+{
+  return (struct undo_record *) (log->records + offset);
+}
+
+static struct undo_record *
+last_undo_record (struct buffer *b)
+{
+  struct undo_log *log = b->text->undo_log;
+  return log && 0 <= log->last ? undo_log_record (log, log->last) : NULL;
+}
+
+/* Return the number of bytes the element of the undo list made of R
+   occupies, like truncate_undo_list counts them.  */
+
+static intmax_t
+undo_record_lisp_size (struct undo_record const *r)
+{
+  switch (r->type)
+    {
+    case UNDO_INSERT:
+      return 2 * sizeof (struct Lisp_Cons);
+    case UNDO_DELETE:
+      return (2 * sizeof (struct Lisp_Cons) + sizeof (struct Lisp_String) - 1
+	      + r->end - r->beg);
+    default:
+      return sizeof (struct Lisp_Cons);
+    }
+}
+
+/* Append a record of type TYPE to the log of the current buffer,
+   with room for NBYTES bytes of text after it, and return it.  */
+
+static struct undo_record *
+append_undo_record (enum undo_record_type type, ptrdiff_t nbytes)
+{
+  struct undo_log *log = current_buffer->text->undo_log;
+  if (!log)
+    {
+      log = current_buffer->text->undo_log = xzalloc (sizeof *log);
+      log->last = -1;
+    }
+
+  struct undo_record r = { .prev = log->last, .type = type,
+			   .nbytes = nbytes };
+  ptrdiff_t size = undo_record_size (&r);
+  if (log->alloc - log->size < size)
+    log->records = xpalloc (log->records, &log->alloc,
+			    size - (log->alloc - log->size), -1, 1);
+  struct undo_record *p = undo_log_record (log, log->size);
+  *p = r;
+  log->last = log->size;
+  log->size += size;
+  return p;
+}
+
+/* Make room for NBYTES more bytes of text in the record R, which is
+   the last of the log of the current buffer, and return R, which may
+   have moved.  */
+
+static struct undo_record *
+enlarge_undo_record (struct undo_record *r, ptrdiff_t nbytes)
+{
+  struct undo_log *log = current_buffer->text->undo_log;
+  eassert (r == undo_log_record (log, log->last));
+  ptrdiff_t old_size = undo_record_size (r);
+  r->nbytes += nbytes;
+  ptrdiff_t grow = undo_record_size (r) - old_size;
+  if (log->alloc - log->size < grow)
+    {
+      log->records = xpalloc (log->records, &log->alloc,
+			      grow - (log->alloc - log->size), -1, 1);
+      r = undo_log_record (log, log->last);
+    }
+  log->size += grow;
+  return r;
+}
+
+/* Free the log of B, discarding its records.  This is done whenever
+   the undo list of B is set, since its records are meant to precede
+   the old value.  */
+
+void
+free_undo_log (struct buffer *b)
+{
+  struct undo_log *log = b->text->undo_log;
+
+  if (log)
+    {
+      xfree (log->records);
+      xfree (log);
+      b->text->undo_log = NULL;
+    }
+}
+
+/* Return the undo list of B, converting the records of its log into
+   elements of it first.  */
+
+Lisp_Object
+buffer_undo_list (struct buffer *b)
+{
+  struct undo_log *log = b->text->undo_log;
+  if (!log || log->size == 0)
+    return BVAR (b, undo_list);
+
+  /* The undo list is shared by the buffers sharing the text, and is
+     kept by the current buffer if it is one of them, otherwise by the
+     base buffer.  */
+  struct buffer *owner = (current_buffer->text == b->text ? current_buffer
+			  : b->base_buffer ? b->base_buffer : b);
+  Lisp_Object old = BVAR (owner, undo_list);
+  if (EQ (old, Qt))
+    return BVAR (b, undo_list);
+
+  Lisp_Object list = old;
+  for (ptrdiff_t offset = 0; offset < log->size; )
+    {
+      struct undo_record *r = undo_log_record (log, offset);
+      Lisp_Object elt;
+      switch (r->type)
+	{
+	case UNDO_BOUNDARY:
+	  elt = Qnil;
+	  break;
+	case UNDO_POINT:
+	  elt = make_fixnum (r->beg);
+	  break;
+	case UNDO_INSERT:
+	  elt = Fcons (make_fixnum (r->beg), make_fixnum (r->end));
+	  break;
+	case UNDO_DELETE:
+	  elt = Fcons (make_specified_string ((char *) (r + 1),
+					      r->end - r->beg, r->nbytes,
+					      r->multibyte),
+		       make_fixnum (r->point_at_end ? -r->beg : r->beg));
+	  break;
+	default:
+	  emacs_abort ();
+	}
+      list = Fcons (elt, list);
+      offset += undo_record_size (r);
+    }
+  log->size = 0;
+  log->last = -1;
+
+  bset_undo_list (owner, list);
+  if (b != owner && EQ (BVAR (b, undo_list), old))
+    bset_undo_list (b, list);
+  return BVAR (b, undo_list);
+}
+
+/* Return the undo list of the current buffer, to push an element onto
+   it.  */
+
+static Lisp_Object
+current_undo_list (void)
+{
+  return buffer_undo_list (current_buffer);
+}
+
 /* Prepare the undo info for recording a change. */
 static void
 prepare_record (void)
@@ -57,8 +301,12 @@ record_point (ptrdiff_t beg)
   first change. FIXME: This check is currently dependent on being
   called before record_first_change, but could be made not to by
   ignoring timestamp undo entries */
-  at_boundary = ! CONSP (BVAR (current_buffer, undo_list))
-                || NILP (XCAR (BVAR (current_buffer, undo_list)));
+  struct undo_record *last = last_undo_record (current_buffer);
+  if (last)
+    at_boundary = last->type == UNDO_BOUNDARY;
+  else
+    at_boundary = ! CONSP (BVAR (current_buffer, undo_list))
+                  || NILP (XCAR (BVAR (current_buffer, undo_list)));
 
   /* If this is the first change since save, then record this.*/
   if (MODIFF <= SAVE_MODIFF)
@@ -73,9 +321,15 @@ record_point (ptrdiff_t beg)
   if (at_boundary
       && point_before_last_command_or_undo != beg
       && buffer_before_last_command_or_undo == current_buffer )
-    bset_undo_list (current_buffer,
-		    Fcons (make_fixnum (point_before_last_command_or_undo),
-			   BVAR (current_buffer, undo_list)));
+    {
+      if (undo_compact_log)
+	append_undo_record (UNDO_POINT, 0)->beg
+	  = point_before_last_command_or_undo;
+      else
+	bset_undo_list (current_buffer,
+			Fcons (make_fixnum (point_before_last_command_or_undo),
+			       current_undo_list ()));
+    }
 }
 
 /* Record an insertion that just happened or is about to happen,
@@ -97,7 +351,16 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 
   /* If this is following another insertion and consecutive with it
      in the buffer, combine the two.  */
-  if (CONSP (BVAR (current_buffer, undo_list)))
+  struct undo_record *last = last_undo_record (current_buffer);
+  if (last)
+    {
+      if (last->type == UNDO_INSERT && last->end == beg)
+	{
+	  last->end = beg + length;
+	  return;
+	}
+    }
+  else if (CONSP (BVAR (current_buffer, undo_list)))
     {
       Lisp_Object elt;
       elt = XCAR (BVAR (current_buffer, undo_list));
@@ -111,10 +374,18 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 	}
     }
 
+  if (undo_compact_log)
+    {
+      last = append_undo_record (UNDO_INSERT, 0);
+      last->beg = beg;
+      last->end = beg + length;
+      return;
+    }
+
   XSETFASTINT (lbeg, beg);
   XSETINT (lend, beg + length);
   bset_undo_list (current_buffer,
-		  Fcons (Fcons (lbeg, lend), BVAR (current_buffer, undo_list)));
+		  Fcons (Fcons (lbeg, lend), current_undo_list ()));
 }
 
 /* Record the fact that markers in the region of FROM, TO are about to
@@ -128,32 +399,94 @@ record_marker_adjustments (ptrdiff_t from, ptrdiff_t to)
 {
   prepare_record ();
 
-  for (struct Lisp_Marker *m = BUF_MARKERS (current_buffer); m; m = m->next)
+  for (ptrdiff_t i = select_markers (current_buffer, from, to);
+       i < BUF_MARKERS_GPT (current_buffer); i++)
     {
+      struct Lisp_Marker *m = BUF_MARKERS (current_buffer)[i];
       ptrdiff_t charpos = m->charpos;
-      eassert (charpos <= Z);
-
-      if (from <= charpos && charpos <= to)
-        {
-          /* insertion_type nil markers will end up at the beginning of
-             the re-inserted text after undoing a deletion, and must be
-             adjusted to move them to the correct place.
-
-             insertion_type t markers will automatically move forward
-             upon re-inserting the deleted text, so we have to arrange
-             for them to move backward to the correct position.  */
-	  ptrdiff_t adjustment = (m->insertion_type ? to : from) - charpos;
-
-          if (adjustment)
-            {
-	      Lisp_Object marker = make_lisp_ptr (m, Lisp_Vectorlike);
-              bset_undo_list
-                (current_buffer,
-                 Fcons (Fcons (marker, make_fixnum (adjustment)),
-                        BVAR (current_buffer, undo_list)));
-            }
-        }
+      eassert (from <= charpos && charpos <= to);
+
+      /* insertion_type nil markers will end up at the beginning of
+	 the re-inserted text after undoing a deletion, and must be
+	 adjusted to move them to the correct place.
+
+	 insertion_type t markers will automatically move forward
+	 upon re-inserting the deleted text, so we have to arrange
+	 for them to move backward to the correct position.  */
+      ptrdiff_t adjustment = (m->insertion_type ? to : from) - charpos;
+
+      if (adjustment)
+	{
+	  Lisp_Object marker = make_lisp_ptr (m, Lisp_Vectorlike);
+	  bset_undo_list
+	    (current_buffer,
+	     Fcons (Fcons (marker, make_fixnum (adjustment)),
+		    current_undo_list ()));
+	}
+    }
+}
+
+/* Return whether record_marker_adjustments would record anything for
+   a deletion between FROM and TO.  */
+
+static bool
+marker_adjustments_p (ptrdiff_t from, ptrdiff_t to)
+{
+  for (ptrdiff_t i = select_markers (current_buffer, from, to);
+       i < BUF_MARKERS_GPT (current_buffer); i++)
+    {
+      struct Lisp_Marker *m = BUF_MARKERS (current_buffer)[i];
+      if (m->charpos != (m->insertion_type ? to : from))
+	return true;
+    }
+  return false;
+}
+
+/* Record in the log of the current buffer that NBYTES bytes of text,
+   between BEG and END, are about to be deleted, and return where to
+   copy the text.  MULTIBYTE says whether the text is multibyte.  */
+
+static unsigned char *
+log_delete (ptrdiff_t beg, ptrdiff_t end, ptrdiff_t nbytes, bool multibyte)
+{
+  bool point_at_end = PT == end;
+
+  prepare_record ();
+
+  record_point (beg);
+
+  /* If this deletion continues the previous one, forward or backward,
+     combine the two.  */
+  struct undo_record *last = last_undo_record (current_buffer);
+  if (last && last->type == UNDO_DELETE
+      && last->multibyte == multibyte
+      && last->point_at_end == point_at_end)
+    {
+      if (!point_at_end && last->beg == beg)
+	{
+	  ptrdiff_t old_nbytes = last->nbytes;
+	  last = enlarge_undo_record (last, nbytes);
+	  last->end += end - beg;
+	  return (unsigned char *) (last + 1) + old_nbytes;
+	}
+      if (point_at_end && last->beg == end
+	  && last->nbytes <= UNDO_PREPEND_MAX)
+	{
+	  ptrdiff_t old_nbytes = last->nbytes;
+	  last = enlarge_undo_record (last, nbytes);
+	  unsigned char *text = (unsigned char *) (last + 1);
+	  memmove (text + nbytes, text, old_nbytes);
+	  last->beg = beg;
+	  return text;
+	}
     }
+
+  last = append_undo_record (UNDO_DELETE, nbytes);
+  last->beg = beg;
+  last->end = end;
+  last->multibyte = multibyte;
+  last->point_at_end = point_at_end;
+  return (unsigned char *) (last + 1);
 }
 
 /* Record that a deletion is about to take place, of the characters in
@@ -167,11 +500,21 @@ record_delete (ptrdiff_t beg, Lisp_Object string, bool record_markers)
   if (EQ (BVAR (current_buffer, undo_list), Qt))
     return;
 
+  ptrdiff_t end = beg + SCHARS (string);
+  if (undo_compact_log && !string_intervals (string)
+      && !(record_markers && marker_adjustments_p (beg, end)))
+    {
+      memcpy (log_delete (beg, end, SBYTES (string),
+			  STRING_MULTIBYTE (string)),
+	      SDATA (string), SBYTES (string));
+      return;
+    }
+
   prepare_record ();
 
   record_point (beg);
 
-  if (PT == beg + SCHARS (string))
+  if (PT == end)
     {
       XSETINT (sbeg, -beg);
     }
@@ -184,11 +527,52 @@ record_delete (ptrdiff_t beg, Lisp_Object string, bool record_markers)
      immediately before the deletion is recorded.  See bug 16818
      discussion.  */
   if (record_markers)
-    record_marker_adjustments (beg, beg + SCHARS (string));
+    record_marker_adjustments (beg, end);
 
   bset_undo_list
     (current_buffer,
-     Fcons (Fcons (string, sbeg), BVAR (current_buffer, undo_list)));
+     Fcons (Fcons (string, sbeg), current_undo_list ()));
+}
+
+/* Record that the text of the current buffer between FROM and TO, at
+   byte positions FROM_BYTE and TO_BYTE, is about to be deleted, with
+   the adjustments of the markers in it.  This is like record_delete
+   with the text as a string, but doesn't make the string when the
+   deletion can be recorded in the log.  */
+
+void
+record_delete_text (ptrdiff_t from, ptrdiff_t from_byte,
+		    ptrdiff_t to, ptrdiff_t to_byte)
+{
+  if (EQ (BVAR (current_buffer, undo_list), Qt))
+    return;
+
+  bool properties = false;
+  if (buffer_intervals (current_buffer))
+    for (INTERVAL i = find_interval (buffer_intervals (current_buffer), from);
+	 i && i->position < to && !properties; i = next_interval (i))
+      properties = !NILP (i->plist);
+
+  if (!undo_compact_log || properties || marker_adjustments_p (from, to))
+    {
+      record_delete (from, make_buffer_string_both (from, from_byte,
+						    to, to_byte, true),
+		     true);
+      return;
+    }
+
+  ptrdiff_t nbytes = to_byte - from_byte;
+  unsigned char *text
+    = log_delete (from, to, nbytes,
+		  !NILP (BVAR (current_buffer, enable_multibyte_characters)));
+  if (from_byte < GPT_BYTE && GPT_BYTE < to_byte)
+    {
+      ptrdiff_t before_gap = GPT_BYTE - from_byte;
+      memcpy (text, BYTE_POS_ADDR (from_byte), before_gap);
+      memcpy (text + before_gap, GAP_END_ADDR, nbytes - before_gap);
+    }
+  else
+    memcpy (text, BYTE_POS_ADDR (from_byte), nbytes);
 }
 
 /* Record that a replacement is about to take place,
@@ -219,7 +603,7 @@ record_first_change (void)
 
   bset_undo_list (current_buffer,
 		  Fcons (Fcons (Qt, buffer_visited_file_modtime (base_buffer)),
-			 BVAR (current_buffer, undo_list)));
+			 current_undo_list ()));
 }
 
 /* Record a change in property PROP (whose old value was VAL)
@@ -244,8 +628,7 @@ record_property_change (ptrdiff_t beg, ptrdiff_t length,
   XSETINT (lbeg, beg);
   XSETINT (lend, beg + length);
   entry = Fcons (Qnil, Fcons (prop, Fcons (value, Fcons (lbeg, lend))));
-  bset_undo_list (current_buffer,
-		  Fcons (entry, BVAR (current_buffer, undo_list)));
+  bset_undo_list (current_buffer, Fcons (entry, current_undo_list ()));
 }
 
 DEFUN ("undo-boundary", Fundo_boundary, Sundo_boundary, 0, 0, 0,
@@ -254,11 +637,15 @@ An undo command will stop at this point,
 but another undo command will undo to the previous boundary.  */)
   (void)
 {
-  Lisp_Object tem;
   if (EQ (BVAR (current_buffer, undo_list), Qt))
     return Qnil;
-  tem = Fcar (BVAR (current_buffer, undo_list));
-  if (!NILP (tem))
+  struct undo_record *last = last_undo_record (current_buffer);
+  if (last)
+    {
+      if (last->type != UNDO_BOUNDARY)
+	append_undo_record (UNDO_BOUNDARY, 0);
+    }
+  else if (!NILP (Fcar (BVAR (current_buffer, undo_list))))
     {
       /* One way or another, cons nil onto the front of the undo list.  */
       if (!NILP (pending_boundary))
@@ -281,6 +668,106 @@ but another undo command will undo to the previous boundary.  */)
   return Qnil;
 }
 
+/* A place in the undo information of a buffer for truncate_undo_list:
+   a record of the log of the buffer, or an element of its
+   buffer-undo-list, which follows the records.  */
+
+struct undo_cursor
+{
+  struct undo_log *log;
+
+  /* The offset of the record, or -1 past the records.  */
+  ptrdiff_t offset;
+
+  /* Past the records, the cons of the element, and the previous cons
+     or nil.  */
+  Lisp_Object prev, next;
+};
+
+static bool
+undo_cursor_more_p (struct undo_cursor *c)
+{
+  return 0 <= c->offset || CONSP (c->next);
+}
+
+static bool
+undo_cursor_boundary_p (struct undo_cursor *c)
+{
+  return (0 <= c->offset
+	  ? undo_log_record (c->log, c->offset)->type == UNDO_BOUNDARY
+	  : NILP (XCAR (c->next)));
+}
+
+/* Return the space occupied by the element at C and its chain link.  */
+
+static intmax_t
+undo_cursor_size (struct undo_cursor *c)
+{
+  if (0 <= c->offset)
+    return undo_record_lisp_size (undo_log_record (c->log, c->offset));
+
+  Lisp_Object elt = XCAR (c->next);
+  intmax_t size = sizeof (struct Lisp_Cons);
+  if (CONSP (elt))
+    {
+      size += sizeof (struct Lisp_Cons);
+      if (STRINGP (XCAR (elt)))
+	size += sizeof (struct Lisp_String) - 1 + SCHARS (XCAR (elt));
+    }
+  return size;
+}
+
+static void
+undo_cursor_advance (struct undo_cursor *c)
+{
+  if (0 <= c->offset)
+    c->offset = undo_log_record (c->log, c->offset)->prev;
+  else
+    {
+      c->prev = c->next;
+      c->next = XCDR (c->next);
+    }
+}
+
+static void
+undo_cursor_init (struct undo_cursor *c, struct buffer *b)
+{
+  c->log = b->text->undo_log;
+  c->offset = c->log ? c->log->last : -1;
+  c->prev = Qnil;
+  c->next = BVAR (b, undo_list);
+}
+
+/* Discard the element at C in the undo information of B, and the
+   older ones.  */
+
+static void
+undo_cursor_truncate (struct undo_cursor *c, struct buffer *b)
+{
+  if (0 <= c->offset)
+    {
+      struct undo_log *log = c->log;
+      ptrdiff_t start = (c->offset
+			 + undo_record_size (undo_log_record (log,
+							      c->offset)));
+      log->size -= start;
+      memmove (log->records, log->records + start, log->size);
+      log->last = -1;
+      for (ptrdiff_t offset = 0; offset < log->size; )
+	{
+	  struct undo_record *r = undo_log_record (log, offset);
+	  r->prev = log->last;
+	  log->last = offset;
+	  offset += undo_record_size (r);
+	}
+      bset_undo_list (b, Qnil);
+    }
+  else if (!NILP (c->prev))
+    XSETCDR (c->prev, Qnil);
+  else
+    bset_undo_list (b, Qnil);
+}
+
 /* At garbage collection time, make an undo list shorter at the end,
    returning the truncated list.  How this is done depends on the
    variables undo-limit, undo-strong-limit and undo-outer-limit.
@@ -289,9 +776,10 @@ but another undo command will undo to the previous boundary.  */)
 void
 truncate_undo_list (struct buffer *b)
 {
-  Lisp_Object list;
-  Lisp_Object prev, next, last_boundary;
+  struct undo_cursor c, last_boundary;
+  bool boundary_found = false;
   intmax_t size_so_far = 0;
+  ptrdiff_t first_change_length = 0;
 
   /* Make sure that calling undo-outer-limit-function
      won't cause another GC.  */
@@ -303,21 +791,17 @@ truncate_undo_list (struct buffer *b)
   record_unwind_current_buffer ();
   set_buffer_internal (b);
 
-  list = BVAR (b, undo_list);
-
-  prev = Qnil;
-  next = list;
-  last_boundary = Qnil;
+  undo_cursor_init (&c, b);
 
   /* If the first element is an undo boundary, skip past it.  */
-  if (CONSP (next) && NILP (XCAR (next)))
+  if (undo_cursor_more_p (&c) && undo_cursor_boundary_p (&c))
     {
       /* Add in the space occupied by this element and its chain link.  */
       size_so_far += sizeof (struct Lisp_Cons);
 
       /* Advance to next element.  */
-      prev = next;
-      next = XCDR (next);
+      undo_cursor_advance (&c);
+      first_change_length++;
     }
 
   /* Always preserve at least the most recent undo record
@@ -326,24 +810,14 @@ truncate_undo_list (struct buffer *b)
      Skip, skip, skip the undo, skip, skip, skip the undo,
      Skip, skip, skip the undo, skip to the undo bound'ry.  */
 
-  while (CONSP (next) && ! NILP (XCAR (next)))
+  while (undo_cursor_more_p (&c) && ! undo_cursor_boundary_p (&c))
     {
-      Lisp_Object elt;
-      elt = XCAR (next);
-
       /* Add in the space occupied by this element and its chain link.  */
-      size_so_far += sizeof (struct Lisp_Cons);
-      if (CONSP (elt))
-	{
-	  size_so_far += sizeof (struct Lisp_Cons);
-	  if (STRINGP (XCAR (elt)))
-	    size_so_far += (sizeof (struct Lisp_String) - 1
-			    + SCHARS (XCAR (elt)));
-	}
+      size_so_far += undo_cursor_size (&c);
 
       /* Advance to next element.  */
-      prev = next;
-      next = XCDR (next);
+      undo_cursor_advance (&c);
+      first_change_length++;
     }
 
   /* If by the first boundary we have already passed undo_outer_limit,
@@ -357,6 +831,10 @@ truncate_undo_list (struct buffer *b)
     {
       Lisp_Object tem;
 
+      /* The function sees the whole undo list, so convert the log into
+	 it.  */
+      buffer_undo_list (b);
+
       /* Normally the function this calls is undo-outer-limit-truncate.  */
       tem = calln (Vundo_outer_limit_function, make_int (size_so_far));
       if (! NILP (tem))
@@ -366,54 +844,55 @@ truncate_undo_list (struct buffer *b)
 	  unbind_to (count, Qnil);
 	  return;
 	}
+
+      undo_cursor_init (&c, b);
+      for (ptrdiff_t i = 0; i < first_change_length && undo_cursor_more_p (&c);
+	   i++)
+	undo_cursor_advance (&c);
     }
 
-  if (CONSP (next))
-    last_boundary = prev;
+  if (undo_cursor_more_p (&c))
+    {
+      last_boundary = c;
+      boundary_found = true;
+    }
 
   /* Keep additional undo data, if it fits in the limits.  */
-  while (CONSP (next))
+  while (undo_cursor_more_p (&c))
     {
-      Lisp_Object elt;
-      elt = XCAR (next);
-
       /* When we get to a boundary, decide whether to truncate
 	 either before or after it.  The lower threshold, undo_limit,
 	 tells us to truncate after it.  If its size pushes past
 	 the higher threshold undo_strong_limit, we truncate before it.  */
-      if (NILP (elt))
+      if (undo_cursor_boundary_p (&c))
 	{
 	  if (size_so_far > undo_strong_limit)
 	    break;
-	  last_boundary = prev;
+	  last_boundary = c;
+	  boundary_found = true;
 	  if (size_so_far > undo_limit)
 	    break;
 	}
 
       /* Add in the space occupied by this element and its chain link.  */
-      size_so_far += sizeof (struct Lisp_Cons);
-      if (CONSP (elt))
-	{
-	  size_so_far += sizeof (struct Lisp_Cons);
-	  if (STRINGP (XCAR (elt)))
-	    size_so_far += (sizeof (struct Lisp_String) - 1
-			    + SCHARS (XCAR (elt)));
-	}
+      size_so_far += undo_cursor_size (&c);
 
       /* Advance to next element.  */
-      prev = next;
-      next = XCDR (next);
+      undo_cursor_advance (&c);
     }
 
   /* If we scanned the whole list, it is short enough; don't change it.  */
-  if (NILP (next))
+  if (!undo_cursor_more_p (&c))
     ;
   /* Truncate at the boundary where we decided to truncate.  */
-  else if (!NILP (last_boundary))
-    XSETCDR (last_boundary, Qnil);
+  else if (boundary_found)
+    undo_cursor_truncate (&last_boundary, b);
   /* There's nothing we decided to keep, so clear it out.  */
   else
-    bset_undo_list (b, Qnil);
+    {
+      bset_undo_list (b, Qnil);
+      free_undo_log (b);
+    }
 
   unbind_to (count, Qnil);
 }
@@ -487,4 +966,17 @@ so it must make sure not to do a lot of consing.  */);
   DEFVAR_BOOL ("undo-inhibit-record-point", undo_inhibit_record_point,
 	       doc: /* Non-nil means do not record `point' in `buffer-undo-list'.  */);
   undo_inhibit_record_point = false;
+
+  DEFVAR_BOOL ("undo-compact-log", undo_compact_log,
+	       doc: /* Non-nil means record changes for undo in a compact form.
+Insertions, deletions and undo boundaries are then recorded in a
+compact log attached to the buffer text, rather than as elements of
+`buffer-undo-list', and consecutive insertions or deletions are
+combined there.  This reduces the memory and time it takes to record
+many small changes.  The log is converted into elements of
+`buffer-undo-list' whenever that variable is used, so this makes no
+difference to the undo commands or to Lisp programs.
+
+This variable can be set buffer-locally.  */);
+  undo_compact_log = false;
 }
@@ -493,6 +493,7 @@ along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.  */
 #include "intervals.h"
 #include "coding.h"
 #include "region-cache.h"
+#include "line-index.h"
 #include "font.h"
 #include "fontset.h"
 #include "blockinput.h"
@@ -29911,6 +29912,27 @@ display_count_lines (ptrdiff_t start_byte,
     = (!NILP (BVAR (current_buffer, selective_display))
        && !FIXNUMP (BVAR (current_buffer, selective_display)));
 
+  /* Counting many lines over a long stretch of text is faster with
+     the line index, which however knows only about newlines.  */
+  if (!selective_display && eabs (count) >= LINE_INDEX_MIN_COUNT)
+    {
+      struct line_index *line_index
+	= buffer_line_index (current_buffer, eabs (limit_byte - start_byte));
+
+      if (line_index)
+	{
+	  ptrdiff_t counted;
+
+	  *byte_pos_ptr = line_index_scan (current_buffer, line_index,
+					   start_byte, limit_byte, count,
+					   &counted);
+	  /* See below for why the last newline found doesn't count
+	     when scanning backwards.  */
+	  return (counted == count && count < 0
+		  ? - count - 1 : eabs (counted));
+	}
+    }
+
   if (count > 0)
     {
       while (start_byte < limit_byte)
@@ -697,6 +697,125 @@ unquoted file names."
       (tmpdir nospecial-dir t)
     (should-error (directory-files-and-attributes nospecial-dir))))
 
+(ert-deftest files-tests-directory-files-walk ()
+  "Test `directory-files-walk'."
+  (ert-with-temp-directory dir
+    (dolist (file '("a" "b.el" "sub/c.el" "sub/deep/d.el" "sub/deep/e"
+                    "skip/f.el"))
+      (make-empty-file (expand-file-name file dir) t))
+    (let ((walk (lambda (&rest args)
+                  (sort (mapcar (lambda (file) (file-relative-name file dir))
+                                (apply #'directory-files-walk dir args))))))
+      (should (equal (funcall walk)
+                     '("a" "b.el" "skip/" "skip/f.el" "sub/" "sub/c.el"
+                       "sub/deep/" "sub/deep/d.el" "sub/deep/e")))
+      (should (equal (funcall walk nil "\\.el\\'")
+                     '("b.el" "skip/f.el" "sub/c.el" "sub/deep/d.el")))
+      (should (equal (funcall walk nil "\\.el\\'" "\\`skip\\'")
+                     '("b.el" "sub/c.el" "sub/deep/d.el")))
+      (should (equal (funcall walk nil nil
+                              (lambda (file) (string-suffix-p "/deep/" file))
+                              1)
+                     '("a" "b.el" "skip/" "skip/f.el" "sub/" "sub/c.el")))
+      (should (equal (funcall walk nil nil nil 0)
+                     '("a" "b.el" "skip/" "sub/")))
+      ;; FUNCTION gets all the files, in batches.
+      (let ((files nil))
+        (should-not (directory-files-walk
+                     dir (lambda (batch) (setq files (append batch files)))))
+        (should (equal (sort files) (sort (directory-files-walk dir))))))
+    (should-error (directory-files-walk (expand-file-name "a" dir))
+                  :type 'file-error)
+    (should-error (directory-files-walk (expand-file-name "none" dir))
+                  :type 'file-missing)))
+
+(ert-deftest files-tests-directory-files-walk-symlinks ()
+  "Test that `directory-files-walk' does not follow cycles of links."
+  (ert-with-temp-directory dir
+    (make-empty-file (expand-file-name "sub/file" dir) t)
+    (skip-unless
+     (ignore-errors
+       (make-symbolic-link ".." (expand-file-name "sub/up" dir))
+       t))
+    (let ((files (mapcar (lambda (file) (file-relative-name file dir))
+                         (directory-files-walk dir))))
+      (should (equal (sort files) '("sub/" "sub/file" "sub/up"))))
+    (let ((files (mapcar (lambda (file) (file-relative-name file dir))
+                         (directory-files-walk dir nil nil nil nil t))))
+      (should (equal (sort files) '("sub/" "sub/file" "sub/up/"))))))
+
+(ert-deftest files-tests-file-attributes-list ()
+  "Test that `file-attributes-list' is like `file-attributes'."
+  (ert-with-temp-directory dir
+    (dotimes (i 300)
+      (make-empty-file (expand-file-name (format "file%d" i) dir)))
+    (ignore-errors
+      (make-symbolic-link "file1" (expand-file-name "link" dir)))
+    (let* ((default-directory (file-name-as-directory dir))
+           (files (append (directory-files dir t) '("none" "file2"))))
+      ;; Reading the link may change its access time once.
+      (mapc #'file-attributes files)
+      (dolist (id-format '(integer string))
+        (should (equal (file-attributes-list files id-format)
+                       (mapcar (lambda (file)
+                                 (file-attributes file id-format))
+                               files)))))))
+
+(ert-deftest files-tests-cache-file-attributes ()
+  "Test that cached file attributes follow changes to the files."
+  (ert-with-temp-directory dir
+    (let* ((cache-file-attributes t)
+           (sub (expand-file-name "sub" dir))
+           (file (expand-file-name "file" sub)))
+      (make-directory sub)
+      (should-not (file-attributes file))
+      (write-region "abc" nil file nil 'silent)
+      (should (equal (file-attribute-size (file-attributes file)) 3))
+      (write-region "abcdef" nil file nil 'silent)
+      (should (equal (file-attribute-size (file-attributes file)) 6))
+      (set-file-modes file #o600)
+      (should (equal (file-attribute-modes (file-attributes file 'string))
+                     "-rw-------"))
+      ;; Adding a file changes the attributes of its directory.
+      (file-attributes sub)
+      (sleep-for 0.01)
+      (write-region "" nil (expand-file-name "new" sub) nil 'silent)
+      (should (equal (file-attributes sub)
+                     (let ((cache-file-attributes nil))
+                       (file-attributes sub))))
+      ;; Renaming a directory changes what the names below it mean.
+      (rename-file sub (expand-file-name "old" dir))
+      (should-not (file-attributes file))
+      (make-directory sub)
+      (write-region "a" nil file nil 'silent)
+      (should (equal (file-attribute-size (file-attributes file)) 1))
+      (delete-file file)
+      (should-not (file-attributes file)))))
+
+(ert-deftest files-tests-cache-file-attributes-symlink ()
+  "Test that cached file attributes follow changes to symbolic links."
+  (ert-with-temp-directory dir
+    (let* ((cache-file-attributes t)
+           (link (expand-file-name "link" dir))
+           (file (expand-file-name "file" link))
+           (new (expand-file-name "new" dir)))
+      (dolist (target '("a" "b"))
+        (make-directory (expand-file-name target dir)))
+      (write-region "a" nil (expand-file-name "a/file" dir) nil 'silent)
+      (write-region "bb" nil (expand-file-name "b/file" dir) nil 'silent)
+      (skip-unless (ignore-errors (make-symbolic-link "a" link) t))
+      (should (equal (file-attribute-size (file-attributes file)) 1))
+      ;; Retarget the link by renaming another over it, as "ln -sfn"
+      ;; does.
+      (make-symbolic-link "b" new)
+      (rename-file new link t)
+      (should (equal (file-attribute-size (file-attributes file)) 2))
+      ;; The new target is watched.
+      (write-region "bbb" nil file nil 'silent)
+      (should (equal (file-attribute-size (file-attributes file)) 3))
+      (delete-file link)
+      (should-not (file-attributes file)))))
+
 (defvar w32-downcase-file-names)
 
 (ert-deftest files-tests-directory-files-recursively-w32 ()
@@ -2302,5 +2421,61 @@ Prompt users for any modified buffer with `buffer-offer-save' non-nil."
   (should (file-expand-wildcards
            (concat (directory-file-name default-directory) "*/"))))
 
+(ert-deftest files-tests-insert-file-contents-async ()
+  "Test inserting files in the background, in several slices."
+  (let ((insert-file-contents-async-slice-size 100))
+    (dolist (test '((utf-8-unix "café\nλ\n")
+                    (utf-8-dos "line\r\nλ line\r\n")
+                    (latin-1-unix "caf\351\n")
+                    (undecided "dos line\r\n")))
+      (ert-with-temp-file file
+        (let ((coding-system-for-write 'no-conversion)
+              (bytes (apply #'concat (make-list 50 (cadr test)))))
+          (write-region bytes nil file nil 'silent)
+          (with-temp-buffer
+            (insert "<>")
+            (goto-char 2)
+            (let* ((coding-system-for-read
+                    (unless (eq (car test) 'undecided) (car test)))
+                   (done nil)
+                   (result 'none))
+              (insert-file-contents-async file (lambda (err)
+                                                 (setq result err done t)))
+              ;; Moving point does not change where the text goes.
+              (goto-char (point-max))
+              (let ((n 0))
+                (while (and (not done) (< n 200))
+                  (accept-process-output nil 0.05)
+                  (setq n (1+ n))))
+              (should (null result))
+              (should (equal (buffer-string)
+                             (concat "<"
+                                     (with-temp-buffer
+                                       (insert-file-contents file)
+                                       (buffer-string))
+                                     ">"))))))))))
+
+(ert-deftest files-tests-insert-file-contents-async-error ()
+  "Test errors and cancellation of `insert-file-contents-async'."
+  (with-temp-buffer
+    (let (done result)
+      (insert-file-contents-async "/nonexistent/file"
+                                  (lambda (err) (setq result err done t)))
+      (let ((n 0))
+        (while (and (not done) (< n 200))
+          (accept-process-output nil 0.05)
+          (setq n (1+ n))))
+      (should (eq (car result) 'file-missing))))
+  (ert-with-temp-file file
+    :text "contents\n"
+    (with-temp-buffer
+      (let* ((called nil)
+             (handle (insert-file-contents-async
+                      file (lambda (_err) (setq called t)))))
+        (insert-file-contents-async-cancel handle)
+        (sit-for 0.2)
+        (should-not called)
+        (should (equal (buffer-string) ""))))))
+
 (provide 'files-tests)
 ;;; files-tests.el ends here
@@ -181,6 +181,54 @@ Check fix for Bug#20623."
   (let ((buffer-file-coding-system 'utf-8-with-signature))
     (should (eq 'utf-8-with-signature (sgml-html-meta-run "utf-8")))))
 
+(ert-deftest mule-coding-detection-cache ()
+  "Test remembering the coding systems detected for large files."
+  (ert-with-temp-file file
+    :coding 'iso-latin-1-unix
+    :text (concat (make-string 3000 ?a) "\n\xe9t\xe9\n")
+    (let ((coding-detection-cache-threshold 1000)
+          (coding-detection-cache-file nil)
+          (coding-detection--cache nil)
+          (coding-detection--cache-modified nil)
+          (kill-emacs-hook nil)
+          (auto-coding-alist nil)
+          (file-coding-system-alist nil)
+          detected)
+      (with-temp-buffer
+        (insert-file-contents file t)
+        (setq detected buffer-file-coding-system)
+        (should (eq (cdr (gethash file coding-detection--cache)) detected)))
+      ;; The remembered coding system is used, even if the detection
+      ;; would give another one.
+      (puthash file (cons (car (gethash file coding-detection--cache))
+                          'iso-latin-2-unix)
+               coding-detection--cache)
+      (with-temp-buffer
+        (insert-file-contents file t)
+        (should (eq buffer-file-coding-system 'iso-latin-2-unix))
+        ;; Reverting uses it too.
+        (revert-buffer t t)
+        (should (eq buffer-file-coding-system 'iso-latin-2-unix)))
+      ;; A changed file is detected again.
+      (let ((coding-system-for-write 'iso-latin-1-unix))
+        (write-region "\xe0 la\n" nil file t))
+      (set-file-times file (time-add nil 10))
+      (with-temp-buffer
+        (insert-file-contents file t)
+        (should (eq buffer-file-coding-system detected)))
+      ;; A coding system forced with `coding-system-for-read' is not
+      ;; remembered, even after a lookup not followed by an insertion.
+      (clrhash coding-detection--cache)
+      (with-temp-buffer
+        (set-auto-coding file 0))
+      (with-temp-buffer
+        (let ((coding-system-for-read 'iso-latin-2-unix))
+          (insert-file-contents file t)))
+      (should-not (gethash file coding-detection--cache))
+      (with-temp-buffer
+        (insert-file-contents file t)
+        (should (eq buffer-file-coding-system detected))))))
+
 ;; Stop "Local Variables" above causing confusion when visiting this file.
 
 
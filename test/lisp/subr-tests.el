@@ -1792,5 +1792,41 @@ The argument names are important."
       (search-forward "c")
       (replace-match "ccc")))))
 
+(ert-deftest subr-test-coalesce-change-calls ()
+  "Test running the change hooks once with `coalesce-change-calls'."
+  (with-temp-buffer
+    (insert "foo bar foo bar foo\n")
+    (let (before after)
+      (add-hook 'before-change-functions
+                (lambda (beg end) (push (list beg end) before))
+                nil t)
+      (add-hook 'after-change-functions
+                (lambda (beg end len) (push (list beg end len) after))
+                nil t)
+      (should (= (coalesce-change-calls
+                  (lambda ()
+                    (replace-regexp-in-region "foo" "quux" (point-min)))
+                  (point-min) (point-max))
+                 3))
+      (should (equal before '((1 21))))
+      (should (equal after '((1 23 19))))
+      (should (equal (buffer-string) "quux bar quux bar quux\n"))
+      (setq before nil after nil)
+      (with-coalesced-change-calls
+        (goto-char 5)
+        (insert "x")
+        (goto-char 1)
+        (insert "y"))
+      (should (equal before '((1 6) (5 5))))
+      (should (equal after '((1 7 4))))
+      (should (equal (buffer-substring 1 7) "yquuxx"))
+      ;; The after-change functions run on a nonlocal exit.
+      (setq before nil after nil)
+      (should-error (with-coalesced-change-calls
+                      (insert "z")
+                      (delete-char 1)
+                      (error "Oops")))
+      (should (equal after '((2 3 1)))))))
+
 (provide 'subr-tests)
 ;;; subr-tests.el ends here
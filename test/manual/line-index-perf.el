@@ -0,0 +1,107 @@
+;;; line-index-perf.el --- Benchmark counting lines  -*- lexical-binding:t -*-
+
+;; Copyright (C) 2026 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Measure what it costs to show the line number in the mode line, and
+;; to go to a line, in a buffer with millions of lines, with and
+;; without the line index (see src/line-index.h).  Run with
+;;
+;;   emacs -Q -l line-index-perf.el -f line-index-perf-run
+;;
+;; and look at the results in the *Messages* buffer, or interactively
+;; with M-x line-index-perf-run.  The number of lines can be changed
+;; with `line-index-perf-lines'.  In batch mode, the mode line is never
+;; computed, so only the other measurements are made.
+
+;;; Code:
+
+(require 'benchmark)
+
+(defvar line-index-perf-lines 2000000
+  "Number of lines in the buffer used for benchmarking.")
+
+(defvar line-index-perf-repetitions 100
+  "Number of times each operation is timed.")
+
+(defun line-index-perf--fill ()
+  "Fill the current buffer with `line-index-perf-lines' lines."
+  (dotimes (i line-index-perf-lines)
+    (insert (format "Line %d of the text, with some words on it.\n" i))))
+
+(defun line-index-perf--mode-line (window)
+  "Show the line number of a random place of WINDOW's buffer.
+This is what redisplay does after a command moves far away, with
+`line-number-mode' on."
+  (let ((pos (1+ (random (buffer-size)))))
+    (set-window-start window pos)
+    (set-window-point window pos)
+    (goto-char pos)
+    (format-mode-line "%l" nil window)))
+
+(defun line-index-perf--redisplay ()
+  "Go to a random place of the current buffer and redisplay."
+  (goto-char (1+ (random (buffer-size))))
+  (redisplay t))
+
+(defun line-index-perf--typing ()
+  "Insert a line near the end of the current buffer and redisplay."
+  (goto-char (- (point-max) (random 1000)))
+  (insert "a new line\n")
+  (redisplay t))
+
+(defun line-index-perf--report (name function)
+  "Time calls to FUNCTION without arguments, and report them as NAME."
+  (let ((time (car (benchmark-call function line-index-perf-repetitions))))
+    (message "  %-24s %10.3f ms" name
+             (/ (* time 1000.0) line-index-perf-repetitions))))
+
+(defun line-index-perf-run ()
+  "Benchmark line counting with and without the line index."
+  (interactive)
+  (let ((buffer (get-buffer-create " *line-index-perf*"))
+        (window (selected-window)))
+    (with-current-buffer buffer
+      (erase-buffer)
+      (line-index-perf--fill)
+      (set-window-buffer window buffer)
+      (setq-local line-number-mode t)
+      (let ((line-number-display-limit nil))
+        (dolist (cache '(nil t))
+          (setq cache-long-scans cache)
+          (message "%d lines, cache-long-scans %s:"
+                   (count-lines (point-min) (point-max)) cache)
+          (unless noninteractive
+            (line-index-perf--report
+             "mode line %l" (lambda () (line-index-perf--mode-line window)))
+            (line-index-perf--report
+             "jump + redisplay" #'line-index-perf--redisplay)
+            (line-index-perf--report
+             "typing + redisplay" #'line-index-perf--typing))
+          (line-index-perf--report
+           "line-number-at-pos"
+           (lambda () (line-number-at-pos (1+ (random (buffer-size))))))
+          (line-index-perf--report
+           "goto-line"
+           (lambda ()
+             (goto-char (point-min))
+             (forward-line (random line-index-perf-lines)))))))
+    (kill-buffer buffer)))
+
+;;; line-index-perf.el ends here
@@ -0,0 +1,87 @@
+;;; process-epoll-perf.el --- Benchmark waiting for many processes  -*- lexical-binding:t -*-
+
+;; Copyright (C) 2026 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <https://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Measure how waiting for subprocess output scales with the number of
+;; subprocesses, with and without `process-use-epoll'.  Many idle
+;; processes are started, each of which has two pipes, and output is
+;; then exchanged with one more process, waiting for all of them each
+;; time.  Run with
+;;
+;;   emacs -Q --batch -l process-epoll-perf.el -f process-epoll-perf-run
+;;
+;; or interactively with M-x process-epoll-perf-run, and look at the
+;; results in the *Messages* buffer.  Emacs can only wait for
+;; descriptors below FD_SETSIZE, usually 1024, so the default of 480
+;; idle processes is about as many as it can have.
+
+;;; Code:
+
+(require 'benchmark)
+
+(defvar process-epoll-perf-processes '(0 120 240 480)
+  "Numbers of idle processes with which to measure.")
+
+(defvar process-epoll-perf-exchanges 5000
+  "Number of lines exchanged with the active process.")
+
+(defun process-epoll-perf--start (name &optional filter)
+  "Start a `cat' process called NAME with pipes, and FILTER if non-nil."
+  (make-process :name name :command '("cat") :connection-type 'pipe
+                :noquery t :filter filter))
+
+(defun process-epoll-perf--exchange ()
+  "Exchange `process-epoll-perf-exchanges' lines with a process.
+Return the time this took, in seconds."
+  (let* ((count 0)
+         (process (process-epoll-perf--start
+                   "active"
+                   (lambda (process string)
+                     (dotimes (i (length string))
+                       (when (eq (aref string i) ?\n)
+                         (setq count (1+ count))))
+                     (when (< count process-epoll-perf-exchanges)
+                       (process-send-string process "x\n"))))))
+    (unwind-protect
+        (car (benchmark-run 1
+               (process-send-string process "x\n")
+               (while (< count process-epoll-perf-exchanges)
+                 (accept-process-output nil 1))))
+      (delete-process process))))
+
+(defun process-epoll-perf-run ()
+  "Benchmark waiting for subprocess output with and without epoll."
+  (interactive)
+  (let ((process-adaptive-read-buffering nil)
+        (idle nil))
+    (unwind-protect
+        (dolist (n process-epoll-perf-processes)
+          (while (< (length idle) n)
+            (push (process-epoll-perf--start "idle") idle))
+          (message "%d idle processes:" n)
+          (dolist (epoll '(nil t))
+            (let ((process-use-epoll epoll))
+              (message "  process-use-epoll %-3s %10.3f us per line"
+                       epoll
+                       (/ (* (process-epoll-perf--exchange) 1e6)
+                          process-epoll-perf-exchanges)))))
+      (mapc #'delete-process idle))))
+
+;;; process-epoll-perf.el ends here
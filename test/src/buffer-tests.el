@@ -269,6 +269,60 @@ with parameters from the *Messages* buffer modification."
   (with-temp-buffer
     (should (eq (buffer-base-buffer (current-buffer)) nil))))
 
+(ert-deftest buffer-tests--snapshot ()
+  "Test that snapshots keep the text when their buffer changes."
+  (with-temp-buffer
+    (insert (propertize "hello" 'face 'bold) " world\n")
+    (dotimes (_ 1000)
+      (insert "some more text\n"))
+    (let* ((base (current-buffer))
+           (text (buffer-string))
+           (snaps (list (make-buffer-snapshot base))))
+      (unwind-protect
+          (progn
+            (should (equal (buffer-string) text))
+            (with-current-buffer (car snaps)
+              (should buffer-read-only)
+              (should (equal-including-properties (buffer-string) text))
+              (should (eq (syntax-table) (with-current-buffer base
+                                           (syntax-table))))
+              (should-error (insert "x") :type 'buffer-read-only))
+            ;; Move the gap, insert and delete text.
+            (goto-char 3)
+            (insert "abc")
+            (push (make-buffer-snapshot base) snaps)
+            (goto-char (point-max))
+            (delete-region 100 200)
+            (push (make-buffer-snapshot base "*snap*") snaps)
+            (erase-buffer)
+            (insert "new")
+            (should (equal (buffer-string) "new"))
+            (with-current-buffer (nth 0 snaps)
+              (should (equal (buffer-name) "*snap*"))
+              (should (equal (buffer-string)
+                             (concat (substring text 0 2) "abc"
+                                     (substring text 2 96)
+                                     (substring text 196)))))
+            (with-current-buffer (nth 1 snaps)
+              (should (equal (buffer-string)
+                             (concat (substring text 0 2) "abc"
+                                     (substring text 2))))
+              ;; Modifying a snapshot doesn't change the others.
+              (let ((inhibit-read-only t))
+                (goto-char (point-min))
+                (insert "x")))
+            (kill-buffer base)
+            (garbage-collect)
+            (with-current-buffer (nth 2 snaps)
+              (should (equal-including-properties (buffer-string) text))
+              (goto-char (point-min))
+              (should (search-forward "world" nil t))
+              (should (= (point) 12))
+              (should (re-search-forward "^\\(some\\) more" nil t))
+              (should (equal (match-string 1) "some"))
+              (should (equal (buffer-substring 1 6) "hello"))))
+        (mapc #'kill-buffer snaps)))))
+
 (ert-deftest buffer-tests--overlays-indirect-bug58928 ()
   (with-temp-buffer
     (insert "hello world")
@@ -8386,6 +8440,53 @@ dicta sunt, explicabo.  "))
     (remove-overlays)
     (should (= (length (overlays-in (point-min) (point-max))) 0))))
 
+;; `make-overlays' and `delete-overlays-in' build and filter the overlay
+;; tree as a whole when they change many overlays at once.
+(ert-deftest test-make-overlays ()
+  (with-temp-buffer
+    (insert (make-string 1000 ?a))
+    (make-overlay 10 20)
+    (let* ((ranges (vconcat (mapcar (lambda (i) (cons (+ i 5) i))
+                                    (number-sequence 1 990))
+                            '((2000 . 500))))
+           (overlays (make-overlays ranges nil nil t '(face bold))))
+      (should (= (length overlays) 991))
+      (should (equal (mapcar (lambda (ov) (cons (overlay-start ov)
+                                                (overlay-end ov)))
+                             (seq-take overlays 2))
+                     '((1 . 6) (2 . 7))))
+      (should (equal (cons (overlay-start (aref overlays 990))
+                           (overlay-end (aref overlays 990)))
+                     '(500 . 1001)))
+      (should (eq (overlay-get (aref overlays 0) 'face) 'bold))
+      (should-not (eq (overlay-properties (aref overlays 0))
+                      (overlay-properties (aref overlays 1))))
+      (should (= (length (overlays-in 1 1001)) 992))
+      (should (equal (sort (mapcar #'overlay-start (overlays-at 100)) #'<)
+                     '(96 97 98 99 100)))
+      ;; Unsorted ranges work too.
+      (should (= (length (make-overlays [(50 . 60) (5 . 6)])) 2))
+      (should (= (length (overlays-in 1 1001)) 994))))
+  (with-temp-buffer
+    (should-error (make-overlays [(1 . a)]))
+    (should-not (overlays-in (point-min) (point-max)))))
+
+(ert-deftest test-delete-overlays-in ()
+  (with-temp-buffer
+    (insert (make-string 1000 ?a))
+    (let ((overlays (make-overlays
+                     (vconcat (mapcar (lambda (i) (cons i (1+ i)))
+                                      (number-sequence 1 999))))))
+      (dotimes (i 999)
+        (overlay-put (aref overlays i) 'tag (% i 2)))
+      (should (= (delete-overlays-in 100 200 'tag 1) 50))
+      (should (= (length (overlays-in 100 200)) 50))
+      (should-not (overlay-buffer (aref overlays 99)))
+      (should (overlay-buffer (aref overlays 100)))
+      (should (= (delete-overlays-in 1 1001) 949))
+      (should-not (overlays-in (point-min) (point-max)))
+      (should (= (delete-overlays-in 1 1001) 0)))))
+
 (defun test-kill-buffer-auto-save (auto-save-answer body-func)
   "Test helper for `kill-buffer-delete-auto-save' tests.
 
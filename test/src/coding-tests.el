@@ -376,6 +376,38 @@
 			 (with-temp-buffer (insert-file-contents (car file))))))
 	  (insert (format "%s: %s\n" (car file) result)))))))
 
+(defun benchmark-eol-conversion (&optional lines)
+  "Measure how fast end-of-lines are converted when reading and writing.
+Read and write a file of LINES lines (default 1000000) with each
+end-of-line format, and insert the throughput in the current buffer."
+  (let ((gc-cons-threshold (max gc-cons-threshold 4000000))
+        (results (current-buffer))
+        (file (make-temp-file "coding-eol"))
+        (text (with-temp-buffer
+                (dotimes (i (or lines 1000000))
+                  (insert (if (= (% i 10) 0) "Ça, c'est une ligne " "A line ")
+                          (make-string 60 ?x) "\n"))
+                (buffer-string))))
+    (unwind-protect
+        (dolist (coding '(utf-8-unix utf-8-dos utf-8-mac
+                          latin-1-unix latin-1-dos))
+          (let ((bytes (string-bytes (encode-coding-string text coding)))
+                (coding-system-for-write coding)
+                (coding-system-for-read coding))
+            (with-temp-buffer
+              (insert text)
+              (let ((write (car (benchmark-run 5
+                                  (write-region nil nil file nil 'quiet))))
+                    (read (car (benchmark-run 5
+                                 (with-temp-buffer
+                                   (insert-file-contents file))))))
+                (with-current-buffer results
+                  (insert (format "%-14s read %7.1f MB/s  write %7.1f MB/s\n"
+                                  coding
+                                  (/ (* 5 bytes) read 1e6)
+                                  (/ (* 5 bytes) write 1e6))))))))
+      (delete-file file))))
+
 (ert-deftest coding-nocopy-trivial ()
   "Check that the NOCOPY parameter works for the trivial coding system."
   (let ((s "abc"))
@@ -430,5 +462,148 @@
                  '((iso-latin-1 3) (us-ascii 1 3))))
   (should-error (check-coding-systems-region "å" nil '(bad-coding-system))))
 
+;; Decoding UTF-8 handles runs of ASCII and valid sequences in bulk;
+;; make sure the result is what decoding each piece alone gives.
+(ert-deftest coding-decode-utf-8-runs ()
+  (let ((pieces (append (mapcar (lambda (s) (encode-coding-string s 'utf-8))
+                                '("é" "€" "𝄞" "日本語"))
+                        (list "abc" "\n" (make-string 100 ?a)
+                              "\xff" "\xc0\xaf" "\xed\xa0\x80" "\xe2\x82"
+                              "\xf0\x9d"))))
+    (random "coding-decode-utf-8-runs")
+    (dotimes (_ 20)
+      (let ((encoded nil) (decoded nil))
+        (dotimes (_ 2000)
+          (let ((piece (nth (random (length pieces)) pieces)))
+            (push piece encoded)
+            (push (decode-coding-string piece 'utf-8-unix) decoded)))
+        (should (equal (decode-coding-string (apply #'concat encoded)
+                                             'utf-8-unix)
+                       (apply #'concat decoded)))))))
+
+(ert-deftest coding-detection-sample ()
+  "Test detecting the encoding of a large text from a sample."
+  (let* ((line (encode-coding-string "Ünïcödé text\n" 'utf-8))
+         (text (apply #'concat (make-list 20000 line)))
+         (middle (* (length line) 10000))
+         ;; An invalid byte that the sample misses.
+         (invalid (concat (substring text 0 middle) "\xff"
+                          (substring text middle)))
+         (file (make-temp-file "coding-tests")))
+    (unwind-protect
+        (progn
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region invalid nil file nil 'nomessage))
+          (let ((coding-detection-sample-size nil))
+            (should (eq (detect-coding-string text t) 'utf-8-unix))
+            (should (eq (detect-coding-string invalid t) 'raw-text-unix)))
+          (let ((coding-detection-sample-size 4096))
+            (should (eq (detect-coding-string text t) 'utf-8-unix))
+            (should (eq (detect-coding-string invalid t) 'utf-8-unix))
+            ;; The whole file is still decoded correctly.
+            (with-temp-buffer
+              (insert-file-contents file)
+              (should (eq last-coding-system-used 'utf-8-unix))
+              (should (equal (buffer-string)
+                             (decode-coding-string invalid 'utf-8-unix))))))
+      (delete-file file))))
+
+(ert-deftest coding-decode-large-file ()
+  "Test decoding a file large enough to be decoded in parallel."
+  (let ((pieces (append (mapcar (lambda (s) (encode-coding-string s 'utf-8))
+                                '("é" "€" "𝄞" "日本語"))
+                        (list "abc" "\n" "\r\n" "\r" "\r\xff" (make-string 100 ?a)
+                              "\xff" "\xc0\xaf" "\xed\xa0\x80" "\xe2\x82"
+                              "\xf0\x9d" "\xf8\x88\x80\x80\x80")))
+        (file (make-temp-file "coding-tests"))
+        encoded text)
+    (random "coding-decode-large-file")
+    (dotimes (_ 300000)
+      (push (nth (random (length pieces)) pieces) encoded))
+    (setq text (mapconcat #'identity encoded))
+    (unwind-protect
+        (progn
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region text nil file nil 'nomessage))
+          (dolist (coding '(utf-8 utf-8-unix utf-8-dos utf-8-mac raw-text-dos))
+            (with-temp-buffer
+              (insert "<>")
+              (goto-char 2)
+              (let ((coding-system-for-read coding))
+                (insert-file-contents file))
+              (let ((used last-coding-system-used))
+                (should (eq (compare-strings
+                             (buffer-string) nil nil
+                             (concat "<" (decode-coding-string text coding) ">")
+                             nil nil)
+                            t))
+                (should (eq used last-coding-system-used))))))
+      (delete-file file))
+    ;; The multibyte form of a raw-byte character is shorter than its
+    ;; UTF-8 sequence.
+    (setq text (concat (make-string (* 6 1024 1024) ?a)
+                       "\xf8\x8f\xbf\xbe\x80"))
+    (setq file (make-temp-file "coding-tests"))
+    (unwind-protect
+        (progn
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region text nil file nil 'nomessage))
+          (with-temp-buffer
+            (let ((coding-system-for-read 'utf-8))
+              (insert-file-contents file))
+            (should (= (buffer-size) (1+ (* 6 1024 1024))))
+            (should (eq (char-before (point-max))
+                        (unibyte-char-to-multibyte #x80)))
+            (should (= (position-bytes (point-max))
+                       (+ (position-bytes (1- (point-max)))
+                          (string-bytes (string (char-before (point-max)))))))
+            (should (equal (buffer-string)
+                           (decode-coding-string text 'utf-8)))))
+      (delete-file file))
+    (should (equal (decode-coding-string "\r\xff" 'utf-8-dos)
+                   (string ?\r (unibyte-char-to-multibyte #xff))))))
+
+(ert-deftest coding-eol-conversion ()
+  "Check converting end-of-lines in buffers, with and without markers."
+  (let ((file (make-temp-file "coding-tests")))
+    (unwind-protect
+        (dolist (test '(("a\r\nb\r\r\nc\rd\r\n\r" dos "a\nb\r\nc\rd\n\r")
+                        ("a\r\nb\r\r\nc\rd\r\n\r" mac
+                         "a\n\nb\n\n\nc\nd\n\n\n")
+                        ("é\r\nλ\r\n" dos "é\nλ\n")
+                        ("a\r\nb\r\nc\r\n" nil "a\nb\nc\n")
+                        ("a\rb\rc\r" nil "a\nb\nc\n")))
+          (pcase-let* ((`(,bytes ,eol ,text) test)
+                       (coding (if eol
+                                   (coding-system-change-eol-conversion
+                                    'utf-8 eol)
+                                 'utf-8))
+                       (encoded (encode-coding-string bytes 'utf-8-unix)))
+            (let ((coding-system-for-write 'no-conversion))
+              (write-region encoded nil file nil 'nomessage))
+            (with-temp-buffer
+              (let ((coding-system-for-read coding))
+                (insert-file-contents file))
+              (should (equal (buffer-string) text)))
+            ;; Text with a marker inside is converted in the same way.
+            (with-temp-buffer
+              (insert "x" encoded)
+              (let ((marker (copy-marker 3)))
+                (decode-coding-region 2 (point-max) coding)
+                (should (equal (buffer-substring 2 (point-max)) text))
+                (should (<= 2 marker (point-max)))))
+            ;; Encoding turns the newlines back into the end-of-lines.
+            (when eol
+              (with-temp-buffer
+                (insert text)
+                (let ((coding-system-for-write coding))
+                  (write-region nil nil file nil 'nomessage)))
+              (with-temp-buffer
+                (set-buffer-multibyte nil)
+                (insert-file-contents-literally file)
+                (should (equal (buffer-string)
+                               (encode-coding-string text coding)))))))
+      (delete-file file))))
+
 (provide 'coding-tests)
 ;;; coding-tests.el ends here
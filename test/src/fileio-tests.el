@@ -277,5 +277,202 @@ Also check that an encoding error can appear in a symlink."
       ;; We should have prompted about the supersession threat.
       (should asked))))
 
+(ert-deftest fileio-tests--insert-file-contents-mapped ()
+  "Test inserting files mapped into memory."
+  (let ((file-mapping-threshold 1))
+    (dolist (test '(("ascii\nonly\n" utf-8 "ascii\nonly\n")
+                    ("caf\303\251\n" utf-8 "café\n")
+                    ("dos\r\nline\r\n" undecided "dos\nline\n")
+                    ("\351t\351\n" latin-1 "été\n")
+                    ("\0\1\377" no-conversion "\0\1\377")))
+      (pcase-let ((`(,bytes ,coding ,text) test))
+        (ert-with-temp-file file
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region bytes nil file))
+          (with-temp-buffer
+            (set-buffer-multibyte (not (eq coding 'no-conversion)))
+            (let ((coding-system-for-read coding))
+              (insert-file-contents file))
+            (should (equal (buffer-string) text))
+            ;; Modifying the buffer copies the text, and leaves the
+            ;; file alone.
+            (goto-char (point-max))
+            (insert "end")
+            (goto-char (point-min))
+            (delete-char 1)
+            (should (equal (buffer-string)
+                           (concat (substring text 1) "end"))))
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (insert-file-contents-literally file)
+            (should (equal (buffer-string) bytes))
+            ;; Making the buffer multibyte copies the text.
+            (set-buffer-multibyte t)
+            (let ((coding-system-for-write 'no-conversion))
+              (write-region "changed" nil file))
+            (should (equal (buffer-string)
+                           (decode-coding-string bytes 'utf-8-emacs-unix)))))))))
+
+(ert-deftest fileio-tests--insert-file-contents-mapped-truncated ()
+  "Test truncating a file mapped into memory."
+  (skip-unless (not (memq system-type '(windows-nt ms-dos))))
+  (let ((file-mapping-threshold 1)
+        (bytes (make-string (* 4 65536) ?x)))
+    (ert-with-temp-file file
+      (with-temp-buffer
+        (set-buffer-multibyte nil)
+        (write-region bytes nil file nil 'silent)
+        (insert-file-contents-literally file)
+        ;; Truncating the file in place loses the text past its new
+        ;; end, which then reads as null bytes, and signals an error
+        ;; rather than crashing Emacs.
+        (write-region "xyz" nil file nil 'silent)
+        (let (text)
+          (should-error (progn (setq text (buffer-string))
+                               (dotimes (_ 2) (ignore)))
+                        :type 'file-error)
+          (should (= (length text) (length bytes)))
+          (should (string-prefix-p "xyz" text))
+          (should (string-suffix-p "\0\0\0" text)))
+        (should (= (buffer-size) (length bytes)))
+        (goto-char (point-max))
+        (insert "end")
+        (should (string-suffix-p "\0end" (buffer-string)))))))
+
+(ert-deftest fileio-tests--write-region-as-is ()
+  "Check writing text that needs no encoding, and text that does."
+  (dolist (text (list "ascii\nonly\n" "café\nλ\n"
+                      (concat "raw " (string #x3fff80 #x3fffc1) "\n")))
+    (dolist (coding '(utf-8-unix utf-8-emacs-unix raw-text-unix
+                      utf-8-dos utf-8-with-signature-unix))
+      (ert-with-temp-file file
+        (with-temp-buffer
+          (insert text text)
+          ;; Put the gap in the middle of the text.
+          (goto-char (1+ (length text)))
+          (insert "x")
+          (delete-char -1)
+          (let ((coding-system-for-write coding))
+            (write-region nil nil file))
+          (let ((expected (encode-coding-string (buffer-string) coding)))
+            (with-temp-buffer
+              (set-buffer-multibyte nil)
+              (insert-file-contents-literally file)
+              (should (equal (buffer-string) expected)))))))))
+
+(defun fileio-tests--wait (predicate)
+  "Wait for up to 10 seconds for PREDICATE to return non-nil."
+  (let ((n 0))
+    (while (and (not (funcall predicate)) (< n 200))
+      (accept-process-output nil 0.05)
+      (setq n (1+ n)))))
+
+(ert-deftest fileio-tests--file-read-async ()
+  "Check reading files in the background."
+  (ert-with-temp-file file
+    :text (mapconcat #'number-to-string (number-sequence 1 100000) "\n")
+    (let ((expected (with-temp-buffer
+                      (set-buffer-multibyte nil)
+                      (insert-file-contents-literally file)
+                      (buffer-string)))
+          results)
+      (dolist (range '((nil nil) (10 20) (100 nil) (20 10)))
+        (file-read-async file
+                         (lambda (data err) (push (list range data err) results))
+                         (car range) (cadr range)))
+      (fileio-tests--wait (lambda () (= (length results) 4)))
+      (should (= (length results) 4))
+      (dolist (result results)
+        (let ((beg (or (car (nth 0 result)) 0))
+              (end (or (cadr (nth 0 result)) (length expected))))
+          (should-not (nth 2 result))
+          (should-not (multibyte-string-p (nth 1 result)))
+          (should (equal (nth 1 result)
+                         (substring expected beg (max beg end))))))))
+  (let (result done)
+    (file-read-async "/nonexistent/file"
+                     (lambda (data err) (setq result (list data err) done t)))
+    (fileio-tests--wait (lambda () done))
+    (should (equal (car result) nil))
+    (should (eq (car (cadr result)) 'file-missing))))
+
+(ert-deftest fileio-tests--file-read-async-cancel ()
+  "Check that a cancelled read does not call its callback."
+  (ert-with-temp-file file
+    :text "contents\n"
+    (let* ((called nil)
+           (done nil)
+           (id (file-read-async file (lambda (_data _err) (setq called t)))))
+      (file-read-async file (lambda (_data _err) (setq done t)))
+      (let ((cancelled (file-read-async-cancel id)))
+        (fileio-tests--wait (lambda () done))
+        (should done)
+        (should (eq called (not cancelled)))))))
+
+(ert-deftest fileio-tests--do-auto-save-async ()
+  "Check auto-saving in the background."
+  (ert-with-temp-directory dir
+    (let ((file (expand-file-name "#auto-save#" dir))
+          (elapsed auto-save-elapsed))
+      (with-temp-buffer
+        (setq buffer-auto-save-file-name file)
+        (dotimes (i 10000)
+          (insert (format "Line %d, \u00e9\n" i)))
+        (insert "\200\377" (unibyte-string #xe9))
+        (do-auto-save t nil t)
+        ;; Wait for the file to be written.
+        (do-auto-save t)
+        (should (> auto-save-elapsed elapsed))
+        (should (equal (with-temp-buffer
+                         (set-buffer-multibyte nil)
+                         (insert-file-contents-literally file)
+                         (buffer-string))
+                       (encode-coding-string (buffer-string)
+                                             'utf-8-emacs-unix)))
+        ;; The file is not written again once deleted.
+        (insert "more")
+        (do-auto-save t nil t)
+        (set-buffer-modified-p nil)
+        (delete-file file)
+        (do-auto-save t)
+        (should-not (file-exists-p file))))))
+
+(ert-deftest fileio-tests--copy-file-async ()
+  "Check copying files in the background."
+  (ert-with-temp-directory dir
+    (let ((file (expand-file-name "file" dir))
+          (newname (expand-file-name "newname" dir))
+          (contents (mapconcat #'number-to-string (number-sequence 1 100000)
+                               "\n"))
+          result progress)
+      (with-temp-file file
+        (insert contents))
+      (set-file-times file 1000)
+      (copy-file-async file newname (lambda (err) (setq result (list err)))
+                       nil t (lambda (copied size) (push (cons copied size)
+                                                         progress)))
+      (fileio-tests--wait (lambda () result))
+      (should (equal result '(nil)))
+      (should (equal (car progress)
+                     (cons (length contents) (length contents))))
+      (should (equal (with-temp-buffer
+                       (insert-file-contents newname)
+                       (buffer-string))
+                     contents))
+      (should (time-equal-p (file-attribute-modification-time
+                             (file-attributes newname))
+                            1000))
+      (should-error (copy-file-async file newname #'ignore)
+                    :type 'file-already-exists)
+      (let* ((called nil)
+             (done nil)
+             (copy (copy-file-async file newname
+                                    (lambda (_err) (setq called t)) t)))
+        (copy-file-async file (expand-file-name "other" dir)
+                         (lambda (_err) (setq done t)))
+        (let ((cancelled (copy-file-async-cancel copy)))
+          (fileio-tests--wait (lambda () done))
+          (should done)
+          (should (eq called (not cancelled))))))))
 
 ;;; fileio-tests.el ends here
@@ -1636,6 +1636,52 @@
     (should-error (line-number-at-pos -1))
     (should-error (line-number-at-pos 100))))
 
+(defun fns-tests--newline-after (n)
+  "Return the position after the Nth newline from point-min, or nil."
+  (save-excursion
+    (goto-char (point-min))
+    (and (search-forward "\n" nil t n) (point))))
+
+(ert-deftest test-line-number-at-position-large ()
+  "Check line counts in a buffer big enough to have a line index."
+  (with-temp-buffer
+    (setq-local cache-long-scans t)
+    (random "line-index")
+    (dotimes (i 4000)
+      (insert (make-string (random 60) (if (zerop (% i 7)) ?é ?x)) "\n"))
+    (dotimes (_ 25)
+      ;; Modify the buffer at random...
+      (let ((pos (1+ (random (buffer-size)))))
+        (pcase (random 4)
+          (0 (goto-char pos)
+             (insert (apply #'concat (make-list (random 300) "é\nab"))))
+          (1 (delete-region pos (min (point-max) (+ pos (random 5000)))))
+          (2 (subst-char-in-region pos (min (point-max) (+ pos 200))
+                                   ?x ?\n))
+          (3 (goto-char (point-max))
+             (insert "tail\n"))))
+      ;; ...and check the line counts.
+      (dotimes (_ 3)
+        (let ((pos (1+ (random (buffer-size)))))
+          (should (= (line-number-at-pos pos)
+                     (1+ (how-many "\n" (point-min) pos))))))
+      (let ((n (+ 128 (random 3000)))
+            (total (how-many "\n" (point-min) (point-max))))
+        (goto-char (point-min))
+        (forward-line n)
+        (should (= (point) (if (<= n total)
+                               (fns-tests--newline-after n)
+                             (point-max))))
+        (goto-char (point-max))
+        (forward-line (- n))
+        (should (= (point) (if (< n total)
+                               (fns-tests--newline-after (- total n))
+                             (point-min))))
+        (should (= (count-lines (point-min) (point-max))
+                   (if (eq (char-before (point-max)) ?\n)
+                       total
+                     (1+ total))))))))
+
 (defun fns-tests-concat (&rest args)
   ;; Dodge the byte-compiler's partial evaluation of `concat' with
   ;; constant arguments.
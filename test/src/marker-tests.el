@@ -70,4 +70,113 @@
         (should-not (memq m3 ms))
         (should (all (lambda (m) (eq (marker-buffer m) (current-buffer))) ms))))))
 
+;; Check that markers keep their positions, both in characters and in
+;; bytes, through many changes.
+
+(defun marker-tests--check (markers)
+  "Check that each element of MARKERS, (MARKER . POS), is at POS."
+  (dolist (elt markers)
+    (let ((marker (car elt)))
+      (should (eq (marker-buffer marker) (current-buffer)))
+      (should (= (marker-position marker) (cdr elt)))
+      ;; `goto-char' uses the byte position of the marker.
+      (goto-char marker)
+      (should (= (position-bytes (point))
+                 (1+ (string-bytes (buffer-substring (point-min) (point)))))))))
+
+(defun marker-tests--insert (markers pos text before-markers)
+  "Insert TEXT at POS, and update MARKERS for it.
+If BEFORE-MARKERS is non-nil, use `insert-before-markers'."
+  (goto-char pos)
+  (if before-markers (insert-before-markers text) (insert text))
+  (dolist (elt markers)
+    (when (or (> (cdr elt) pos)
+              (and (= (cdr elt) pos)
+                   (or before-markers (marker-insertion-type (car elt)))))
+      (setcdr elt (+ (cdr elt) (length text))))))
+
+(defun marker-tests--delete (markers from to)
+  "Delete the text from FROM to TO, and update MARKERS for it."
+  (delete-region from to)
+  (dolist (elt markers)
+    (setcdr elt (cond ((> (cdr elt) to) (- (cdr elt) (- to from)))
+                      ((> (cdr elt) from) from)
+                      (t (cdr elt))))))
+
+(ert-deftest marker-random-changes ()
+  (random "marker-random-changes")
+  (with-temp-buffer
+    (let ((texts ["a" "bc" "é" "日本語" "x\n" "ü€ "])
+          (markers nil))
+      (dotimes (_ 50)
+        (insert (aref texts (random (length texts)))))
+      (dotimes (i 2000)
+        (let ((pos (1+ (random (1+ (buffer-size)))))
+              (text (aref texts (random (length texts)))))
+          (pcase (random 9)
+            ((or 0 1) (marker-tests--insert markers pos text nil))
+            (2 (marker-tests--insert markers pos text t))
+            (3 (marker-tests--delete markers pos
+                                     (min (point-max) (+ pos (random 10)))))
+            ((or 4 5)
+             (push (cons (copy-marker pos (zerop (random 2))) pos) markers))
+            (6 (when markers
+                 (let ((elt (nth (random (length markers)) markers)))
+                   (set-marker (car elt) pos)
+                   (setcdr elt pos))))
+            (7 (when markers
+                 (let ((elt (nth (random (length markers)) markers)))
+                   (set-marker (car elt) nil)
+                   (setq markers (delq elt markers)))))
+            ;; Leave a marker to the garbage collector.
+            (8 (when markers
+                 (setq markers (delq (nth (random (length markers)) markers)
+                                     markers))
+                 (when (zerop (random 20))
+                   (garbage-collect)))))
+          (when (zerop (% i 10))
+            (marker-tests--check markers))))
+      (marker-tests--check markers)
+      ;; The conversions between characters and bytes use the markers.
+      (dotimes (_ 200)
+        (let ((pos (1+ (random (1+ (buffer-size))))))
+          (should (= (position-bytes pos)
+                     (1+ (string-bytes (buffer-substring (point-min) pos)))))
+          (should (= (byte-to-position (position-bytes pos)) pos)))))))
+
+(ert-deftest marker-transpose-regions ()
+  (with-temp-buffer
+    (insert "ab日本cdé")
+    (let ((markers (mapcar #'copy-marker (number-sequence 1 8))))
+      (transpose-regions 1 3 4 7)
+      (should (equal (mapcar #'marker-position markers)
+                     '(5 6 4 1 2 3 7 8)))
+      (dolist (marker markers)
+        (goto-char marker)
+        (should (= (position-bytes (point))
+                   (1+ (string-bytes
+                        (buffer-substring (point-min) (point))))))))))
+
+(ert-deftest marker-position-conversions ()
+  "Check conversions between characters and bytes in a large buffer.
+These use the position index, which must follow the changes."
+  (random "marker-position-conversions")
+  (with-temp-buffer
+    (let ((texts ["ascii text, " "日本語のテキスト" "é\n" "😀"]))
+      (dotimes (_ 20000)
+        (insert (aref texts (random (length texts)))))
+      (dotimes (i 300)
+        (let ((pos (1+ (random (1+ (buffer-size))))))
+          (pcase (% i 3)
+            (0 (goto-char (1+ (random (1+ (buffer-size)))))
+               (insert (aref texts (random (length texts)))))
+            (1 (let ((from (1+ (random (buffer-size)))))
+                 (delete-region from (min (point-max)
+                                          (+ from (random 100))))))
+            (_ (goto-char (point-min))))
+          (setq pos (min pos (point-max)))
+          (let ((bytes (1+ (string-bytes (buffer-substring 1 pos)))))
+            (should (= (position-bytes pos) bytes))
+            (should (= (byte-to-position bytes) pos))))))))
+
 ;;; marker-tests.el ends here
@@ -1133,5 +1133,68 @@ should also run to completion, printing out the line of text it read."
   (process-test--check-pipe-process (:name "test" :buffer "test") t)
   (process-test--check-pipe-process (:name "test" :buffer nil) nil))
 
+(ert-deftest process-tests/use-epoll ()
+  "Check that output of many processes arrives, waiting with epoll or not."
+  (skip-unless (executable-find "cat"))
+  (dolist (process-use-epoll '(t nil))
+    (let ((outputs nil)
+          (procs nil))
+      (unwind-protect
+          (progn
+            (dotimes (round 2)
+              ;; Deleting processes between rounds makes the next ones
+              ;; reuse their descriptors.
+              (mapc #'delete-process procs)
+              (setq procs nil outputs nil)
+              (dotimes (i 20)
+                (let ((proc (make-process
+                             :name (format "cat-%d" i)
+                             :command '("cat")
+                             :connection-type 'pipe
+                             :noquery t
+                             :filter (lambda (proc string)
+                                       (push (cons (process-name proc) string)
+                                             outputs)))))
+                  (push proc procs)
+                  (process-send-string proc (format "%d %d\n" round i))))
+              (with-timeout (10 (ert-fail "Timed out"))
+                (while (< (length outputs) 20)
+                  (accept-process-output nil 0.1)))
+              (dotimes (i 20)
+                (should (equal (cdr (assoc (format "cat-%d" i) outputs))
+                               (format "%d %d\n" round i))))))
+        (mapc #'delete-process procs)))))
+
+(ert-deftest process-tests/insert-split-output ()
+  "Check inserting output that is split in the middle of characters."
+  (skip-unless (executable-find "printf"))
+  (let ((output "h\303\251llo w\303\266rld\r\n\342\202\254\342\202\254\r\nend"))
+    (dolist (fast-read-process-output '(t nil))
+      (dolist (multibyte '(t nil))
+        (with-temp-buffer
+          (set-buffer-multibyte multibyte)
+          (insert "ab")
+          (let* ((read-process-output-max 5)
+                 (marker (copy-marker 3))
+                 (proc (make-process :name "printf"
+                                     :command (list "printf" output)
+                                     :buffer (current-buffer)
+                                     :coding (if multibyte 'utf-8-dos
+                                               'no-conversion)
+                                     :connection-type 'pipe
+                                     :sentinel #'ignore
+                                     :noquery t)))
+            (set-marker (process-mark proc) 3)
+            (with-timeout (10 (ert-fail "Timed out"))
+              (while (accept-process-output proc)))
+            (should (equal (buffer-string)
+                           (if multibyte "abhéllo wörld\n€€\nend"
+                             (concat "ab" (encode-coding-string
+                                           "héllo wörld\r\n€€\r\nend"
+                                           'utf-8)))))
+            ;; Output is inserted before markers.
+            (should (= marker (point-max)))
+            (should (= (process-mark proc) (point-max)))))))))
+
 (provide 'process-tests)
 ;;; process-tests.el ends here
@@ -998,4 +998,37 @@ This evaluates the TESTS test cases from glibc."
   ;; relint suppression: Repetition of expression matching an empty string
   (should (equal (string-match "a*\\(?:c\\|b*\\)*" "a") 0)))
 
+;; Patterns that backtrack exponentially or exhaust the failure stack
+;; unless the matcher falls back to linear-time simulation.  Each entry
+;; is (REGEXP SUBJECT MATCH-END), MATCH-END being nil for no match.
+(defconst regex-tests--pathological
+  (let ((long (make-string 200000 ?a)))
+    `(;; String and comment syntax as used by font-lock.
+      ("\"\\(?:[^\"\\\\]\\|\\\\.\\)*\"" ,(concat "\"" long "\"") 200002)
+      ("/\\*\\(?:[^*]\\|\\*+[^*/]\\)*\\*+/" ,(concat "/*" long "*/") 200004)
+      ;; Nested and ambiguous repetition.
+      ("\\`\\(?:a\\|aa\\)*c" ,(make-string 60 ?a) nil)
+      ("\\`\\(?:a*\\)*b" ,(make-string 60 ?a) nil)
+      ("\\(?:\\s-*\\w+\\)*;" ,(make-string 2000 ?a) nil)
+      ("^\\(?:\\(?:\\sw\\|\\s_\\)+ *\\)*=" ,(make-string 40 ?x) nil)
+      ("\\`\\([a-z]+\\)*\\([0-9]\\)" ,(concat (make-string 40 ?a) "7") 41)))
+  "Regexps that need the linear-time matcher.")
+
+(ert-deftest regexp-tests-pathological ()
+  "Check that pathological regexps neither overflow nor take forever."
+  (dolist (test regex-tests--pathological)
+    (pcase-let ((`(,re ,subject ,end) test))
+      (should (equal (list re (and (string-match re subject) (match-end 0)))
+                     (list re end)))
+      (with-temp-buffer
+        (insert subject)
+        (goto-char (point-min))
+        (should (equal (list re (and (re-search-forward re nil t)
+                                     (1- (point))))
+                       (list re end))))))
+  ;; Submatch data must be the same as with backtracking.
+  (let ((subject (concat (make-string 40 ?a) "7")))
+    (should (string-match "\\`\\([a-z]+\\)*\\([0-9]\\)" subject))
+    (should (equal (match-data) '(0 41 0 40 40 41)))))
+
 ;;; regex-emacs-tests.el ends here
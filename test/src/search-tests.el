@@ -80,3 +80,73 @@
         ))))
 
 ;;; search-tests.el ends here
+
+(ert-deftest search-test--search-across-gap ()
+  "Check plain string search wherever the gap is."
+  (let ((text (concat (make-string 37 ?x) "abc" (make-string 20 ?y)
+                      "ABé" "ABC" (make-string 30 ?z) "aBc" "é")))
+    (with-temp-buffer
+      (insert text)
+      (dotimes (i (1+ (buffer-size)))
+        ;; Leave the gap at position I + 1.
+        (goto-char (1+ i))
+        (insert "_")
+        (delete-char -1)
+        (dolist (case-fold-search '(nil t))
+          (dolist (pattern '("abc" "ABC" "zaB" "Bé" "é" "yyyyyyyyyyyyA"))
+            (let* ((haystack (if case-fold-search (downcase text) text))
+                   (needle (if case-fold-search (downcase pattern) pattern))
+                   (first (string-search needle haystack))
+                   (last (let ((pos nil) (from 0))
+                           (while (setq from (string-search
+                                              needle haystack from))
+                             (setq pos from)
+                             (setq from (1+ from)))
+                           pos)))
+              (goto-char (point-min))
+              (should (equal (search-forward pattern nil t)
+                             (and first (+ first (length pattern) 1))))
+              (goto-char (point-max))
+              (should (equal (search-backward pattern nil t)
+                             (and last (1+ last))))))))
+      ;; A case table where a non-ASCII character folds to an ASCII
+      ;; one needs the general searchers.
+      (erase-buffer)
+      (insert "abc\N{KELVIN SIGN}")
+      (goto-char (point-min))
+      (let ((table (copy-case-table (standard-case-table)))
+            (case-fold-search t))
+        (set-case-syntax-pair ?\N{KELVIN SIGN} ?k table)
+        (with-case-table table
+          (should (equal (search-forward "k" nil t) 5)))))))
+
+(ert-deftest search-test--replace-match-in-place ()
+  "Replacing text by text of the same size need not move the gap."
+  (with-temp-buffer
+    (insert "foo é bar foo\n")
+    (put-text-property 1 4 'face 'bold)
+    (goto-char (point-min))
+    (insert "x")
+    (buffer-enable-undo)
+    (let ((gap (gap-position))
+          (marker (copy-marker 15))
+          (changes nil))
+      (add-hook 'after-change-functions
+                (lambda (beg end len) (push (list beg end len) changes))
+                nil t)
+      (goto-char (point-max))
+      (should (search-backward "foo" nil t))
+      (replace-match "BAR" t t)
+      (should (equal (buffer-string) "xfoo é bar BAR\n"))
+      (should (= (gap-position) gap))
+      (should (= (point) 15))
+      (should (= marker 15))
+      (should (equal changes '((12 15 3))))
+      (goto-char (point-min))
+      (should (search-forward "é" nil t))
+      (replace-match "è" t t)
+      (should (equal (buffer-string) "xfoo è bar BAR\n"))
+      (should (equal (get-text-property 2 'face) 'bold))
+      (should (= (position-bytes (point-max)) 17))
+      (primitive-undo 1 buffer-undo-list)
+      (should (equal (buffer-string) "xfoo é bar foo\n")))))
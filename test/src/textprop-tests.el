@@ -119,5 +119,73 @@
       ;; `inhibit-read-only''s influence towards the end of the buffer.
       (should-error (delete-and-extract-region 26 37)))))
 
+;; Check the summaries of property runs in the interval tree against a
+;; scan of each character.
+(ert-deftest textprop-tests-next-single-property-change-runs ()
+  (random "textprop-runs")
+  (let ((category (make-symbol "category")))
+    (put category 'invisible 'hidden)
+    (with-temp-buffer
+      (insert (make-string 2000 ?x))
+      (dotimes (n 600)
+        (let* ((beg (1+ (random 1999)))
+               (end (min (point-max) (+ beg 1 (random 50)))))
+          (pcase (random 5)
+            (0 (put-text-property beg end 'face (random 3)))
+            (1 (put-text-property beg end 'invisible (nth (random 2) '(t hidden))))
+            (2 (put-text-property beg end 'category category))
+            (3 (remove-text-properties beg end '(invisible nil)))
+            (4 (add-face-text-property beg end 'bold)))
+          (when (zerop (% n 50))
+            (dolist (start '(1 17 500 1999))
+              (let ((value (get-text-property start 'invisible))
+                    (expected nil))
+                (let ((pos (1+ start)))
+                  (while (and (not expected) (< pos (point-max)))
+                    (unless (eq (get-text-property pos 'invisible) value)
+                      (setq expected pos))
+                    (setq pos (1+ pos))))
+                (should (eq (next-single-property-change start 'invisible)
+                            expected))
+                (should (eq (next-single-char-property-change
+                             start 'invisible nil 1000)
+                            (if (and expected (< expected 1000))
+                                expected
+                              1000)))))))))))
+
+;; `add-text-properties-batch' should do what calls to
+;; `add-text-properties' do, but run the change hooks only once.
+(ert-deftest textprop-tests-add-text-properties-batch ()
+  (let ((specs [(2 4 (face bold)) (3 6 (face italic)) (8 9 (x 1 y 2))])
+        (changes nil))
+    (with-temp-buffer
+      (insert "abcdefghij")
+      (add-hook 'after-change-functions
+                (lambda (&rest args) (push args changes)) nil t)
+      (should (add-text-properties-batch specs))
+      (should (equal changes '((2 9 7))))
+      (let ((expected (with-temp-buffer
+                        (insert "abcdefghij")
+                        (seq-doseq (spec specs)
+                          (apply #'add-text-properties spec))
+                        (buffer-string))))
+        (should (equal-including-properties (buffer-string) expected)))
+      ;; Nothing changes if the text already has the properties.
+      (setq changes nil)
+      (set-buffer-modified-p nil)
+      (should-not (add-text-properties-batch [(2 3 (face bold))
+                                              (8 9 (x 1))]))
+      (should-not changes)
+      (should-not (buffer-modified-p))
+      (should-error (add-text-properties-batch [(5 6 (a 1)) (2 3 (b 1))]))
+      (should-error (add-text-properties-batch [(5 60 (a 1))])
+                    :type 'args-out-of-range))
+    (let ((string (copy-sequence "hello world")))
+      (add-text-properties-batch [(0 5 (face bold)) (6 11 (face italic))]
+                                 string)
+      (should (equal-including-properties
+               string
+               #("hello world" 0 5 (face bold) 6 11 (face italic)))))))
+
 (provide 'textprop-tests)
 ;;; textprop-tests.el ends here
@@ -539,5 +539,77 @@ Demonstrates bug 25599."
     (undo-boundary)
     (undo)))
 
+(ert-deftest undo-test-compact-log ()
+  "Test recording changes with `undo-compact-log'."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (setq-local undo-compact-log t)
+    (insert "abc")
+    (insert "def")
+    (undo-boundary)
+    (goto-char 2)
+    (delete-char 1)
+    (delete-char 1)
+    (undo-boundary)
+    (goto-char (point-max))
+    (delete-char -1)
+    (delete-char -1)
+    (undo-boundary)
+    (put-text-property 1 2 'face 'bold)
+    (goto-char 1)
+    (delete-char 1)
+    (should (equal (buffer-string) "d"))
+    (should (equal (last buffer-undo-list 2)
+                   '((1 . 7) (t . 0))))
+    (should (equal (seq-take buffer-undo-list 7)
+                   (list (cons (propertize "a" 'face 'bold) 1)
+                         '(nil face nil 1 . 2)
+                         nil
+                         '("ef" . -3)
+                         2
+                         nil
+                         '("bc" . 2))))
+    ;; Setting the list discards what was not converted yet.
+    (insert "x")
+    (setq buffer-undo-list nil)
+    (should-not buffer-undo-list)
+    (insert "y")
+    (should (equal (car buffer-undo-list) '(2 . 3)))
+    (should-not (member '(1 . 2) buffer-undo-list))))
+
+(ert-deftest undo-test-compact-log-undo ()
+  "Test undoing changes recorded with `undo-compact-log'."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (setq-local undo-compact-log t)
+    (dotimes (i 100)
+      (insert (format "line %d\n" i)))
+    (let ((text (buffer-string))
+          (m (copy-marker 50)))
+      (setq buffer-undo-list nil)
+      (goto-char 40)
+      (dotimes (_ 20)
+        (delete-char 1))
+      (dotimes (_ 5)
+        (delete-char -1))
+      (undo-boundary)
+      (delete-region 200 300)
+      (insert "\u00e9t\u00e9")
+      (undo-boundary)
+      (should (= m 35))
+      (let ((list buffer-undo-list))
+        (while list
+          (setq list (primitive-undo 1 list))))
+      (should (equal (buffer-string) text))
+      (should (= m 50)))
+    ;; The log is truncated like the list.
+    (dotimes (i 100)
+      (insert (format "line %d\n" i))
+      (undo-boundary))
+    (let ((undo-limit 100)
+          (undo-strong-limit 200))
+      (garbage-collect))
+    (should (< (length buffer-undo-list) 20))))
+
 (provide 'undo-tests)
 ;;; undo-tests.el ends here